@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Run the Go microbenchmarks and compare them against the baseline recorded
+# in go/benchmarks/baseline.txt. Pass --update to record a new baseline
+# instead, e.g. after a change that is meant to change performance.
+
+set -e
+cd go
+
+BENCH_ARGS=(-run '^$' -bench . -benchmem -count 5 ./internal/...)
+
+if [ "$1" = "--update" ]; then
+    go test "${BENCH_ARGS[@]}" | tee benchmarks/baseline.txt
+    exit 0
+fi
+
+go test "${BENCH_ARGS[@]}" | tee benchmarks/current.txt
+if command -v benchstat >/dev/null; then
+    benchstat benchmarks/baseline.txt benchmarks/current.txt
+else
+    echo "Install benchstat to compare against the baseline: go install golang.org/x/perf/cmd/benchstat@latest"
+fi
@@ -0,0 +1,197 @@
+package clangd
+
+import (
+	"encoding/json"
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+// Benchmarks of the transport and of hover parsing. They run on responses in
+// testdata, so they need no clangd. Compare runs against the baseline in
+// go/benchmarks.
+//
+// The responses are synthetic rather than captured from clangd. hover.json
+// holds the hover texts of the parser tests, and workspace_symbol.json lists
+// the symbols of the sample project in test/fixtures in clangd's format,
+// written from its sources. Replace them with captures made with
+// CLANGD_DAEMON_LSP_RECORD once clangd is at hand; the baseline has to be
+// recorded again then.
+
+// Returns the contents of a file in testdata
+func loadRecording(tb testing.TB, name string) []byte {
+	tb.Helper()
+	data, err := os.ReadFile(filepath.Join("testdata", name))
+	if err != nil {
+		tb.Fatalf("reading recording: %v", err)
+	}
+	return data
+}
+
+// Returns the recorded hover responses
+func loadHovers(tb testing.TB) []Hover {
+	tb.Helper()
+	var hovers []Hover
+	if err := json.Unmarshal(loadRecording(tb, "hover.json"), &hovers); err != nil {
+		tb.Fatalf("decoding hover.json: %v", err)
+	}
+	return hovers
+}
+
+// Returns recorded results of a small request (a hover) and a large one (a
+// workspace/symbol query matching every symbol of the project)
+func loadPayloads(tb testing.TB) []struct {
+	name    string
+	payload json.RawMessage
+} {
+	tb.Helper()
+	hover, err := json.Marshal(loadHovers(tb)[3])
+	if err != nil {
+		tb.Fatalf("encoding hover: %v", err)
+	}
+	return []struct {
+		name    string
+		payload json.RawMessage
+	}{
+		{"small", hover},
+		{"large", loadRecording(tb, "workspace_symbol.json")},
+	}
+}
+
+// Returns a framed response to request "1" with the result
+func frameResponse(result json.RawMessage) []byte {
+	content := fmt.Sprintf(`{"jsonrpc":"2.0","id":"1","result":%s}`, result)
+	return []byte(fmt.Sprintf("Content-Length: %d\r\n\r\n%s", len(content), content))
+}
+
+// An endless stream of the same data
+type repeatReader struct {
+	data   []byte
+	offset int
+}
+
+func (r *repeatReader) Read(p []byte) (int, error) {
+	n := copy(p, r.data[r.offset:])
+	r.offset = (r.offset + n) % len(r.data)
+	return n, nil
+}
+
+func BenchmarkTransportReadMessage(b *testing.B) {
+	for _, p := range loadPayloads(b) {
+		b.Run(p.name, func(b *testing.B) {
+			frame := frameResponse(p.payload)
+			transport := NewTransport(&repeatReader{data: frame}, io.Discard, io.Discard)
+			b.SetBytes(int64(len(frame)))
+			b.ReportAllocs()
+			b.ResetTimer()
+
+			for i := 0; i < b.N; i++ {
+				if _, err := transport.readMessage(); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
+
+func BenchmarkTransportWriteMessage(b *testing.B) {
+	// A hover request, and opening a document of the size of the large payload
+	small, _ := json.Marshal(HoverParams{
+		TextDocumentPositionParams: TextDocumentPositionParams{
+			TextDocument: TextDocumentIdentifier{URI: "file:///home/user/sample-project/src/core/game_object.cpp"},
+			Position:     Position{Line: 42, Character: 17},
+		},
+	})
+	large, _ := json.Marshal(DidOpenTextDocumentParams{
+		TextDocument: TextDocumentItem{
+			URI:        "file:///home/user/sample-project/src/core/game_object.cpp",
+			LanguageID: "cpp",
+			Version:    1,
+			Text:       string(loadRecording(b, "workspace_symbol.json")),
+		},
+	})
+
+	for _, p := range []struct {
+		name   string
+		params json.RawMessage
+	}{{"small", small}, {"large", large}} {
+		b.Run(p.name, func(b *testing.B) {
+			transport := NewTransport(&repeatReader{data: []byte{0}}, io.Discard, io.Discard)
+			request := Request{Jsonrpc: "2.0", ID: "1", Method: "textDocument/hover", Params: p.params}
+			b.SetBytes(int64(len(p.params)))
+			b.ReportAllocs()
+			b.ResetTimer()
+
+			for i := 0; i < b.N; i++ {
+				if err := transport.writeMessage(request); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
+
+// Sends requests through pipes to a server that answers each with a
+// recorded result, so the whole path of a request is measured: encoding and
+// framing the request, reading and decoding the response and handing it to
+// the waiting request.
+func BenchmarkTransportRoundTrip(b *testing.B) {
+	for _, p := range loadPayloads(b) {
+		b.Run(p.name, func(b *testing.B) {
+			requestsR, requestsW := io.Pipe()
+			responsesR, responsesW := io.Pipe()
+			defer requestsR.Close()
+			defer responsesW.Close()
+
+			transport := NewTransport(responsesR, requestsW, io.Discard)
+			transport.Start()
+
+			// The server side reuses the transport's framing
+			server := NewTransport(requestsR, responsesW, io.Discard)
+			go func() {
+				for {
+					msg, err := server.readMessage()
+					if err != nil {
+						return
+					}
+					var id string
+					json.Unmarshal(msg.ID, &id)
+					if err := server.writeMessage(Response{Jsonrpc: "2.0", ID: id, Result: p.payload}); err != nil {
+						return
+					}
+				}
+			}()
+
+			params := WorkspaceSymbolParams{Query: "Update"}
+			b.SetBytes(int64(len(p.payload)))
+			b.ReportAllocs()
+			b.ResetTimer()
+
+			for i := 0; i < b.N; i++ {
+				if _, err := transport.SendRequest("workspace/symbol", params); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
+
+// Parses every hover response of the corpus once per iteration
+func BenchmarkParseDocumentation(b *testing.B) {
+	hovers := loadHovers(b)
+	var size int64
+	for _, hover := range hovers {
+		size += int64(len(hover.Contents.Value))
+	}
+	b.SetBytes(size)
+	b.ReportAllocs()
+	b.ResetTimer()
+
+	for i := 0; i < b.N; i++ {
+		for _, hover := range hovers {
+			parseDocumentation(hover.Contents.Value)
+		}
+	}
+}
@@ -2,6 +2,7 @@ package clangd
 
 import (
 	"bufio"
+	"context"
 	"encoding/json"
 	"fmt"
 	"io"
@@ -12,16 +13,30 @@ import (
 	"strconv"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"clangd-query/internal/logger"
+	"clangd-query/internal/trace"
 )
 
 // ClangdClient manages a clangd language server subprocess and handles LSP communication.
 // It provides high-level methods for C++ code intelligence operations like finding definitions,
 // references, and symbols. The client maintains the lifecycle of the clangd process and
 // tracks which documents are open to optimize clangd's memory usage.
+//
+// Requests can be made from multiple goroutines concurrently. WithContext
+// returns a client whose requests are cancelled together with a context.
 type ClangdClient struct {
+	*clientState
+
+	// Requests made through this client are cancelled when ctx is done
+	ctx context.Context
+}
+
+// clientState is shared by a client and all clients derived from it with
+// WithContext.
+type clientState struct {
 	cmd           *exec.Cmd
 	transport     *Transport
 	ProjectRoot   string // Exported for commands to access
@@ -29,11 +44,23 @@ type ClangdClient struct {
 	indexingDone  chan struct{}
 	isIndexing    bool
 	indexingMu    sync.RWMutex
-	openDocuments map[string]bool
+	openDocuments map[string]*openDocument
+	documentUse   map[string]time.Time // Last request against each open document
 	docMu         sync.RWMutex
 	capabilities  *ServerCapabilities
 	timeout       time.Duration
 	logger        logger.Logger
+
+	// Called after every request that targets a single document, with the
+	// request's latency. Used by the daemon to track the working set.
+	documentObserver DocumentObserver
+
+	// Results computed ahead of time by Prefetch
+	prefetch *prefetchCache
+
+	// indexGeneration is bumped whenever clangd finishes an indexing pass or
+	// files change on disk. Caches derived from the index compare against it.
+	indexGeneration atomic.Uint64
 }
 
 // Path helper methods
@@ -91,8 +118,9 @@ func (c *ClangdClient) PathFromFileURI(uri string) string {
 // Creates and initializes a new clangd client for the given project.
 // This function starts the clangd subprocess, establishes LSP communication,
 // and waits for initial indexing to complete. The buildDir should contain
-// a compile_commands.json file for accurate code intelligence.
-func NewClangdClient(projectRoot, buildDir string, log logger.Logger) (*ClangdClient, error) {
+// a compile_commands.json file for accurate code intelligence. If recorder
+// is not nil, every message exchanged with clangd is recorded to it.
+func NewClangdClient(projectRoot, buildDir string, recorder *Recorder, log logger.Logger) (*ClangdClient, error) {
 	// Find clangd executable
 	clangdPath, err := exec.LookPath("clangd")
 	if err != nil {
@@ -127,38 +155,66 @@ func NewClangdClient(projectRoot, buildDir string, log logger.Logger) (*ClangdCl
 	}
 
 	transport := NewTransport(stdoutPipe, stdinPipe, os.Stderr)
-
-	client := &ClangdClient{
-		cmd:           cmd,
-		transport:     transport,
-		ProjectRoot:   projectRoot,
-		buildDir:      buildDir,
-		indexingDone:  make(chan struct{}),
-		openDocuments: make(map[string]bool),
-		timeout:       30 * time.Second,
-		logger:        log,
+	if recorder != nil {
+		transport.SetRecorder(recorder)
 	}
+	client := newClient(cmd, transport, projectRoot, buildDir, log)
 
 	// Start goroutine to parse clangd stderr
 	go client.parseClangdLogs(stderrPipe)
 
-	// Register notification handlers
-	client.transport.RegisterNotificationHandler("$/progress", client.handleProgress)
-	client.transport.RegisterNotificationHandler("textDocument/publishDiagnostics", client.handleDiagnostics)
-	client.transport.RegisterNotificationHandler("window/logMessage", client.handleLogMessage)
+	if err := client.start(); err != nil {
+		client.Stop()
+		return nil, fmt.Errorf("failed to initialize clangd: %v", err)
+	}
+
+	return client, nil
+}
 
-	// Start transport
-	client.transport.Start()
+// Creates a client that talks to a language server over the given streams
+// instead of a clangd process it starts itself, e.g. an in-process server
+// answering with recorded responses. The server is initialized like clangd.
+func NewStreamClient(projectRoot, buildDir string, in io.Reader, out io.Writer, log logger.Logger) (*ClangdClient, error) {
+	client := newClient(nil, NewTransport(in, out, os.Stderr), projectRoot, buildDir, log)
 
-	// Initialize
-	if err := client.initialize(); err != nil {
+	if err := client.start(); err != nil {
 		client.Stop()
-		return nil, fmt.Errorf("failed to initialize clangd: %v", err)
+		return nil, fmt.Errorf("failed to initialize language server: %v", err)
 	}
 
 	return client, nil
 }
 
+func newClient(cmd *exec.Cmd, transport *Transport, projectRoot, buildDir string, log logger.Logger) *ClangdClient {
+	return &ClangdClient{
+		clientState: &clientState{
+			cmd:           cmd,
+			transport:     transport,
+			ProjectRoot:   projectRoot,
+			buildDir:      buildDir,
+			indexingDone:  make(chan struct{}),
+			openDocuments: make(map[string]*openDocument),
+			documentUse:   make(map[string]time.Time),
+			timeout:       30 * time.Second,
+			logger:        log,
+			prefetch:      newPrefetchCache(),
+		},
+		ctx: context.Background(),
+	}
+}
+
+// Registers the notification handlers, starts the transport and initializes
+// the server
+func (c *ClangdClient) start() error {
+	c.transport.RegisterNotificationHandler("$/progress", c.handleProgress)
+	c.transport.RegisterNotificationHandler("textDocument/publishDiagnostics", c.handleDiagnostics)
+	c.transport.RegisterNotificationHandler("window/logMessage", c.handleLogMessage)
+
+	c.transport.Start()
+
+	return c.initialize()
+}
+
 // initialize sends the initialize request to clangd
 func (c *ClangdClient) initialize() error {
 	pid := os.Getpid()
@@ -280,6 +336,9 @@ func (c *ClangdClient) handleProgress(params json.RawMessage) {
 			c.isIndexing = true
 		}
 	} else if progress.Value.Kind == "end" {
+		// Results prefetched while clangd indexed may be incomplete
+		c.indexGeneration.Add(1)
+		c.prefetch.clear()
 		if c.isIndexing {
 			c.isIndexing = false
 			select {
@@ -302,37 +361,178 @@ func (c *ClangdClient) handleLogMessage(params json.RawMessage) {
 	// We ignore log messages for now
 }
 
+// Returns a counter that changes whenever the symbol index may have changed,
+// either because clangd finished an indexing pass or because files changed.
+func (c *ClangdClient) IndexGeneration() uint64 {
+	return c.indexGeneration.Load()
+}
+
 // WaitForIndexing waits for clangd to finish indexing
 func (c *ClangdClient) WaitForIndexing() {
 	select {
 	case <-c.indexingDone:
+	case <-c.ctx.Done():
 	case <-time.After(5 * time.Second):
 		// Timeout - assume indexing is done or not needed
 	}
 }
 
+// Returns the process ID of clangd, 0 for a client created with
+// NewStreamClient
+func (c *ClangdClient) PID() int {
+	if c.cmd == nil {
+		return 0
+	}
+	return c.cmd.Process.Pid
+}
+
+// Returns a channel that is closed when the connection to clangd is lost,
+// because clangd exited, crashed or was stopped
+func (c *ClangdClient) Done() <-chan struct{} {
+	return c.transport.Done()
+}
+
+// Returns true while clangd reports background indexing in progress
+func (c *ClangdClient) IsIndexing() bool {
+	c.indexingMu.Lock()
+	defer c.indexingMu.Unlock()
+	return c.isIndexing
+}
+
+// Returns a client that shares clangd and all state with c, but whose
+// requests are cancelled when ctx is done. Cancelled requests are abandoned
+// with $/cancelRequest so clangd stops working on them.
+func (c *ClangdClient) WithContext(ctx context.Context) *ClangdClient {
+	return &ClangdClient{clientState: c.clientState, ctx: ctx}
+}
+
+// Reads a source file, timing the read in the trace of the client's context
+func (c *ClangdClient) ReadFile(path string) ([]byte, error) {
+	_, span := trace.Start(c.ctx, "os.ReadFile", "io")
+	defer span.End()
+	span.SetArg("path", path)
+	return os.ReadFile(path)
+}
+
+// Returns how many clangd requests were cancelled because their context was
+// done or they timed out.
+func (c *ClangdClient) CancelledRequests() int64 {
+	return c.transport.CancelledRequests()
+}
+
 // Sends a request to clangd and waits for the response.
 // The underlying transport handles timeouts (30 seconds by default), so this method
 // will not block indefinitely. If the connection to clangd is lost, this method
 // returns an error immediately rather than attempting to reconnect.
 func (c *ClangdClient) sendRequest(method string, params interface{}) (json.RawMessage, error) {
-	result, err := c.transport.SendRequest(method, params)
+	result, err := c.transport.SendRequestContext(c.ctx, method, params)
 	if err != nil {
-		c.logger.Error("Request %s failed: %v", method, err)
+		if c.ctx.Err() != nil {
+			c.logger.Debug("Request %s cancelled: %v", method, err)
+		} else {
+			c.logger.Error("Request %s failed: %v", method, err)
+		}
+	}
+	return result, err
+}
+
+// DocumentObserver is notified about every request clangd answered for a
+// specific document and how long it took.
+type DocumentObserver func(uri string, method string, latency time.Duration)
+
+// Registers an observer for per-document requests. Must be called before the
+// client is used concurrently.
+func (c *ClangdClient) SetDocumentObserver(observer DocumentObserver) {
+	c.documentObserver = observer
+}
+
+// Sends a request that targets a single document and reports its latency to
+// the document observer, if any. Results computed by Prefetch are served
+// without a round trip to clangd.
+func (c *ClangdClient) sendDocumentRequest(uri string, method string, params interface{}) (json.RawMessage, error) {
+	start := time.Now()
+	c.recordDependency(uri)
+	c.touchDocument(uri)
+
+	if key, ok := prefetchKey(method, params); ok {
+		if cached, hit := c.prefetch.lookup(key); hit {
+			if c.documentObserver != nil {
+				c.documentObserver(uri, method, time.Since(start))
+			}
+			return cached, nil
+		}
+	}
+
+	result, err := c.sendRequest(method, params)
+	if err == nil && c.documentObserver != nil {
+		c.documentObserver(uri, method, time.Since(start))
 	}
 	return result, err
 }
 
+// Speculatively sends a request for a document and keeps the result, so a
+// later interactive request with the same method and params is answered
+// without waiting for clangd. Only per-document methods can be prefetched.
+// Returns the (possibly already cached) result so callers can derive further
+// prefetches from it.
+func (c *ClangdClient) Prefetch(uri string, method string, params interface{}) (json.RawMessage, error) {
+	key, ok := prefetchKey(method, params)
+	if !ok {
+		return nil, fmt.Errorf("method %s cannot be prefetched", method)
+	}
+
+	if cached, ok := c.prefetch.peek(key); ok {
+		return cached, nil
+	}
+
+	if err := c.OpenDocument(uri); err != nil {
+		return nil, err
+	}
+
+	generation := c.indexGeneration.Load()
+	result, err := c.sendRequest(method, params)
+	if err != nil {
+		return nil, err
+	}
+
+	// Files changed while the request was in flight, the result may be stale
+	if c.indexGeneration.Load() == generation {
+		c.prefetch.store(key, result)
+	}
+	return result, nil
+}
+
+// Returns statistics about prefetched results and how often they were used.
+func (c *ClangdClient) PrefetchStats() PrefetchStats {
+	return c.prefetch.snapshot()
+}
+
+// openDocument is the content of a document as clangd last saw it. Its
+// mutex orders the notifications sent for the document.
+type openDocument struct {
+	mu      sync.Mutex
+	text    string
+	version int
+	closed  bool
+}
+
 // OpenDocument opens a document in clangd
 func (c *ClangdClient) OpenDocument(uri string) error {
 	c.docMu.Lock()
-	if c.openDocuments[uri] {
+	if c.openDocuments[uri] != nil {
 		c.docMu.Unlock()
 		return nil // Already open
 	}
-	c.openDocuments[uri] = true
+	doc := &openDocument{version: 1}
+	doc.mu.Lock()
+	defer doc.mu.Unlock()
+	c.openDocuments[uri] = doc
+	c.documentUse[uri] = time.Now()
 	c.docMu.Unlock()
 
+	_, span := trace.Start(c.ctx, "textDocument/didOpen", "lsp")
+	defer span.End()
+
 	// Read file content
 	path := c.PathFromFileURI(uri)
 	content, err := os.ReadFile(path)
@@ -340,31 +540,91 @@ func (c *ClangdClient) OpenDocument(uri string) error {
 		c.docMu.Lock()
 		delete(c.openDocuments, uri)
 		c.docMu.Unlock()
+		doc.closed = true
 		return err
 	}
+	doc.text = string(content)
 
 	params := DidOpenTextDocumentParams{
 		TextDocument: TextDocumentItem{
 			URI:        uri,
 			LanguageID: getLanguageID(path),
-			Version:    1,
-			Text:       string(content),
+			Version:    doc.version,
+			Text:       doc.text,
 		},
 	}
 
 	return c.transport.SendNotification("textDocument/didOpen", params)
 }
 
+// UpdateDocument sends the current content of an open document's file to
+// clangd. Unlike closing and reopening the document, this keeps clangd's
+// state for it: only the changed region is sent, and if it doesn't touch the
+// includes, clangd reuses the document's preamble. Does nothing if the
+// document isn't open or its content didn't change.
+func (c *ClangdClient) UpdateDocument(uri string) error {
+	content, err := os.ReadFile(c.PathFromFileURI(uri))
+	if err != nil {
+		return err
+	}
+	return c.ChangeDocument(uri, string(content))
+}
+
+// ChangeDocument replaces the content of an open document in clangd with
+// text, see UpdateDocument
+func (c *ClangdClient) ChangeDocument(uri string, text string) error {
+	c.docMu.RLock()
+	doc := c.openDocuments[uri]
+	c.docMu.RUnlock()
+	if doc == nil {
+		return nil
+	}
+
+	doc.mu.Lock()
+	defer doc.mu.Unlock()
+	if doc.closed || doc.text == text {
+		return nil
+	}
+
+	var change TextDocumentContentChangeEvent
+	if textDocumentSyncKind(c.capabilities) == TextDocumentSyncIncremental {
+		change = computeEdit(doc.text, text)
+	} else {
+		change = TextDocumentContentChangeEvent{Text: text}
+	}
+	doc.text = text
+	doc.version++
+
+	params := DidChangeTextDocumentParams{
+		TextDocument: VersionedTextDocumentIdentifier{
+			TextDocumentIdentifier: TextDocumentIdentifier{URI: uri},
+			Version:                doc.version,
+		},
+		ContentChanges: []TextDocumentContentChangeEvent{change},
+	}
+	return c.transport.SendNotification("textDocument/didChange", params)
+}
+
 // CloseDocument closes a document in clangd
 func (c *ClangdClient) CloseDocument(uri string) error {
 	c.docMu.Lock()
-	if !c.openDocuments[uri] {
+	doc := c.openDocuments[uri]
+	if doc == nil {
 		c.docMu.Unlock()
 		return nil // Not open
 	}
 	delete(c.openDocuments, uri)
+	delete(c.documentUse, uri)
 	c.docMu.Unlock()
 
+	// After any notification for the document that is being sent
+	doc.mu.Lock()
+	defer doc.mu.Unlock()
+	if doc.closed {
+		return nil
+	}
+	doc.closed = true
+
 	params := DidCloseTextDocumentParams{
 		TextDocument: TextDocumentIdentifier{
 			URI: uri,
@@ -374,6 +634,33 @@ func (c *ClangdClient) CloseDocument(uri string) error {
 	return c.transport.SendNotification("textDocument/didClose", params)
 }
 
+// Records a request against an open document
+func (c *ClangdClient) touchDocument(uri string) {
+	c.docMu.Lock()
+	defer c.docMu.Unlock()
+	if c.openDocuments[uri] != nil {
+		c.documentUse[uri] = time.Now()
+	}
+}
+
+// Closes the open documents that no request used within idle, so clangd can
+// free their ASTs. Returns the number of documents closed.
+func (c *ClangdClient) CloseColdDocuments(idle time.Duration) int {
+	c.docMu.RLock()
+	var cold []string
+	for uri := range c.openDocuments {
+		if time.Since(c.documentUse[uri]) >= idle {
+			cold = append(cold, uri)
+		}
+	}
+	c.docMu.RUnlock()
+
+	for _, uri := range cold {
+		c.CloseDocument(uri)
+	}
+	return len(cold)
+}
+
 // GetDefinition gets the definition location for a symbol
 func (c *ClangdClient) GetDefinition(uri string, position Position) ([]Location, error) {
 	if err := c.OpenDocument(uri); err != nil {
@@ -387,7 +674,7 @@ func (c *ClangdClient) GetDefinition(uri string, position Position) ([]Location,
 		},
 	}
 
-	result, err := c.sendRequest("textDocument/definition", params)
+	result, err := c.sendDocumentRequest(uri, "textDocument/definition", params)
 	if err != nil {
 		return nil, err
 	}
@@ -397,12 +684,14 @@ func (c *ClangdClient) GetDefinition(uri string, position Position) ([]Location,
 
 	// Try as array first
 	if err := json.Unmarshal(result, &locations); err == nil {
+		c.recordLocations(locations)
 		return locations, nil
 	}
 
 	// Try as single location
 	var location Location
 	if err := json.Unmarshal(result, &location); err == nil {
+		c.recordDependency(location.URI)
 		return []Location{location}, nil
 	}
 
@@ -422,7 +711,7 @@ func (c *ClangdClient) GetDeclaration(uri string, position Position) ([]Location
 		},
 	}
 
-	result, err := c.sendRequest("textDocument/declaration", params)
+	result, err := c.sendDocumentRequest(uri, "textDocument/declaration", params)
 	if err != nil {
 		return nil, err
 	}
@@ -432,12 +721,14 @@ func (c *ClangdClient) GetDeclaration(uri string, position Position) ([]Location
 
 	// Try as array first
 	if err := json.Unmarshal(result, &locations); err == nil {
+		c.recordLocations(locations)
 		return locations, nil
 	}
 
 	// Try as single location
 	var location Location
 	if err := json.Unmarshal(result, &location); err == nil {
+		c.recordDependency(location.URI)
 		return []Location{location}, nil
 	}
 
@@ -460,7 +751,7 @@ func (c *ClangdClient) GetReferences(uri string, position Position, includeDecla
 		},
 	}
 
-	result, err := c.sendRequest("textDocument/references", params)
+	result, err := c.sendDocumentRequest(uri, "textDocument/references", params)
 	if err != nil {
 		return nil, err
 	}
@@ -470,6 +761,7 @@ func (c *ClangdClient) GetReferences(uri string, position Position, includeDecla
 		return nil, err
 	}
 
+	c.recordLocations(locations)
 	return locations, nil
 }
 
@@ -486,7 +778,7 @@ func (c *ClangdClient) GetHover(uri string, position Position) (*Hover, error) {
 		},
 	}
 
-	result, err := c.sendRequest("textDocument/hover", params)
+	result, err := c.sendDocumentRequest(uri, "textDocument/hover", params)
 	if err != nil {
 		return nil, err
 	}
@@ -509,7 +801,7 @@ func (c *ClangdClient) GetDocumentSymbols(uri string) ([]DocumentSymbol, error)
 		TextDocument: TextDocumentIdentifier{URI: uri},
 	}
 
-	result, err := c.sendRequest("textDocument/documentSymbol", params)
+	result, err := c.sendDocumentRequest(uri, "textDocument/documentSymbol", params)
 	if err != nil {
 		return nil, err
 	}
@@ -532,7 +824,7 @@ func (c *ClangdClient) GetFoldingRanges(uri string) ([]FoldingRange, error) {
 		TextDocument: TextDocumentIdentifier{URI: uri},
 	}
 
-	result, err := c.sendRequest("textDocument/foldingRange", params)
+	result, err := c.sendDocumentRequest(uri, "textDocument/foldingRange", params)
 	if err != nil {
 		return nil, err
 	}
@@ -563,9 +855,58 @@ func (c *ClangdClient) WorkspaceSymbol(query string) ([]WorkspaceSymbol, error)
 		return nil, err
 	}
 
+	for _, symbol := range symbols {
+		c.recordDependency(symbol.Location.URI)
+	}
 	return symbols, nil
 }
 
+// Seed queries used to enumerate the whole workspace index. clangd's index
+// matches short queries against the first character of each identifier, so
+// one query per possible leading character covers every named symbol.
+const allSymbolsSeeds = "abcdefghijklmnopqrstuvwxyz_~"
+
+// AllWorkspaceSymbols enumerates every symbol in clangd's index by issuing one
+// unlimited workspace/symbol query per leading identifier character and
+// merging the results. This is expensive on large projects and is meant for
+// building daemon-side indexes, not for interactive lookups.
+func (c *ClangdClient) AllWorkspaceSymbols() ([]WorkspaceSymbol, error) {
+	c.WaitForIndexing()
+
+	unlimited := 0
+	seen := make(map[string]bool)
+	var all []WorkspaceSymbol
+
+	for _, seed := range allSymbolsSeeds {
+		params := WorkspaceSymbolParams{
+			Query: string(seed),
+			Limit: &unlimited,
+		}
+
+		result, err := c.sendRequest("workspace/symbol", params)
+		if err != nil {
+			return nil, err
+		}
+
+		var symbols []WorkspaceSymbol
+		if err := json.Unmarshal(result, &symbols); err != nil {
+			return nil, err
+		}
+
+		for _, symbol := range symbols {
+			key := fmt.Sprintf("%s|%s|%s:%d:%d", symbol.ContainerName, symbol.Name,
+				symbol.Location.URI, symbol.Location.Range.Start.Line, symbol.Location.Range.Start.Character)
+			if seen[key] {
+				continue
+			}
+			seen[key] = true
+			all = append(all, symbol)
+		}
+	}
+
+	return all, nil
+}
+
 // PrepareTypeHierarchy prepares type hierarchy for a position
 func (c *ClangdClient) PrepareTypeHierarchy(uri string, position Position) ([]TypeHierarchyItem, error) {
 	if err := c.OpenDocument(uri); err != nil {
@@ -579,7 +920,7 @@ func (c *ClangdClient) PrepareTypeHierarchy(uri string, position Position) ([]Ty
 		},
 	}
 
-	result, err := c.sendRequest("textDocument/prepareTypeHierarchy", params)
+	result, err := c.sendDocumentRequest(uri, "textDocument/prepareTypeHierarchy", params)
 	if err != nil {
 		return nil, err
 	}
@@ -589,6 +930,9 @@ func (c *ClangdClient) PrepareTypeHierarchy(uri string, position Position) ([]Ty
 		return nil, err
 	}
 
+	for _, item := range items {
+		c.recordDependency(item.URI)
+	}
 	return items, nil
 }
 
@@ -608,6 +952,9 @@ func (c *ClangdClient) GetSupertypes(item TypeHierarchyItem) ([]TypeHierarchyIte
 		return nil, err
 	}
 
+	for _, item := range items {
+		c.recordDependency(item.URI)
+	}
 	return items, nil
 }
 
@@ -627,32 +974,56 @@ func (c *ClangdClient) GetSubtypes(item TypeHierarchyItem) ([]TypeHierarchyItem,
 		return nil, err
 	}
 
+	for _, item := range items {
+		c.recordDependency(item.URI)
+	}
 	return items, nil
 }
 
-// OnFilesChanged handles file change notifications
-func (c *ClangdClient) OnFilesChanged(files []string) {
-	// Implement the close/reopen workaround for reindexing
-	for _, file := range files {
-		uri := c.FileURIFromPath(file)
+// OnFilesChanged handles file change notifications. Open documents are
+// handled first, since they are the ones queries are about to use; clangd
+// rebuilds them right away and indexes the rest in the order given.
+func (c *ClangdClient) OnFilesChanged(changes []FileChange) {
+	c.indexGeneration.Add(1)
+	c.prefetch.clear()
 
-		c.docMu.RLock()
-		isOpen := c.openDocuments[uri]
-		c.docMu.RUnlock()
+	c.docMu.RLock()
+	isOpen := make([]bool, len(changes))
+	for i, change := range changes {
+		isOpen[i] = c.openDocuments[c.FileURIFromPath(change.Path)] != nil
+	}
+	c.docMu.RUnlock()
 
-		if isOpen {
-			// Close and reopen to force reindexing
+	ordered := make([]FileChange, 0, len(changes))
+	for i, change := range changes {
+		if isOpen[i] {
+			ordered = append(ordered, change)
+		}
+	}
+	openCount := len(ordered)
+	for i, change := range changes {
+		if !isOpen[i] {
+			ordered = append(ordered, change)
+		}
+	}
+
+	// Send open documents their new content, so clangd rebuilds them
+	for _, change := range ordered[:openCount] {
+		uri := c.FileURIFromPath(change.Path)
+		if change.Type == FileChangeTypeDeleted {
+			c.CloseDocument(uri)
+		} else if err := c.UpdateDocument(uri); err != nil {
+			c.logger.Debug("Failed to update %s, closing it: %v", change.Path, err)
 			c.CloseDocument(uri)
-			c.OpenDocument(uri)
 		}
 	}
 
 	// Also send didChangeWatchedFiles notification
-	events := make([]FileEvent, len(files))
-	for i, file := range files {
+	events := make([]FileEvent, len(ordered))
+	for i, change := range ordered {
 		events[i] = FileEvent{
-			URI:  c.FileURIFromPath(file),
-			Type: FileChangeTypeChanged,
+			URI:  c.FileURIFromPath(change.Path),
+			Type: change.Type,
 		}
 	}
 
@@ -663,6 +1034,19 @@ func (c *ClangdClient) OnFilesChanged(files []string) {
 	c.transport.SendNotification("workspace/didChangeWatchedFiles", params)
 }
 
+// UpdateCompileCommands tells clangd the new compile commands of files, keyed
+// by absolute path. clangd rebuilds open files and reindexes the affected
+// translation units; other files keep their ASTs and index.
+func (c *ClangdClient) UpdateCompileCommands(commands map[string]CompileCommand) error {
+	c.indexGeneration.Add(1)
+	c.prefetch.clear()
+
+	params := DidChangeConfigurationParams{
+		Settings: ClangdSettings{CompilationDatabaseChanges: commands},
+	}
+	return c.transport.SendNotification("workspace/didChangeConfiguration", params)
+}
+
 // Shutdown sends the shutdown request
 func (c *ClangdClient) Shutdown() error {
 	_, err := c.sendRequest("shutdown", ShutdownParams{})
@@ -727,6 +1111,9 @@ func (c *ClangdClient) Stop() error {
 	if err := c.Exit(); err != nil {
 		c.logger.Debug("Exit notification failed: %v", err)
 	}
+	if c.cmd == nil {
+		return nil
+	}
 
 	// Give it time to exit
 	done := make(chan error, 1)
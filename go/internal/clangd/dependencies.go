@@ -0,0 +1,61 @@
+package clangd
+
+import (
+	"context"
+	"sort"
+	"sync"
+)
+
+// DependencySet collects the files a command's results were computed from:
+// every document a request targeted and every file a returned location points
+// into. Caches use it to decide when a stored result is no longer valid.
+type DependencySet struct {
+	mu    sync.Mutex
+	paths map[string]bool
+}
+
+type dependencySetKey struct{}
+
+// Creates an empty dependency set
+func NewDependencySet() *DependencySet {
+	return &DependencySet{paths: make(map[string]bool)}
+}
+
+// Returns a context that makes clients created with WithContext record their
+// dependencies in set.
+func WithDependencySet(ctx context.Context, set *DependencySet) context.Context {
+	return context.WithValue(ctx, dependencySetKey{}, set)
+}
+
+// Adds an absolute file path to the set
+func (s *DependencySet) Add(path string) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	s.paths[path] = true
+}
+
+// Returns the recorded paths, sorted
+func (s *DependencySet) Paths() []string {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	paths := make([]string, 0, len(s.paths))
+	for path := range s.paths {
+		paths = append(paths, path)
+	}
+	sort.Strings(paths)
+	return paths
+}
+
+// Records a file URI in the dependency set of the client's context, if any
+func (c *ClangdClient) recordDependency(uri string) {
+	if set, ok := c.ctx.Value(dependencySetKey{}).(*DependencySet); ok && uri != "" {
+		set.Add(c.PathFromFileURI(uri))
+	}
+}
+
+func (c *ClangdClient) recordLocations(locations []Location) {
+	for _, location := range locations {
+		c.recordDependency(location.URI)
+	}
+}
@@ -2,6 +2,7 @@ package clangd
 
 import (
 	"bufio"
+	"context"
 	"encoding/json"
 	"errors"
 	"fmt"
@@ -11,6 +12,8 @@ import (
 	"sync"
 	"sync/atomic"
 	"time"
+
+	"clangd-query/internal/trace"
 )
 
 // Request represents a JSON-RPC 2.0 request message that expects a response.
@@ -59,6 +62,9 @@ const (
 	InternalError  = -32603 // Internal JSON-RPC error
 )
 
+// Upper bound on the size of a single message payload from clangd.
+const maxMessageSize = 256 * 1024 * 1024
+
 // Common transport errors that can occur during JSON-RPC communication.
 // These are transport-level errors, distinct from JSON-RPC protocol errors.
 var (
@@ -66,30 +72,65 @@ var (
 	ErrTimeout          = errors.New("request timeout")
 )
 
-// Transport manages synchronous JSON-RPC 2.0 communication over stdin/stdout.
-// It implements a simple request-response model where each request blocks until
-// its response is received. This design eliminates complexity around concurrent
-// request tracking while still supporting asynchronous notifications from the server.
+// Notifications read but not yet handled, before reading waits for the
+// handlers. Bounds the memory a flood of notifications can take.
+const notificationQueueSize = 1024
+
+// Default time to wait for a response before giving up on a request.
+const requestTimeout = 30 * time.Second
+
+// Transport manages JSON-RPC 2.0 communication over stdin/stdout.
+// Requests from multiple goroutines can be in flight at the same time: each
+// request registers a channel under its ID, and a single reader goroutine
+// started by Start routes every response to the channel of the request it
+// answers. clangd processes requests concurrently, so a slow request (for
+// example references of a hot symbol) no longer holds up cheap ones.
 //
-// The transport ensures thread-safety by serializing all requests through a mutex,
-// making it impossible to have response mismatches or race conditions.
+// Writes are serialized through a mutex so framed messages never interleave.
+// Requests can be abandoned through their context, in which case clangd is
+// told to stop working on them with $/cancelRequest.
 type Transport struct {
 	reader *bufio.Reader
 	writer io.Writer
 	stderr io.Writer
 
-	nextID int64      // Atomic counter for generating unique request IDs
-	mu     sync.Mutex // Serializes all requests and protects the closed flag
-	closed bool       // Set to true when the connection fails or closes
+	nextID  int64      // Atomic counter for generating unique request IDs
+	writeMu sync.Mutex // Serializes writes of framed messages
+
+	mu      sync.Mutex                // Protects pending and closed
+	pending map[string]chan *Response // Response channels of in-flight requests by ID
+	closed  bool                      // Set to true when the connection fails or closes
+	done    chan struct{}             // Closed together with closed being set
 
-	handlers   map[string]NotificationHandler // Registered handlers for server notifications
-	handlersMu sync.RWMutex                   // Protects the handlers map
+	cancelled atomic.Int64 // Number of requests abandoned with $/cancelRequest
+
+	handlers      map[string]NotificationHandler // Registered handlers for server notifications
+	handlersMu    sync.RWMutex                   // Protects the handlers map
+	notifications chan *Notification             // Queue of notifications for their handlers
+
+	recorder *Recorder // Records every message if set
 }
 
 // NotificationHandler processes incoming notifications from the server.
-// Handlers are called asynchronously when notifications arrive.
+// Handlers are called one at a time in the order the notifications arrive,
+// on a goroutine of their own so they don't hold up responses.
 type NotificationHandler func(params json.RawMessage)
 
+// Any message read from the server. Responses have an ID and no method,
+// notifications have a method and no ID, requests from the server have both.
+type incomingMessage struct {
+	ID     json.RawMessage `json:"id,omitempty"`
+	Method string          `json:"method,omitempty"`
+	Params json.RawMessage `json:"params,omitempty"`
+	Result json.RawMessage `json:"result,omitempty"`
+	Error  *Error          `json:"error,omitempty"`
+}
+
+// Params of the $/cancelRequest notification
+type cancelParams struct {
+	ID string `json:"id"`
+}
+
 // Creates a new Transport for JSON-RPC communication.
 // The stdin parameter is used for reading responses and notifications,
 // stdout for writing requests and notifications, and stderr for error logging.
@@ -98,13 +139,17 @@ func NewTransport(stdin io.Reader, stdout, stderr io.Writer) *Transport {
 		reader:   bufio.NewReader(stdin),
 		writer:   stdout,
 		stderr:   stderr,
+		pending:  make(map[string]chan *Response),
+		done:     make(chan struct{}),
 		handlers: make(map[string]NotificationHandler),
+		// Once full, reading from the server waits for the handlers
+		notifications: make(chan *Notification, notificationQueueSize),
 	}
 }
 
 // Registers a handler for a specific notification method.
 // When a notification with the given method name arrives from the server,
-// the handler will be called asynchronously with the notification parameters.
+// the handler will be called with the notification parameters.
 // Only one handler can be registered per method; subsequent registrations
 // will replace the previous handler.
 func (t *Transport) RegisterNotificationHandler(method string, handler NotificationHandler) {
@@ -114,18 +159,24 @@ func (t *Transport) RegisterNotificationHandler(method string, handler Notificat
 }
 
 // Sends a JSON-RPC request and blocks until the response is received.
-// This method is thread-safe and ensures that only one request is in flight at a time.
-// The method automatically generates a unique ID for request correlation and handles
-// timeout (30 seconds) to prevent indefinite blocking. Any notifications received
-// while waiting for the response are dispatched to their registered handlers.
+// Equivalent to SendRequestContext with a background context.
 func (t *Transport) SendRequest(method string, params interface{}) (json.RawMessage, error) {
-	t.mu.Lock()
-	defer t.mu.Unlock()
+	return t.SendRequestContext(context.Background(), method, params)
+}
 
-	if t.closed {
-		return nil, ErrConnectionClosed
+// Sends a JSON-RPC request and blocks until the response is received, the
+// context is done or the request times out (30 seconds). This method is
+// thread-safe and any number of requests can be in flight at once. When the
+// context is done or the request times out, the server is sent a
+// $/cancelRequest for it and the context's error or ErrTimeout is returned.
+func (t *Transport) SendRequestContext(ctx context.Context, method string, params interface{}) (json.RawMessage, error) {
+	if err := ctx.Err(); err != nil {
+		return nil, err
 	}
 
+	_, span := trace.Start(ctx, method, "lsp")
+	defer span.End()
+
 	// Generate unique string ID to avoid JSON number type ambiguity
 	id := strconv.FormatInt(atomic.AddInt64(&t.nextID, 1), 10)
 
@@ -141,60 +192,73 @@ func (t *Transport) SendRequest(method string, params interface{}) (json.RawMess
 		Params:  paramsJSON,
 	}
 
-	// Write the request to the output stream
+	// Register before writing so a fast response can't arrive unclaimed
+	done := make(chan *Response, 1)
+	t.mu.Lock()
+	if t.closed {
+		t.mu.Unlock()
+		return nil, ErrConnectionClosed
+	}
+	t.pending[id] = done
+	t.mu.Unlock()
+
 	if err := t.writeMessage(req); err != nil {
-		t.closed = true
+		t.close()
 		return nil, fmt.Errorf("Error writing request: %w", err)
 	}
 
-	// Read the response in a goroutine to implement timeout
-	type result struct {
-		resp *Response
-		err  error
-	}
-	done := make(chan result, 1)
-
-	go func() {
-		resp, err := t.readResponse(id)
-		select {
-		case done <- result{resp, err}:
-		default:
-			// Timeout already occurred, discard result
-		}
-	}()
+	timer := time.NewTimer(requestTimeout)
+	defer timer.Stop()
 
-	// Block until we get a response or timeout
 	select {
-	case r := <-done:
-		if r.err != nil {
-			if errors.Is(r.err, io.EOF) || errors.Is(r.err, io.ErrUnexpectedEOF) {
-				t.closed = true
-				return nil, ErrConnectionClosed
-			}
-			return nil, r.err
+	case resp, ok := <-done:
+		if !ok {
+			return nil, ErrConnectionClosed
 		}
-
-		if r.resp.Error != nil {
-			return nil, fmt.Errorf("RPC error %d: %s", r.resp.Error.Code, r.resp.Error.Message)
+		if resp.Error != nil {
+			span.SetArg("error", resp.Error.Message)
+			return nil, fmt.Errorf("RPC error %d: %s", resp.Error.Code, resp.Error.Message)
 		}
+		return resp.Result, nil
 
-		return r.resp.Result, nil
+	case <-ctx.Done():
+		span.SetArg("error", "cancelled")
+		t.cancel(id)
+		return nil, ctx.Err()
 
-	case <-time.After(30 * time.Second):
-		t.closed = true
+	case <-timer.C:
+		span.SetArg("error", "timed out")
+		t.cancel(id)
 		return nil, ErrTimeout
 	}
 }
 
+// Abandons an in-flight request and asks the server to stop working on it.
+// A response that still arrives afterwards is discarded by the reader.
+func (t *Transport) cancel(id string) {
+	t.mu.Lock()
+	delete(t.pending, id)
+	t.mu.Unlock()
+
+	t.cancelled.Add(1)
+	t.SendNotification("$/cancelRequest", cancelParams{ID: id})
+}
+
+// Returns how many requests were abandoned with $/cancelRequest because their
+// context was done or they timed out.
+func (t *Transport) CancelledRequests() int64 {
+	return t.cancelled.Load()
+}
+
 // Sends a notification to the server without expecting a response.
 // Notifications are fire-and-forget messages used for events like
 // file opened/closed notifications. This method returns immediately
 // after writing the notification to the output stream.
 func (t *Transport) SendNotification(method string, params interface{}) error {
 	t.mu.Lock()
-	defer t.mu.Unlock()
-
-	if t.closed {
+	closed := t.closed
+	t.mu.Unlock()
+	if closed {
 		return ErrConnectionClosed
 	}
 
@@ -210,60 +274,110 @@ func (t *Transport) SendNotification(method string, params interface{}) error {
 	}
 
 	if err := t.writeMessage(notif); err != nil {
-		t.closed = true
+		t.close()
 		return fmt.Errorf("Error writing notification: %w", err)
 	}
 
 	return nil
 }
 
-// Placeholder for notification reader initialization.
-// In this synchronous implementation, notifications are processed inline
-// while waiting for responses, avoiding the need for a separate reader goroutine.
-// This design prevents reader conflicts and simplifies the implementation.
+// Records every message sent and received from now on. Must be called before
+// Start. The transport closes the recorder when the connection closes.
+func (t *Transport) SetRecorder(recorder *Recorder) {
+	t.recorder = recorder
+}
+
+// Starts the reader goroutine that routes responses to waiting requests and
+// dispatches notifications. Must be called before the first request.
 func (t *Transport) Start() {
-	// Notifications are handled during readResponse, not in a separate goroutine
+	go t.readLoop()
+	go t.dispatchNotifications()
 }
 
-// Reads messages from the input stream until it finds a response with the expected ID.
-// Any notifications encountered while waiting are dispatched to their handlers.
-// This approach ensures we never miss notifications even while waiting for a response.
-func (t *Transport) readResponse(expectedID string) (*Response, error) {
+// Reads messages until the input stream fails or closes. Responses are handed
+// to the request waiting for them; notifications are dispatched to their
+// handlers. When reading fails, all pending requests fail with
+// ErrConnectionClosed.
+func (t *Transport) readLoop() {
 	for {
 		msg, err := t.readMessage()
 		if err != nil {
-			return nil, err
+			if !errors.Is(err, io.EOF) && !errors.Is(err, io.ErrUnexpectedEOF) {
+				fmt.Fprintf(t.stderr, "Error reading from clangd: %v\n", err)
+			}
+			t.close()
+			close(t.notifications)
+			return
 		}
 
-		// Found the response we're waiting for
-		if id, ok := msg["id"].(string); ok && id == expectedID {
-			var resp Response
-			data, _ := json.Marshal(msg)
-			if err := json.Unmarshal(data, &resp); err != nil {
-				return nil, fmt.Errorf("Error decoding response: %w", err)
+		switch {
+		case msg.Method == "" && len(msg.ID) > 0:
+			t.dispatchResponse(msg)
+
+		case msg.Method != "" && len(msg.ID) == 0:
+			notif := &Notification{
+				Jsonrpc: "2.0",
+				Method:  msg.Method,
+				Params:  msg.Params,
 			}
-			return &resp, nil
+			t.notifications <- notif
 		}
+		// Requests from the server (e.g. window/workDoneProgress/create) are ignored
+	}
+}
 
-		// Process any notifications that arrive while waiting
-		if msg["id"] == nil && msg["method"] != nil {
-			var notif Notification
-			if data, _ := json.Marshal(msg); data != nil {
-				if err := json.Unmarshal(data, &notif); err == nil {
-					go func() {
-						t.handleNotification(&notif)
-					}()
-				}
-			}
+// Hands a response to the request waiting for it. Responses to abandoned
+// requests are dropped.
+func (t *Transport) dispatchResponse(msg *incomingMessage) {
+	var id string
+	if err := json.Unmarshal(msg.ID, &id); err != nil {
+		return // We only ever send string IDs
+	}
+
+	t.mu.Lock()
+	done, ok := t.pending[id]
+	delete(t.pending, id)
+	t.mu.Unlock()
+
+	if ok {
+		done <- &Response{
+			Jsonrpc: "2.0",
+			ID:      id,
+			Result:  msg.Result,
+			Error:   msg.Error,
 		}
-		// Ignore responses for other IDs (shouldn't happen in synchronous mode)
+	}
+}
+
+// Returns a channel that is closed when the connection to the server is
+// lost, e.g. because the server exited
+func (t *Transport) Done() <-chan struct{} {
+	return t.done
+}
+
+// Marks the transport as closed and fails all pending requests.
+func (t *Transport) close() {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+
+	if t.closed {
+		return
+	}
+	t.closed = true
+	close(t.done)
+	for id, done := range t.pending {
+		close(done)
+		delete(t.pending, id)
+	}
+	if t.recorder != nil {
+		t.recorder.Close()
 	}
 }
 
 // Reads a single JSON-RPC message from the input stream.
 // Messages use HTTP-style headers with Content-Length to frame the JSON payload.
 // This is the standard format used by the Language Server Protocol.
-func (t *Transport) readMessage() (map[string]interface{}, error) {
+func (t *Transport) readMessage() (*incomingMessage, error) {
 	// Parse HTTP-style headers
 	var contentLength int
 	for {
@@ -283,9 +397,11 @@ func (t *Transport) readMessage() (map[string]interface{}, error) {
 			if err != nil {
 				return nil, fmt.Errorf("invalid Content-Length: %w", err)
 			}
-			// Sanity check: messages shouldn't be larger than 10MB
-			if length < 0 || length > 10*1024*1024 {
-				return nil, fmt.Errorf("invalid Content-Length %d: must be between 0 and 10MB", length)
+			// Sanity check: unlimited workspace/symbol responses on large
+			// projects can reach tens of megabytes, but nothing legitimate
+			// comes close to 256MB
+			if length < 0 || length > maxMessageSize {
+				return nil, fmt.Errorf("invalid Content-Length %d: must be between 0 and 256MB", length)
 			}
 			contentLength = length
 		}
@@ -304,18 +420,27 @@ func (t *Transport) readMessage() (map[string]interface{}, error) {
 	if n != contentLength {
 		return nil, fmt.Errorf("content length mismatch: expected %d, got %d", contentLength, n)
 	}
+	if t.recorder != nil {
+		t.recorder.record(RecordReceive, content)
+	}
 
-	// Unmarshal into generic map to determine message type
-	var msg map[string]interface{}
+	var msg incomingMessage
 	if err := json.Unmarshal(content, &msg); err != nil {
 		return nil, fmt.Errorf("parse message: %w", err)
 	}
 
-	return msg, nil
+	return &msg, nil
+}
+
+// Calls the handlers of queued notifications in order, so e.g. the end of a
+// progress is never handled before its beginning, until reading stops
+func (t *Transport) dispatchNotifications() {
+	for notif := range t.notifications {
+		t.handleNotification(notif)
+	}
 }
 
 // Dispatches a notification to its registered handler if one exists.
-// Handlers are called asynchronously to avoid blocking message processing.
 // If no handler is registered for the notification method, it's silently ignored.
 func (t *Transport) handleNotification(notif *Notification) {
 	t.handlersMu.RLock()
@@ -329,7 +454,8 @@ func (t *Transport) handleNotification(notif *Notification) {
 
 // Writes a JSON-RPC message to the output stream with proper framing.
 // The message is preceded by HTTP-style headers including Content-Length.
-// This method assumes the caller holds the transport mutex.
+// Header and payload are written in a single call under the write mutex, so
+// concurrent writers never interleave.
 func (t *Transport) writeMessage(msg interface{}) error {
 	content, err := json.Marshal(msg)
 	if err != nil {
@@ -337,14 +463,16 @@ func (t *Transport) writeMessage(msg interface{}) error {
 	}
 
 	header := fmt.Sprintf("Content-Length: %d\r\n\r\n", len(content))
+	frame := make([]byte, 0, len(header)+len(content))
+	frame = append(frame, header...)
+	frame = append(frame, content...)
 
-	if _, err := t.writer.Write([]byte(header)); err != nil {
-		return err
-	}
+	t.writeMu.Lock()
+	defer t.writeMu.Unlock()
 
-	if _, err := t.writer.Write(content); err != nil {
-		return err
+	if t.recorder != nil {
+		t.recorder.record(RecordSend, content)
 	}
-
-	return nil
+	_, err = t.writer.Write(frame)
+	return err
 }
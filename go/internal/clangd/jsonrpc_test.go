@@ -0,0 +1,221 @@
+package clangd
+
+import (
+	"bufio"
+	"context"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+)
+
+// fakeServer reads framed requests written by a Transport and lets the test
+// answer them in any order.
+type fakeServer struct {
+	reader *bufio.Reader // Requests from the transport
+	writer io.Writer     // Responses to the transport
+}
+
+func newTransportPair(t *testing.T) (*Transport, *fakeServer) {
+	t.Helper()
+	requestsR, requestsW := io.Pipe()
+	responsesR, responsesW := io.Pipe()
+	t.Cleanup(func() {
+		requestsR.Close()
+		responsesW.Close()
+	})
+
+	transport := NewTransport(responsesR, requestsW, io.Discard)
+	transport.Start()
+	return transport, &fakeServer{reader: bufio.NewReader(requestsR), writer: responsesW}
+}
+
+func (s *fakeServer) read(t *testing.T) incomingMessage {
+	t.Helper()
+	var length int
+	for {
+		line, err := s.reader.ReadString('\n')
+		if err != nil {
+			t.Fatalf("reading header: %v", err)
+		}
+		line = strings.TrimSpace(line)
+		if line == "" {
+			break
+		}
+		length, _ = strconv.Atoi(strings.TrimPrefix(line, "Content-Length: "))
+	}
+	content := make([]byte, length)
+	if _, err := io.ReadFull(s.reader, content); err != nil {
+		t.Fatalf("reading content: %v", err)
+	}
+	var msg incomingMessage
+	if err := json.Unmarshal(content, &msg); err != nil {
+		t.Fatalf("decoding message: %v", err)
+	}
+	return msg
+}
+
+func (s *fakeServer) respond(t *testing.T, id json.RawMessage, result string) {
+	t.Helper()
+	content := fmt.Sprintf(`{"jsonrpc":"2.0","id":%s,"result":%s}`, id, result)
+	fmt.Fprintf(s.writer, "Content-Length: %d\r\n\r\n%s", len(content), content)
+}
+
+func TestTransportOutOfOrderResponses(t *testing.T) {
+	transport, server := newTransportPair(t)
+
+	type result struct {
+		value string
+		err   error
+	}
+	slow := make(chan result, 1)
+	go func() {
+		r, err := transport.SendRequest("slow", nil)
+		slow <- result{string(r), err}
+	}()
+	slowReq := server.read(t)
+
+	fast := make(chan result, 1)
+	go func() {
+		r, err := transport.SendRequest("fast", nil)
+		fast <- result{string(r), err}
+	}()
+	fastReq := server.read(t)
+
+	// Answer the second request first, it must not wait for the first one
+	server.respond(t, fastReq.ID, `"fast"`)
+	if r := <-fast; r.err != nil || r.value != `"fast"` {
+		t.Fatalf("fast request: got %q, %v", r.value, r.err)
+	}
+
+	server.respond(t, slowReq.ID, `"slow"`)
+	if r := <-slow; r.err != nil || r.value != `"slow"` {
+		t.Fatalf("slow request: got %q, %v", r.value, r.err)
+	}
+}
+
+func TestTransportCancelSendsCancelRequest(t *testing.T) {
+	transport, server := newTransportPair(t)
+
+	ctx, cancel := context.WithCancel(context.Background())
+	errs := make(chan error, 1)
+	go func() {
+		_, err := transport.SendRequestContext(ctx, "textDocument/references", nil)
+		errs <- err
+	}()
+	req := server.read(t)
+
+	cancel()
+	notif := server.read(t)
+
+	select {
+	case err := <-errs:
+		if !errors.Is(err, context.Canceled) {
+			t.Fatalf("expected context.Canceled, got %v", err)
+		}
+	case <-time.After(time.Second):
+		t.Fatalf("cancelled request did not return")
+	}
+
+	var params cancelParams
+	json.Unmarshal(notif.Params, &params)
+	var id string
+	json.Unmarshal(req.ID, &id)
+	if notif.Method != "$/cancelRequest" || params.ID != id {
+		t.Errorf("expected $/cancelRequest for %s, got %s %s", id, notif.Method, notif.Params)
+	}
+	if transport.CancelledRequests() != 1 {
+		t.Errorf("expected 1 cancelled request, got %d", transport.CancelledRequests())
+	}
+
+	// A late response to the cancelled request is dropped
+	server.respond(t, req.ID, `null`)
+}
+
+func TestTransportRecordsMessages(t *testing.T) {
+	requestsR, requestsW := io.Pipe()
+	responsesR, responsesW := io.Pipe()
+	t.Cleanup(func() {
+		requestsR.Close()
+		responsesW.Close()
+	})
+	path := filepath.Join(t.TempDir(), "session.jsonl")
+	recorder, err := NewRecorder(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	transport := NewTransport(responsesR, requestsW, io.Discard)
+	transport.SetRecorder(recorder)
+	transport.Start()
+	server := &fakeServer{reader: bufio.NewReader(requestsR), writer: responsesW}
+
+	done := make(chan error, 1)
+	go func() {
+		_, err := transport.SendRequest("workspace/symbol", WorkspaceSymbolParams{Query: "Vector"})
+		done <- err
+	}()
+	req := server.read(t)
+	server.respond(t, req.ID, `[]`)
+	if err := <-done; err != nil {
+		t.Fatal(err)
+	}
+	recorder.Close()
+
+	messages, err := ReadRecording(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(messages) != 2 {
+		t.Fatalf("expected 2 recorded messages, got %d", len(messages))
+	}
+	if messages[0].Direction != RecordSend || !strings.Contains(string(messages[0].Message), `"query":"Vector"`) {
+		t.Errorf("unexpected first message: %s %s", messages[0].Direction, messages[0].Message)
+	}
+	if messages[1].Direction != RecordReceive || !strings.Contains(string(messages[1].Message), `"result":[]`) {
+		t.Errorf("unexpected second message: %s %s", messages[1].Direction, messages[1].Message)
+	}
+	if messages[1].Time < messages[0].Time {
+		t.Errorf("response recorded before request: %d < %d", messages[1].Time, messages[0].Time)
+	}
+}
+
+func TestTransportHandlesNotificationsInOrder(t *testing.T) {
+	requestsR, requestsW := io.Pipe()
+	responsesR, responsesW := io.Pipe()
+	t.Cleanup(func() {
+		requestsR.Close()
+		responsesW.Close()
+	})
+	transport := NewTransport(responsesR, requestsW, io.Discard)
+
+	const count = 5000 // More than fit into the queue
+	received := make(chan int, count)
+	transport.RegisterNotificationHandler("$/progress", func(params json.RawMessage) {
+		var n int
+		json.Unmarshal(params, &n)
+		received <- n
+	})
+	transport.Start()
+
+	go func() {
+		for i := 0; i < count; i++ {
+			content := fmt.Sprintf(`{"jsonrpc":"2.0","method":"$/progress","params":%d}`, i)
+			fmt.Fprintf(responsesW, "Content-Length: %d\r\n\r\n%s", len(content), content)
+		}
+	}()
+	for i := 0; i < count; i++ {
+		select {
+		case n := <-received:
+			if n != i {
+				t.Fatalf("Expected notification %d, got %d", i, n)
+			}
+		case <-time.After(5 * time.Second):
+			t.Fatalf("Notification %d not handled", i)
+		}
+	}
+}
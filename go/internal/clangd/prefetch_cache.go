@@ -0,0 +1,137 @@
+package clangd
+
+import (
+	"encoding/json"
+	"sync"
+)
+
+// Methods whose results only depend on the requested document and position,
+// so they can be computed ahead of time and served from the prefetch cache.
+var prefetchableMethods = map[string]bool{
+	"textDocument/definition":           true,
+	"textDocument/documentSymbol":       true,
+	"textDocument/foldingRange":         true,
+	"textDocument/hover":                true,
+	"textDocument/prepareTypeHierarchy": true,
+}
+
+// Maximum number of prefetched results kept in memory
+const maxPrefetchEntries = 1024
+
+// PrefetchStats reports how effective speculative prefetching is.
+type PrefetchStats struct {
+	Prefetched int64 `json:"prefetched"` // Results stored by prefetching
+	Used       int64 `json:"used"`       // Prefetched results served at least once
+	Wasted     int64 `json:"wasted"`     // Prefetched results dropped without ever being used
+	Hits       int64 `json:"hits"`       // Lookups served from the cache
+	Misses     int64 `json:"misses"`     // Lookups of prefetchable methods that went to clangd
+}
+
+type prefetchEntry struct {
+	result json.RawMessage
+	used   bool
+}
+
+// prefetchCache holds results computed speculatively at low priority, keyed
+// by method and encoded params. Interactive requests for the exact same
+// method and params are answered from it instead of clangd. All entries are
+// dropped when files change, since any result may depend on them.
+type prefetchCache struct {
+	mu      sync.Mutex
+	entries map[string]*prefetchEntry
+	order   []string // Insertion order, oldest first, for eviction
+	stats   PrefetchStats
+}
+
+func newPrefetchCache() *prefetchCache {
+	return &prefetchCache{
+		entries: make(map[string]*prefetchEntry),
+	}
+}
+
+// Returns the cache key for a request, or false if the method can't be cached.
+func prefetchKey(method string, params interface{}) (string, bool) {
+	if !prefetchableMethods[method] {
+		return "", false
+	}
+	data, err := json.Marshal(params)
+	if err != nil {
+		return "", false
+	}
+	return method + "\x00" + string(data), true
+}
+
+// Looks up an interactive request and records a hit or miss.
+func (pc *prefetchCache) lookup(key string) (json.RawMessage, bool) {
+	pc.mu.Lock()
+	defer pc.mu.Unlock()
+
+	entry, ok := pc.entries[key]
+	if !ok {
+		pc.stats.Misses++
+		return nil, false
+	}
+
+	pc.stats.Hits++
+	if !entry.used {
+		entry.used = true
+		pc.stats.Used++
+	}
+	return entry.result, true
+}
+
+// Returns a prefetched result without affecting hit statistics.
+func (pc *prefetchCache) peek(key string) (json.RawMessage, bool) {
+	pc.mu.Lock()
+	defer pc.mu.Unlock()
+
+	if entry, ok := pc.entries[key]; ok {
+		return entry.result, true
+	}
+	return nil, false
+}
+
+// Stores a prefetched result, evicting the oldest entries when full.
+func (pc *prefetchCache) store(key string, result json.RawMessage) {
+	pc.mu.Lock()
+	defer pc.mu.Unlock()
+
+	if _, exists := pc.entries[key]; exists {
+		return
+	}
+
+	pc.entries[key] = &prefetchEntry{result: result}
+	pc.order = append(pc.order, key)
+	pc.stats.Prefetched++
+
+	for len(pc.entries) > maxPrefetchEntries && len(pc.order) > 0 {
+		oldest := pc.order[0]
+		pc.order = pc.order[1:]
+		if entry, ok := pc.entries[oldest]; ok {
+			if !entry.used {
+				pc.stats.Wasted++
+			}
+			delete(pc.entries, oldest)
+		}
+	}
+}
+
+// Drops all entries, counting the ones that were never used as wasted.
+func (pc *prefetchCache) clear() {
+	pc.mu.Lock()
+	defer pc.mu.Unlock()
+
+	for _, entry := range pc.entries {
+		if !entry.used {
+			pc.stats.Wasted++
+		}
+	}
+	pc.entries = make(map[string]*prefetchEntry)
+	pc.order = nil
+}
+
+func (pc *prefetchCache) snapshot() PrefetchStats {
+	pc.mu.Lock()
+	defer pc.mu.Unlock()
+	return pc.stats
+}
@@ -0,0 +1,58 @@
+package clangd
+
+import (
+	"encoding/json"
+	"testing"
+)
+
+func TestPrefetchCacheAccounting(t *testing.T) {
+	cache := newPrefetchCache()
+
+	params := HoverParams{
+		TextDocumentPositionParams: TextDocumentPositionParams{
+			TextDocument: TextDocumentIdentifier{URI: "file:///project/engine.h"},
+			Position:     Position{Line: 10, Character: 4},
+		},
+	}
+	key, ok := prefetchKey("textDocument/hover", params)
+	if !ok {
+		t.Fatalf("expected hover to be prefetchable")
+	}
+	if _, ok := prefetchKey("textDocument/references", params); ok {
+		t.Errorf("expected references not to be prefetchable")
+	}
+
+	if _, hit := cache.lookup(key); hit {
+		t.Fatalf("expected miss on empty cache")
+	}
+
+	cache.store(key, json.RawMessage(`{"contents":{"kind":"markdown","value":"x"}}`))
+	cache.store("unused", json.RawMessage(`null`))
+
+	for i := 0; i < 2; i++ {
+		if _, hit := cache.lookup(key); !hit {
+			t.Fatalf("expected hit after store")
+		}
+	}
+
+	cache.clear()
+	if _, hit := cache.lookup(key); hit {
+		t.Errorf("expected miss after clear")
+	}
+
+	want := PrefetchStats{Prefetched: 2, Used: 1, Wasted: 1, Hits: 2, Misses: 2}
+	if got := cache.snapshot(); got != want {
+		t.Errorf("unexpected stats:\nwant: %+v\ngot:  %+v", want, got)
+	}
+}
+
+func TestPrefetchCacheClearedWhenIndexingEnds(t *testing.T) {
+	c := &ClangdClient{clientState: &clientState{prefetch: newPrefetchCache(), indexingDone: make(chan struct{})}}
+	c.handleProgress(json.RawMessage(`{"token":"backgroundIndexProgress","value":{"kind":"begin","title":"indexing"}}`))
+	c.prefetch.store("hover", json.RawMessage(`null`))
+
+	c.handleProgress(json.RawMessage(`{"token":"backgroundIndexProgress","value":{"kind":"end"}}`))
+	if _, ok := c.prefetch.peek("hover"); ok {
+		t.Errorf("expected results prefetched during indexing to be dropped when it ends")
+	}
+}
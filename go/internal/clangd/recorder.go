@@ -0,0 +1,106 @@
+package clangd
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"os"
+	"sync"
+	"time"
+)
+
+// Directions of recorded messages
+const (
+	RecordSend    = "send"    // From the client to the server
+	RecordReceive = "receive" // From the server to the client
+)
+
+// RecordedMessage is one message of a recorded LSP session
+type RecordedMessage struct {
+	Time      int64           `json:"time"` // Microseconds since the recording started
+	Direction string          `json:"direction"`
+	Message   json.RawMessage `json:"message"`
+}
+
+// Recorder writes every message a transport sends and receives to a file,
+// one JSON object per line, so the session can be replayed without clangd.
+// Messages are written as they pass, so a recording is complete up to the
+// last message even if the daemon is killed.
+type Recorder struct {
+	mu     sync.Mutex
+	file   *os.File
+	start  time.Time
+	closed bool
+}
+
+// Creates a recorder that writes to a new file at path, replacing any
+// previous recording there
+func NewRecorder(path string) (*Recorder, error) {
+	file, err := os.Create(path)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create recording: %v", err)
+	}
+	return &Recorder{file: file, start: time.Now()}, nil
+}
+
+// Appends a message. Errors are ignored, a failing recording must not fail
+// the requests it records.
+func (r *Recorder) record(direction string, content []byte) {
+	// Keep <, > and & of C++ types readable
+	var line bytes.Buffer
+	encoder := json.NewEncoder(&line)
+	encoder.SetEscapeHTML(false)
+	err := encoder.Encode(RecordedMessage{
+		Time:      time.Since(r.start).Microseconds(),
+		Direction: direction,
+		Message:   content,
+	})
+	if err != nil {
+		return
+	}
+
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if !r.closed {
+		r.file.Write(line.Bytes())
+	}
+}
+
+// Closes the recording file. Messages recorded afterwards are dropped.
+func (r *Recorder) Close() error {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if r.closed {
+		return nil
+	}
+	r.closed = true
+	return r.file.Close()
+}
+
+// Reads the messages of a recording
+func ReadRecording(path string) ([]RecordedMessage, error) {
+	file, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer file.Close()
+
+	var messages []RecordedMessage
+	scanner := bufio.NewScanner(file)
+	scanner.Buffer(make([]byte, 0, 64*1024), maxMessageSize)
+	for line := 1; scanner.Scan(); line++ {
+		if len(scanner.Bytes()) == 0 {
+			continue
+		}
+		var msg RecordedMessage
+		if err := json.Unmarshal(scanner.Bytes(), &msg); err != nil {
+			return nil, fmt.Errorf("%s:%d: %v", path, line, err)
+		}
+		messages = append(messages, msg)
+	}
+	if err := scanner.Err(); err != nil {
+		return nil, err
+	}
+	return messages, nil
+}
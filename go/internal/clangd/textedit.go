@@ -0,0 +1,96 @@
+package clangd
+
+import (
+	"strings"
+	"unicode/utf8"
+)
+
+// Text document sync kinds a server announces in its capabilities
+const (
+	TextDocumentSyncNone        = 0
+	TextDocumentSyncFull        = 1
+	TextDocumentSyncIncremental = 2
+)
+
+// computeEdit returns a single change event that turns oldText into newText,
+// replacing only the region between their common prefix and suffix. Editing
+// a function body therefore leaves the includes at the top of the file out
+// of the edit, and clangd can reuse the document's preamble.
+func computeEdit(oldText, newText string) TextDocumentContentChangeEvent {
+	maxCommon := len(oldText)
+	if len(newText) < maxCommon {
+		maxCommon = len(newText)
+	}
+
+	prefix := 0
+	for prefix < maxCommon && oldText[prefix] == newText[prefix] {
+		prefix++
+	}
+	// Don't split a UTF-8 sequence or a \r\n line ending
+	for prefix > 0 && (!runeStartAt(oldText, prefix) || !runeStartAt(newText, prefix)) {
+		prefix--
+	}
+	if prefix > 0 && oldText[prefix-1] == '\r' {
+		prefix--
+	}
+
+	suffix := 0
+	for suffix < maxCommon-prefix && oldText[len(oldText)-1-suffix] == newText[len(newText)-1-suffix] {
+		suffix++
+	}
+	for suffix > 0 && (!runeStartAt(oldText, len(oldText)-suffix) || !runeStartAt(newText, len(newText)-suffix)) {
+		suffix--
+	}
+	if end := len(oldText) - suffix; suffix > 0 && end > prefix && oldText[end] == '\n' && oldText[end-1] == '\r' {
+		suffix--
+	}
+
+	return TextDocumentContentChangeEvent{
+		Range: &Range{
+			Start: offsetToPosition(oldText, prefix),
+			End:   offsetToPosition(oldText, len(oldText)-suffix),
+		},
+		Text: newText[prefix : len(newText)-suffix],
+	}
+}
+
+// Returns true if offset is the end of text or the start of a UTF-8 sequence
+func runeStartAt(text string, offset int) bool {
+	return offset >= len(text) || utf8.RuneStart(text[offset])
+}
+
+// Converts a byte offset into an LSP position, whose character is counted
+// in UTF-16 code units
+func offsetToPosition(text string, offset int) Position {
+	before := text[:offset]
+	line := strings.Count(before, "\n")
+	lineStart := strings.LastIndexByte(before, '\n') + 1
+
+	character := 0
+	for _, r := range before[lineStart:] {
+		// Runes outside the Basic Multilingual Plane take a surrogate pair
+		if r >= 0x10000 {
+			character += 2
+		} else {
+			character++
+		}
+	}
+	return Position{Line: line, Character: character}
+}
+
+// Returns the text document sync kind of the server's capabilities, which is
+// either a number or an object with a "change" field
+func textDocumentSyncKind(capabilities *ServerCapabilities) int {
+	if capabilities == nil {
+		return TextDocumentSyncNone
+	}
+	switch sync := capabilities.TextDocumentSync.(type) {
+	case float64:
+		return int(sync)
+	case map[string]interface{}:
+		if change, ok := sync["change"].(float64); ok {
+			return int(change)
+		}
+	}
+	return TextDocumentSyncNone
+}
@@ -0,0 +1,121 @@
+package clangd
+
+import (
+	"strings"
+	"testing"
+)
+
+// Applies a change event to a text, the way a server does
+func applyEdit(t *testing.T, text string, change TextDocumentContentChangeEvent) string {
+	t.Helper()
+	start := positionToOffset(t, text, change.Range.Start)
+	end := positionToOffset(t, text, change.Range.End)
+	return text[:start] + change.Text + text[end:]
+}
+
+func positionToOffset(t *testing.T, text string, pos Position) int {
+	t.Helper()
+	offset := 0
+	for line := 0; line < pos.Line; line++ {
+		next := strings.IndexByte(text[offset:], '\n')
+		if next < 0 {
+			t.Fatalf("Line %d is out of range", pos.Line)
+		}
+		offset += next + 1
+	}
+	character := 0
+	for _, r := range text[offset:] {
+		if character >= pos.Character || r == '\n' {
+			break
+		}
+		if r >= 0x10000 {
+			character += 2
+		} else {
+			character++
+		}
+		offset += len(string(r))
+	}
+	if character != pos.Character {
+		t.Fatalf("Position %+v is not at a character boundary", pos)
+	}
+	return offset
+}
+
+func TestComputeEdit(t *testing.T) {
+	tests := []struct {
+		name     string
+		old, new string
+		text     string // A minimal replacement text
+	}{
+		{"insert", "int a;\nint b;\n", "int a;\nint c;\nint b;\n", "int c;\n"},
+		{"delete", "#include <x>\nvoid f() { g(); }\n", "#include <x>\nvoid f() {}\n", ""},
+		{"replace", "void f() { return 1; }", "void f() { return 2; }", "2"},
+		{"identical", "int a;", "int a;", ""},
+		{"from empty", "", "int a;\n", "int a;\n"},
+		{"to empty", "int a;\n", "", ""},
+		{"repeated text", "aaaa", "aaaaaa", "aa"},
+		{"multibyte", "// é\nint a;", "// è\nint a;", "è"},
+		{"surrogate pair", "s = \"😀\"; int a;", "s = \"😁\"; int a;", "😁"},
+		{"crlf", "int a;\r\nint b;\r\n", "int a;\nint b;\r\n", "\n"},
+		{"crlf insert", "a\r\nb", "a\r\nx\r\nb", "x\r\n"},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			change := computeEdit(tt.old, tt.new)
+			if got := applyEdit(t, tt.old, change); got != tt.new {
+				t.Errorf("Applying the edit gave %q, want %q", got, tt.new)
+			}
+			// Where the edit goes can be ambiguous, its size can't
+			if len(change.Text) != len(tt.text) {
+				t.Errorf("Edit text is %q, want one like %q", change.Text, tt.text)
+			}
+		})
+	}
+}
+
+func TestComputeEditKeepsPreamble(t *testing.T) {
+	old := "#include <vector>\n#include <string>\n\nint f() {\n  return 1;\n}\n"
+	new := strings.Replace(old, "return 1;", "return 42;", 1)
+
+	change := computeEdit(old, new)
+	if change.Range.Start.Line != 4 || change.Range.End.Line != 4 {
+		t.Errorf("Edit spans lines %d-%d, want line 4 only", change.Range.Start.Line, change.Range.End.Line)
+	}
+}
+
+func TestOffsetToPosition(t *testing.T) {
+	text := "ab\ncé😀d\n"
+	tests := []struct {
+		offset int
+		want   Position
+	}{
+		{0, Position{Line: 0, Character: 0}},
+		{2, Position{Line: 0, Character: 2}},
+		{3, Position{Line: 1, Character: 0}},
+		{6, Position{Line: 1, Character: 2}},  // After the two-byte é
+		{10, Position{Line: 1, Character: 4}}, // After the surrogate pair
+		{len(text), Position{Line: 2, Character: 0}},
+	}
+	for _, tt := range tests {
+		if got := offsetToPosition(text, tt.offset); got != tt.want {
+			t.Errorf("offsetToPosition(%d) = %+v, want %+v", tt.offset, got, tt.want)
+		}
+	}
+}
+
+func TestTextDocumentSyncKind(t *testing.T) {
+	tests := []struct {
+		sync interface{}
+		want int
+	}{
+		{nil, TextDocumentSyncNone},
+		{float64(1), TextDocumentSyncFull},
+		{map[string]interface{}{"openClose": true, "change": float64(2)}, TextDocumentSyncIncremental},
+	}
+	for _, tt := range tests {
+		capabilities := &ServerCapabilities{TextDocumentSync: tt.sync}
+		if got := textDocumentSyncKind(capabilities); got != tt.want {
+			t.Errorf("textDocumentSyncKind(%v) = %d, want %d", tt.sync, got, tt.want)
+		}
+	}
+}
@@ -278,6 +278,9 @@ func (k SymbolKind) String() string {
 
 type WorkspaceSymbolParams struct {
 	Query string `json:"query"`
+	// Limit overrides clangd's default result limit (clangd extension).
+	// Zero means unlimited, nil keeps clangd's default.
+	Limit *int `json:"limit,omitempty"`
 }
 
 type WorkspaceSymbol struct {
@@ -350,12 +353,37 @@ type FileEvent struct {
 
 type FileChangeType int
 
+// FileChange is a change to a file on disk, as the daemon's file watcher
+// reports it
+type FileChange struct {
+	Path string
+	Type FileChangeType
+}
+
 const (
 	FileChangeTypeCreated FileChangeType = 1
 	FileChangeTypeChanged FileChangeType = 2
 	FileChangeTypeDeleted FileChangeType = 3
 )
 
+// Compile commands (clangd extension)
+
+// CompileCommand is the compile command of a single file, as clangd accepts
+// it in compilationDatabaseChanges
+type CompileCommand struct {
+	WorkingDirectory   string   `json:"workingDirectory"`
+	CompilationCommand []string `json:"compilationCommand"`
+}
+
+type ClangdSettings struct {
+	// Keyed by absolute file path
+	CompilationDatabaseChanges map[string]CompileCommand `json:"compilationDatabaseChanges"`
+}
+
+type DidChangeConfigurationParams struct {
+	Settings ClangdSettings `json:"settings"`
+}
+
 // Progress notifications
 
 type ProgressParams struct {
@@ -1,11 +1,15 @@
 package client
 
 import (
+	"bufio"
 	"encoding/json"
 	"fmt"
 	"net"
 	"os"
 	"os/exec"
+	"sort"
+	"strconv"
+	"strings"
 	"syscall"
 	"time"
 
@@ -22,6 +26,10 @@ type Config struct {
 	ProjectRoot string
 }
 
+// How long to wait for a newly started daemon to accept connections. Only
+// covers binding the socket; clangd starts after that.
+const daemonStartTimeout = 10 * time.Second
+
 // Client handles communication with the daemon
 type Client struct {
 	conn    net.Conn
@@ -29,6 +37,8 @@ type Client struct {
 	decoder *json.Decoder
 	timeout time.Duration
 	reqID   int
+	project string    // Project root sent with every request, for shared daemons
+	started time.Time // When Run started, sent so traces show the client's time
 }
 
 // RPCOptions contains options for RPC calls
@@ -38,9 +48,12 @@ type RPCOptions struct {
 
 // Request represents a JSON-RPC request
 type Request struct {
-	ID     int                    `json:"id"`
-	Method string                 `json:"method"`
-	Params map[string]interface{} `json:"params,omitempty"`
+	ID          int                    `json:"id"`
+	Method      string                 `json:"method"`
+	Params      map[string]interface{} `json:"params,omitempty"`
+	Deadline    int64                  `json:"deadline,omitempty"` // Unix milliseconds
+	Project     string                 `json:"project,omitempty"`
+	ClientStart int64                  `json:"clientStart,omitempty"` // Unix microseconds
 }
 
 // Response represents a JSON-RPC response
@@ -58,11 +71,26 @@ type ErrorResponse struct {
 
 // StatusInfo represents daemon status
 type StatusInfo struct {
-	PID           int    `json:"pid"`
-	ProjectRoot   string `json:"projectRoot"`
-	Uptime        string `json:"uptime"`
-	TotalRequests int    `json:"totalRequests"`
-	Connections   int    `json:"connections"`
+	PID            int                         `json:"pid"`
+	ProjectRoot    string                      `json:"projectRoot"`
+	Uptime         string                      `json:"uptime"`
+	TotalRequests  int                         `json:"totalRequests"`
+	Connections    int                         `json:"connections"`
+	IndexedSymbols int                         `json:"indexedSymbols"`
+	Startup        *daemon.StartupStatus       `json:"startup"`
+	StartTimes     *daemon.StartTimes          `json:"startTimes"`
+	Database       *daemon.CompilationDatabase `json:"compilationDatabase"`
+	Regeneration   *daemon.RegenerationStatus  `json:"regeneration"`
+	Watcher        *daemon.WatcherStatus       `json:"watcher"`
+	Hibernation    *daemon.HibernationStatus   `json:"hibernation"`
+	WorkingSet     *daemon.WorkingSetStatus    `json:"workingSet"`
+	Prefetch       *daemon.PrefetchStatus      `json:"prefetch"`
+	Scheduler      *daemon.SchedulerStatus     `json:"scheduler"`
+	Coalescing     *daemon.CoalescingStatus    `json:"coalescing"`
+	ResultCache    *daemon.ResultCacheStatus   `json:"resultCache"`
+	Shared         *daemon.SharedStatus        `json:"shared"`
+	Memory         *daemon.GovernorStatus      `json:"memory"`
+	Resources      *daemon.ResourceStatus      `json:"resources"`
 }
 
 // NewClient creates a new client connected to the daemon
@@ -84,11 +112,18 @@ func (c *Client) CallRPC(method string, params map[string]interface{}, opts *RPC
 		timeout = opts.Timeout
 	}
 
-	// Create request
+	// Create request. The daemon cancels the command once the deadline has
+	// passed, since we stop waiting for the response at that point.
+	deadline := time.Now().Add(timeout)
 	req := Request{
-		ID:     c.reqID,
-		Method: method,
-		Params: params,
+		ID:       c.reqID,
+		Method:   method,
+		Params:   params,
+		Deadline: deadline.UnixMilli(),
+		Project:  c.project,
+	}
+	if !c.started.IsZero() {
+		req.ClientStart = c.started.UnixMicro()
 	}
 	c.reqID++
 
@@ -98,7 +133,7 @@ func (c *Client) CallRPC(method string, params map[string]interface{}, opts *RPC
 	}
 
 	// Set read timeout
-	c.conn.SetReadDeadline(time.Now().Add(timeout))
+	c.conn.SetReadDeadline(deadline)
 
 	// Read response
 	var resp Response
@@ -144,6 +179,67 @@ func (c *Client) Search(symbol string, limit int) (string, error) {
 	})
 }
 
+// SearchOptions contains the flags of a regex or glob search
+type SearchOptions struct {
+	Pattern string
+	Regex   bool
+	Glob    bool
+	Kinds   string // Comma separated symbol kinds
+	Path    string // Project relative path prefix
+}
+
+// SearchPattern searches for symbols with a regex or glob pattern
+func (c *Client) SearchPattern(opts *SearchOptions, limit int) (string, error) {
+	return c.callCommand("search", map[string]interface{}{
+		"symbol": opts.Pattern,
+		"limit":  limit,
+		"regex":  opts.Regex,
+		"glob":   opts.Glob,
+		"kind":   opts.Kinds,
+		"path":   opts.Path,
+	})
+}
+
+// parseSearchArguments parses the search command's own flags. The pattern is
+// the first argument that is not a flag.
+func parseSearchArguments(args []string) (*SearchOptions, error) {
+	opts := &SearchOptions{}
+	for i := 0; i < len(args); i++ {
+		switch args[i] {
+		case "--regex":
+			opts.Regex = true
+		case "--glob":
+			opts.Glob = true
+		case "--kind", "--path":
+			if i+1 >= len(args) {
+				return nil, fmt.Errorf("flag %s requires a value", args[i])
+			}
+			if args[i] == "--kind" {
+				opts.Kinds = args[i+1]
+			} else {
+				opts.Path = args[i+1]
+			}
+			i++
+		default:
+			if opts.Pattern == "" {
+				opts.Pattern = args[i]
+			}
+		}
+	}
+
+	if opts.Regex && opts.Glob {
+		return nil, fmt.Errorf("--regex and --glob cannot be combined")
+	}
+	if (opts.Kinds != "" || opts.Path != "") && !opts.Regex && !opts.Glob {
+		return nil, fmt.Errorf("--kind and --path require --regex or --glob")
+	}
+	if opts.Pattern == "" {
+		return nil, fmt.Errorf("search requires a symbol argument")
+	}
+	opts.Path = strings.TrimPrefix(opts.Path, "./")
+	return opts, nil
+}
+
 // Show shows declaration and definition
 func (c *Client) Show(symbol string) (string, error) {
 	return c.callCommand("show", map[string]interface{}{
@@ -188,24 +284,92 @@ func (c *Client) Interface(symbol string) (string, error) {
 	})
 }
 
-// GetLogs retrieves daemon logs
-func (c *Client) GetLogs(level string) (string, error) {
+// How often logs --follow asks the daemon for new entries
+const logsFollowInterval = 500 * time.Millisecond
+
+// LogsResponse holds daemon logs and the cursor to continue reading from
+type LogsResponse struct {
+	Logs   string `json:"logs"`
+	Cursor uint64 `json:"cursor"`
+	Note   string `json:"note,omitempty"`
+}
+
+// GetLogs retrieves the daemon logs logged after the cursor, all of them for
+// a cursor of 0
+func (c *Client) GetLogs(level string, after uint64) (*LogsResponse, error) {
 	params := map[string]interface{}{
 		"level": level,
+		"after": after,
+	}
+
+	var logsResponse LogsResponse
+	if err := c.CallTyped("logs", params, &logsResponse); err != nil {
+		return nil, err
+	}
+	return &logsResponse, nil
+}
+
+// FollowLogs prints daemon logs as they are logged, until the daemon goes
+// away
+func (c *Client) FollowLogs(level string) error {
+	var cursor uint64
+	for {
+		logs, err := c.GetLogs(level, cursor)
+		if err != nil {
+			return err
+		}
+		if cursor == 0 && logs.Note != "" {
+			fmt.Fprintln(os.Stderr, logs.Note)
+		}
+		if logs.Logs != "" {
+			fmt.Println(logs.Logs)
+		}
+		cursor = logs.Cursor
+		time.Sleep(logsFollowInterval)
 	}
+}
 
-	var logsResponse map[string]string
-	err := c.CallTyped("logs", params, &logsResponse)
+// GetTrace retrieves the traces of the last requests, all of the buffered
+// ones if last is 0, in Chrome's trace event format
+func (c *Client) GetTrace(last int) (string, error) {
+	result, err := c.CallRPC("trace", map[string]interface{}{"last": last}, nil)
 	if err != nil {
 		return "", err
 	}
-	return logsResponse["logs"], nil
+	return string(result), nil
+}
+
+// Profile asks the daemon to capture a profile of itself, sampling timed
+// profiles for the given number of seconds (0 for the daemon's default)
+func (c *Client) Profile(kind string, seconds int) (*daemon.ProfileResult, error) {
+	params := map[string]interface{}{"kind": kind}
+	// The daemon answers once sampling is done
+	opts := &RPCOptions{Timeout: c.timeout + 30*time.Second}
+	if seconds > 0 {
+		params["seconds"] = seconds
+		opts.Timeout = c.timeout + time.Duration(seconds)*time.Second
+	}
+
+	result, err := c.CallRPC("profile", params, opts)
+	if err != nil {
+		return nil, err
+	}
+	var profile daemon.ProfileResult
+	if err := json.Unmarshal(result, &profile); err != nil {
+		return nil, err
+	}
+	return &profile, nil
 }
 
-// GetStatus retrieves daemon status
-func (c *Client) GetStatus() (*StatusInfo, error) {
+// GetStatus retrieves daemon status, with clangd's resource use over time
+// if resources is set
+func (c *Client) GetStatus(resources bool) (*StatusInfo, error) {
+	params := map[string]interface{}{}
+	if resources {
+		params["resources"] = true
+	}
 	var status StatusInfo
-	err := c.CallTyped("status", map[string]interface{}{}, &status)
+	err := c.CallTyped("status", params, &status)
 	return &status, err
 }
 
@@ -239,7 +403,14 @@ func (c *Client) handleCommand(config *Config) (string, error) {
 	// Handle each command
 	switch config.Command {
 	case "search":
-		return c.Search(symbol, config.Limit)
+		opts, err := parseSearchArguments(config.Arguments)
+		if err != nil {
+			return "", err
+		}
+		if opts.Regex || opts.Glob {
+			return c.SearchPattern(opts, config.Limit)
+		}
+		return c.Search(opts.Pattern, config.Limit)
 	case "show":
 		return c.Show(symbol)
 	case "view":
@@ -256,26 +427,85 @@ func (c *Client) handleCommand(config *Config) (string, error) {
 	case "logs":
 		// Parse log level from arguments
 		logLevel := "info" // default
+		follow := false
 		for _, arg := range config.Arguments {
 			if arg == "--verbose" || arg == "-v" {
 				logLevel = "verbose"
 			} else if arg == "--error" || arg == "-e" {
 				logLevel = "error"
+			} else if arg == "--follow" || arg == "-f" {
+				follow = true
 			}
 		}
 		// Global verbose flag overrides
 		if config.Verbose {
 			logLevel = "verbose"
 		}
-		return c.GetLogs(logLevel)
+		if follow {
+			return "", c.FollowLogs(logLevel)
+		}
+		logs, err := c.GetLogs(logLevel, 0)
+		if err != nil {
+			return "", err
+		}
+		if logs.Note != "" {
+			return logs.Note + "\n" + logs.Logs, nil
+		}
+		return logs.Logs, nil
+
+	case "trace":
+		last := 0
+		for i, arg := range config.Arguments {
+			if arg == "--last" && i+1 < len(config.Arguments) {
+				n, err := strconv.Atoi(config.Arguments[i+1])
+				if err != nil || n <= 0 {
+					return "", fmt.Errorf("invalid --last value: %s", config.Arguments[i+1])
+				}
+				last = n
+			}
+		}
+		return c.GetTrace(last)
+
+	case "profile":
+		if len(config.Arguments) == 0 {
+			return "", fmt.Errorf("profile requires a kind: cpu, heap, goroutine, mutex or block")
+		}
+		seconds := 0
+		for i, arg := range config.Arguments {
+			if arg == "--seconds" && i+1 < len(config.Arguments) {
+				n, err := strconv.Atoi(config.Arguments[i+1])
+				if err != nil || n <= 0 {
+					return "", fmt.Errorf("invalid --seconds value: %s", config.Arguments[i+1])
+				}
+				seconds = n
+			}
+		}
+		kind := config.Arguments[0]
+		if kind == "cpu" || kind == "mutex" || kind == "block" {
+			duration := "30"
+			if seconds > 0 {
+				duration = strconv.Itoa(seconds)
+			}
+			fmt.Fprintf(os.Stderr, "Profiling the daemon for %s seconds...\n", duration)
+		}
+		profile, err := c.Profile(kind, seconds)
+		if err != nil {
+			return "", err
+		}
+		return fmt.Sprintf("Wrote %s profile to %s\nInspect it with: go tool pprof %s", profile.Kind, profile.Path, profile.Path), nil
 
 	case "status":
-		status, err := c.GetStatus()
+		resources := false
+		for _, arg := range config.Arguments {
+			if arg == "--resources" {
+				resources = true
+			}
+		}
+		status, err := c.GetStatus(resources)
 		if err != nil {
 			return "", err
 		}
-		return fmt.Sprintf("Daemon Status:\n  PID: %d\n  Project: %s\n  Uptime: %s\n  Requests: %d\n  Connections: %d\n",
-			status.PID, status.ProjectRoot, status.Uptime, status.TotalRequests, status.Connections), nil
+		return formatStatus(status), nil
 
 	case "shutdown":
 		if err := c.Shutdown(); err != nil {
@@ -288,49 +518,263 @@ func (c *Client) handleCommand(config *Config) (string, error) {
 	}
 }
 
-// Run executes the client with the given configuration
-func Run(config *Config) error {
-	// Get project root from config
-	projectRoot := config.ProjectRoot
-	if projectRoot == "" {
-		return fmt.Errorf("project root not set")
+// formatStatus formats the daemon status for display
+func formatStatus(status *StatusInfo) string {
+	output := fmt.Sprintf("Daemon Status:\n  PID: %d\n  Project: %s\n  Uptime: %s\n  Requests: %d\n  Connections: %d\n  Indexed symbols: %d\n",
+		status.PID, status.ProjectRoot, status.Uptime, status.TotalRequests, status.Connections, status.IndexedSymbols)
+
+	if st := status.Startup; st != nil {
+		output += fmt.Sprintf("\nStartup:\n  Phase: %s (for %s)\n  Readiness policy: %s\n", st.Phase, st.Elapsed, st.Readiness)
+		if st.Error != "" {
+			output += fmt.Sprintf("  Error: %s\n", st.Error)
+		}
+		for _, phase := range st.Phases {
+			output += fmt.Sprintf("  %-16s %s\n", phase.Phase+":", phase.Duration)
+		}
 	}
 
-	// Check if daemon is running
-	lockInfo, err := daemon.ReadLockFile(projectRoot)
-	if err != nil {
-		return fmt.Errorf("failed to read lock file: %v", err)
+	if times := status.StartTimes; times != nil && times.ColdStart != "" {
+		output += fmt.Sprintf("  Cold start: %s\n", times.ColdStart)
+		if times.Resumes > 0 {
+			output += fmt.Sprintf("  Resume: %s avg, %s last (%d resumes)\n", times.AvgResume, times.LastResume, times.Resumes)
+		}
+		if times.Crashes > 0 {
+			output += fmt.Sprintf("  Restarted after crashes: %d\n", times.Crashes)
+		}
 	}
 
-	needStart := false
-	if lockInfo == nil {
-		needStart = true
-	} else if !daemon.IsProcessAlive(lockInfo.PID) {
-		needStart = true
-		daemon.RemoveLockFile(projectRoot)
-		daemon.CleanupSocket(lockInfo.SocketPath)
-	} else if daemon.IsDaemonStale(lockInfo) {
-		// Stop old daemon
-		if config.Verbose {
-			fmt.Fprintf(os.Stderr, "Stopping stale daemon (PID %d)...\n", lockInfo.PID)
+	if db := status.Database; db != nil {
+		stale := ""
+		if db.Stale {
+			stale = ", stale"
+		}
+		output += fmt.Sprintf("  Compilation database: %s (%s%s)\n", db.Dir, db.Source, stale)
+	}
+	if regen := status.Regeneration; regen != nil {
+		if regen.Running {
+			output += "  Regenerating compilation database in the background\n"
+		}
+		if last := regen.Last; last != nil {
+			output += fmt.Sprintf("  Last regeneration: %s, took %s, %d changed, %d added, %d removed, %s\n",
+				last.Time, last.Duration, last.Changed, last.Added, last.Removed, last.Action)
+			if last.Error != "" {
+				output += fmt.Sprintf("  Regeneration error: %s\n", last.Error)
+			}
 		}
-		syscall.Kill(lockInfo.PID, syscall.SIGTERM)
-		time.Sleep(500 * time.Millisecond)
-		needStart = true
 	}
 
-	if needStart {
-		if err := startDaemon(projectRoot, config.Verbose); err != nil {
-			return fmt.Errorf("failed to start daemon: %v", err)
+	if hib := status.Hibernation; hib != nil && (hib.Hibernated || hib.Hibernations > 0) {
+		if hib.Hibernated {
+			output += fmt.Sprintf("\nHibernated for %s, clangd resumes on the next query\n", hib.Since)
+		} else {
+			output += fmt.Sprintf("\nHibernated %d times\n", hib.Hibernations)
 		}
+	}
+
+	if ws := status.WorkingSet; ws != nil {
+		output += fmt.Sprintf("\nWorking Set:\n  Tracked documents: %d\n  Prewarmed: %d files in %s\n",
+			ws.TrackedDocuments, ws.PrewarmedFiles, ws.PrewarmTime)
+		output += fmt.Sprintf("  First request on warmed files: %s avg (%d files)\n", ws.WarmFirstLatency, ws.WarmFirstRequests)
+		output += fmt.Sprintf("  First request on cold files: %s avg (%d files)\n", ws.ColdFirstLatency, ws.ColdFirstRequests)
+	}
+
+	if w := status.Watcher; w != nil {
+		output += fmt.Sprintf("\nFile Watcher:\n  Mode: %s, %s scope, set up in %s\n  Directories: %d watched, %d polled, %d ignored\n",
+			w.Mode, w.Scope, w.SetupTime, w.WatchedDirectories, w.PolledDirectories, w.IgnoredDirectories)
+		if w.Batches > 0 {
+			output += fmt.Sprintf("  Change batches: %d (%d bulk), last one %d files\n", w.Batches, w.BulkBatches, w.LastBatch)
+		}
+		if w.Suppressed > 0 {
+			output += fmt.Sprintf("  Unchanged files ignored: %d (%d files hashed)\n", w.Suppressed, w.HashedFiles)
+		}
+		if w.WatchLimitReached {
+			output += fmt.Sprintf("  inotify watch limit reached (fs.inotify.max_user_watches = %d), polling every %s\n", w.MaxUserWatches, w.PollInterval)
+		}
+	}
+
+	if mem := status.Memory; mem != nil {
+		output += fmt.Sprintf("\nMemory:\n  clangd RSS: %s (peak %s)\n  Limits: soft %s, hard %s\n",
+			mem.RSS, mem.PeakRSS, mem.SoftLimit, mem.HardLimit)
+		output += fmt.Sprintf("  Soft limit actions: %d, restarts: %d\n", mem.SoftActions, mem.Restarts)
+		for _, action := range mem.Recent {
+			output += fmt.Sprintf("  %s %s: %s -> %s (%s)\n", action.Time, action.Action, action.Before, action.After, action.Detail)
+		}
+	}
 
-		// Re-read lock file
-		lockInfo, err = daemon.ReadLockFile(projectRoot)
-		if err != nil || lockInfo == nil {
-			return fmt.Errorf("daemon started but lock file not found")
+	if sched := status.Scheduler; sched != nil {
+		output += fmt.Sprintf("\nScheduler:\n  Workers: %d\n  Cancelled clangd requests: %d\n", sched.Workers, sched.CancelledClangdRequests)
+		for _, lane := range sched.Lanes {
+			output += fmt.Sprintf("  %-12s queued %d, running %d, completed %d, cancelled %d, wait %s avg / %s max\n",
+				lane.Name+":", lane.Queued, lane.Running, lane.Completed, lane.Cancelled, lane.AvgWait, lane.MaxWait)
 		}
 	}
 
+	if co := status.Coalescing; co != nil {
+		output += fmt.Sprintf("\nCoalescing:\n  Executed: %d\n  Coalesced: %d\n", co.Executed, co.Coalesced)
+	}
+
+	if rc := status.ResultCache; rc != nil {
+		output += fmt.Sprintf("\nResult Cache:\n  Entries: %d (%d loaded from disk in %s)\n  File size: %d bytes\n",
+			rc.Entries, rc.LoadedEntries, rc.LoadTime, rc.FileSize)
+		output += fmt.Sprintf("  Hits: %d, misses: %d, invalidated: %d, evicted: %d\n", rc.Hits, rc.Misses, rc.Invalidated, rc.Evicted)
+	}
+
+	if shared := status.Shared; shared != nil {
+		output += fmt.Sprintf("\nShared Daemon:\n  Memory budget: %s\n", shared.MemoryBudget)
+		for _, project := range shared.Projects {
+			state := project.State
+			if project.Phase != "" {
+				state += ", " + project.Phase
+			}
+			if project.RSS != "" {
+				state += ", " + project.RSS
+			}
+			output += fmt.Sprintf("  %s (%s, last used %s ago, evicted %d times)\n",
+				project.ProjectRoot, state, project.LastUsed, project.Evictions)
+		}
+	}
+
+	if pf := status.Prefetch; pf != nil {
+		output += fmt.Sprintf("\nPrefetch:\n  Hit rate: %s (%d hits, %d misses)\n", pf.HitRate, pf.Hits, pf.Misses)
+		output += fmt.Sprintf("  Prefetched results: %d (%d used, %d wasted)\n", pf.Prefetched, pf.Used, pf.Wasted)
+		output += fmt.Sprintf("  Dropped jobs: %d\n", pf.Dropped)
+	}
+
+	if res := status.Resources; res != nil {
+		output += formatResources(res)
+	}
+
+	return output
+}
+
+// Windows over which status --resources shows trends
+var resourceTrendWindows = []time.Duration{time.Minute, 5 * time.Minute, 15 * time.Minute, time.Hour}
+
+// Number of sampling intervals with the largest RSS growth that are listed
+const maxResourceIncreases = 5
+
+// Formats clangd's current resource use, its trends, and the intervals in
+// which its memory grew most along with the requests served in them
+func formatResources(res *daemon.ResourceStatus) string {
+	samples := res.Samples
+	if len(samples) == 0 {
+		return fmt.Sprintf("\nclangd Resources:\n  No samples yet, clangd is sampled every %s\n", res.Interval)
+	}
+	latest := samples[len(samples)-1]
+	var peak int64
+	for _, s := range samples {
+		if s.RSS > peak {
+			peak = s.RSS
+		}
+	}
+
+	output := fmt.Sprintf("\nclangd Resources (every %s, %d samples over %s):\n", res.Interval, len(samples),
+		latest.Time.Sub(samples[0].Time).Round(time.Second))
+	output += fmt.Sprintf("  RSS: %s (peak %s)\n", formatBytes(latest.RSS), formatBytes(peak))
+	output += fmt.Sprintf("  CPU: %.1f%% now, %s total\n", latest.CPUPercent, res.CPUTime)
+	output += fmt.Sprintf("  Threads: %d, open files: %d\n", latest.Threads, latest.OpenFiles)
+	output += fmt.Sprintf("  Index on disk: %s\n", formatBytes(latest.CacheSize))
+
+	output += fmt.Sprintf("  %-10s %10s %8s %10s %9s\n", "Trend", "RSS", "CPU avg", "Index", "Requests")
+	for _, window := range resourceTrendWindows {
+		// The first sample within the window is the baseline
+		first := len(samples) - 1
+		for first > 0 && latest.Time.Sub(samples[first-1].Time) <= window {
+			first--
+		}
+		if first == len(samples)-1 {
+			continue
+		}
+		var cpu float64
+		requests := 0
+		for _, s := range samples[first+1:] {
+			cpu += s.CPUPercent
+			requests += s.Requests
+		}
+		cpu /= float64(len(samples) - 1 - first)
+		label := "last " + formatWindow(window)
+		if first == 0 && latest.Time.Sub(samples[0].Time) < window {
+			label = "all"
+		}
+		output += fmt.Sprintf("  %-10s %10s %7.1f%% %10s %9d\n", label,
+			formatByteDelta(latest.RSS-samples[first].RSS), cpu,
+			formatByteDelta(latest.CacheSize-samples[first].CacheSize), requests)
+		if first == 0 {
+			break // Longer windows show the same
+		}
+	}
+
+	// Intervals in which RSS grew most, with the requests that ran in them
+	type increase struct {
+		sample daemon.ResourceSample
+		delta  int64
+	}
+	var increases []increase
+	for i := 1; i < len(samples); i++ {
+		if delta := samples[i].RSS - samples[i-1].RSS; delta > 0 {
+			increases = append(increases, increase{samples[i], delta})
+		}
+	}
+	sort.SliceStable(increases, func(i, j int) bool { return increases[i].delta > increases[j].delta })
+	if len(increases) > maxResourceIncreases {
+		increases = increases[:maxResourceIncreases]
+	}
+	if len(increases) > 0 {
+		output += "  Largest RSS increases:\n"
+	}
+	for _, inc := range increases {
+		activity := inc.sample.Activity
+		if activity == "" {
+			activity = "no requests"
+		}
+		output += fmt.Sprintf("    %s %s (%s)\n", inc.sample.Time.Local().Format("15:04:05"), formatByteDelta(inc.delta), activity)
+	}
+	return output
+}
+
+func formatBytes(bytes int64) string {
+	return fmt.Sprintf("%dMB", bytes>>20)
+}
+
+func formatByteDelta(bytes int64) string {
+	if bytes < 0 {
+		return fmt.Sprintf("-%dMB", (-bytes)>>20)
+	}
+	return fmt.Sprintf("+%dMB", bytes>>20)
+}
+
+func formatWindow(window time.Duration) string {
+	if window >= time.Hour {
+		return fmt.Sprintf("%dh", int(window.Hours()))
+	}
+	return fmt.Sprintf("%dm", int(window.Minutes()))
+}
+
+// Run executes the client with the given configuration
+func Run(config *Config) error {
+	started := time.Now()
+
+	// Get project root from config
+	projectRoot := config.ProjectRoot
+	if projectRoot == "" {
+		return fmt.Errorf("project root not set")
+	}
+
+	// Find the running daemon, or start one. A shared daemon keeps its lock
+	// file in the user's cache directory rather than the project.
+	daemonRoot := projectRoot
+	shared := isSharedDaemonEnabled()
+	if shared {
+		var err error
+		if daemonRoot, err = daemon.GetSharedDaemonDir(); err != nil {
+			return err
+		}
+	}
+	lockInfo, err := ensureDaemon(daemonRoot, shared, config.Verbose)
+	if err != nil {
+		return err
+	}
+
 	// Connect to daemon
 	conn, err := net.Dial("unix", lockInfo.SocketPath)
 	if err != nil {
@@ -340,6 +784,8 @@ func Run(config *Config) error {
 
 	// Create client
 	client := NewClient(conn, time.Duration(config.Timeout)*time.Second)
+	client.project = projectRoot
+	client.started = started
 
 	// Execute command and print output
 	output, err := client.handleCommand(config)
@@ -351,7 +797,69 @@ func Run(config *Config) error {
 	return nil
 }
 
-func startDaemon(projectRoot string, verbose bool) error {
+// Returns true if CLANGD_QUERY_SHARED asks for one daemon serving all of the
+// user's projects
+func isSharedDaemonEnabled() bool {
+	value := os.Getenv("CLANGD_QUERY_SHARED")
+	return value != "" && value != "0"
+}
+
+// Returns true if the lock file points to a live daemon of the current build
+func isDaemonUsable(lockInfo *daemon.LockInfo) bool {
+	return lockInfo != nil && daemon.IsProcessAlive(lockInfo.PID) && !daemon.IsDaemonStale(lockInfo)
+}
+
+// Returns the lock info of the project's daemon, starting the daemon first if
+// none is running. Starting is serialized with the spawn lock, so when many
+// clients start at once in a cold project, one of them starts the daemon and
+// the others wait for it instead of starting their own.
+func ensureDaemon(projectRoot string, shared bool, verbose bool) (*daemon.LockInfo, error) {
+	// Fast path, the daemon is usually running already
+	lockInfo, err := daemon.ReadLockFile(projectRoot)
+	if err == nil && isDaemonUsable(lockInfo) {
+		return lockInfo, nil
+	}
+
+	unlock, err := daemon.LockSpawn(projectRoot)
+	if err != nil {
+		return nil, fmt.Errorf("failed to lock %s: %v", daemon.GetLockPath(projectRoot), err)
+	}
+	defer unlock()
+
+	// Another client may have started the daemon while we waited for the lock
+	lockInfo, err = daemon.ReadLockFile(projectRoot)
+	if err != nil {
+		return nil, fmt.Errorf("failed to read lock file: %v", err)
+	}
+	if isDaemonUsable(lockInfo) {
+		return lockInfo, nil
+	}
+
+	if lockInfo != nil {
+		if daemon.IsProcessAlive(lockInfo.PID) {
+			// Stop old daemon
+			if verbose {
+				fmt.Fprintf(os.Stderr, "Stopping stale daemon (PID %d)...\n", lockInfo.PID)
+			}
+			syscall.Kill(lockInfo.PID, syscall.SIGTERM)
+			time.Sleep(500 * time.Millisecond)
+		}
+		daemon.CleanupSocket(lockInfo.SocketPath)
+	}
+
+	if err := startDaemon(projectRoot, shared, verbose); err != nil {
+		return nil, fmt.Errorf("failed to start daemon: %v", err)
+	}
+
+	// Re-read lock file
+	lockInfo, err = daemon.ReadLockFile(projectRoot)
+	if err != nil || lockInfo == nil {
+		return nil, fmt.Errorf("daemon started but lock file not found")
+	}
+	return lockInfo, nil
+}
+
+func startDaemon(projectRoot string, shared bool, verbose bool) error {
 	if verbose {
 		fmt.Fprintf(os.Stderr, "Starting daemon...\n")
 	}
@@ -367,6 +875,9 @@ func startDaemon(projectRoot string, verbose bool) error {
 	if verbose {
 		args = append(args, "--verbose")
 	}
+	if shared {
+		args = append(args, "--shared")
+	}
 	cmd := exec.Command(execPath, args...)
 
 	// Detach from current process group
@@ -385,25 +896,49 @@ func startDaemon(projectRoot string, verbose bool) error {
 	cmd.Stdout = logFile
 	cmd.Stderr = logFile
 
-	if err := cmd.Start(); err != nil {
+	// The daemon reports on this pipe once its socket accepts connections,
+	// or why it exited before that
+	readyReader, readyWriter, err := os.Pipe()
+	if err != nil {
+		return err
+	}
+	defer readyReader.Close()
+	cmd.ExtraFiles = []*os.File{readyWriter} // Becomes fd 3 in the daemon
+	cmd.Env = append(os.Environ(), daemon.ReadyFDEnv+"=3")
+
+	err = cmd.Start()
+	// Only the daemon holds the write end now, so reading sees EOF if it dies
+	readyWriter.Close()
+	if err != nil {
 		return err
 	}
 
 	// Don't wait for it - let it run in background
 	go cmd.Wait()
 
-	// Wait for daemon to be ready
-	socketPath := daemon.GetSocketPath(projectRoot)
-	for i := 0; i < 50; i++ { // 5 seconds timeout
-		if _, err := os.Stat(socketPath); err == nil {
-			// Socket exists, try to connect
-			if conn, err := net.Dial("unix", socketPath); err == nil {
-				conn.Close()
-				return nil
-			}
+	return waitForDaemonReady(readyReader, logPath)
+}
+
+// Waits for the daemon's readiness message. The socket is bound before
+// clangd starts, so this doesn't depend on the size of the project.
+func waitForDaemonReady(pipe *os.File, logPath string) error {
+	lines := make(chan string, 1)
+	go func() {
+		line, _ := bufio.NewReader(pipe).ReadString('\n')
+		lines <- strings.TrimSpace(line)
+	}()
+
+	select {
+	case line := <-lines:
+		switch {
+		case line == "ready":
+			return nil
+		case strings.HasPrefix(line, "error: "):
+			return fmt.Errorf("%s", strings.TrimPrefix(line, "error: "))
+		default:
+			return fmt.Errorf("daemon exited during startup, see %s", logPath)
 		}
-		time.Sleep(100 * time.Millisecond)
+	case <-time.After(daemonStartTimeout):
+		return fmt.Errorf("daemon failed to start within %v, see %s", daemonStartTimeout, logPath)
 	}
-
-	return fmt.Errorf("daemon failed to start within timeout")
 }
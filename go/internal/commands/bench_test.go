@@ -0,0 +1,174 @@
+package commands
+
+import (
+	"encoding/json"
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/logger"
+	"clangd-query/internal/replay"
+)
+
+// Benchmarks of building command output. Commands run against a replay
+// server that answers with the synthetic responses in ../clangd/testdata,
+// see there, so they need no clangd. Compare runs against the baseline in
+// go/benchmarks.
+
+const (
+	// Project root the responses were written for
+	recordedRoot = "/home/user/sample-project"
+	fixtureRoot  = "../../../test/fixtures/sample-project"
+	recordingDir = "../clangd/testdata"
+)
+
+// Returns a recording with its paths moved into the sample project fixture
+func loadRecording(tb testing.TB, name string) json.RawMessage {
+	tb.Helper()
+	data, err := os.ReadFile(filepath.Join(recordingDir, name))
+	if err != nil {
+		tb.Fatalf("reading recording: %v", err)
+	}
+	root, err := filepath.Abs(fixtureRoot)
+	if err != nil {
+		tb.Fatal(err)
+	}
+	return json.RawMessage(strings.ReplaceAll(string(data), "file://"+recordedRoot, "file://"+root))
+}
+
+// Returns a client of a server that answers every request with the recorded
+// result of its method. Indexing ends once the client opens its first
+// document.
+func newReplayClient(tb testing.TB, results map[string]json.RawMessage) *clangd.ClangdClient {
+	tb.Helper()
+	var messages []clangd.RecordedMessage
+	add := func(direction, content string) {
+		messages = append(messages, clangd.RecordedMessage{Direction: direction, Message: json.RawMessage(content)})
+	}
+	add(clangd.RecordSend, `{"jsonrpc":"2.0","method":"textDocument/didOpen"}`)
+	add(clangd.RecordReceive, `{"jsonrpc":"2.0","method":"$/progress","params":{"token":"backgroundIndexProgress","value":{"kind":"end"}}}`)
+	id := 0
+	for method, result := range results {
+		id++
+		add(clangd.RecordSend, fmt.Sprintf(`{"jsonrpc":"2.0","id":%d,"method":%q}`, id, method))
+		add(clangd.RecordReceive, fmt.Sprintf(`{"jsonrpc":"2.0","id":%d,"result":%s}`, id, result))
+	}
+
+	server, err := replay.NewServer(messages, 0)
+	if err != nil {
+		tb.Fatal(err)
+	}
+	return connectReplay(tb, server)
+}
+
+// Returns a client connected to a replay server for the sample project
+// fixture
+func connectReplay(tb testing.TB, server *replay.Server) *clangd.ClangdClient {
+	tb.Helper()
+	root, err := filepath.Abs(fixtureRoot)
+	if err != nil {
+		tb.Fatal(err)
+	}
+
+	// The client opens the first file of the compilation database to start
+	// indexing
+	buildDir := tb.TempDir()
+	compileCommands := fmt.Sprintf(`[{"directory":%q,"file":%q,"command":"c++ -c main.cpp"}]`,
+		buildDir, filepath.Join(root, "src", "main.cpp"))
+	if err := os.WriteFile(filepath.Join(buildDir, "compile_commands.json"), []byte(compileCommands), 0644); err != nil {
+		tb.Fatal(err)
+	}
+
+	client, err := replay.Connect(server, root, buildDir, &logger.NullLogger{})
+	if err != nil {
+		tb.Fatalf("starting client: %v", err)
+	}
+	tb.Cleanup(func() { client.Stop() })
+	return client
+}
+
+// Returns a client whose server knows every symbol of the sample project and
+// answers hovers with the documentation of GameObject::Update
+func newSampleProjectClient(tb testing.TB) *clangd.ClangdClient {
+	tb.Helper()
+	var hovers []json.RawMessage
+	if err := json.Unmarshal(loadRecording(tb, "hover.json"), &hovers); err != nil {
+		tb.Fatalf("decoding hover.json: %v", err)
+	}
+	return newReplayClient(tb, map[string]json.RawMessage{
+		"initialize":         json.RawMessage(`{"capabilities":{"textDocumentSync":2}}`),
+		"workspace/symbol":   loadRecording(tb, "workspace_symbol.json"),
+		"textDocument/hover": hovers[8],
+	})
+}
+
+func BenchmarkSearch(b *testing.B) {
+	client := newSampleProjectClient(b)
+	log := &logger.NullLogger{}
+
+	for _, limit := range []int{20, 0} {
+		b.Run(fmt.Sprintf("limit=%d", limit), func(b *testing.B) {
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				if _, err := Search(client, "Update", limit, log); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
+
+func BenchmarkSignature(b *testing.B) {
+	client := newSampleProjectClient(b)
+	log := &logger.NullLogger{}
+
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if _, err := Signature(client, "Update", log); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+// Formats the locations of all symbols of the sample project once per
+// iteration
+func BenchmarkFormatLocation(b *testing.B) {
+	client := newSampleProjectClient(b)
+	var symbols []clangd.WorkspaceSymbol
+	if err := json.Unmarshal(loadRecording(b, "workspace_symbol.json"), &symbols); err != nil {
+		b.Fatalf("decoding workspace_symbol.json: %v", err)
+	}
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		for _, symbol := range symbols {
+			formatLocation(client, symbol.Location)
+		}
+	}
+}
+
+// Wraps the recorded hover texts to the width of the signature command once
+// per iteration
+func BenchmarkWordWrap(b *testing.B) {
+	var hovers []clangd.Hover
+	if err := json.Unmarshal(loadRecording(b, "hover.json"), &hovers); err != nil {
+		b.Fatalf("decoding hover.json: %v", err)
+	}
+	var size int64
+	for _, hover := range hovers {
+		size += int64(len(hover.Contents.Value))
+	}
+
+	b.SetBytes(size)
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		for _, hover := range hovers {
+			wordWrap(hover.Contents.Value, 80)
+		}
+	}
+}
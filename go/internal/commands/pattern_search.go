@@ -0,0 +1,151 @@
+package commands
+
+import (
+	"fmt"
+	"strings"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/index"
+	"clangd-query/internal/logger"
+)
+
+// Default number of results for pattern searches. This mirrors clangd's own
+// default limit for workspace/symbol so both search modes behave alike.
+const defaultPatternSearchLimit = 100
+
+// PatternSearchOptions configures a regex or glob symbol search.
+type PatternSearchOptions struct {
+	Pattern    string
+	Glob       bool     // Interpret Pattern as a glob instead of a regex
+	Kinds      []string // Symbol kind names as printed by search, e.g. "class"
+	PathPrefix string   // Project relative path prefix filter
+	Limit      int
+}
+
+// Performs a regex or glob search over the daemon's trigram symbol index and
+// returns formatted text output in the same format as Search. The index is
+// built from clangd first if it was never built. An index built before files
+// changed is searched as is; the daemon rebuilds it in the background, since
+// a rebuild enumerates every symbol of the project.
+func SearchPattern(client *clangd.ClangdClient, idx *index.SymbolIndex, opts PatternSearchOptions, log logger.Logger) (string, error) {
+	mode := "regex"
+	if opts.Glob {
+		mode = "glob"
+	}
+	log.Info("Searching for symbols matching %s: %s (limit: %d)", mode, opts.Pattern, opts.Limit)
+
+	var kinds []clangd.SymbolKind
+	for _, name := range opts.Kinds {
+		kind, ok := ParseSymbolKind(name)
+		if !ok {
+			return "", fmt.Errorf("unknown symbol kind %q", name)
+		}
+		kinds = append(kinds, kind)
+	}
+
+	if _, built := idx.Generation(); !built {
+		if err := RefreshSymbolIndex(client, idx, log); err != nil {
+			return "", err
+		}
+	}
+
+	limit := opts.Limit
+	if limit <= 0 {
+		limit = defaultPatternSearchLimit
+	}
+
+	queryOpts := index.QueryOptions{
+		Kinds:      kinds,
+		PathPrefix: opts.PathPrefix,
+		Limit:      limit,
+	}
+
+	var result *index.QueryResult
+	var err error
+	if opts.Glob {
+		result, err = idx.QueryGlob(opts.Pattern, queryOpts)
+	} else {
+		result, err = idx.QueryRegex(opts.Pattern, queryOpts)
+	}
+	if err != nil {
+		return "", err
+	}
+
+	log.Debug("Pattern %s matched %d of %d candidates (%d symbols indexed) in %v",
+		opts.Pattern, result.Total, result.Candidates, idx.Len(), result.Duration)
+
+	if result.Total == 0 {
+		return fmt.Sprintf(`No symbols found matching %s "%s"`, mode, opts.Pattern), nil
+	}
+
+	output := fmt.Sprintf(`Found %d symbols matching %s "%s"`, result.Total, mode, opts.Pattern)
+	if result.Total > len(result.Symbols) {
+		output += fmt.Sprintf(" (showing first %d, use --limit for more)", len(result.Symbols))
+	}
+	output += ":\n\n"
+
+	for _, symbol := range result.Symbols {
+		output += fmt.Sprintf(
+			"- `%s` at %s [%s]\n",
+			symbol.Name,
+			formatLocation(client, symbol.Location),
+			SymbolKindToString(symbol.Kind))
+	}
+	// Remove trailing newline
+	return strings.TrimRight(output, "\n"), nil
+}
+
+// Rebuilds the symbol index from clangd if the index is older than clangd's
+// current index generation. Concurrent callers share a single rebuild.
+func RefreshSymbolIndex(client *clangd.ClangdClient, idx *index.SymbolIndex, log logger.Logger) error {
+	return idx.EnsureFresh(client.IndexGeneration(), func() ([]index.Symbol, error) {
+		log.Info("Building symbol index...")
+
+		symbols, err := client.AllWorkspaceSymbols()
+		if err != nil {
+			return nil, fmt.Errorf("failed to enumerate workspace symbols: %v", err)
+		}
+
+		// Intern URIs and paths, there are typically many symbols per file and
+		// every decoded symbol carries its own copy of the URI
+		type file struct {
+			uri  string
+			path string
+		}
+		files := make(map[string]file)
+		entries := make([]index.Symbol, 0, len(symbols))
+		for _, symbol := range symbols {
+			f, ok := files[symbol.Location.URI]
+			if !ok {
+				f = file{
+					uri:  symbol.Location.URI,
+					path: client.ToRelativePath(client.PathFromFileURI(symbol.Location.URI)),
+				}
+				files[f.uri] = f
+			}
+			symbol.Location.URI = f.uri
+
+			entries = append(entries, index.Symbol{
+				Name:     formatSymbolForDisplay(symbol),
+				Kind:     symbol.Kind,
+				Path:     f.path,
+				Location: symbol.Location,
+			})
+		}
+
+		log.Info("Symbol index built with %d symbols from %d files", len(entries), len(files))
+		return entries, nil
+	})
+}
+
+// Converts a symbol kind name as printed by SymbolKindToString back to its
+// SymbolKind value. Matching is case insensitive.
+func ParseSymbolKind(name string) (clangd.SymbolKind, bool) {
+	name = strings.ToLower(strings.TrimSpace(name))
+	for kind := clangd.SymbolKindFile; kind <= clangd.SymbolKindTypeParameter; kind++ {
+		if SymbolKindToString(kind) == name {
+			return kind, true
+		}
+	}
+	return 0, false
+}
@@ -0,0 +1,43 @@
+package commands
+
+import (
+	"encoding/json"
+	"path/filepath"
+	"testing"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/index"
+	"clangd-query/internal/logger"
+)
+
+func TestSearchPatternServesStaleIndex(t *testing.T) {
+	// The server knows no workspace/symbol, so rebuilding the index fails
+	client := newReplayClient(t, map[string]json.RawMessage{
+		"initialize": json.RawMessage(`{"capabilities":{}}`),
+	})
+	root, _ := filepath.Abs(fixtureRoot)
+
+	idx := index.NewSymbolIndex()
+	symbols := []index.Symbol{{
+		Name: "game_engine::GameObject",
+		Kind: clangd.SymbolKindClass,
+		Path: "include/core/game_object.h",
+		Location: clangd.Location{
+			URI:   "file://" + filepath.Join(root, "include", "core", "game_object.h"),
+			Range: clangd.Range{Start: clangd.Position{Line: 25, Character: 6}},
+		},
+	}}
+	// Built from a generation clangd has moved past
+	idx.EnsureFresh(client.IndexGeneration()+1, func() ([]index.Symbol, error) { return symbols, nil })
+
+	output, err := SearchPattern(client, idx, PatternSearchOptions{Pattern: "Game.*"}, &logger.NullLogger{})
+	if err != nil {
+		t.Fatalf("expected the stale index to be searched without clangd, got %v", err)
+	}
+	assertContains(t, output, "`game_engine::GameObject` at include/core/game_object.h:26:7 [class]")
+
+	// An index that was never built can't be served
+	if _, err := SearchPattern(client, index.NewSymbolIndex(), PatternSearchOptions{Pattern: "Game.*"}, &logger.NullLogger{}); err == nil {
+		t.Errorf("expected an unbuilt index to be built from clangd first")
+	}
+}
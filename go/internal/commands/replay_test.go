@@ -0,0 +1,124 @@
+package commands
+
+import (
+	"path/filepath"
+	"strings"
+	"testing"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/logger"
+	"clangd-query/internal/replay"
+)
+
+// Regression tests and benchmarks of commands against replayed LSP sessions,
+// without their latency, so the tests take milliseconds and need no clangd.
+//
+// The sessions in testdata are synthetic. They were written in the format of
+// CLANGD_DAEMON_LSP_RECORD from the sources of the sample project in
+// test/fixtures, not captured from clangd, so these tests check the commands
+// against what clangd is expected to answer. Replace them with captures of
+// the same commands on the sample project once clangd is at hand. The
+// end-to-end tests in go/test run the same commands against clangd.
+
+// Returns a client connected to a replay of the session in
+// testdata/<name>.jsonl
+func newRecordedClient(tb testing.TB, name string) *clangd.ClangdClient {
+	tb.Helper()
+	server, err := replay.Load(filepath.Join("testdata", name+".jsonl"), 0)
+	if err != nil {
+		tb.Fatal(err)
+	}
+	return connectReplay(tb, server)
+}
+
+func assertContains(t *testing.T, output string, want ...string) {
+	t.Helper()
+	for _, w := range want {
+		if !strings.Contains(output, w) {
+			t.Errorf("Expected output to contain %q, got:\n%s", w, output)
+		}
+	}
+}
+
+func TestShowRecorded(t *testing.T) {
+	client := newRecordedClient(t, "show")
+	output, err := Show(client, "GameObject::Update", &logger.NullLogger{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	assertContains(t, output,
+		"From include/core/game_object.h:34:8 (declaration)",
+		"void Update(float delta_time) override;",
+		"From src/core/game_object.cpp:21:18 (definition)",
+		"void GameObject::Update(float delta_time) {",
+		"OnUpdate(delta_time);")
+	if strings.Index(output, "(declaration)") > strings.Index(output, "(definition)") {
+		t.Errorf("Expected the declaration before the definition, got:\n%s", output)
+	}
+}
+
+func TestInterfaceRecorded(t *testing.T) {
+	client := newRecordedClient(t, "interface")
+	output, err := Interface(client, "Updatable", &logger.NullLogger{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	assertContains(t, output,
+		"class game_engine::Updatable - include/core/interfaces.h:18:7",
+		"Public Interface:",
+		"virtual void Update(float delta_time) = 0\n  @brief Updates the object state",
+		"virtual bool IsActive() const = 0")
+}
+
+func TestHierarchyRecorded(t *testing.T) {
+	client := newRecordedClient(t, "hierarchy")
+	output, err := Hierarchy(client, "Character", 20, &logger.NullLogger{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	want := "Inherits from:\n" +
+		"└── GameObject - include/core/game_object.h:26\n" +
+		"\n" +
+		"Character - include/game/character.h:9\n" +
+		"├── Enemy - include/game/enemy.h:9\n" +
+		"└── Player - include/game/player.h:11"
+	if output != want {
+		t.Errorf("Expected:\n%s\ngot:\n%s", want, output)
+	}
+}
+
+func BenchmarkShow(b *testing.B) {
+	client := newRecordedClient(b, "show")
+	log := &logger.NullLogger{}
+
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if _, err := Show(client, "GameObject::Update", log); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkInterface(b *testing.B) {
+	client := newRecordedClient(b, "interface")
+	log := &logger.NullLogger{}
+
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if _, err := Interface(client, "Updatable", log); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkHierarchy(b *testing.B) {
+	client := newRecordedClient(b, "hierarchy")
+	log := &logger.NullLogger{}
+
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if _, err := Hierarchy(client, "Character", 20, log); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
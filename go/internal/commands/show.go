@@ -2,7 +2,6 @@ package commands
 
 import (
 	"fmt"
-	"os"
 	"regexp"
 	"sort"
 	"strings"
@@ -52,7 +51,7 @@ func Show(client *clangd.ClangdClient, query string, log logger.Logger) (string,
 		symbol.Kind == clangd.SymbolKindConstructor {
 
 		// Determine if the symbol location is a definition or declaration
-		symbolHasBody, _ := hasBody(symbolPath, symbol.Location.Range.Start.Line)
+		symbolHasBody, _ := hasBody(client, symbolPath, symbol.Location.Range.Start.Line)
 		symbolIsInSourceFile := regexp.MustCompile(`\.(cc|cpp|cxx|c\+\+)$`).MatchString(strings.ToLower(symbolPath))
 
 		// In source files, it's almost always a definition
@@ -95,7 +94,7 @@ func Show(client *clangd.ClangdClient, query string, log logger.Logger) (string,
 					otherType = "declaration"
 				} else {
 					// We have the declaration, check if the other location has a body
-					hasBodyAtDef, _ := hasBody(defPath, def.Range.Start.Line)
+					hasBodyAtDef, _ := hasBody(client, defPath, def.Range.Start.Line)
 					if hasBodyAtDef {
 						otherType = "definition"
 					} else {
@@ -144,7 +143,7 @@ func Show(client *clangd.ClangdClient, query string, log logger.Logger) (string,
 	// Get context for each location
 	for i, loc := range locations {
 		// Read the file
-		content, err := os.ReadFile(loc.path)
+		content, err := client.ReadFile(loc.path)
 		if err != nil {
 			log.Debug("Failed to read file %s: %v", loc.path, err)
 			continue
@@ -308,8 +307,8 @@ func Show(client *clangd.ClangdClient, query string, log logger.Logger) (string,
 }
 
 // hasBody checks if a function/method has a body at the given location
-func hasBody(filePath string, startLine int) (bool, error) {
-	content, err := os.ReadFile(filePath)
+func hasBody(client *clangd.ClangdClient, filePath string, startLine int) (bool, error) {
+	content, err := client.ReadFile(filePath)
 	if err != nil {
 		return false, err
 	}
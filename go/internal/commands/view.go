@@ -2,7 +2,6 @@ package commands
 
 import (
 	"fmt"
-	"os"
 	"strings"
 
 	"clangd-query/internal/clangd"
@@ -47,7 +46,7 @@ func View(client *clangd.ClangdClient, query string, log logger.Logger) (string,
 	log.Debug("Got %d folding ranges", len(foldingRanges))
 
 	// Read the file content
-	content, err := os.ReadFile(filePath)
+	content, err := client.ReadFile(filePath)
 	if err != nil {
 		return "", fmt.Errorf("failed to read file: %v", err)
 	}
@@ -0,0 +1,936 @@
+package daemon
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/commands"
+	"clangd-query/internal/index"
+	"clangd-query/internal/logger"
+	"clangd-query/internal/trace"
+)
+
+// Backend states reported by the status command
+const (
+	BackendStopped = "stopped" // Not started yet, or evicted
+	BackendRunning = "running"
+)
+
+// A clangd that crashes within crashLoopWindow of its last crash is restarted
+// after crashRestartDelay rather than right away
+const (
+	crashLoopWindow   = time.Minute
+	crashRestartDelay = 5 * time.Second
+)
+
+// ProjectStatus summarizes one project of a shared daemon for the status command
+type ProjectStatus struct {
+	ProjectRoot string `json:"projectRoot"`
+	State       string `json:"state"`
+	Phase       string `json:"phase,omitempty"`
+	RSS         string `json:"rss,omitempty"` // Resident memory of clangd
+	LastUsed    string `json:"lastUsed"`      // Time since the last request
+	Evictions   int    `json:"evictions"`
+}
+
+// StartTimes compares how long clangd took to come up on the first start,
+// when it may have to index the project, and on later resumes from
+// hibernation or eviction, when it loads the index from disk
+type StartTimes struct {
+	ColdStart  string `json:"coldStart,omitempty"`
+	Resumes    int    `json:"resumes"`
+	AvgResume  string `json:"avgResume,omitempty"`
+	LastResume string `json:"lastResume,omitempty"`
+	Crashes    int    `json:"crashes,omitempty"` // Restarts after clangd exited unexpectedly
+}
+
+// SharedStatus reports the projects of a shared daemon for the status command
+type SharedStatus struct {
+	MemoryBudget string          `json:"memoryBudget"`
+	Projects     []ProjectStatus `json:"projects"`
+}
+
+// Backend is one project's clangd along with everything built on it: the
+// working set, prefetcher, symbol index, result cache and file watcher. A
+// per-project daemon has exactly one backend; a shared daemon has one per
+// project it has served.
+//
+// A backend's clangd can be stopped to free memory and started again later.
+// clangd keeps its background index on disk, so a restarted backend only has
+// to load it rather than index the project from scratch.
+type Backend struct {
+	projectRoot string
+	logger      logger.Logger
+	scheduler   *Scheduler
+	isBusy      func() bool
+	readiness   string
+	symbolIndex *index.SymbolIndex
+	coalescer   *Coalescer
+	resultCache *ResultCache
+	governor    *MemoryGovernor
+	resources   *ResourceMonitor
+	regenerator *DatabaseRegenerator
+	closed      chan struct{} // Closed when the daemon is done with the backend
+
+	// Set while the symbol index is rebuilt in the background
+	refreshingIndex atomic.Bool
+
+	// Called when clangd failed to start and the failure was reported long
+	// enough. A per-project daemon exits; a shared daemon stops the backend,
+	// so the next request tries again.
+	onStartupFailed func(b *Backend)
+
+	// Called when a request starts clangd again after it was stopped
+	onResume func()
+
+	mu        sync.Mutex
+	startup   *Startup
+	stop      chan struct{} // Closed when the current clangd is stopped
+	running   bool
+	active    int // Requests currently using clangd
+	lastUsed  time.Time
+	evictions int
+	crashes   int
+	lastCrash time.Time
+
+	// Time until clangd accepted queries, see StartTimes
+	starts      int
+	coldStart   time.Duration
+	resumes     int
+	resumeTotal time.Duration
+	lastResume  time.Duration
+
+	// Stops of the clangds and file watchers detached by stopLocked
+	halting sync.WaitGroup
+
+	// The compile_commands.json of the last bring-up, and when it was last
+	// configured as far as the daemon knows
+	database           *CompilationDatabase
+	databaseConfigured time.Time
+
+	// Handed over by bringUp under mu and valid once the startup is ready,
+	// until clangd stops
+	clangdClient *clangd.ClangdClient
+	workingSet   *WorkingSet
+	prefetcher   *Prefetcher
+	fileWatcher  *FileWatcher
+}
+
+// Creates the backend of a project, without starting clangd yet
+func NewBackend(projectRoot string, scheduler *Scheduler, isBusy func() bool, readiness string, log logger.Logger) *Backend {
+	b := &Backend{
+		projectRoot: projectRoot,
+		logger:      log,
+		scheduler:   scheduler,
+		isBusy:      isBusy,
+		readiness:   readiness,
+		symbolIndex: index.NewSymbolIndex(),
+		coalescer:   NewCoalescer(),
+		// Results of earlier sessions are served as long as their files are unchanged
+		resultCache: OpenResultCache(projectRoot, defaultResultCacheSize, log),
+		lastUsed:    time.Now(),
+		closed:      make(chan struct{}),
+	}
+	b.governor = NewMemoryGovernor(b, log)
+	go b.governor.Run(b.closed)
+	b.resources = NewResourceMonitor(b, log)
+	go b.resources.Run(b.closed)
+	b.regenerator = NewDatabaseRegenerator(b, log)
+	return b
+}
+
+// Starts clangd in the background unless it is running already. Must be
+// called with b.mu held.
+func (b *Backend) startLocked() {
+	if b.running {
+		return
+	}
+	b.running = true
+	previous := b.startup
+	b.startup = NewStartup(b.readiness)
+	b.stop = make(chan struct{})
+	b.starts++
+	go b.bringUp(b.startup, previous, b.stop, b.starts > 1)
+}
+
+// Starts clangd in the background unless it is running already
+func (b *Backend) Start() {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	b.startLocked()
+}
+
+// Marks the backend as used by a request, starting clangd again if it was
+// stopped. Returns the startup to wait on. Must be paired with release.
+func (b *Backend) acquire() *Startup {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	if !b.running {
+		b.logger.Info("Starting clangd for %s", b.projectRoot)
+		if b.starts > 0 && b.onResume != nil {
+			b.onResume()
+		}
+		b.startLocked()
+	}
+	b.active++
+	b.lastUsed = time.Now()
+	return b.startup
+}
+
+func (b *Backend) release() {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	b.active--
+	b.lastUsed = time.Now()
+}
+
+// Returns the clangd client once it is running, nil before that
+func (b *Backend) runningClient() *clangd.ClangdClient {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	if !b.running || !b.startup.isReady() {
+		return nil
+	}
+	return b.clangdClient
+}
+
+// Returns the startup of the current clangd
+func (b *Backend) currentStartup() *Startup {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	return b.startup
+}
+
+// Returns the resident memory of clangd, or 0 if it isn't running
+func (b *Backend) RSS() int64 {
+	client := b.runningClient()
+	if client == nil {
+		return 0
+	}
+	rss, err := readRSS(client.PID())
+	if err != nil {
+		return 0
+	}
+	return rss
+}
+
+// Returns true while clangd is running or starting
+func (b *Backend) Running() bool {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	return b.running
+}
+
+// Returns the time of the last request
+func (b *Backend) LastUsed() time.Time {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	return b.lastUsed
+}
+
+// Returns true if clangd is running and accepts queries, and no request is
+// using it. Must be called with b.mu held.
+func (b *Backend) unusedLocked() bool {
+	return b.running && b.active == 0 && b.startup.isReady()
+}
+
+// Returns true if clangd is unused and its startup has completed, including
+// the first indexing pass. Must be called with b.mu held.
+func (b *Backend) idleLocked() bool {
+	if !b.unusedLocked() {
+		return false
+	}
+	select {
+	case <-b.startup.done:
+		return true
+	default:
+		return false
+	}
+}
+
+// Stops clangd if no request is using it and its startup has completed.
+// Returns false if the backend can't be stopped right now.
+func (b *Backend) StopIfIdle() bool {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	if !b.idleLocked() {
+		return false
+	}
+	b.stopLocked()
+	return true
+}
+
+// Stops clangd to free memory for other projects, see StopIfIdle
+func (b *Backend) Evict() bool {
+	if !b.StopIfIdle() {
+		return false
+	}
+	b.mu.Lock()
+	b.evictions++
+	b.mu.Unlock()
+	return true
+}
+
+// Stops clangd and starts it again if no request is using it. The working
+// set is saved on stop and prewarmed on start. Unlike StopIfIdle, this
+// doesn't wait for indexing to end, as clangd uses the most memory while it
+// indexes; the new clangd picks up indexing from its index on disk. Returns
+// false if the backend can't be restarted right now.
+func (b *Backend) Restart() bool {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	if !b.unusedLocked() {
+		return false
+	}
+	b.stopLocked()
+	b.startLocked()
+	return true
+}
+
+// Stops clangd and everything built on it, saving the working set for the
+// next start. Must be called with b.mu held. Doesn't wait for an unfinished
+// bring-up: it releases whatever it didn't hand over to the backend yet
+// itself, see bringUp.
+//
+// A clangd that hangs takes until the request timeout to refuse shutdown, so
+// clangd and the file watcher are detached and stopped in the background.
+// Status and queries don't wait for them; Close does.
+func (b *Backend) stopLocked() {
+	if !b.running {
+		return
+	}
+	b.running = false
+	close(b.stop)
+
+	if b.workingSet != nil {
+		b.saveWorkingSet()
+	}
+	client, fileWatcher := b.clangdClient, b.fileWatcher
+	b.halting.Add(1)
+	go func() {
+		defer b.halting.Done()
+		if fileWatcher != nil {
+			fileWatcher.Stop()
+		}
+		if client != nil {
+			client.Stop()
+		}
+	}()
+	b.clangdClient = nil
+	b.workingSet = nil
+	b.prefetcher = nil
+	b.fileWatcher = nil
+
+	// Index generations start over with the next clangd
+	b.symbolIndex.Reset()
+}
+
+// Restarts clangd when it exits while the daemon still uses it, e.g. after a
+// crash. Requests in flight fail, later ones wait for the new clangd. A clangd
+// that crashes again soon after is restarted after a pause, so one that
+// crashes right away doesn't keep the daemon busy restarting it.
+func (b *Backend) restartOnExit(client *clangd.ClangdClient, stop chan struct{}) {
+	select {
+	case <-stop:
+		return
+	case <-client.Done():
+	}
+
+	b.mu.Lock()
+	select {
+	case <-stop:
+		b.mu.Unlock()
+		return // Stopped on purpose
+	default:
+	}
+	b.crashes++
+	var delay time.Duration
+	if time.Since(b.lastCrash) < crashLoopWindow {
+		delay = crashRestartDelay
+	}
+	b.lastCrash = time.Now()
+	b.mu.Unlock()
+
+	b.logger.Error("clangd exited unexpectedly, restarting it in %v", delay)
+	select {
+	case <-stop:
+		return
+	case <-time.After(delay):
+	}
+
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	select {
+	case <-stop:
+		return
+	default:
+	}
+	b.stopLocked()
+	b.startLocked()
+}
+
+// Stops clangd. The next request starts it again.
+func (b *Backend) Stop() {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	b.stopLocked()
+}
+
+// Stops clangd and closes the result cache, when the daemon shuts down.
+// Waits for the stopped clangds to exit, so none outlives the daemon.
+func (b *Backend) Close() {
+	close(b.closed)
+	b.mu.Lock()
+	startup := b.startup
+	b.stopLocked()
+	b.mu.Unlock()
+
+	// Give an unfinished bring-up the chance to stop the clangd it started
+	// before the daemon exits
+	if startup != nil {
+		select {
+		case <-startup.done:
+		case <-time.After(startupShutdownWait):
+			b.logger.Info("Startup of %s still in progress (%s), not waiting for it", b.projectRoot, startup.Phase())
+		}
+	}
+	b.halting.Wait()
+	b.resultCache.Close()
+}
+
+// Records that the compile_commands.json in dir was regenerated and is no
+// longer stale
+func (b *Backend) databaseRegenerated(dir string) {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	if b.database != nil && b.database.Dir == dir && b.database.Stale {
+		database := *b.database
+		database.Stale = false
+		b.database = &database
+	}
+}
+
+// Records that CMake files changed after the developer's build directory dir
+// was configured
+func (b *Backend) databaseOutdated(dir string) {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	if b.database != nil && b.database.Dir == dir {
+		database := *b.database
+		database.Stale = true
+		b.database = &database
+		b.databaseConfigured = configureTime(dir)
+	}
+}
+
+// Returns the compilation database for the status command. A stale build
+// directory of the developer is no longer stale once they reconfigured it,
+// and clangd picks up its new compile commands. Must be called with b.mu
+// held.
+func (b *Backend) databaseStatusLocked() *CompilationDatabase {
+	if b.database.Stale && b.database.Source != DatabasePrivate &&
+		configureTime(b.database.Dir).After(b.databaseConfigured) {
+		database := *b.database
+		database.Stale = false
+		b.database = &database
+	}
+	return b.database
+}
+
+// Watches the directories of a regenerated compile_commands.json that
+// weren't referenced before
+func (b *Backend) refreshWatchScope(dir string) {
+	b.mu.Lock()
+	fileWatcher := b.fileWatcher
+	b.mu.Unlock()
+	if fileWatcher != nil {
+		fileWatcher.AddScope(dir)
+	}
+}
+
+// Brings up clangd and everything that depends on it while the socket is
+// already serving. Runs in its own goroutine; queries that need clangd wait
+// until it marks the startup ready.
+//
+// Each part is handed over to the backend under b.mu, unless clangd was
+// stopped meanwhile. stopLocked releases the parts that were handed over,
+// bringUp the ones that weren't, so stopping never waits for a bring-up.
+func (b *Backend) bringUp(startup, previous *Startup, stop chan struct{}, resumed bool) {
+	defer close(startup.done)
+
+	// A stopped bring-up may still be running cmake or starting clangd. Don't
+	// work on the same build directory and index at the same time.
+	if previous != nil {
+		<-previous.done
+	}
+	begin := time.Now()
+
+	stopped := func() bool {
+		select {
+		case <-stop:
+			return true
+		default:
+			return false
+		}
+	}
+	if stopped() {
+		return
+	}
+	handOver := func(set func()) bool {
+		b.mu.Lock()
+		defer b.mu.Unlock()
+		if stopped() {
+			return false
+		}
+		set()
+		return true
+	}
+
+	// Ensure compilation database exists
+	database, err := EnsureCompilationDatabase(b.projectRoot, b.logger)
+	if err != nil {
+		b.failStartup(startup, fmt.Errorf("failed to find compilation database: %v", err))
+		return
+	}
+	if stopped() {
+		return
+	}
+
+	// Start clangd
+	startup.setPhase(PhaseStartingClangd)
+	b.mu.Lock()
+	b.database = database
+	b.databaseConfigured = configureTime(database.Dir)
+	b.mu.Unlock()
+	b.logger.Info("Starting clangd with build directory: %s", database.Dir)
+	recorder := b.newLSPRecorder()
+	client, err := clangd.NewClangdClient(b.projectRoot, database.Dir, recorder, b.logger)
+	if err != nil {
+		if recorder != nil {
+			recorder.Close()
+		}
+		b.failStartup(startup, fmt.Errorf("failed to start clangd: %v", err))
+		return
+	}
+	if !handOver(func() { b.clangdClient = client }) {
+		client.Stop()
+		return
+	}
+	go b.restartOnExit(client, stop)
+
+	// Setup file watcher
+	fileWatcher, err := NewFileWatcher(b.projectRoot, database.Dir, func(changes []clangd.FileChange) {
+		b.logger.Debug("Files changed: %v", changes)
+		sources := make([]clangd.FileChange, 0, len(changes))
+		cmakeChanged := false
+		for _, change := range changes {
+			if isCMakeFile(change.Path) {
+				cmakeChanged = true
+			} else {
+				sources = append(sources, change)
+			}
+		}
+		// Notify clangd about file changes
+		if len(sources) > 0 {
+			client.OnFilesChanged(sources)
+		}
+		if cmakeChanged {
+			b.regenerator.Start(*database)
+		}
+	}, b.logger)
+	if err != nil {
+		b.logger.Error("Failed to setup file watcher: %v", err)
+		// Continue without file watching
+	}
+	if !handOver(func() { b.fileWatcher = fileWatcher }) {
+		if fileWatcher != nil {
+			fileWatcher.Stop()
+		}
+		return
+	}
+
+	// Track the documents queries use and reopen last session's working set
+	workingSet := LoadWorkingSet(b.projectRoot, b.logger)
+	if !handOver(func() { b.workingSet = workingSet }) {
+		return
+	}
+	client.SetDocumentObserver(func(uri string, method string, latency time.Duration) {
+		path := client.PathFromFileURI(uri)
+		workingSet.Record(path, latency)
+		// Rewrites of these files that don't change them keep their ASTs
+		if fileWatcher != nil {
+			fileWatcher.Track(path)
+		}
+	})
+	go workingSet.Prewarm(client, getPrewarmCount(), b.isBusy, stop)
+	go b.saveWorkingSetPeriodically(workingSet, stop)
+
+	// Compute the likely follow-up queries of each command in the background
+	if isPrefetchEnabled() {
+		prefetcher := NewPrefetcher(client, b.scheduler, b.isBusy, stop, b.logger)
+		if !handOver(func() { b.prefetcher = prefetcher }) {
+			return
+		}
+		go prefetcher.Run()
+	}
+
+	// Build the symbol index for regex and glob searches in the background, so
+	// the first pattern search doesn't have to wait for it
+	b.refreshSymbolIndex(client)
+
+	startup.markReady()
+	b.recordStartTime(resumed, time.Since(begin))
+	b.logger.Info("clangd is running after %s, serving queries for %s", time.Since(begin).Round(time.Millisecond), b.projectRoot)
+
+	// clangd started on a database older than the CMake files. A private one
+	// is configured while clangd indexes and the difference applied once done.
+	if database.Stale {
+		b.regenerator.Start(*database)
+	}
+
+	// Queries are answered while clangd indexes, but status shows when it's done
+	client.WaitForIndexing()
+	ticker := time.NewTicker(250 * time.Millisecond)
+	defer ticker.Stop()
+	for client.IsIndexing() {
+		select {
+		case <-ticker.C:
+		case <-stop:
+			return
+		}
+	}
+	startup.setPhase(PhaseReady)
+	b.logger.Info("Startup complete")
+}
+
+// Rebuilds the symbol index from clangd in the background lane, unless a
+// rebuild is already under way. Pattern searches keep using the current
+// index meanwhile.
+func (b *Backend) refreshSymbolIndex(client *clangd.ClangdClient) {
+	if !b.refreshingIndex.CompareAndSwap(false, true) {
+		return
+	}
+	go func() {
+		defer b.refreshingIndex.Store(false)
+		err := b.scheduler.Do(context.Background(), LaneBackground, func(ctx context.Context) error {
+			return commands.RefreshSymbolIndex(client.WithContext(ctx), b.symbolIndex, b.logger)
+		})
+		select {
+		case <-client.Done():
+			// clangd stopped, the next one builds its own index
+		default:
+			if err != nil {
+				b.logger.Error("Failed to build symbol index: %v", err)
+			}
+		}
+	}()
+}
+
+func (b *Backend) recordStartTime(resumed bool, duration time.Duration) {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	if resumed {
+		b.resumes++
+		b.resumeTotal += duration
+		b.lastResume = duration
+	} else {
+		b.coldStart = duration
+	}
+}
+
+// Fails the bring-up. Queries report the error for a grace period, so
+// clients see the reason rather than a vanished daemon.
+func (b *Backend) failStartup(startup *Startup, err error) {
+	b.logger.Error("Startup failed: %v", err)
+	startup.fail(err)
+	time.AfterFunc(failedStartupGrace, func() {
+		if b.onStartupFailed != nil {
+			b.onStartupFailed(b)
+		}
+	})
+}
+
+func (b *Backend) saveWorkingSet() {
+	if err := b.workingSet.Save(); err != nil {
+		b.logger.Error("Failed to save working set: %v", err)
+	}
+}
+
+// Saves the working set every minute, so it survives a daemon crash
+func (b *Backend) saveWorkingSetPeriodically(workingSet *WorkingSet, stop chan struct{}) {
+	ticker := time.NewTicker(time.Minute)
+	defer ticker.Stop()
+
+	for {
+		select {
+		case <-ticker.C:
+			if err := workingSet.Save(); err != nil {
+				b.logger.Error("Failed to save working set: %v", err)
+			}
+		case <-stop:
+			return
+		}
+	}
+}
+
+// Runs a clangd backed request in its scheduler lane. Cached results are
+// served without starting clangd; everything else starts it if needed.
+func (b *Backend) handleRequest(ctx context.Context, req Request, lane Lane) (json.RawMessage, error) {
+	b.resources.RecordRequest(req.Method)
+
+	cacheKey, cacheable := resultCacheKey(req)
+	if cacheable {
+		_, span := trace.Start(ctx, "ResultCache.Get", "daemon")
+		result, ok := b.resultCache.Get(cacheKey)
+		span.SetArg("hit", strconv.FormatBool(ok))
+		span.End()
+		if ok {
+			b.logger.Debug("%s served from result cache", req.Method)
+			return result, nil
+		}
+	}
+
+	startup := b.acquire()
+	defer b.release()
+
+	// Everything else needs clangd, which may still be starting
+	_, span := trace.Start(ctx, "Startup.wait", "daemon")
+	err := startup.wait(ctx)
+	span.End()
+	if err != nil {
+		return nil, err
+	}
+	client := b.runningClient()
+	if client == nil {
+		return nil, fmt.Errorf("clangd for %s is not running", b.projectRoot)
+	}
+
+	run := func(ctx context.Context) (json.RawMessage, error) {
+		// Collect the files the result depends on, for the result cache
+		deps := clangd.NewDependencySet()
+		generation := client.IndexGeneration()
+
+		var result json.RawMessage
+		_, queued := trace.Start(ctx, "Scheduler.wait", "daemon")
+		err := b.scheduler.Do(clangd.WithDependencySet(ctx, deps), lane, func(ctx context.Context) error {
+			queued.End()
+			var err error
+			result, err = b.runCommand(ctx, client, req)
+			return err
+		})
+		queued.End()
+
+		// Results computed while files changed or clangd was still indexing
+		// may be stale or incomplete, and are not kept
+		if err == nil && cacheable && client.IndexGeneration() == generation {
+			b.resultCache.Put(cacheKey, result, deps.Paths())
+		}
+		return result, err
+	}
+
+	// Identical queries in flight at the same time run only once
+	key := coalescingKey(req, client.IndexGeneration())
+	return b.coalescer.Do(ctx, key, run)
+}
+
+// Names of the functions of the commands package that run each request,
+// for traces
+var commandFunctions = map[string]string{
+	"search":    "Search",
+	"show":      "Show",
+	"view":      "View",
+	"usages":    "Usages",
+	"hierarchy": "Hierarchy",
+	"signature": "Signature",
+	"interface": "Interface",
+}
+
+// Runs a command against clangd. The command is cancelled together with ctx.
+func (b *Backend) runCommand(ctx context.Context, clangdClient *clangd.ClangdClient, req Request) (json.RawMessage, error) {
+	function := commandFunctions[req.Method]
+	if req.Params["regex"] == true || req.Params["glob"] == true {
+		function = "SearchPattern"
+	}
+	ctx, span := trace.Start(ctx, "commands."+function, "command")
+	defer span.End()
+	client := clangdClient.WithContext(ctx)
+
+	input, _ := req.Params["symbol"].(string)
+
+	limit := -1
+	if l, ok := req.Params["limit"].(float64); ok {
+		limit = int(l)
+	}
+
+	var output string
+	var err error
+
+	switch req.Method {
+	case "search":
+		regex, _ := req.Params["regex"].(bool)
+		glob, _ := req.Params["glob"].(bool)
+		if regex || glob {
+			opts := commands.PatternSearchOptions{
+				Pattern: input,
+				Glob:    glob,
+				Limit:   limit,
+			}
+			if kinds, ok := req.Params["kind"].(string); ok && kinds != "" {
+				opts.Kinds = strings.Split(kinds, ",")
+			}
+			opts.PathPrefix, _ = req.Params["path"].(string)
+			// Files changed or clangd indexed since the index was built
+			if generation, built := b.symbolIndex.Generation(); built && generation != clangdClient.IndexGeneration() {
+				b.refreshSymbolIndex(clangdClient)
+			}
+			output, err = commands.SearchPattern(client, b.symbolIndex, opts, b.logger)
+		} else {
+			output, err = commands.Search(client, input, limit, b.logger)
+		}
+	case "show":
+		output, err = commands.Show(client, input, b.logger)
+	case "view":
+		output, err = commands.View(client, input, b.logger)
+	case "usages":
+		output, err = commands.Usages(client, input, limit, b.logger)
+	case "hierarchy":
+		output, err = commands.Hierarchy(client, input, limit, b.logger)
+	case "signature":
+		output, err = commands.Signature(client, input, b.logger)
+	case "interface":
+		output, err = commands.Interface(client, input, b.logger)
+	default:
+		return nil, fmt.Errorf("unknown method: %s", req.Method)
+	}
+
+	if err != nil {
+		if ctx.Err() == nil {
+			b.logger.Error("%s failed: %v", req.Method, err)
+		}
+		return nil, err
+	}
+
+	// Pattern searches have no single top hit to follow up on
+	if prefetcher := b.currentPrefetcher(); prefetcher != nil && req.Params["regex"] != true && req.Params["glob"] != true {
+		prefetcher.Schedule(req.Method, input)
+	}
+
+	return json.Marshal(map[string]string{"output": output})
+}
+
+func (b *Backend) currentPrefetcher() *Prefetcher {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	if !b.running || !b.startup.isReady() {
+		return nil
+	}
+	return b.prefetcher
+}
+
+// Adds the backend's sections to a status response
+func (b *Backend) addStatus(status map[string]interface{}) {
+	status["projectRoot"] = b.projectRoot
+	status["indexedSymbols"] = b.symbolIndex.Len()
+	status["coalescing"] = b.coalescer.Status()
+	status["resultCache"] = b.resultCache.Status()
+	status["memory"] = b.governor.Status()
+
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	if b.startup != nil {
+		status["startup"] = b.startup.Status()
+	}
+	status["startTimes"] = b.startTimesLocked()
+	if b.database != nil {
+		status["compilationDatabase"] = b.databaseStatusLocked()
+	}
+	status["regeneration"] = b.regenerator.Status()
+	// Parts that only exist while clangd is running
+	if b.running && b.startup.isReady() {
+		status["workingSet"] = b.workingSet.Status()
+		if b.prefetcher != nil {
+			status["prefetch"] = b.prefetcher.Status()
+		}
+		if b.fileWatcher != nil {
+			status["watcher"] = b.fileWatcher.Status()
+		}
+	}
+}
+
+func (b *Backend) startTimesLocked() StartTimes {
+	times := StartTimes{Resumes: b.resumes, Crashes: b.crashes}
+	if b.coldStart > 0 {
+		times.ColdStart = b.coldStart.Round(time.Millisecond).String()
+	}
+	if b.resumes > 0 {
+		times.AvgResume = (b.resumeTotal / time.Duration(b.resumes)).Round(time.Millisecond).String()
+		times.LastResume = b.lastResume.Round(time.Millisecond).String()
+	}
+	return times
+}
+
+// Returns a recorder for the LSP session of the clangd being started if
+// CLANGD_DAEMON_LSP_RECORD names a file to record to (absolute or relative to
+// the project root), nil otherwise. Each start of clangd replaces the
+// previous recording.
+func (b *Backend) newLSPRecorder() *clangd.Recorder {
+	path := os.Getenv("CLANGD_DAEMON_LSP_RECORD")
+	if path == "" {
+		return nil
+	}
+	if !filepath.IsAbs(path) {
+		path = filepath.Join(b.projectRoot, path)
+	}
+	recorder, err := clangd.NewRecorder(path)
+	if err != nil {
+		b.logger.Error("Not recording the LSP session: %v", err)
+		return nil
+	}
+	b.logger.Info("Recording the LSP session to %s", path)
+	return recorder
+}
+
+// Returns the number of cancelled clangd requests, for the scheduler status
+func (b *Backend) cancelledRequests() int64 {
+	if client := b.runningClient(); client != nil {
+		return client.CancelledRequests()
+	}
+	return 0
+}
+
+// Returns a summary of the backend for a shared daemon's status
+func (b *Backend) ProjectStatus() ProjectStatus {
+	rss := b.RSS()
+
+	b.mu.Lock()
+	defer b.mu.Unlock()
+
+	status := ProjectStatus{
+		ProjectRoot: b.projectRoot,
+		State:       BackendStopped,
+		LastUsed:    time.Since(b.lastUsed).Round(time.Second).String(),
+		Evictions:   b.evictions,
+	}
+	if b.running {
+		status.State = BackendRunning
+		status.Phase = b.startup.Phase()
+	}
+	if rss > 0 {
+		status.RSS = formatMB(rss)
+	}
+	return status
+}
@@ -0,0 +1,146 @@
+package daemon
+
+import (
+	"context"
+	"fmt"
+	"path/filepath"
+	"testing"
+	"time"
+
+	"clangd-query/internal/index"
+	"clangd-query/internal/logger"
+	"clangd-query/internal/replay"
+	"clangd-query/internal/trace"
+)
+
+// Returns a backend whose clangd is a replay of the synthetic session in
+// ../commands/testdata/<name>.jsonl
+func newReplayBackend(t *testing.T, name string) *Backend {
+	t.Helper()
+	log := &logger.NullLogger{}
+	root, err := filepath.Abs("../../../test/fixtures/sample-project")
+	if err != nil {
+		t.Fatal(err)
+	}
+	server, err := replay.Load(filepath.Join("..", "commands", "testdata", name+".jsonl"), 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	buildDir := t.TempDir()
+	writeFile(t, filepath.Join(buildDir, "compile_commands.json"), fmt.Sprintf(
+		`[{"directory":%q,"file":%q,"command":"c++ -c main.cpp"}]`, buildDir, filepath.Join(root, "src", "main.cpp")))
+	client, err := replay.Connect(server, root, buildDir, log)
+	if err != nil {
+		t.Fatalf("starting client: %v", err)
+	}
+
+	// Results are cached in a project of the test's own
+	b := NewBackend(t.TempDir(), NewScheduler(2), func() bool { return false }, ReadinessWait, log)
+	startup := NewStartup(ReadinessWait)
+	startup.markReady()
+	close(startup.done)
+	b.mu.Lock()
+	b.running = true
+	b.startup = startup
+	b.stop = make(chan struct{})
+	b.clangdClient = client
+	b.mu.Unlock()
+	t.Cleanup(b.Close)
+	return b
+}
+
+func TestRequestTracesLSPCalls(t *testing.T) {
+	b := newReplayBackend(t, "show")
+	tracer := trace.NewTracer(1)
+
+	ctx, root := tracer.StartTrace(context.Background(), "show", "daemon")
+	req := Request{Method: "show", Params: map[string]interface{}{"symbol": "GameObject::Update"}}
+	if _, err := b.handleRequest(ctx, req, LaneInteractive); err != nil {
+		t.Fatal(err)
+	}
+	root.End()
+
+	spans, _ := tracer.Last(1)[0].Spans()
+	var command uint64
+	for _, span := range spans {
+		if span.Name == "commands.Show" {
+			command = span.ID
+		}
+	}
+	if command == 0 {
+		t.Fatalf("expected a commands.Show span, got %d spans", len(spans))
+	}
+	calls := 0
+	for _, span := range spans {
+		if span.Category != "lsp" {
+			continue
+		}
+		calls++
+		if span.Parent != command {
+			t.Errorf("expected %s to be a child of commands.Show", span.Name)
+		}
+	}
+	if calls == 0 {
+		t.Errorf("expected the LSP calls of show in the trace")
+	}
+}
+
+func TestStopDoesNotWaitForBringUp(t *testing.T) {
+	// A bring-up that needs b.mu to finish, e.g. after clangd crashed while
+	// it started, must not hold up stopping
+	b := &Backend{
+		projectRoot: t.TempDir(),
+		logger:      &logger.NullLogger{},
+		running:     true,
+		startup:     NewStartup(ReadinessWait),
+		stop:        make(chan struct{}),
+		symbolIndex: index.NewSymbolIndex(),
+	}
+	start := time.Now()
+	b.Stop()
+	if elapsed := time.Since(start); elapsed >= startupShutdownWait {
+		t.Errorf("expected Stop to return right away, took %v", elapsed)
+	}
+	select {
+	case <-b.stop:
+	default:
+		t.Errorf("expected the bring-up to be told to stop")
+	}
+}
+
+func TestRestartWhileIndexing(t *testing.T) {
+	// clangd accepts queries but hasn't finished its first indexing pass,
+	// when it uses the most memory
+	indexing := NewStartup(ReadinessWait)
+	indexing.markReady()
+	b := &Backend{
+		projectRoot: t.TempDir(),
+		logger:      &logger.NullLogger{},
+		readiness:   ReadinessWait,
+		running:     true,
+		startup:     indexing,
+		stop:        make(chan struct{}),
+		symbolIndex: index.NewSymbolIndex(),
+	}
+	if !b.Restart() {
+		t.Fatalf("expected clangd to be restarted while it indexes")
+	}
+	restarted := b.currentStartup()
+
+	// Stopped before the old bring-up ends, the new one does nothing
+	b.Stop()
+	close(indexing.done)
+	select {
+	case <-restarted.done:
+	case <-time.After(time.Second):
+		t.Fatalf("expected the stopped bring-up to end")
+	}
+
+	b.mu.Lock()
+	b.running, b.startup, b.stop = true, indexing, make(chan struct{})
+	b.active = 1
+	b.mu.Unlock()
+	if b.Restart() {
+		t.Errorf("expected clangd not to be restarted while a request uses it")
+	}
+}
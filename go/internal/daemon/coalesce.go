@@ -0,0 +1,118 @@
+package daemon
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"sync"
+)
+
+// An execution of a request shared by every identical request that arrived
+// while it was running
+type flight struct {
+	done    chan struct{}
+	result  json.RawMessage
+	err     error
+	waiters int
+	cancel  context.CancelFunc
+}
+
+// CoalescingStatus reports how many requests shared another request's
+// execution, for the status command
+type CoalescingStatus struct {
+	Executed  int64 `json:"executed"`  // Requests that ran
+	Coalesced int64 `json:"coalesced"` // Requests answered by an identical request already in flight
+}
+
+// Coalescer runs identical concurrent requests only once. When many agents
+// work on the same task they often send the exact same query within moments
+// of each other; the first one runs and all others wait for its result
+// instead of sending the same work to clangd again.
+//
+// The shared execution is cancelled only when every request waiting for it
+// has gone away, so one client disconnecting or hitting its deadline doesn't
+// fail the others.
+type Coalescer struct {
+	mu        sync.Mutex
+	flights   map[string]*flight
+	executed  int64
+	coalesced int64
+}
+
+// Creates an empty coalescer
+func NewCoalescer() *Coalescer {
+	return &Coalescer{
+		flights: make(map[string]*flight),
+	}
+}
+
+// Returns the coalescing key of a request. Results can only be shared within
+// one index generation, since any file change may alter them.
+func coalescingKey(req Request, generation uint64) string {
+	params, _ := json.Marshal(req.Params) // Map keys are sorted, so this is canonical
+	return fmt.Sprintf("%s\x00%s\x00%d", req.Method, params, generation)
+}
+
+// Runs fn for the key, or waits for the run already in flight for the same
+// key. Returns ctx's error if ctx is done before the result is available.
+// The run keeps the values of the ctx that started it, like its trace span,
+// but not its deadline.
+func (c *Coalescer) Do(ctx context.Context, key string, fn func(ctx context.Context) (json.RawMessage, error)) (json.RawMessage, error) {
+	c.mu.Lock()
+	f, ok := c.flights[key]
+	if ok {
+		f.waiters++
+		c.coalesced++
+		c.mu.Unlock()
+	} else {
+		flightCtx, cancel := context.WithCancel(context.WithoutCancel(ctx))
+		f = &flight{
+			done:    make(chan struct{}),
+			waiters: 1,
+			cancel:  cancel,
+		}
+		c.flights[key] = f
+		c.executed++
+		c.mu.Unlock()
+
+		go func() {
+			defer cancel()
+			f.result, f.err = fn(flightCtx)
+
+			c.mu.Lock()
+			if c.flights[key] == f {
+				delete(c.flights, key)
+			}
+			c.mu.Unlock()
+			close(f.done)
+		}()
+	}
+
+	select {
+	case <-f.done:
+		return f.result, f.err
+	case <-ctx.Done():
+		c.mu.Lock()
+		f.waiters--
+		if f.waiters == 0 {
+			// Nobody is interested anymore. Later requests start over rather
+			// than joining a cancelled run.
+			f.cancel()
+			if c.flights[key] == f {
+				delete(c.flights, key)
+			}
+		}
+		c.mu.Unlock()
+		return nil, ctx.Err()
+	}
+}
+
+// Returns coalescing statistics for the status command
+func (c *Coalescer) Status() CoalescingStatus {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return CoalescingStatus{
+		Executed:  c.executed,
+		Coalesced: c.coalesced,
+	}
+}
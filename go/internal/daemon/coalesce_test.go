@@ -0,0 +1,105 @@
+package daemon
+
+import (
+	"context"
+	"encoding/json"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+func TestCoalescerRunsIdenticalRequestsOnce(t *testing.T) {
+	c := NewCoalescer()
+	release := make(chan struct{})
+	var runs atomic.Int32
+
+	fn := func(ctx context.Context) (json.RawMessage, error) {
+		runs.Add(1)
+		<-release
+		return json.RawMessage(`"result"`), nil
+	}
+
+	key := coalescingKey(Request{Method: "show", Params: map[string]interface{}{"symbol": "Engine"}}, 1)
+
+	var wg sync.WaitGroup
+	results := make([]string, 5)
+	for i := range results {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			result, err := c.Do(context.Background(), key, fn)
+			if err != nil {
+				t.Errorf("Do failed: %v", err)
+			}
+			results[i] = string(result)
+		}(i)
+	}
+
+	// Wait until all requests joined the flight before letting it finish
+	for c.Status().Executed+c.Status().Coalesced < 5 {
+		time.Sleep(time.Millisecond)
+	}
+	close(release)
+	wg.Wait()
+
+	if runs.Load() != 1 {
+		t.Errorf("expected 1 run, got %d", runs.Load())
+	}
+	for i, result := range results {
+		if result != `"result"` {
+			t.Errorf("request %d got %s", i, result)
+		}
+	}
+	if status := c.Status(); status.Executed != 1 || status.Coalesced != 4 {
+		t.Errorf("unexpected status: %+v", status)
+	}
+}
+
+func TestCoalescerCancelsWhenAllWaitersLeave(t *testing.T) {
+	c := NewCoalescer()
+	cancelled := make(chan struct{})
+
+	fn := func(ctx context.Context) (json.RawMessage, error) {
+		<-ctx.Done()
+		close(cancelled)
+		return nil, ctx.Err()
+	}
+
+	first, cancelFirst := context.WithCancel(context.Background())
+	second, cancelSecond := context.WithCancel(context.Background())
+
+	var wg sync.WaitGroup
+	for _, ctx := range []context.Context{first, second} {
+		wg.Add(1)
+		go func(ctx context.Context) {
+			defer wg.Done()
+			c.Do(ctx, "usages", fn)
+		}(ctx)
+	}
+	for c.Status().Executed+c.Status().Coalesced < 2 {
+		time.Sleep(time.Millisecond)
+	}
+
+	cancelFirst()
+	select {
+	case <-cancelled:
+		t.Fatalf("shared run cancelled while a request was still waiting")
+	case <-time.After(20 * time.Millisecond):
+	}
+
+	cancelSecond()
+	select {
+	case <-cancelled:
+	case <-time.After(time.Second):
+		t.Fatalf("shared run not cancelled after all requests left")
+	}
+	wg.Wait()
+}
+
+func TestCoalescingKeyIncludesGeneration(t *testing.T) {
+	req := Request{Method: "usages", Params: map[string]interface{}{"symbol": "GameObject::Update", "limit": 20}}
+	if coalescingKey(req, 1) == coalescingKey(req, 2) {
+		t.Errorf("requests from different index generations must not be coalesced")
+	}
+}
@@ -1,28 +1,280 @@
 package daemon
 
 import (
+	"encoding/json"
 	"fmt"
+	"io/fs"
 	"os"
 	"os/exec"
 	"path/filepath"
+	"sort"
 	"strings"
+	"time"
 
 	"clangd-query/internal/logger"
 )
 
-// EnsureCompilationDatabase ensures compile_commands.json exists in the build directory
-func EnsureCompilationDatabase(projectRoot string, log logger.Logger) (string, error) {
-	buildDir := filepath.Join(projectRoot, ".cache", "clangd-query", "build")
-	compileCommandsPath := filepath.Join(buildDir, "compile_commands.json")
+// Where a compilation database was found, as reported by the status command
+const (
+	DatabaseOverride    = "override"      // CLANGD_DAEMON_COMPILE_COMMANDS_DIR
+	DatabaseProjectRoot = "project root"  // compile_commands.json, usually a symlink, in the project root
+	DatabaseBuildTree   = "build tree"    // An existing build directory of the project
+	DatabasePrivate     = "private build" // Configured by clangd-query in .cache/clangd-query/build
+)
+
+// Build directories searched for an existing compile_commands.json, relative
+// to the project root. Patterns are expanded with filepath.Glob.
+var buildTreeCandidates = []string{
+	"build",
+	"out",
+	"cmake-build-*",
+	"build-*",
+	"build/*",
+	"out/build/*",
+}
+
+// CompilationDatabase describes the compile_commands.json clangd uses
+type CompilationDatabase struct {
+	Dir    string `json:"dir"`    // Directory containing compile_commands.json
+	Source string `json:"source"` // One of the Database* constants
+	Stale  bool   `json:"stale"`  // Configured before the last CMake change
+}
+
+// EnsureCompilationDatabase finds a usable compile_commands.json for the
+// project. In order, it uses the directory named by the
+// CLANGD_DAEMON_COMPILE_COMMANDS_DIR environment variable, a
+// compile_commands.json in the project root, the most recently configured of
+// the project's build directories, or the private build directory. A
+// database is only reused if it lists files of the project. One configured
+// after the last change to any CMake file is preferred; otherwise a stale one
+// CMake can reconfigure is returned with Stale set, so clangd starts right
+// away. The caller regenerates the private build directory in the background;
+// build directories of the developer are theirs to reconfigure. If none is
+// usable, it configures the private build directory.
+func EnsureCompilationDatabase(projectRoot string, log logger.Logger) (*CompilationDatabase, error) {
+	if dir := os.Getenv("CLANGD_DAEMON_COMPILE_COMMANDS_DIR"); dir != "" {
+		if !filepath.IsAbs(dir) {
+			dir = filepath.Join(projectRoot, dir)
+		}
+		if err := checkCompilationDatabase(dir, projectRoot); err != nil {
+			return nil, fmt.Errorf("CLANGD_DAEMON_COMPILE_COMMANDS_DIR: %v", err)
+		}
+		log.Info("Using compile_commands.json in %s (CLANGD_DAEMON_COMPILE_COMMANDS_DIR)", dir)
+		return &CompilationDatabase{Dir: dir, Source: DatabaseOverride}, nil
+	}
+
+	cmakeChanged := newestCMakeFile(projectRoot)
+
+	if db := findExistingDatabase(projectRoot, cmakeChanged, log); db != nil {
+		log.Info("Using existing compile_commands.json in %s (%s)", db.Dir, db.Source)
+		return db, nil
+	}
+
+	buildDir := getPrivateBuildDir(projectRoot)
+	if err := configureBuild(projectRoot, buildDir, log); err != nil {
+		return nil, err
+	}
+	return &CompilationDatabase{Dir: buildDir, Source: DatabasePrivate}, nil
+}
+
+// Returns the private build directory clangd-query configures itself
+func getPrivateBuildDir(projectRoot string) string {
+	return filepath.Join(projectRoot, ".cache", "clangd-query", "build")
+}
+
+// Returns the first up-to-date database in order of preference, or else the
+// first stale one CMake can reconfigure, or nil
+func findExistingDatabase(projectRoot string, cmakeChanged time.Time, log logger.Logger) *CompilationDatabase {
+	candidates := findDatabases(projectRoot, log)
+	for _, db := range candidates {
+		if !configureTime(db.Dir).Before(cmakeChanged) {
+			return db
+		}
+	}
+
+	for _, db := range candidates {
+		if canReconfigure(db.Dir) {
+			if db.Source == DatabasePrivate {
+				log.Info("compile_commands.json in %s is older than the last change to the CMake files, regenerating it in the background", db.Dir)
+			} else {
+				log.Info("compile_commands.json in %s is older than the last change to the CMake files, using it until the build directory is reconfigured", db.Dir)
+			}
+			db.Stale = true
+			return db
+		}
+		log.Info("Ignoring compile_commands.json in %s: older than the last change to the CMake files", db.Dir)
+	}
+	return nil
+}
+
+// Returns the directories holding a compile_commands.json of the project, in
+// order of preference: the project root, the build directories by the time
+// they were last configured, and the private build directory
+func findDatabases(projectRoot string, log logger.Logger) []*CompilationDatabase {
+	var databases []*CompilationDatabase
+
+	// A compile_commands.json in the root is usually a symlink into the build
+	// directory the developer works with, so it takes precedence
+	rootDatabase := filepath.Join(projectRoot, "compile_commands.json")
+	if target, err := filepath.EvalSymlinks(rootDatabase); err == nil {
+		dir := filepath.Dir(target)
+		if validDatabase(dir, projectRoot, log) {
+			databases = append(databases, &CompilationDatabase{Dir: dir, Source: DatabaseProjectRoot})
+		}
+	}
+
+	var buildTrees []*CompilationDatabase
+	seen := make(map[string]bool)
+	for _, pattern := range buildTreeCandidates {
+		matches, _ := filepath.Glob(filepath.Join(projectRoot, pattern))
+		sort.Strings(matches)
+		for _, dir := range matches {
+			if seen[dir] {
+				continue
+			}
+			seen[dir] = true
+			if validDatabase(dir, projectRoot, log) {
+				buildTrees = append(buildTrees, &CompilationDatabase{Dir: dir, Source: DatabaseBuildTree})
+			}
+		}
+	}
+	sort.SliceStable(buildTrees, func(i, j int) bool {
+		return configureTime(buildTrees[i].Dir).After(configureTime(buildTrees[j].Dir))
+	})
+	databases = append(databases, buildTrees...)
+
+	if privateDir := getPrivateBuildDir(projectRoot); validDatabase(privateDir, projectRoot, log) {
+		databases = append(databases, &CompilationDatabase{Dir: privateDir, Source: DatabasePrivate})
+	}
+	return databases
+}
 
-	// Check if it already exists
-	if _, err := os.Stat(compileCommandsPath); err == nil {
-		return buildDir, nil
+// Returns true if dir holds a compile_commands.json of the project
+func validDatabase(dir string, projectRoot string, log logger.Logger) bool {
+	if _, err := os.Stat(filepath.Join(dir, "compile_commands.json")); err != nil {
+		return false
 	}
+	if err := checkCompilationDatabase(dir, projectRoot); err != nil {
+		log.Debug("Ignoring compile_commands.json in %s: %v", dir, err)
+		return false
+	}
+	return true
+}
+
+// Returns true if dir is a CMake build directory that can be reconfigured
+func canReconfigure(dir string) bool {
+	_, err := os.Stat(filepath.Join(dir, "CMakeCache.txt"))
+	return err == nil
+}
+
+// Checks that dir holds a compile_commands.json whose first entry is a file
+// of the project. Only the first entry is decoded, as databases of large
+// projects are tens of megabytes.
+func checkCompilationDatabase(dir string, projectRoot string) error {
+	file, err := os.Open(filepath.Join(dir, "compile_commands.json"))
+	if err != nil {
+		return err
+	}
+	defer file.Close()
+
+	decoder := json.NewDecoder(file)
+	if token, err := decoder.Token(); err != nil || token != json.Delim('[') {
+		return fmt.Errorf("compile_commands.json is not a JSON array")
+	}
+	if !decoder.More() {
+		return fmt.Errorf("compile_commands.json is empty")
+	}
+
+	var entry struct {
+		Directory string `json:"directory"`
+		File      string `json:"file"`
+	}
+	if err := decoder.Decode(&entry); err != nil {
+		return fmt.Errorf("failed to parse compile_commands.json: %v", err)
+	}
+
+	path := entry.File
+	if !filepath.IsAbs(path) {
+		path = filepath.Join(entry.Directory, path)
+	}
+	if !isWithin(path, projectRoot) {
+		return fmt.Errorf("compile_commands.json lists %s, which is outside of %s", path, projectRoot)
+	}
+	return nil
+}
+
+// Returns true if path is projectRoot or inside it
+func isWithin(path string, projectRoot string) bool {
+	rel, err := filepath.Rel(projectRoot, filepath.Clean(path))
+	return err == nil && rel != ".." && !strings.HasPrefix(rel, ".."+string(filepath.Separator))
+}
+
+// Returns when the build directory was last configured. CMake rewrites
+// CMakeCache.txt on every configure, but may leave compile_commands.json
+// untouched if its content didn't change.
+func configureTime(dir string) time.Time {
+	var newest time.Time
+	for _, name := range []string{"compile_commands.json", "CMakeCache.txt"} {
+		if info, err := os.Stat(filepath.Join(dir, name)); err == nil && info.ModTime().After(newest) {
+			newest = info.ModTime()
+		}
+	}
+	return newest
+}
+
+// Returns the modification time of the most recently changed CMake file of
+// the project, skipping hidden and build directories
+func newestCMakeFile(projectRoot string) time.Time {
+	var newest time.Time
+	filepath.WalkDir(projectRoot, func(path string, entry fs.DirEntry, err error) error {
+		if err != nil {
+			return nil // Ignore errors walking the tree
+		}
+
+		if entry.IsDir() {
+			if path == projectRoot {
+				return nil
+			}
+			if isSkippedDirectory(entry.Name()) {
+				return filepath.SkipDir
+			}
+			// Build directories with other names still contain a CMakeCache.txt
+			if _, err := os.Stat(filepath.Join(path, "CMakeCache.txt")); err == nil {
+				return filepath.SkipDir
+			}
+			return nil
+		}
+
+		if isCMakeFile(path) {
+			if info, err := entry.Info(); err == nil && info.ModTime().After(newest) {
+				newest = info.ModTime()
+			}
+		}
+		return nil
+	})
+	return newest
+}
+
+// Returns true for hidden and build directories, which are neither watched
+// nor searched for CMake files
+func isSkippedDirectory(base string) bool {
+	return strings.HasPrefix(base, ".") ||
+		base == "build" ||
+		base == "cmake-build-debug" ||
+		base == "cmake-build-release" ||
+		base == "out" ||
+		base == "bin" ||
+		base == "obj"
+}
+
+// Configures a build directory with CMake to generate its
+// compile_commands.json. An existing build directory keeps its cache.
+func configureBuild(projectRoot string, buildDir string, log logger.Logger) error {
+	compileCommandsPath := filepath.Join(buildDir, "compile_commands.json")
 
 	// Create build directory
 	if err := os.MkdirAll(buildDir, 0755); err != nil {
-		return "", fmt.Errorf("failed to create build directory: %v", err)
+		return fmt.Errorf("failed to create build directory: %v", err)
 	}
 
 	// Run CMake to generate compile_commands.json
@@ -37,15 +289,15 @@ func EnsureCompilationDatabase(projectRoot string, log logger.Logger) (string, e
 	if err != nil {
 		// Check if cmake is not found
 		if strings.Contains(err.Error(), "executable file not found") {
-			return "", fmt.Errorf("cmake not found in PATH. Please install CMake to use clangd-query")
+			return fmt.Errorf("cmake not found in PATH. Please install CMake to use clangd-query")
 		}
-		return "", fmt.Errorf("cmake failed: %v\nOutput: %s", err, output)
+		return fmt.Errorf("cmake failed: %v\nOutput: %s", err, output)
 	}
 
 	// Verify the file was created
 	if _, err := os.Stat(compileCommandsPath); err != nil {
-		return "", fmt.Errorf("cmake succeeded but compile_commands.json was not created")
+		return fmt.Errorf("cmake succeeded but compile_commands.json was not created")
 	}
 
-	return buildDir, nil
+	return nil
 }
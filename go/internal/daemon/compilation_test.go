@@ -0,0 +1,130 @@
+package daemon
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+
+	"clangd-query/internal/logger"
+)
+
+// Creates a build directory with a compile_commands.json listing file,
+// configured at the given time
+func writeBuildTree(t *testing.T, dir string, file string, configured time.Time) {
+	t.Helper()
+	if err := os.MkdirAll(dir, 0755); err != nil {
+		t.Fatal(err)
+	}
+	database := filepath.Join(dir, "compile_commands.json")
+	writeFile(t, database, fmt.Sprintf(`[{"directory": %q, "file": %q, "command": "c++ -c %s"}]`, dir, file, file))
+	if err := os.Chtimes(database, configured, configured); err != nil {
+		t.Fatal(err)
+	}
+}
+
+// Creates a project whose CMakeLists.txt was last changed at the given time
+func newCMakeProject(t *testing.T, changed time.Time) string {
+	t.Helper()
+	projectRoot := t.TempDir()
+	cmakeLists := filepath.Join(projectRoot, "CMakeLists.txt")
+	writeFile(t, cmakeLists, "project(test)")
+	if err := os.Chtimes(cmakeLists, changed, changed); err != nil {
+		t.Fatal(err)
+	}
+	writeFile(t, filepath.Join(projectRoot, "main.cpp"), "int main() {}")
+	return projectRoot
+}
+
+func TestFindExistingDatabase(t *testing.T) {
+	log := &logger.NullLogger{}
+	changed := time.Now().Add(-time.Hour)
+
+	t.Run("most recently configured build tree", func(t *testing.T) {
+		projectRoot := newCMakeProject(t, changed)
+		main := filepath.Join(projectRoot, "main.cpp")
+		writeBuildTree(t, filepath.Join(projectRoot, "build"), main, changed.Add(time.Minute))
+		writeBuildTree(t, filepath.Join(projectRoot, "cmake-build-debug"), main, changed.Add(2*time.Minute))
+
+		db := findExistingDatabase(projectRoot, newestCMakeFile(projectRoot), log)
+		if db == nil || db.Dir != filepath.Join(projectRoot, "cmake-build-debug") || db.Source != DatabaseBuildTree {
+			t.Errorf("expected cmake-build-debug, got %+v", db)
+		}
+	})
+
+	t.Run("root symlink takes precedence", func(t *testing.T) {
+		projectRoot := newCMakeProject(t, changed)
+		main := filepath.Join(projectRoot, "main.cpp")
+		writeBuildTree(t, filepath.Join(projectRoot, "build"), main, changed.Add(2*time.Minute))
+		writeBuildTree(t, filepath.Join(projectRoot, "out", "build", "debug"), main, changed.Add(time.Minute))
+		target := filepath.Join(projectRoot, "out", "build", "debug", "compile_commands.json")
+		if err := os.Symlink(target, filepath.Join(projectRoot, "compile_commands.json")); err != nil {
+			t.Fatal(err)
+		}
+
+		db := findExistingDatabase(projectRoot, newestCMakeFile(projectRoot), log)
+		if db == nil || db.Dir != filepath.Join(projectRoot, "out", "build", "debug") || db.Source != DatabaseProjectRoot {
+			t.Errorf("expected the symlinked build directory, got %+v", db)
+		}
+	})
+
+	t.Run("foreign databases and stale ones CMake can't reconfigure are ignored", func(t *testing.T) {
+		projectRoot := newCMakeProject(t, changed)
+		writeBuildTree(t, filepath.Join(projectRoot, "build"), filepath.Join(projectRoot, "main.cpp"), changed.Add(-time.Minute))
+		writeBuildTree(t, filepath.Join(projectRoot, "out"), "/elsewhere/main.cpp", changed.Add(time.Minute))
+
+		if db := findExistingDatabase(projectRoot, newestCMakeFile(projectRoot), log); db != nil {
+			t.Errorf("expected no usable database, got %+v", db)
+		}
+	})
+
+	t.Run("CMake files in build trees are not considered", func(t *testing.T) {
+		projectRoot := newCMakeProject(t, changed)
+		buildDir := filepath.Join(projectRoot, "build")
+		writeBuildTree(t, buildDir, filepath.Join(projectRoot, "main.cpp"), changed.Add(time.Minute))
+		writeFile(t, filepath.Join(buildDir, "generated.cmake"), "")
+
+		if db := findExistingDatabase(projectRoot, newestCMakeFile(projectRoot), log); db == nil {
+			t.Errorf("expected the build tree to be used")
+		}
+	})
+}
+
+func TestCompilationDatabaseOverride(t *testing.T) {
+	projectRoot := newCMakeProject(t, time.Now())
+	writeBuildTree(t, filepath.Join(projectRoot, "custom"), filepath.Join(projectRoot, "main.cpp"), time.Now().Add(-time.Hour))
+
+	// The override is used even if it is stale
+	t.Setenv("CLANGD_DAEMON_COMPILE_COMMANDS_DIR", "custom")
+	db, err := EnsureCompilationDatabase(projectRoot, &logger.NullLogger{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if db.Dir != filepath.Join(projectRoot, "custom") || db.Source != DatabaseOverride {
+		t.Errorf("expected the override, got %+v", db)
+	}
+
+	t.Setenv("CLANGD_DAEMON_COMPILE_COMMANDS_DIR", "missing")
+	if _, err := EnsureCompilationDatabase(projectRoot, &logger.NullLogger{}); err == nil {
+		t.Errorf("expected an error for a missing override")
+	}
+}
+
+func TestStaleBuildTreeIsUsed(t *testing.T) {
+	changed := time.Now().Add(-time.Hour)
+	projectRoot := newCMakeProject(t, changed)
+	buildDir := filepath.Join(projectRoot, "build")
+	writeBuildTree(t, buildDir, filepath.Join(projectRoot, "main.cpp"), changed.Add(-time.Minute))
+	cache := filepath.Join(buildDir, "CMakeCache.txt")
+	writeFile(t, cache, "")
+	if err := os.Chtimes(cache, changed.Add(-time.Minute), changed.Add(-time.Minute)); err != nil {
+		t.Fatal(err)
+	}
+
+	// A stale CMake build directory is used rather than configuring from scratch
+	db := findExistingDatabase(projectRoot, newestCMakeFile(projectRoot), &logger.NullLogger{})
+	if db == nil || db.Dir != buildDir || !db.Stale {
+		t.Errorf("expected the stale build directory, got %+v", db)
+	}
+}
@@ -0,0 +1,126 @@
+package daemon
+
+import (
+	"hash/fnv"
+	"io"
+	"os"
+	"sync"
+)
+
+// ContentHashes remembers the content hash of source files, so the file
+// watcher can drop events for files that were rewritten or touched without
+// changing, e.g. by formatters and build tools. Hashes are computed lazily:
+// in the background for files queries use, and on the first real change of
+// any other file. A file without a recorded hash always counts as changed.
+type ContentHashes struct {
+	mu         sync.Mutex
+	hashes     map[string]fileHash
+	hashing    map[string]bool // Files being hashed by Track
+	suppressed int64
+}
+
+// Creates an empty set of content hashes
+func NewContentHashes() *ContentHashes {
+	return &ContentHashes{
+		hashes:  make(map[string]fileHash),
+		hashing: make(map[string]bool),
+	}
+}
+
+// Records the hash of a file in the background, unless it is known already
+func (h *ContentHashes) Track(path string) {
+	h.mu.Lock()
+	defer h.mu.Unlock()
+	if _, ok := h.hashes[path]; ok || h.hashing[path] {
+		return
+	}
+	h.hashing[path] = true
+
+	go func() {
+		memo, err := hashFileContent(path)
+
+		h.mu.Lock()
+		defer h.mu.Unlock()
+		delete(h.hashing, path)
+		// A hash recorded by Changed meanwhile is newer
+		if _, ok := h.hashes[path]; err == nil && !ok {
+			h.hashes[path] = memo
+		}
+	}()
+}
+
+// Returns true if the content of a file differs from its recorded hash, and
+// records the current one. Unchanged files are counted as suppressed. The
+// file isn't read if its size and modification time are unchanged.
+func (h *ContentHashes) Changed(path string) bool {
+	info, err := os.Stat(path)
+	if err != nil {
+		h.Forget(path)
+		return true
+	}
+
+	h.mu.Lock()
+	previous, known := h.hashes[path]
+	h.mu.Unlock()
+	if known && previous.size == info.Size() && previous.modTime.Equal(info.ModTime()) {
+		h.countSuppressed()
+		return false
+	}
+
+	memo, err := hashFileContent(path)
+	if err != nil {
+		h.Forget(path)
+		return true
+	}
+	h.mu.Lock()
+	h.hashes[path] = memo
+	h.mu.Unlock()
+
+	if known && previous.size == memo.size && previous.hash == memo.hash {
+		h.countSuppressed()
+		return false
+	}
+	return true
+}
+
+// Drops the hash of a deleted file
+func (h *ContentHashes) Forget(path string) {
+	h.mu.Lock()
+	defer h.mu.Unlock()
+	delete(h.hashes, path)
+}
+
+func (h *ContentHashes) countSuppressed() {
+	h.mu.Lock()
+	defer h.mu.Unlock()
+	h.suppressed++
+}
+
+// Returns the number of files with a recorded hash and the number of
+// changes dropped because the content was the same
+func (h *ContentHashes) Stats() (files int, suppressed int64) {
+	h.mu.Lock()
+	defer h.mu.Unlock()
+	return len(h.hashes), h.suppressed
+}
+
+// Returns the FNV-1a content hash of a file along with its size and
+// modification time
+func hashFileContent(path string) (fileHash, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return fileHash{}, err
+	}
+	defer f.Close()
+
+	info, err := f.Stat()
+	if err != nil {
+		return fileHash{}, err
+	}
+
+	h := fnv.New64a()
+	if _, err := io.Copy(h, f); err != nil {
+		return fileHash{}, err
+	}
+	return fileHash{size: info.Size(), modTime: info.ModTime(), hash: h.Sum64()}, nil
+}
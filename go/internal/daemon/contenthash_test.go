@@ -0,0 +1,70 @@
+package daemon
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+func TestContentHashesDropUnchangedFiles(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "engine.cpp")
+	writeFile(t, path, "void start() {}")
+	hashes := NewContentHashes()
+
+	// Without a recorded hash a file counts as changed
+	if !hashes.Changed(path) {
+		t.Errorf("expected an unknown file to count as changed")
+	}
+
+	// Touched, and rewritten with the same content
+	later := time.Now().Add(time.Second)
+	if err := os.Chtimes(path, later, later); err != nil {
+		t.Fatal(err)
+	}
+	if hashes.Changed(path) {
+		t.Errorf("expected a touched file to be unchanged")
+	}
+	writeFile(t, path, "void start() {}")
+	if hashes.Changed(path) {
+		t.Errorf("expected a file rewritten with the same content to be unchanged")
+	}
+
+	writeFile(t, path, "void start() { run(); }")
+	if !hashes.Changed(path) {
+		t.Errorf("expected a modified file to be changed")
+	}
+
+	if files, suppressed := hashes.Stats(); files != 1 || suppressed != 2 {
+		t.Errorf("expected 1 hashed file and 2 suppressed changes, got %d and %d", files, suppressed)
+	}
+
+	hashes.Forget(path)
+	if !hashes.Changed(path) {
+		t.Errorf("expected a forgotten file to count as changed")
+	}
+}
+
+func TestContentHashesTrack(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "engine.h")
+	writeFile(t, path, "class Engine {};")
+	hashes := NewContentHashes()
+
+	hashes.Track(path)
+	deadline := time.Now().Add(5 * time.Second)
+	for {
+		if files, _ := hashes.Stats(); files == 1 {
+			break
+		}
+		if time.Now().After(deadline) {
+			t.Fatal("expected the tracked file to be hashed")
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+
+	// The first rewrite after tracking is recognized as a no-op
+	writeFile(t, path, "class Engine {};")
+	if hashes.Changed(path) {
+		t.Errorf("expected a rewrite of a tracked file with the same content to be unchanged")
+	}
+}
@@ -1,48 +1,79 @@
 package daemon
 
 import (
+	"context"
 	"encoding/json"
 	"fmt"
 	"net"
 	"os"
 	"os/signal"
+	"path/filepath"
+	"sort"
+	"strconv"
 	"sync"
+	"sync/atomic"
 	"syscall"
 	"time"
 
-	"clangd-query/internal/clangd"
-	"clangd-query/internal/commands"
 	"clangd-query/internal/logger"
+	"clangd-query/internal/trace"
 )
 
+// Number of request traces kept for the trace command
+const traceCapacity = 200
+
 // Config contains daemon configuration
 type Config struct {
-	ProjectRoot string
+	ProjectRoot string // For a shared daemon, the directory of its lock and log files
 	Verbose     bool
+	Shared      bool // Serve any project instead of only ProjectRoot
 }
 
-// Daemon manages the clangd process and handles client connections
+// Daemon manages the clangd process and handles client connections.
+//
+// A shared daemon hosts the backends of several projects and routes each
+// request by its project root. It keeps the total memory of all clangd
+// instances within a budget by stopping the least recently used ones.
 type Daemon struct {
 	projectRoot   string
+	shared        bool
 	socketPath    string
 	logger        logger.Logger
-	clangdClient  *clangd.ClangdClient
-	fileWatcher   *FileWatcher
+	scheduler     *Scheduler
+	readiness     string
+	memoryBudget  int64
+	backendsMu    sync.Mutex
+	backends      map[string]*Backend
 	listener      net.Listener
 	idleTimer     *time.Timer
 	idleTimeout   time.Duration
+	hibernated    bool
+	hibernatedAt  time.Time
+	hibernations  int
 	mu            sync.Mutex
 	shutdown      chan struct{}
+	shutdownOnce  sync.Once
 	connections   int
 	totalRequests int
 	startTime     time.Time
+	tracer        *trace.Tracer
+	profiler      *Profiler
+
+	// Number of clangd backed requests currently queued or running.
+	// Background work like prewarming waits for this to drop to zero.
+	activeRequests atomic.Int32
 }
 
 // Request represents a client request
 type Request struct {
-	ID     interface{}            `json:"id"`
-	Method string                 `json:"method"`
-	Params map[string]interface{} `json:"params,omitempty"`
+	ID       interface{}            `json:"id"`
+	Method   string                 `json:"method"`
+	Params   map[string]interface{} `json:"params,omitempty"`
+	Deadline int64                  `json:"deadline,omitempty"` // Unix milliseconds, the client gives up after this
+	Project  string                 `json:"project,omitempty"`  // Project root, which a shared daemon routes by
+	// Unix microseconds when the client started handling the command, so
+	// its share of the time shows up in the request's trace
+	ClientStart int64 `json:"clientStart,omitempty"`
 }
 
 // Response represents a daemon response
@@ -61,62 +92,49 @@ type ErrorResponse struct {
 // Run starts the daemon
 func Run(config *Config) {
 	daemon := &Daemon{
-		projectRoot: config.ProjectRoot,
-		socketPath:  GetSocketPath(config.ProjectRoot),
-		shutdown:    make(chan struct{}),
-		startTime:   time.Now(),
+		projectRoot:  config.ProjectRoot,
+		shared:       config.Shared,
+		socketPath:   GetSocketPath(config.ProjectRoot),
+		scheduler:    NewScheduler(getWorkerCount()),
+		readiness:    getReadinessPolicy(),
+		memoryBudget: getMemoryBudget(),
+		backends:     make(map[string]*Backend),
+		shutdown:     make(chan struct{}),
+		startTime:    time.Now(),
+		tracer:       trace.NewTracer(traceCapacity),
+		profiler:     NewProfiler(getProfileDir(config.ProjectRoot)),
 	}
 
 	// Setup logging with config
 	if err := daemon.setupLogging(config.Verbose); err != nil {
 		fmt.Fprintf(os.Stderr, "Failed to setup logging: %v\n", err)
+		notifyStarted(fmt.Errorf("failed to setup logging: %v", err))
 		os.Exit(1)
 	}
-	defer func() {
-		if fileLogger, ok := daemon.logger.(*logger.FileLogger); ok {
-			fileLogger.Close()
-		}
-	}()
+	defer daemon.closeLogger()
 
-	daemon.logger.Info("Starting daemon for project: %s", config.ProjectRoot)
+	if config.Shared {
+		daemon.logger.Info("Starting shared daemon with a %s memory budget", formatMB(daemon.memoryBudget))
+	} else {
+		daemon.logger.Info("Starting daemon for project: %s", config.ProjectRoot)
+	}
 
 	// Check for existing daemon
 	if err := daemon.checkExistingDaemon(); err != nil {
 		daemon.logger.Error("Error checking existing daemon: %v", err)
+		notifyStarted(err)
+		daemon.closeLogger()
 		os.Exit(1)
 	}
 
 	// Write lock file
 	if err := WriteLockFile(config.ProjectRoot, os.Getpid(), daemon.socketPath); err != nil {
 		daemon.logger.Error("Failed to write lock file: %v", err)
+		notifyStarted(fmt.Errorf("failed to write lock file: %v", err))
+		daemon.closeLogger()
 		os.Exit(1)
 	}
-	defer RemoveLockFile(config.ProjectRoot)
-
-	// Ensure compilation database exists
-	buildDir, err := EnsureCompilationDatabase(config.ProjectRoot, daemon.logger)
-	if err != nil {
-		daemon.logger.Error("Failed to find compilation database: %v", err)
-		os.Exit(1)
-	}
-
-	// Start clangd
-	daemon.logger.Info("Starting clangd with build directory: %s", buildDir)
-	daemon.clangdClient, err = clangd.NewClangdClient(config.ProjectRoot, buildDir, daemon.logger)
-	if err != nil {
-		daemon.logger.Error("Failed to start clangd: %v", err)
-		os.Exit(1)
-	}
-	defer daemon.clangdClient.Stop()
-
-	// Setup file watcher
-	daemon.fileWatcher, err = NewFileWatcher(config.ProjectRoot, daemon.onFilesChanged, daemon.logger)
-	if err != nil {
-		daemon.logger.Error("Failed to setup file watcher: %v", err)
-		// Continue without file watching
-	} else {
-		defer daemon.fileWatcher.Stop()
-	}
+	defer RemoveOwnLockFile(config.ProjectRoot, os.Getpid())
 
 	// Setup idle timeout
 	daemon.setupIdleTimeout()
@@ -124,18 +142,38 @@ func Run(config *Config) {
 	// Setup signal handlers
 	daemon.setupSignalHandlers()
 
-	// Start socket server
+	// Start socket server before clangd, so clients can connect, see the
+	// startup phase, and get cached results while cmake and clangd start
 	if err := daemon.startSocketServer(); err != nil {
 		daemon.logger.Error("Failed to start socket server: %v", err)
+		notifyStarted(fmt.Errorf("failed to start socket server: %v", err))
+		daemon.closeLogger()
 		os.Exit(1)
 	}
+	notifyStarted(nil)
 
 	daemon.logger.Info("Daemon started successfully")
 
+	if config.Shared {
+		// Projects are started by their first request
+		go daemon.enforceMemoryBudget()
+	} else {
+		backend := daemon.newBackend(config.ProjectRoot)
+		backend.onStartupFailed = func(*Backend) {
+			daemon.logger.Info("Shutting down after failed startup")
+			daemon.requestShutdown()
+		}
+		backend.Start()
+	}
+
 	// Wait for shutdown
 	<-daemon.shutdown
 
 	daemon.logger.Info("Daemon shutting down")
+
+	for _, backend := range daemon.allBackends() {
+		backend.Close()
+	}
 }
 
 func (d *Daemon) setupLogging(verbose bool) error {
@@ -147,8 +185,9 @@ func (d *Daemon) setupLogging(verbose bool) error {
 		fileLogLevel = logger.LevelDebug
 	}
 
-	// Create file logger
-	fileLogger, err := logger.NewFileLogger(logPath, fileLogLevel)
+	// Create file logger. Debug messages are only formatted and kept in
+	// memory if they are logged to the file or explicitly requested.
+	fileLogger, err := logger.NewFileLogger(logPath, fileLogLevel, getMemoryLogLevel(fileLogLevel))
 	if err != nil {
 		return err
 	}
@@ -157,6 +196,27 @@ func (d *Daemon) setupLogging(verbose bool) error {
 	return nil
 }
 
+// Returns the most verbose level kept in memory for the logs command, which
+// CLANGD_DAEMON_LOG_LEVEL (error, info or debug) can raise above the file's
+func getMemoryLogLevel(fileLevel logger.LogLevel) logger.LogLevel {
+	switch os.Getenv("CLANGD_DAEMON_LOG_LEVEL") {
+	case "debug", "verbose":
+		return logger.LevelDebug
+	case "info":
+		return logger.LevelInfo
+	case "error":
+		return logger.LevelError
+	}
+	return fileLevel
+}
+
+// Writes pending log lines to the log file and closes it
+func (d *Daemon) closeLogger() {
+	if fileLogger, ok := d.logger.(*logger.FileLogger); ok {
+		fileLogger.Close()
+	}
+}
+
 func (d *Daemon) checkExistingDaemon() error {
 	lockInfo, err := ReadLockFile(d.projectRoot)
 	if err != nil {
@@ -177,9 +237,9 @@ func (d *Daemon) checkExistingDaemon() error {
 			d.logger.Debug("Found stale lock file, cleaning up")
 		}
 
-		// Clean up old socket
+		// Clean up old socket. The lock file itself is overwritten, since
+		// clients may hold the spawn lock on it.
 		CleanupSocket(lockInfo.SocketPath)
-		RemoveLockFile(d.projectRoot)
 	}
 
 	return nil
@@ -209,12 +269,51 @@ func (d *Daemon) resetIdleTimer() {
 		d.idleTimer.Stop()
 	}
 
-	d.idleTimer = time.AfterFunc(d.idleTimeout, func() {
-		d.logger.Info("Idle timeout reached, shutting down")
+	if d.hibernated {
+		// A hibernated daemon only wakes up for queries, and exits after
+		// maxHibernation without any connection
+		d.idleTimer = time.AfterFunc(maxHibernation, func() {
+			d.logger.Info("Hibernated for %s without a connection, shutting down", maxHibernation)
+			d.requestShutdown()
+		})
+		return
+	}
+	d.idleTimer = time.AfterFunc(d.idleTimeout, d.onIdle)
+}
+
+// Returns how many working set documents to prewarm at startup, from the
+// CLANGD_DAEMON_PREWARM environment variable or the default
+func getPrewarmCount() int {
+	if value := os.Getenv("CLANGD_DAEMON_PREWARM"); value != "" {
+		if count, err := strconv.Atoi(value); err == nil && count >= 0 {
+			return count
+		}
+	}
+	return defaultPrewarmCount
+}
+
+// Returns true while clangd backed requests are being handled
+func (d *Daemon) isBusy() bool {
+	return d.activeRequests.Load() > 0
+}
+
+// Shuts the daemon down. Safe to call more than once.
+func (d *Daemon) requestShutdown() {
+	d.shutdownOnce.Do(func() {
 		close(d.shutdown)
 	})
 }
 
+// Returns true once shutdown has been requested
+func (d *Daemon) isShuttingDown() bool {
+	select {
+	case <-d.shutdown:
+		return true
+	default:
+		return false
+	}
+}
+
 func (d *Daemon) setupSignalHandlers() {
 	sigChan := make(chan os.Signal, 1)
 	signal.Notify(sigChan, syscall.SIGTERM, syscall.SIGINT)
@@ -222,7 +321,7 @@ func (d *Daemon) setupSignalHandlers() {
 	go func() {
 		sig := <-sigChan
 		d.logger.Info("Received signal: %v", sig)
-		close(d.shutdown)
+		d.requestShutdown()
 	}()
 }
 
@@ -264,6 +363,9 @@ func (d *Daemon) acceptConnections() {
 	}
 }
 
+// Handles the requests of one client. Requests are decoded one after another
+// but run concurrently, and responses are written as they complete. When the
+// client disconnects, all of its requests still running are cancelled.
 func (d *Daemon) handleConnection(conn net.Conn) {
 	defer conn.Close()
 
@@ -277,6 +379,12 @@ func (d *Daemon) handleConnection(conn net.Conn) {
 	decoder := json.NewDecoder(conn)
 	encoder := json.NewEncoder(conn)
 
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+
+	var encoderMu sync.Mutex
+	var wg sync.WaitGroup
+
 	for {
 		var req Request
 		if err := decoder.Decode(&req); err != nil {
@@ -292,88 +400,228 @@ func (d *Daemon) handleConnection(conn net.Conn) {
 
 		d.logger.Info("Client %d: Request %s", clientID, req.Method)
 
-		// Handle the request
-		result, err := d.handleRequest(req)
+		wg.Add(1)
+		go func(req Request) {
+			defer wg.Done()
 
-		// Send response
-		resp := Response{
-			ID: req.ID,
-		}
+			// Handle the request
+			result, err := d.handleRequest(ctx, req)
 
-		if err != nil {
-			resp.Error = &ErrorResponse{
-				Code:    -1,
-				Message: err.Error(),
+			// Send response
+			resp := Response{
+				ID: req.ID,
 			}
-		} else {
-			resp.Result = result
+
+			if err != nil {
+				resp.Error = &ErrorResponse{
+					Code:    -1,
+					Message: err.Error(),
+				}
+			} else {
+				resp.Result = result
+			}
+
+			encoderMu.Lock()
+			defer encoderMu.Unlock()
+			if err := encoder.Encode(resp); err != nil {
+				d.logger.Error("Client %d: Error encoding response: %v", clientID, err)
+			}
+		}(req)
+	}
+
+	// The client is gone, nobody will read the results of its requests
+	cancel()
+	wg.Wait()
+
+	d.logger.Info("Client %d disconnected", clientID)
+}
+
+// Runs a request in its scheduler lane. The request is cancelled when ctx is
+// done or the client's deadline passes, whichever comes first.
+func (d *Daemon) handleRequest(ctx context.Context, req Request) (json.RawMessage, error) {
+	if req.Deadline > 0 {
+		var cancel context.CancelFunc
+		ctx, cancel = context.WithDeadline(ctx, time.UnixMilli(req.Deadline))
+		defer cancel()
+	}
+
+	lane := laneForMethod(req.Method)
+
+	// Requests that need clangd are traced; control requests like polling
+	// logs would only crowd them out of the buffer
+	if lane != LaneControl {
+		var span *trace.Span
+		ctx, span = d.tracer.StartTrace(ctx, req.Method, "daemon")
+		span.SetArg("lane", lane.String())
+		if symbol, ok := req.Params["symbol"].(string); ok {
+			span.SetArg("symbol", symbol)
 		}
+		if req.Project != "" {
+			span.SetArg("project", req.Project)
+		}
+		defer func() {
+			span.End()
+			// The client's span ends when it has the answer, which is
+			// about when the daemon is done with the request
+			if req.ClientStart > 0 {
+				trace.Record(ctx, "client.Run", "client", time.UnixMicro(req.ClientStart), time.Now())
+			}
+		}()
+	}
 
-		if err := encoder.Encode(resp); err != nil {
-			d.logger.Error("Client %d: Error encoding response: %v", clientID, err)
-			break
+	var result json.RawMessage
+	var err error
+	if lane == LaneControl {
+		err = d.scheduler.Do(ctx, lane, func(ctx context.Context) error {
+			var err error
+			result, err = d.runControlRequest(ctx, req)
+			return err
+		})
+	} else {
+		// Queued requests count as busy too, so background work yields to them
+		d.activeRequests.Add(1)
+		defer d.activeRequests.Add(-1)
+
+		var backend *Backend
+		backend, err = d.backendFor(req.Project)
+		if err != nil {
+			return nil, err
 		}
+		result, err = backend.handleRequest(ctx, req, lane)
 	}
 
-	d.logger.Info("Client %d disconnected", clientID)
+	if ctxErr := ctx.Err(); ctxErr != nil {
+		d.logger.Info("%s cancelled: %v", req.Method, ctxErr)
+		return nil, fmt.Errorf("%s cancelled: %v", req.Method, ctxErr)
+	}
+	return result, err
 }
 
-func (d *Daemon) handleRequest(req Request) (json.RawMessage, error) {
+// Runs the requests that are answered by the daemon itself
+func (d *Daemon) runControlRequest(ctx context.Context, req Request) (json.RawMessage, error) {
 	switch req.Method {
 	case "status":
-		return d.handleStatus()
+		return d.handleStatus(req)
 	case "logs":
 		return d.handleLogs(req)
+	case "trace":
+		return d.handleTrace(req)
+	case "profile":
+		return d.handleProfile(ctx, req)
 	case "shutdown":
 		go func() {
 			time.Sleep(100 * time.Millisecond)
-			close(d.shutdown)
+			d.requestShutdown()
 		}()
 		return json.Marshal(map[string]string{"status": "shutting down"})
 	}
+	return nil, fmt.Errorf("unknown method: %s", req.Method)
+}
+
+// Creates and registers the backend of a project
+func (d *Daemon) newBackend(projectRoot string) *Backend {
+	backend := NewBackend(projectRoot, d.scheduler, d.isBusy, d.readiness, d.logger)
+	backend.onResume = d.wake
+	d.backendsMu.Lock()
+	d.backends[projectRoot] = backend
+	d.backendsMu.Unlock()
+	return backend
+}
 
-	// All other commands go to clangd
-	input, _ := req.Params["symbol"].(string)
+// Returns the backend serving a project. A per-project daemon serves its own
+// project regardless; a shared daemon creates backends on first use.
+func (d *Daemon) backendFor(project string) (*Backend, error) {
+	d.backendsMu.Lock()
+	defer d.backendsMu.Unlock()
 
-	limit := -1
-	if l, ok := req.Params["limit"].(float64); ok {
-		limit = int(l)
+	if !d.shared {
+		return d.backends[d.projectRoot], nil
+	}
+	if project == "" {
+		return nil, fmt.Errorf("requests to a shared daemon must name a project")
+	}
+	if backend, ok := d.backends[project]; ok {
+		return backend, nil
+	}
+	if _, err := os.Stat(filepath.Join(project, "CMakeLists.txt")); err != nil {
+		return nil, fmt.Errorf("not a CMake project: %s", project)
 	}
 
-	var output string
-	var err error
+	d.logger.Info("Adding project: %s", project)
+	backend := NewBackend(project, d.scheduler, d.isBusy, d.readiness, d.logger)
+	backend.onStartupFailed = func(b *Backend) {
+		b.Stop()
+	}
+	backend.onResume = d.wake
+	d.backends[project] = backend
+	return backend, nil
+}
 
-	switch req.Method {
-	case "search":
-		output, err = commands.Search(d.clangdClient, input, limit, d.logger)
-	case "show":
-		output, err = commands.Show(d.clangdClient, input, d.logger)
-	case "view":
-		output, err = commands.View(d.clangdClient, input, d.logger)
-	case "usages":
-		output, err = commands.Usages(d.clangdClient, input, limit, d.logger)
-	case "hierarchy":
-		output, err = commands.Hierarchy(d.clangdClient, input, limit, d.logger)
-	case "signature":
-		output, err = commands.Signature(d.clangdClient, input, d.logger)
-	case "interface":
-		output, err = commands.Interface(d.clangdClient, input, d.logger)
-	default:
-		return nil, fmt.Errorf("unknown method: %s", req.Method)
+// Returns all backends, sorted by project root
+func (d *Daemon) allBackends() []*Backend {
+	d.backendsMu.Lock()
+	defer d.backendsMu.Unlock()
+
+	backends := make([]*Backend, 0, len(d.backends))
+	for _, backend := range d.backends {
+		backends = append(backends, backend)
 	}
+	sort.Slice(backends, func(i, j int) bool {
+		return backends[i].projectRoot < backends[j].projectRoot
+	})
+	return backends
+}
 
-	if err != nil {
-		d.logger.Error("%s failed: %v", req.Method, err)
-		return nil, err
+// Periodically stops the clangd of the least recently used projects while
+// all clangd instances together use more memory than the budget. The most
+// recently used project is never evicted, even if it alone is over budget.
+func (d *Daemon) enforceMemoryBudget() {
+	ticker := time.NewTicker(memoryCheckInterval)
+	defer ticker.Stop()
+
+	for {
+		select {
+		case <-ticker.C:
+			d.evictOverBudget()
+		case <-d.shutdown:
+			return
+		}
+	}
+}
+
+func (d *Daemon) evictOverBudget() {
+	backends := d.allBackends()
+	rss := make(map[*Backend]int64, len(backends))
+	var total int64
+	for _, backend := range backends {
+		rss[backend] = backend.RSS()
+		total += rss[backend]
+	}
+	if total <= d.memoryBudget {
+		return
 	}
 
-	return json.Marshal(map[string]string{"output": output})
+	// Least recently used first
+	sort.Slice(backends, func(i, j int) bool {
+		return backends[i].LastUsed().Before(backends[j].LastUsed())
+	})
+	for _, backend := range backends[:len(backends)-1] {
+		if total <= d.memoryBudget {
+			break
+		}
+		if rss[backend] == 0 || !backend.Evict() {
+			continue
+		}
+		total -= rss[backend]
+		d.logger.Info("Evicted %s (%s) to stay within the %s memory budget, %s in use now",
+			backend.projectRoot, formatMB(rss[backend]), formatMB(d.memoryBudget), formatMB(total))
+	}
 }
 
-func (d *Daemon) handleStatus() (json.RawMessage, error) {
+func (d *Daemon) handleStatus(req Request) (json.RawMessage, error) {
+	// Backends call into the daemon with their lock held, so d.mu must not
+	// be held while asking them for their status
 	d.mu.Lock()
-	defer d.mu.Unlock()
-
 	status := map[string]interface{}{
 		"pid":           os.Getpid(),
 		"projectRoot":   d.projectRoot,
@@ -381,11 +629,75 @@ func (d *Daemon) handleStatus() (json.RawMessage, error) {
 		"totalRequests": d.totalRequests,
 		"connections":   d.connections,
 		"idleTimeout":   d.idleTimeout.String(),
+		"hibernation":   d.hibernationStatusLocked(),
+	}
+	d.mu.Unlock()
+
+	scheduler := d.scheduler.Status()
+	for _, backend := range d.allBackends() {
+		scheduler.CancelledClangdRequests += backend.cancelledRequests()
+	}
+	status["scheduler"] = scheduler
+
+	// Details of the project the client is in
+	d.backendsMu.Lock()
+	backend := d.backends[req.Project]
+	if !d.shared {
+		backend = d.backends[d.projectRoot]
+	}
+	d.backendsMu.Unlock()
+	if backend != nil {
+		backend.addStatus(status)
+		// The time series is only sent when asked for, it has hundreds of samples
+		if req.Params["resources"] == true {
+			status["resources"] = backend.resources.Status()
+		}
+	} else if d.shared {
+		status["projectRoot"] = req.Project
+	}
+
+	if d.shared {
+		var projects []ProjectStatus
+		for _, backend := range d.allBackends() {
+			projects = append(projects, backend.ProjectStatus())
+		}
+		status["shared"] = SharedStatus{
+			MemoryBudget: formatMB(d.memoryBudget),
+			Projects:     projects,
+		}
 	}
 
 	return json.Marshal(status)
 }
 
+// Returns the last traces, by default all of them, in Chrome's trace event
+// format
+func (d *Daemon) handleTrace(req Request) (json.RawMessage, error) {
+	last := 0
+	if n, ok := req.Params["last"].(float64); ok {
+		last = int(n)
+	}
+	return trace.ChromeJSON(d.tracer.Last(last))
+}
+
+// Captures a Go runtime profile of the daemon into a file and returns its path
+func (d *Daemon) handleProfile(ctx context.Context, req Request) (json.RawMessage, error) {
+	kind, _ := req.Params["kind"].(string)
+	var duration time.Duration
+	if seconds, ok := req.Params["seconds"].(float64); ok {
+		duration = time.Duration(seconds * float64(time.Second))
+	}
+
+	d.logger.Info("Capturing %s profile", kind)
+	result, err := d.profiler.Capture(ctx, kind, duration)
+	if err != nil {
+		d.logger.Error("Failed to capture %s profile: %v", kind, err)
+		return nil, err
+	}
+	d.logger.Info("Wrote %s profile to %s", kind, result.Path)
+	return json.Marshal(result)
+}
+
 func (d *Daemon) handleLogs(req Request) (json.RawMessage, error) {
 	// Get log level from params (default to INFO and above)
 	minLevel := logger.LevelInfo
@@ -400,16 +712,17 @@ func (d *Daemon) handleLogs(req Request) (json.RawMessage, error) {
 		}
 	}
 
-	// Get filtered logs from memory
-	logs := d.logger.GetLogs(minLevel)
-	return json.Marshal(map[string]string{"logs": logs})
-}
-
-func (d *Daemon) onFilesChanged(files []string) {
-	d.logger.Debug("Files changed: %v", files)
+	// Entries after the cursor of the previous call, for logs --follow
+	var after uint64
+	if cursor, ok := req.Params["after"].(float64); ok && cursor > 0 {
+		after = uint64(cursor)
+	}
 
-	if d.clangdClient != nil {
-		// Notify clangd about file changes
-		d.clangdClient.OnFilesChanged(files)
+	// Get filtered logs from memory
+	logs, cursor := d.logger.GetLogs(minLevel, after)
+	response := map[string]interface{}{"logs": logs, "cursor": cursor}
+	if !d.logger.Enabled(minLevel) {
+		response["note"] = "Debug messages are not recorded. Start the daemon with --verbose or set CLANGD_DAEMON_LOG_LEVEL=debug to record them."
 	}
+	return json.Marshal(response)
 }
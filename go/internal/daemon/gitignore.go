@@ -0,0 +1,208 @@
+package daemon
+
+import (
+	"bufio"
+	"os"
+	"path/filepath"
+	"regexp"
+	"strings"
+	"sync"
+)
+
+// A single pattern of a .gitignore file
+type ignoreRule struct {
+	pattern *regexp.Regexp // Matches paths relative to the directory of the .gitignore
+	negate  bool
+	dirOnly bool
+}
+
+// Gitignore tells whether paths of a project are excluded by its .gitignore
+// files, including nested ones and .git/info/exclude. Rules of each
+// directory are loaded on first use. A path is ignored if it or any of its
+// parent directories is, as git doesn't look into ignored directories.
+type Gitignore struct {
+	root string
+
+	mu      sync.Mutex
+	rules   map[string][]ignoreRule // By directory of the .gitignore file
+	ignored map[string]bool         // Memoized results for directories
+}
+
+// Creates a matcher for the .gitignore files of a project
+func NewGitignore(root string) *Gitignore {
+	g := &Gitignore{
+		root:    root,
+		rules:   make(map[string][]ignoreRule),
+		ignored: make(map[string]bool),
+	}
+	g.rules[root] = append(
+		loadIgnoreRules(filepath.Join(root, ".git", "info", "exclude")),
+		loadIgnoreRules(filepath.Join(root, ".gitignore"))...)
+	return g
+}
+
+// Returns true if the path is excluded by a .gitignore. Paths outside of the
+// project are never ignored.
+func (g *Gitignore) Ignored(path string, isDir bool) bool {
+	rel, err := filepath.Rel(g.root, path)
+	if err != nil || rel == "." || !isWithin(path, g.root) {
+		return false
+	}
+
+	g.mu.Lock()
+	defer g.mu.Unlock()
+
+	// Parent directories first, their results are memoized
+	parts := strings.Split(filepath.ToSlash(rel), "/")
+	dir := g.root
+	for _, part := range parts[:len(parts)-1] {
+		dir = filepath.Join(dir, part)
+		if g.ignoredLocked(dir, true) {
+			return true
+		}
+	}
+	return g.ignoredLocked(path, isDir)
+}
+
+func (g *Gitignore) ignoredLocked(path string, isDir bool) bool {
+	if isDir {
+		if ignored, ok := g.ignored[path]; ok {
+			return ignored
+		}
+	}
+
+	// Rules of deeper .gitignore files take precedence, and later rules of a
+	// file over earlier ones
+	ignored := false
+	for dir := filepath.Dir(path); ; dir = filepath.Dir(dir) {
+		rules := g.rulesLocked(dir)
+		rel, _ := filepath.Rel(dir, path)
+		rel = filepath.ToSlash(rel)
+		matched := false
+		for i := len(rules) - 1; i >= 0; i-- {
+			rule := rules[i]
+			if rule.dirOnly && !isDir {
+				continue
+			}
+			if rule.pattern.MatchString(rel) {
+				ignored = !rule.negate
+				matched = true
+				break
+			}
+		}
+		if matched || dir == g.root || !isWithin(dir, g.root) {
+			break
+		}
+	}
+
+	if isDir {
+		g.ignored[path] = ignored
+	}
+	return ignored
+}
+
+// Returns the rules of the .gitignore in dir, loading them on first use
+func (g *Gitignore) rulesLocked(dir string) []ignoreRule {
+	rules, ok := g.rules[dir]
+	if !ok {
+		rules = loadIgnoreRules(filepath.Join(dir, ".gitignore"))
+		g.rules[dir] = rules
+	}
+	return rules
+}
+
+// Reads the rules of a .gitignore file. A missing file has no rules.
+func loadIgnoreRules(path string) []ignoreRule {
+	file, err := os.Open(path)
+	if err != nil {
+		return nil
+	}
+	defer file.Close()
+
+	var rules []ignoreRule
+	scanner := bufio.NewScanner(file)
+	for scanner.Scan() {
+		if rule, ok := parseIgnoreRule(scanner.Text()); ok {
+			rules = append(rules, rule)
+		}
+	}
+	return rules
+}
+
+// Parses one line of a .gitignore file. Returns false for blank lines,
+// comments and patterns that can't be compiled.
+func parseIgnoreRule(line string) (ignoreRule, bool) {
+	line = strings.TrimRight(line, " \t\r")
+	if line == "" || strings.HasPrefix(line, "#") {
+		return ignoreRule{}, false
+	}
+
+	var rule ignoreRule
+	if strings.HasPrefix(line, "!") {
+		rule.negate = true
+		line = line[1:]
+	} else if strings.HasPrefix(line, `\`) {
+		line = line[1:] // Escaped leading "!" or "#"
+	}
+	if strings.HasSuffix(line, "/") {
+		rule.dirOnly = true
+		line = strings.TrimSuffix(line, "/")
+	}
+	if line == "" {
+		return ignoreRule{}, false
+	}
+
+	// A pattern without a slash matches at any depth, one with a slash
+	// relative to the directory of the .gitignore
+	anchored := strings.Contains(line, "/")
+	line = strings.TrimPrefix(line, "/")
+
+	var expr strings.Builder
+	expr.WriteString("^")
+	if !anchored {
+		expr.WriteString("(?:.*/)?")
+	}
+	for i := 0; i < len(line); i++ {
+		c := line[i]
+		switch {
+		case strings.HasPrefix(line[i:], "**/"):
+			expr.WriteString("(?:.*/)?")
+			i += 2
+		case strings.HasPrefix(line[i:], "/**") && i+3 == len(line):
+			expr.WriteString("/.*")
+			i += 2
+		case strings.HasPrefix(line[i:], "**"):
+			expr.WriteString(".*")
+			i++
+		case c == '*':
+			expr.WriteString("[^/]*")
+		case c == '?':
+			expr.WriteString("[^/]")
+		case c == '[':
+			end := strings.IndexByte(line[i+1:], ']')
+			if end < 0 {
+				expr.WriteString(`\[`)
+				continue
+			}
+			class := line[i+1 : i+1+end]
+			if strings.HasPrefix(class, "!") {
+				class = "^" + class[1:]
+			}
+			expr.WriteString("[" + class + "]")
+			i += end + 1
+		case c == '\\' && i+1 < len(line):
+			i++
+			expr.WriteString(regexp.QuoteMeta(string(line[i])))
+		default:
+			expr.WriteString(regexp.QuoteMeta(string(c)))
+		}
+	}
+	expr.WriteString("$")
+
+	pattern, err := regexp.Compile(expr.String())
+	if err != nil {
+		return ignoreRule{}, false
+	}
+	rule.pattern = pattern
+	return rule, true
+}
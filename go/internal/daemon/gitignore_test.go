@@ -0,0 +1,55 @@
+package daemon
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+func TestGitignore(t *testing.T) {
+	root := t.TempDir()
+	writeFile(t, filepath.Join(root, ".gitignore"), `# Build output
+/build/
+*.o
+third_party/**/test
+docs/*.html
+!docs/index.html
+gen?/
+`)
+	if err := os.MkdirAll(filepath.Join(root, "lib", "vendor"), 0755); err != nil {
+		t.Fatal(err)
+	}
+	writeFile(t, filepath.Join(root, "lib", ".gitignore"), "vendor/\n!keep.o\n")
+
+	g := NewGitignore(root)
+	tests := []struct {
+		path    string
+		isDir   bool
+		ignored bool
+	}{
+		{"build", true, true},
+		{"build/src", true, true},   // Inside an ignored directory
+		{"src/build", true, false},  // Anchored to the root
+		{"src/main.o", false, true}, // Matches at any depth
+		{"src/main.cpp", false, false},
+		{"third_party/a/b/test", true, true},
+		{"third_party/test", true, true},
+		{"docs/api.html", false, true},
+		{"docs/index.html", false, false}, // Negated
+		{"docs/sub/api.html", false, false},
+		{"gen1", true, true},
+		{"gen1", false, false}, // Directories only
+		{"lib/vendor", true, true},
+		{"lib/keep.o", false, false}, // Nested .gitignore overrides
+		{"lib/other.o", false, true},
+	}
+	for _, test := range tests {
+		if got := g.Ignored(filepath.Join(root, test.path), test.isDir); got != test.ignored {
+			t.Errorf("Ignored(%q, %v) = %v, want %v", test.path, test.isDir, got, test.ignored)
+		}
+	}
+
+	if g.Ignored(root, true) || g.Ignored(filepath.Dir(root), true) {
+		t.Errorf("the project root and paths outside of it are never ignored")
+	}
+}
@@ -0,0 +1,255 @@
+package daemon
+
+import (
+	"os"
+	"strconv"
+	"sync"
+	"time"
+
+	"clangd-query/internal/logger"
+)
+
+// Default memory limits of a project's clangd. Can be overridden with the
+// CLANGD_DAEMON_MEMORY_SOFT and CLANGD_DAEMON_MEMORY_HARD environment
+// variables, where 0 disables the limit.
+const (
+	defaultSoftMemoryLimit = 4 << 30
+	defaultHardMemoryLimit = 8 << 30
+)
+
+const (
+	// How often the governor samples clangd's memory
+	governorInterval = 5 * time.Second
+
+	// Open documents no request used for this long are closed at the soft limit
+	coldDocumentAge = time.Minute
+
+	// Minimum time between two soft limit actions, and between two restarts.
+	// Gives clangd time to release memory and keeps a project whose index
+	// alone exceeds a limit from being restarted over and over.
+	softActionInterval = time.Minute
+	restartInterval    = 5 * time.Minute
+
+	// How long after an action the governor measures its effect
+	governorSettleTime = 2 * time.Second
+
+	// Number of recent actions kept for the status command
+	maxGovernorActions = 10
+)
+
+// Memory governor actions
+const (
+	ActionCloseColdDocuments = "close cold documents"
+	ActionRestart            = "restart"
+)
+
+// GovernorAction records one reaction of the memory governor
+type GovernorAction struct {
+	Time   string `json:"time"`
+	Action string `json:"action"`
+	Before string `json:"before"` // RSS when the limit was crossed
+	After  string `json:"after"`  // RSS once the action took effect
+	Detail string `json:"detail,omitempty"`
+}
+
+// GovernorStatus reports clangd's memory use and the governor's actions for
+// the status command
+type GovernorStatus struct {
+	RSS         string           `json:"rss"`
+	PeakRSS     string           `json:"peakRss"`
+	SoftLimit   string           `json:"softLimit"`
+	HardLimit   string           `json:"hardLimit"`
+	SoftActions int              `json:"softActions"`
+	Restarts    int              `json:"restarts"`
+	Recent      []GovernorAction `json:"recent"` // Most recent last
+}
+
+// MemoryGovernor keeps a project's clangd within memory limits by sampling
+// its RSS from /proc. At the soft limit it closes documents no request used
+// recently, so clangd drops their ASTs; clangd returns freed memory to the
+// system on its own. At the hard limit it restarts clangd once no request is
+// using it. The working set is saved and prewarmed again, and the index is
+// loaded from disk, so the restart costs little more than the prewarming.
+type MemoryGovernor struct {
+	backend   *Backend
+	softLimit int64
+	hardLimit int64
+	logger    logger.Logger
+
+	mu          sync.Mutex
+	rss         int64
+	peakRSS     int64
+	lastSoft    time.Time
+	lastRestart time.Time
+	softActions int
+	restarts    int
+	actions     []GovernorAction
+}
+
+// Creates a governor for a backend with the limits from the environment
+func NewMemoryGovernor(backend *Backend, log logger.Logger) *MemoryGovernor {
+	return &MemoryGovernor{
+		backend:   backend,
+		softLimit: getMemoryLimit("CLANGD_DAEMON_MEMORY_SOFT", defaultSoftMemoryLimit),
+		hardLimit: getMemoryLimit("CLANGD_DAEMON_MEMORY_HARD", defaultHardMemoryLimit),
+		logger:    log,
+	}
+}
+
+// Returns a memory limit from an environment variable, or the default
+func getMemoryLimit(name string, defaultLimit int64) int64 {
+	if value := os.Getenv(name); value != "" {
+		if limit, err := parseByteSize(value); err == nil {
+			return limit
+		}
+	}
+	return defaultLimit
+}
+
+// Samples clangd's memory until stop is closed
+func (g *MemoryGovernor) Run(stop <-chan struct{}) {
+	if g.softLimit == 0 && g.hardLimit == 0 {
+		return
+	}
+
+	ticker := time.NewTicker(governorInterval)
+	defer ticker.Stop()
+
+	for {
+		select {
+		case <-ticker.C:
+			g.check(stop)
+		case <-stop:
+			return
+		}
+	}
+}
+
+// Samples clangd's memory once and reacts to crossed limits
+func (g *MemoryGovernor) check(stop <-chan struct{}) {
+	rss := g.backend.RSS()
+
+	g.mu.Lock()
+	g.rss = rss
+	if rss > g.peakRSS {
+		g.peakRSS = rss
+	}
+	overHard := g.hardLimit > 0 && rss >= g.hardLimit && time.Since(g.lastRestart) >= restartInterval
+	overSoft := g.softLimit > 0 && rss >= g.softLimit && time.Since(g.lastSoft) >= softActionInterval
+	g.mu.Unlock()
+
+	if rss == 0 {
+		return // clangd is not running
+	}
+
+	switch {
+	case overHard:
+		g.restart(rss, stop)
+	case overSoft:
+		g.closeColdDocuments(rss, stop)
+	}
+}
+
+func (g *MemoryGovernor) closeColdDocuments(before int64, stop <-chan struct{}) {
+	client := g.backend.runningClient()
+	if client == nil {
+		return
+	}
+
+	g.mu.Lock()
+	g.lastSoft = time.Now()
+	g.softActions++
+	g.mu.Unlock()
+
+	closed := client.CloseColdDocuments(coldDocumentAge)
+	if !g.settle(stop) {
+		return
+	}
+	g.record(ActionCloseColdDocuments, before, g.backend.RSS(), pluralize(closed, "document")+" closed")
+}
+
+func (g *MemoryGovernor) restart(before int64, stop <-chan struct{}) {
+	// Requests in flight would fail, try again at the next sample
+	if !g.backend.Restart() {
+		g.logger.Debug("Memory governor: clangd is over the hard limit (%s) but busy, restart postponed", formatMB(before))
+		return
+	}
+
+	g.mu.Lock()
+	g.lastRestart = time.Now()
+	g.restarts++
+	g.mu.Unlock()
+
+	// Measure the new clangd once it is up
+	start := time.Now()
+	startup := g.backend.currentStartup()
+	select {
+	case <-startup.ready:
+	case <-stop:
+		return
+	}
+	if !g.settle(stop) {
+		return
+	}
+	g.record(ActionRestart, before, g.backend.RSS(), "clangd running again after "+time.Since(start).Round(time.Millisecond).String())
+}
+
+// Waits for clangd to release memory after an action. Returns false if the
+// governor was stopped meanwhile.
+func (g *MemoryGovernor) settle(stop <-chan struct{}) bool {
+	select {
+	case <-time.After(governorSettleTime):
+		return true
+	case <-stop:
+		return false
+	}
+}
+
+func (g *MemoryGovernor) record(action string, before int64, after int64, detail string) {
+	g.logger.Info("Memory governor: %s in %s, RSS %s before, %s after (%s)",
+		action, g.backend.projectRoot, formatMB(before), formatMB(after), detail)
+
+	g.mu.Lock()
+	defer g.mu.Unlock()
+	g.rss = after
+	g.actions = append(g.actions, GovernorAction{
+		Time:   time.Now().Format(time.RFC3339),
+		Action: action,
+		Before: formatMB(before),
+		After:  formatMB(after),
+		Detail: detail,
+	})
+	if len(g.actions) > maxGovernorActions {
+		g.actions = g.actions[len(g.actions)-maxGovernorActions:]
+	}
+}
+
+// Returns memory use and recent actions for the status command
+func (g *MemoryGovernor) Status() GovernorStatus {
+	g.mu.Lock()
+	defer g.mu.Unlock()
+
+	return GovernorStatus{
+		RSS:         formatMB(g.rss),
+		PeakRSS:     formatMB(g.peakRSS),
+		SoftLimit:   formatLimit(g.softLimit),
+		HardLimit:   formatLimit(g.hardLimit),
+		SoftActions: g.softActions,
+		Restarts:    g.restarts,
+		Recent:      append([]GovernorAction(nil), g.actions...),
+	}
+}
+
+func formatLimit(limit int64) string {
+	if limit == 0 {
+		return "off"
+	}
+	return formatMB(limit)
+}
+
+func pluralize(n int, noun string) string {
+	if n == 1 {
+		return "1 " + noun
+	}
+	return strconv.Itoa(n) + " " + noun + "s"
+}
@@ -0,0 +1,121 @@
+package daemon
+
+import (
+	"os"
+	"runtime/debug"
+	"time"
+)
+
+// How long a hibernated daemon waits for a query before it exits for good
+const maxHibernation = 24 * time.Hour
+
+// HibernationStatus reports whether the daemon is hibernated for the status command
+type HibernationStatus struct {
+	Hibernated   bool   `json:"hibernated"`
+	Since        string `json:"since,omitempty"` // Time spent hibernated
+	Hibernations int    `json:"hibernations"`
+}
+
+// Returns false if CLANGD_DAEMON_HIBERNATE=0 asks for the daemon to exit on
+// idle instead of hibernating
+func isHibernateEnabled() bool {
+	return os.Getenv("CLANGD_DAEMON_HIBERNATE") != "0"
+}
+
+// Called when no client connected for the idle timeout
+func (d *Daemon) onIdle() {
+	if !isHibernateEnabled() {
+		d.logger.Info("Idle timeout reached, shutting down")
+		d.requestShutdown()
+		return
+	}
+	d.hibernate()
+}
+
+// Stops every clangd and drops in-memory caches, but keeps the socket
+// listening. The working set and result cache stay on disk, so the next
+// query resumes clangd against its on-disk index and prewarms the files that
+// were hot, while cached results are served without waking clangd at all.
+//
+// A clangd that is still in use or indexing keeps running, and the daemon
+// tries again after the next idle timeout. It only counts as hibernated once
+// every clangd is stopped.
+func (d *Daemon) hibernate() {
+	d.mu.Lock()
+	alreadyHibernated := d.hibernated
+	d.mu.Unlock()
+
+	if !alreadyHibernated {
+		d.logger.Info("Idle timeout reached, hibernating")
+		stopped := true
+		for _, backend := range d.allBackends() {
+			if !backend.StopIfIdle() && backend.Running() {
+				d.logger.Info("%s is still in use or starting, trying again in %s", backend.projectRoot, d.idleTimeout)
+				stopped = false
+			}
+		}
+		// Return the memory of the stopped backends to the system
+		debug.FreeOSMemory()
+
+		if !stopped {
+			d.mu.Lock()
+			defer d.mu.Unlock()
+			if d.idleTimer != nil {
+				d.idleTimer.Stop()
+			}
+			d.idleTimer = time.AfterFunc(d.idleTimeout, d.onIdle)
+			return
+		}
+	}
+
+	d.mu.Lock()
+	defer d.mu.Unlock()
+
+	if !d.hibernated {
+		d.hibernated = true
+		d.hibernatedAt = time.Now()
+		d.hibernations++
+	}
+
+	// Exit eventually; connections reset this timer like the idle timer
+	if d.idleTimer != nil {
+		d.idleTimer.Stop()
+	}
+	d.idleTimer = time.AfterFunc(maxHibernation-time.Since(d.hibernatedAt), func() {
+		d.logger.Info("Hibernated for %s, shutting down", maxHibernation)
+		d.requestShutdown()
+	})
+}
+
+// Leaves hibernation when a query starts clangd again. Backends resume on
+// their own; this only updates the daemon's state. Called with the
+// backend's lock held, so it must not call back into backends.
+func (d *Daemon) wake() {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+
+	if !d.hibernated {
+		return
+	}
+	d.logger.Info("Resuming after %s of hibernation", time.Since(d.hibernatedAt).Round(time.Second))
+	d.hibernated = false
+
+	// Back to the regular idle timeout
+	if d.idleTimer != nil {
+		d.idleTimer.Stop()
+	}
+	d.idleTimer = time.AfterFunc(d.idleTimeout, d.onIdle)
+}
+
+// Returns the hibernation state for the status command. Must be called with
+// d.mu held.
+func (d *Daemon) hibernationStatusLocked() HibernationStatus {
+	status := HibernationStatus{
+		Hibernated:   d.hibernated,
+		Hibernations: d.hibernations,
+	}
+	if d.hibernated {
+		status.Since = time.Since(d.hibernatedAt).Round(time.Second).String()
+	}
+	return status
+}
@@ -0,0 +1,69 @@
+package daemon
+
+import (
+	"testing"
+	"time"
+
+	"clangd-query/internal/logger"
+)
+
+func TestHibernateAndWake(t *testing.T) {
+	d := &Daemon{
+		logger:      &logger.NullLogger{},
+		backends:    make(map[string]*Backend),
+		idleTimeout: time.Hour,
+		shutdown:    make(chan struct{}),
+	}
+
+	d.hibernate()
+	d.mu.Lock()
+	status := d.hibernationStatusLocked()
+	d.mu.Unlock()
+	if !status.Hibernated || status.Hibernations != 1 {
+		t.Fatalf("expected the daemon to be hibernated, got %+v", status)
+	}
+
+	// Idle timeouts while hibernated don't count as another hibernation
+	d.hibernate()
+	d.mu.Lock()
+	if d.hibernations != 1 {
+		t.Errorf("expected 1 hibernation, got %d", d.hibernations)
+	}
+	d.mu.Unlock()
+
+	d.wake()
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if d.hibernated {
+		t.Errorf("expected the daemon to be awake after a resume")
+	}
+	d.idleTimer.Stop()
+}
+
+func TestHibernateRetriesWhileIndexing(t *testing.T) {
+	d := &Daemon{
+		logger:      &logger.NullLogger{},
+		backends:    make(map[string]*Backend),
+		idleTimeout: time.Hour,
+		shutdown:    make(chan struct{}),
+	}
+	// clangd is still coming up, so the backend can't be stopped yet
+	backend := &Backend{
+		projectRoot: "/project",
+		logger:      &logger.NullLogger{},
+		running:     true,
+		startup:     NewStartup(ReadinessWait),
+	}
+	d.backends[backend.projectRoot] = backend
+
+	d.hibernate()
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if d.hibernated || d.hibernations != 0 {
+		t.Errorf("expected the daemon not to hibernate while clangd runs, got %+v", d.hibernationStatusLocked())
+	}
+	if d.idleTimer == nil {
+		t.Fatalf("expected the idle timer to be armed for another attempt")
+	}
+	d.idleTimer.Stop()
+}
@@ -0,0 +1,88 @@
+package daemon
+
+import (
+	"bufio"
+	"fmt"
+	"os"
+	"strconv"
+	"strings"
+	"time"
+)
+
+// Default global memory budget of a shared daemon
+const defaultMemoryBudget = 8 << 30
+
+// How often a shared daemon checks the memory of its clangd instances
+const memoryCheckInterval = 10 * time.Second
+
+// Returns the resident set size of a process in bytes, from /proc/<pid>/status
+func readRSS(pid int) (int64, error) {
+	file, err := os.Open(fmt.Sprintf("/proc/%d/status", pid))
+	if err != nil {
+		return 0, err
+	}
+	defer file.Close()
+
+	scanner := bufio.NewScanner(file)
+	for scanner.Scan() {
+		line := scanner.Text()
+		if !strings.HasPrefix(line, "VmRSS:") {
+			continue
+		}
+		// The line looks like "VmRSS:    123456 kB"
+		fields := strings.Fields(line)
+		if len(fields) < 2 {
+			break
+		}
+		kb, err := strconv.ParseInt(fields[1], 10, 64)
+		if err != nil {
+			return 0, err
+		}
+		return kb * 1024, nil
+	}
+	if err := scanner.Err(); err != nil {
+		return 0, err
+	}
+	return 0, fmt.Errorf("no VmRSS in /proc/%d/status", pid)
+}
+
+// Parses a size like "512M", "8G" or a plain number of bytes
+func parseByteSize(value string) (int64, error) {
+	value = strings.TrimSpace(strings.ToUpper(value))
+	value = strings.TrimSuffix(value, "B")
+
+	multiplier := int64(1)
+	switch {
+	case strings.HasSuffix(value, "K"):
+		multiplier = 1 << 10
+	case strings.HasSuffix(value, "M"):
+		multiplier = 1 << 20
+	case strings.HasSuffix(value, "G"):
+		multiplier = 1 << 30
+	}
+	if multiplier != 1 {
+		value = value[:len(value)-1]
+	}
+
+	n, err := strconv.ParseInt(value, 10, 64)
+	if err != nil || n < 0 {
+		return 0, fmt.Errorf("invalid size: %q", value)
+	}
+	return n * multiplier, nil
+}
+
+// Returns the memory budget of a shared daemon, from the
+// CLANGD_DAEMON_MEMORY_BUDGET environment variable or the default
+func getMemoryBudget() int64 {
+	if value := os.Getenv("CLANGD_DAEMON_MEMORY_BUDGET"); value != "" {
+		if budget, err := parseByteSize(value); err == nil && budget > 0 {
+			return budget
+		}
+	}
+	return defaultMemoryBudget
+}
+
+// Formats a byte count in megabytes, for logs and status
+func formatMB(bytes int64) string {
+	return fmt.Sprintf("%dMB", bytes>>20)
+}
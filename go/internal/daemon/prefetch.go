@@ -0,0 +1,311 @@
+package daemon
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"os"
+	"sync/atomic"
+	"time"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/logger"
+)
+
+// Number of pending prefetch jobs. A prediction is only useful right after the
+// command that triggered it, so when the queue is full the oldest job is
+// dropped instead of delaying newer ones.
+const prefetchQueueSize = 8
+
+// Maximum number of class members whose hover is prefetched for a likely
+// interface command. Keeps huge classes from occupying clangd for long.
+const maxPrefetchMembers = 64
+
+// How long the prefetcher sleeps before checking again whether interactive
+// requests are still running
+const prefetchYieldInterval = 50 * time.Millisecond
+
+// A command whose likely follow-up queries should be prefetched
+type prefetchJob struct {
+	method string
+	query  string
+}
+
+// PrefetchStatus reports prefetch effectiveness for the status command
+type PrefetchStatus struct {
+	clangd.PrefetchStats
+	Dropped int64  `json:"dropped"` // Jobs dropped because the queue was full
+	HitRate string `json:"hitRate"` // Share of per-document requests served from prefetched results
+}
+
+// Prefetcher predicts the next command from the one just answered and
+// computes the per-document results that command will need, so they are
+// already cached in the clangd client when the query arrives. The observed
+// access patterns are:
+//
+//   - search X is followed by show of the top hit, which needs the
+//     definition, folding ranges and (for types) document symbols
+//   - show or view of a class is followed by interface or hierarchy, which
+//     need document symbols, hovers of all members and the type hierarchy
+//   - show or view of a function is followed by signature, which needs the
+//     hover at the function
+//
+// Prefetching runs in the scheduler's background lane, one job at a time, and
+// waits before every clangd request until no interactive request is running
+// or queued, so it never competes with real queries for clangd.
+type Prefetcher struct {
+	client    *clangd.ClangdClient
+	scheduler *Scheduler
+	busy      func() bool
+	stop      <-chan struct{}
+	jobs      chan prefetchJob
+	dropped   atomic.Int64
+	logger    logger.Logger
+}
+
+// Creates a prefetcher. Call Run in a goroutine to start processing jobs.
+func NewPrefetcher(client *clangd.ClangdClient, scheduler *Scheduler, busy func() bool, stop <-chan struct{}, log logger.Logger) *Prefetcher {
+	return &Prefetcher{
+		client:    client,
+		scheduler: scheduler,
+		busy:      busy,
+		stop:      stop,
+		jobs:      make(chan prefetchJob, prefetchQueueSize),
+		logger:    log,
+	}
+}
+
+// Queues prefetching for the follow-up queries of a successfully answered
+// command. Never blocks.
+func (p *Prefetcher) Schedule(method string, query string) {
+	switch method {
+	case "search", "show", "view":
+	default:
+		return
+	}
+	if query == "" {
+		return
+	}
+
+	job := prefetchJob{method: method, query: query}
+	for {
+		select {
+		case p.jobs <- job:
+			return
+		default:
+		}
+
+		// Queue is full, make room by dropping the oldest job
+		select {
+		case <-p.jobs:
+			p.dropped.Add(1)
+		default:
+		}
+	}
+}
+
+// Processes prefetch jobs until stop is closed. Clangd requests still in
+// flight at that point are cancelled.
+func (p *Prefetcher) Run() {
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+
+	for {
+		select {
+		case <-p.stop:
+			return
+		case job := <-p.jobs:
+			start := time.Now()
+			p.scheduler.Do(ctx, LaneBackground, func(ctx context.Context) error {
+				p.run(p.client.WithContext(ctx), job)
+				return nil
+			})
+			p.logger.Debug("Prefetched follow-ups for %s %s in %v", job.method, job.query, time.Since(start))
+		}
+	}
+}
+
+// Returns prefetch statistics for the status command
+func (p *Prefetcher) Status() PrefetchStatus {
+	stats := p.client.PrefetchStats()
+	hitRate := "n/a"
+	if lookups := stats.Hits + stats.Misses; lookups > 0 {
+		hitRate = fmt.Sprintf("%.1f%%", float64(stats.Hits)*100/float64(lookups))
+	}
+	return PrefetchStatus{
+		PrefetchStats: stats,
+		Dropped:       p.dropped.Load(),
+		HitRate:       hitRate,
+	}
+}
+
+func (p *Prefetcher) run(client *clangd.ClangdClient, job prefetchJob) {
+	if !p.yield() {
+		return
+	}
+
+	symbols, err := client.WorkspaceSymbol(job.query)
+	if err != nil || len(symbols) == 0 {
+		return
+	}
+
+	// Follow-up commands use the best match, same as the command itself
+	symbol := symbols[0]
+
+	switch job.method {
+	case "search":
+		p.prefetchShow(client, symbol)
+	case "show", "view":
+		switch symbol.Kind {
+		case clangd.SymbolKindClass, clangd.SymbolKindStruct:
+			p.prefetchInterface(client, symbol)
+			p.prefetchHierarchy(client, symbol)
+		case clangd.SymbolKindFunction, clangd.SymbolKindMethod, clangd.SymbolKindConstructor:
+			p.fetch(client, symbol.Location.URI, "textDocument/hover", clangd.HoverParams{
+				TextDocumentPositionParams: positionParams(symbol.Location.URI, symbol.Location.Range.Start),
+			})
+		}
+	}
+}
+
+// Prefetches what the show command requests for a symbol
+func (p *Prefetcher) prefetchShow(client *clangd.ClangdClient, symbol clangd.WorkspaceSymbol) {
+	uri := symbol.Location.URI
+
+	switch symbol.Kind {
+	case clangd.SymbolKindFunction, clangd.SymbolKindMethod, clangd.SymbolKindConstructor:
+		result, ok := p.fetch(client, uri, "textDocument/definition", clangd.DefinitionParams{
+			TextDocumentPositionParams: positionParams(uri, symbol.Location.Range.Start),
+		})
+		if ok {
+			var definitions []clangd.Location
+			if err := json.Unmarshal(result, &definitions); err == nil {
+				for _, definition := range definitions {
+					if definition.URI != uri {
+						p.fetch(client, definition.URI, "textDocument/foldingRange", clangd.FoldingRangeParams{
+							TextDocument: clangd.TextDocumentIdentifier{URI: definition.URI},
+						})
+					}
+				}
+			}
+		}
+	case clangd.SymbolKindClass, clangd.SymbolKindStruct, clangd.SymbolKindEnum:
+		p.fetch(client, uri, "textDocument/documentSymbol", clangd.DocumentSymbolParams{
+			TextDocument: clangd.TextDocumentIdentifier{URI: uri},
+		})
+	}
+
+	p.fetch(client, uri, "textDocument/foldingRange", clangd.FoldingRangeParams{
+		TextDocument: clangd.TextDocumentIdentifier{URI: uri},
+	})
+}
+
+// Prefetches what the interface command requests for a class or struct
+func (p *Prefetcher) prefetchInterface(client *clangd.ClangdClient, symbol clangd.WorkspaceSymbol) {
+	uri := symbol.Location.URI
+	result, ok := p.fetch(client, uri, "textDocument/documentSymbol", clangd.DocumentSymbolParams{
+		TextDocument: clangd.TextDocumentIdentifier{URI: uri},
+	})
+	if !ok {
+		return
+	}
+
+	var docSymbols []clangd.DocumentSymbol
+	if err := json.Unmarshal(result, &docSymbols); err != nil {
+		return
+	}
+
+	target := findClassAt(docSymbols, symbol.Location.Range.Start.Line)
+	if target == nil {
+		return
+	}
+
+	for i, child := range target.Children {
+		if i >= maxPrefetchMembers {
+			break
+		}
+		if _, ok := p.fetch(client, uri, "textDocument/hover", clangd.HoverParams{
+			TextDocumentPositionParams: positionParams(uri, child.SelectionRange.Start),
+		}); !ok {
+			return
+		}
+	}
+}
+
+// Prefetches what the hierarchy command requests for a class or struct
+func (p *Prefetcher) prefetchHierarchy(client *clangd.ClangdClient, symbol clangd.WorkspaceSymbol) {
+	uri := symbol.Location.URI
+	p.fetch(client, uri, "textDocument/prepareTypeHierarchy", clangd.TypeHierarchyPrepareParams{
+		TextDocumentPositionParams: positionParams(uri, symbol.Location.Range.Start),
+	})
+}
+
+// Waits for interactive requests to finish, then prefetches a single result.
+// Returns false if the daemon is shutting down or the request failed.
+func (p *Prefetcher) fetch(client *clangd.ClangdClient, uri string, method string, params interface{}) (json.RawMessage, bool) {
+	if !p.yield() {
+		return nil, false
+	}
+
+	result, err := client.Prefetch(uri, method, params)
+	if err != nil {
+		p.logger.Debug("Prefetch of %s failed: %v", method, err)
+		return nil, false
+	}
+	return result, true
+}
+
+// Blocks while interactive requests are running. Returns false if the daemon
+// is shutting down.
+func (p *Prefetcher) yield() bool {
+	for p.busy() {
+		select {
+		case <-p.stop:
+			return false
+		case <-time.After(prefetchYieldInterval):
+		}
+	}
+
+	select {
+	case <-p.stop:
+		return false
+	default:
+		return true
+	}
+}
+
+// Finds the innermost class or struct containing a line, the same way the
+// interface command does
+func findClassAt(symbols []clangd.DocumentSymbol, line int) *clangd.DocumentSymbol {
+	var found *clangd.DocumentSymbol
+	var find func([]clangd.DocumentSymbol)
+	find = func(syms []clangd.DocumentSymbol) {
+		for i := range syms {
+			s := &syms[i]
+			if s.Range.Start.Line <= line && line <= s.Range.End.Line {
+				if s.Kind == clangd.SymbolKindClass || s.Kind == clangd.SymbolKindStruct {
+					found = s
+					return
+				}
+				if len(s.Children) > 0 {
+					find(s.Children)
+				}
+			}
+		}
+	}
+	find(symbols)
+	return found
+}
+
+func positionParams(uri string, position clangd.Position) clangd.TextDocumentPositionParams {
+	return clangd.TextDocumentPositionParams{
+		TextDocument: clangd.TextDocumentIdentifier{URI: uri},
+		Position:     position,
+	}
+}
+
+// Returns whether speculative prefetching is enabled. It can be disabled by
+// setting CLANGD_DAEMON_PREFETCH=0.
+func isPrefetchEnabled() bool {
+	return os.Getenv("CLANGD_DAEMON_PREFETCH") != "0"
+}
@@ -0,0 +1,159 @@
+package daemon
+
+import (
+	"context"
+	"fmt"
+	"os"
+	"path/filepath"
+	"runtime"
+	"runtime/pprof"
+	"sync"
+	"time"
+)
+
+// Profile kinds the profile command captures
+const (
+	ProfileCPU       = "cpu"
+	ProfileHeap      = "heap"
+	ProfileGoroutine = "goroutine"
+	ProfileMutex     = "mutex"
+	ProfileBlock     = "block"
+)
+
+// How long timed profiles (CPU, mutex and block) run by default, and at most
+const (
+	defaultProfileDuration = 30 * time.Second
+	maxProfileDuration     = 10 * time.Minute
+)
+
+// Sampling rates while mutex and block profiles are captured: every mutex
+// contention event, and blocking events of 10µs or more
+const (
+	mutexProfileFraction = 1
+	blockProfileRate     = int(10 * time.Microsecond)
+)
+
+// ProfileResult describes a captured profile
+type ProfileResult struct {
+	Kind     string `json:"kind"`
+	Path     string `json:"path"`
+	Duration string `json:"duration,omitempty"` // For timed profiles
+}
+
+// Profiler captures Go runtime profiles of the daemon into files. The CPU,
+// mutex and block profiles sample for a duration, and the runtime supports
+// only one of each at a time, so timed profiles run one after another.
+// Mutex and block sampling is only enabled while such a profile runs; the
+// runtime accumulates their events, so a profile includes those of earlier
+// captures too.
+type Profiler struct {
+	dir string
+	mu  sync.Mutex // Held while a timed profile runs
+}
+
+// Creates a profiler that writes profiles into dir
+func NewProfiler(dir string) *Profiler {
+	return &Profiler{dir: dir}
+}
+
+// Returns the directory profiles of a daemon are written to
+func getProfileDir(projectRoot string) string {
+	return filepath.Join(filepath.Dir(GetLogPath(projectRoot)), "profiles")
+}
+
+// Captures a profile and writes it to a new file in pprof's format. Timed
+// profiles sample for the given duration, or until ctx is done, in which case
+// no file is written.
+func (p *Profiler) Capture(ctx context.Context, kind string, duration time.Duration) (*ProfileResult, error) {
+	if duration <= 0 {
+		duration = defaultProfileDuration
+	}
+	if duration > maxProfileDuration {
+		return nil, fmt.Errorf("profile duration %v exceeds the maximum of %v", duration, maxProfileDuration)
+	}
+
+	switch kind {
+	case ProfileCPU, ProfileMutex, ProfileBlock:
+		if !p.mu.TryLock() {
+			return nil, fmt.Errorf("another timed profile is running, try again when it is done")
+		}
+		defer p.mu.Unlock()
+	case ProfileHeap, ProfileGoroutine:
+		duration = 0
+	default:
+		return nil, fmt.Errorf("unknown profile kind %q, expected cpu, heap, goroutine, mutex or block", kind)
+	}
+
+	if err := os.MkdirAll(p.dir, 0755); err != nil {
+		return nil, fmt.Errorf("failed to create profile directory: %v", err)
+	}
+	path := filepath.Join(p.dir, fmt.Sprintf("%s-%s.pprof", kind, time.Now().Format("20060102-150405")))
+	file, err := os.Create(path)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create profile file: %v", err)
+	}
+
+	err = p.write(ctx, file, kind, duration)
+	if closeErr := file.Close(); err == nil {
+		err = closeErr
+	}
+	if err != nil {
+		os.Remove(path)
+		return nil, err
+	}
+
+	result := &ProfileResult{Kind: kind, Path: path}
+	if duration > 0 {
+		result.Duration = duration.String()
+	}
+	return result, nil
+}
+
+func (p *Profiler) write(ctx context.Context, file *os.File, kind string, duration time.Duration) error {
+	switch kind {
+	case ProfileCPU:
+		if err := pprof.StartCPUProfile(file); err != nil {
+			return fmt.Errorf("failed to start CPU profile: %v", err)
+		}
+		err := sleepContext(ctx, duration)
+		pprof.StopCPUProfile()
+		return err
+
+	case ProfileMutex:
+		previous := runtime.SetMutexProfileFraction(mutexProfileFraction)
+		err := sleepContext(ctx, duration)
+		runtime.SetMutexProfileFraction(previous)
+		if err != nil {
+			return err
+		}
+
+	case ProfileBlock:
+		runtime.SetBlockProfileRate(blockProfileRate)
+		err := sleepContext(ctx, duration)
+		runtime.SetBlockProfileRate(0)
+		if err != nil {
+			return err
+		}
+
+	case ProfileHeap:
+		// Up-to-date statistics rather than those of the last collection
+		runtime.GC()
+	}
+
+	if err := pprof.Lookup(kind).WriteTo(file, 0); err != nil {
+		return fmt.Errorf("failed to write %s profile: %v", kind, err)
+	}
+	return nil
+}
+
+// Waits for the duration, or returns the error of ctx if it is done first
+func sleepContext(ctx context.Context, duration time.Duration) error {
+	timer := time.NewTimer(duration)
+	defer timer.Stop()
+	select {
+	case <-timer.C:
+		return nil
+	case <-ctx.Done():
+		return ctx.Err()
+	}
+}
@@ -0,0 +1,71 @@
+package daemon
+
+import (
+	"context"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+func TestCaptureProfiles(t *testing.T) {
+	profiler := NewProfiler(filepath.Join(t.TempDir(), "profiles"))
+	for _, kind := range []string{ProfileCPU, ProfileHeap, ProfileGoroutine, ProfileMutex, ProfileBlock} {
+		result, err := profiler.Capture(context.Background(), kind, 50*time.Millisecond)
+		if err != nil {
+			t.Fatalf("Failed to capture %s profile: %v", kind, err)
+		}
+		info, err := os.Stat(result.Path)
+		if err != nil || info.Size() == 0 {
+			t.Errorf("%s profile %s is missing or empty", kind, result.Path)
+		}
+		timed := kind == ProfileCPU || kind == ProfileMutex || kind == ProfileBlock
+		if timed != (result.Duration != "") {
+			t.Errorf("%s profile has duration %q", kind, result.Duration)
+		}
+	}
+}
+
+func TestCaptureRejectsUnknownKinds(t *testing.T) {
+	profiler := NewProfiler(t.TempDir())
+	if _, err := profiler.Capture(context.Background(), "threadcreate", 0); err == nil {
+		t.Error("Expected an error for an unknown profile kind")
+	}
+	if _, err := profiler.Capture(context.Background(), ProfileCPU, time.Hour); err == nil {
+		t.Error("Expected an error for a duration above the maximum")
+	}
+}
+
+func TestTimedProfilesRunOneAtATime(t *testing.T) {
+	profiler := NewProfiler(t.TempDir())
+	ctx, cancel := context.WithCancel(context.Background())
+	done := make(chan error)
+	go func() {
+		_, err := profiler.Capture(ctx, ProfileBlock, time.Minute)
+		done <- err
+	}()
+
+	// Wait for the block profile to start
+	for profiler.mu.TryLock() {
+		profiler.mu.Unlock()
+		time.Sleep(time.Millisecond)
+	}
+	if _, err := profiler.Capture(context.Background(), ProfileMutex, 10*time.Millisecond); err == nil {
+		t.Error("A second timed profile ran while the first one was running")
+	}
+	if _, err := profiler.Capture(context.Background(), ProfileHeap, 0); err != nil {
+		t.Errorf("Heap profile failed while a timed profile was running: %v", err)
+	}
+
+	// A cancelled profile leaves no file behind
+	cancel()
+	if err := <-done; err == nil {
+		t.Error("Expected the cancelled profile to fail")
+	}
+	entries, _ := os.ReadDir(profiler.dir)
+	for _, entry := range entries {
+		if filepath.Ext(entry.Name()) == ".pprof" && entry.Name()[:5] == "block" {
+			t.Errorf("Cancelled profile left %s behind", entry.Name())
+		}
+	}
+}
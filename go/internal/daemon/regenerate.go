@@ -0,0 +1,333 @@
+package daemon
+
+import (
+	"encoding/json"
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"time"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/logger"
+)
+
+// How often a global compile flag change retries restarting clangd while
+// requests are using it
+const regenerationRestartRetry = time.Second
+
+// RegenerationResult describes the outcome of a background regeneration of
+// the compilation database
+type RegenerationResult struct {
+	Time     string `json:"time"`
+	Duration string `json:"duration"`
+	Changed  int    `json:"changed"` // Translation units whose compile command changed
+	Added    int    `json:"added"`
+	Removed  int    `json:"removed"`
+	Action   string `json:"action"`
+	Error    string `json:"error,omitempty"`
+}
+
+// RegenerationStatus reports background regenerations for the status command
+type RegenerationStatus struct {
+	Running       bool                `json:"running"`
+	Regenerations int                 `json:"regenerations"`
+	Last          *RegenerationResult `json:"last,omitempty"`
+}
+
+// DatabaseRegenerator re-runs the CMake configure step of the private build
+// directory, in the background, when clangd uses it and it is stale at
+// startup or CMake files change while the daemon runs. Afterwards it compares
+// the old and new compile commands: clangd is told the new commands of the
+// changed translation units only, so everything else keeps its ASTs and
+// index. If most translation units changed, the flag change is global (e.g. a
+// new define or language standard) and clangd is restarted instead.
+//
+// Build directories of the developer are never reconfigured, as that would
+// rewrite their CMakeCache.txt and race their own builds. clangd keeps using
+// them, and the status command reports them as stale until they are
+// reconfigured.
+type DatabaseRegenerator struct {
+	backend *Backend
+	logger  logger.Logger
+
+	mu            sync.Mutex
+	running       bool
+	again         bool // CMake files changed during the running regeneration
+	regenerations int
+	last          *RegenerationResult
+}
+
+// Creates a regenerator for a backend
+func NewDatabaseRegenerator(backend *Backend, log logger.Logger) *DatabaseRegenerator {
+	return &DatabaseRegenerator{backend: backend, logger: log}
+}
+
+// Regenerates a database in the background. If a regeneration is already
+// running, another one follows it, so changes made meanwhile are picked up.
+func (r *DatabaseRegenerator) Start(db CompilationDatabase) {
+	switch db.Source {
+	case DatabaseOverride:
+		r.logger.Info("CMake files changed, but CLANGD_DAEMON_COMPILE_COMMANDS_DIR is set, not regenerating %s", db.Dir)
+		return
+	case DatabaseProjectRoot, DatabaseBuildTree:
+		r.logger.Info("CMake files changed, but %s is your build directory, not regenerating it. Reconfigure it to update clangd's compile commands.", db.Dir)
+		r.backend.databaseOutdated(db.Dir)
+		return
+	}
+	if !canReconfigure(db.Dir) {
+		r.logger.Info("CMake files changed, but %s is not a CMake build directory, not regenerating it", db.Dir)
+		return
+	}
+
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if r.running {
+		r.again = true
+		return
+	}
+	r.running = true
+	go r.run(db)
+}
+
+func (r *DatabaseRegenerator) run(db CompilationDatabase) {
+	for {
+		r.regenerate(db)
+
+		r.mu.Lock()
+		select {
+		case <-r.backend.closed:
+			r.again = false
+		default:
+		}
+		if !r.again {
+			r.running = false
+			r.mu.Unlock()
+			return
+		}
+		r.again = false
+		r.mu.Unlock()
+	}
+}
+
+func (r *DatabaseRegenerator) regenerate(db CompilationDatabase) {
+	begin := time.Now()
+	result := &RegenerationResult{Time: begin.Format(time.RFC3339)}
+	defer func() {
+		result.Duration = time.Since(begin).Round(time.Millisecond).String()
+		r.mu.Lock()
+		r.regenerations++
+		r.last = result
+		r.mu.Unlock()
+	}()
+
+	r.logger.Info("Regenerating compile_commands.json in %s in the background", db.Dir)
+	before, err := loadCompileCommands(db.Dir)
+	if err != nil {
+		// Without the old commands every translation unit counts as added
+		r.logger.Error("Failed to read compile_commands.json before regenerating: %v", err)
+	}
+	if err := configureBuild(r.backend.projectRoot, db.Dir, r.logger); err != nil {
+		r.logger.Error("Failed to regenerate compile_commands.json, clangd keeps using the old one: %v", err)
+		result.Error = err.Error()
+		return
+	}
+	after, err := loadCompileCommands(db.Dir)
+	if err != nil {
+		r.logger.Error("Failed to read regenerated compile_commands.json: %v", err)
+		result.Error = err.Error()
+		return
+	}
+	r.backend.databaseRegenerated(db.Dir)
+	r.backend.refreshWatchScope(db.Dir)
+
+	diff := diffCompileCommands(before, after)
+	result.Changed = diff.changed
+	result.Added = diff.added
+	result.Removed = diff.removed
+
+	client := r.backend.runningClient()
+	switch {
+	case len(diff.commands) == 0:
+		result.Action = "no compile commands changed"
+	case client == nil:
+		// The next clangd starts with the new database
+		result.Action = "clangd not running"
+	case diff.global(len(before)):
+		result.Action = "restarted clangd"
+		if !r.restartClangd() {
+			result.Action = "daemon shut down before clangd could be restarted"
+		}
+	default:
+		result.Action = fmt.Sprintf("updated %s", pluralize(len(diff.commands), "translation unit"))
+		if err := client.UpdateCompileCommands(diff.commands); err != nil {
+			result.Error = err.Error()
+		}
+	}
+	r.logger.Info("Regenerated compile_commands.json in %s: %d changed, %d added, %d removed, %s",
+		db.Dir, diff.changed, diff.added, diff.removed, result.Action)
+}
+
+// Restarts clangd once no request is using it. Returns false if the daemon
+// shut down first.
+func (r *DatabaseRegenerator) restartClangd() bool {
+	for !r.backend.Restart() {
+		select {
+		case <-time.After(regenerationRestartRetry):
+		case <-r.backend.closed:
+			return false
+		}
+	}
+	return true
+}
+
+// Returns regeneration activity for the status command
+func (r *DatabaseRegenerator) Status() RegenerationStatus {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	return RegenerationStatus{
+		Running:       r.running,
+		Regenerations: r.regenerations,
+		Last:          r.last,
+	}
+}
+
+// The difference between two compilation databases
+type databaseDiff struct {
+	commands map[string]clangd.CompileCommand // New commands of changed and added files
+	changed  int
+	added    int
+	removed  int
+}
+
+// Returns true if the flag change affects most translation units, so
+// restarting clangd is cheaper than updating them one by one
+func (d databaseDiff) global(total int) bool {
+	return d.changed > 0 && d.changed*2 > total
+}
+
+// Compares the compile commands of two databases
+func diffCompileCommands(before, after map[string]clangd.CompileCommand) databaseDiff {
+	diff := databaseDiff{commands: make(map[string]clangd.CompileCommand)}
+	for file, command := range after {
+		old, ok := before[file]
+		switch {
+		case !ok:
+			diff.added++
+		case !sameCompileCommand(old, command):
+			diff.changed++
+		default:
+			continue
+		}
+		diff.commands[file] = command
+	}
+	for file := range before {
+		if _, ok := after[file]; !ok {
+			diff.removed++
+		}
+	}
+	return diff
+}
+
+func sameCompileCommand(a, b clangd.CompileCommand) bool {
+	if a.WorkingDirectory != b.WorkingDirectory || len(a.CompilationCommand) != len(b.CompilationCommand) {
+		return false
+	}
+	for i := range a.CompilationCommand {
+		if a.CompilationCommand[i] != b.CompilationCommand[i] {
+			return false
+		}
+	}
+	return true
+}
+
+// Reads the compile commands of a database, keyed by absolute file path. If
+// a file has several entries, the first one wins, as in clangd.
+func loadCompileCommands(dir string) (map[string]clangd.CompileCommand, error) {
+	data, err := os.ReadFile(filepath.Join(dir, "compile_commands.json"))
+	if err != nil {
+		return nil, err
+	}
+
+	var entries []struct {
+		Directory string   `json:"directory"`
+		File      string   `json:"file"`
+		Command   string   `json:"command"`
+		Arguments []string `json:"arguments"`
+	}
+	if err := json.Unmarshal(data, &entries); err != nil {
+		return nil, fmt.Errorf("failed to parse compile_commands.json: %v", err)
+	}
+
+	commands := make(map[string]clangd.CompileCommand, len(entries))
+	for _, entry := range entries {
+		file := entry.File
+		if !filepath.IsAbs(file) {
+			file = filepath.Join(entry.Directory, file)
+		}
+		file = filepath.Clean(file)
+		if _, ok := commands[file]; ok {
+			continue
+		}
+
+		args := entry.Arguments
+		if len(args) == 0 {
+			args = splitCommand(entry.Command)
+		}
+		commands[file] = clangd.CompileCommand{
+			WorkingDirectory:   entry.Directory,
+			CompilationCommand: args,
+		}
+	}
+	return commands, nil
+}
+
+// Splits a shell command line into arguments, following the quoting rules
+// compilation databases use: single and double quotes, and backslash escapes
+// outside of single quotes
+func splitCommand(command string) []string {
+	var args []string
+	var current strings.Builder
+	inArg := false
+	var quote rune
+
+	runes := []rune(command)
+	for i := 0; i < len(runes); i++ {
+		c := runes[i]
+		switch {
+		case quote == '\'':
+			if c == '\'' {
+				quote = 0
+			} else {
+				current.WriteRune(c)
+			}
+		case c == '\\' && i+1 < len(runes):
+			i++
+			current.WriteRune(runes[i])
+			inArg = true
+		case quote == '"':
+			if c == '"' {
+				quote = 0
+			} else {
+				current.WriteRune(c)
+			}
+		case c == '\'' || c == '"':
+			quote = c
+			inArg = true
+		case c == ' ' || c == '\t' || c == '\n':
+			if inArg {
+				args = append(args, current.String())
+				current.Reset()
+				inArg = false
+			}
+		default:
+			current.WriteRune(c)
+			inArg = true
+		}
+	}
+	if inArg {
+		args = append(args, current.String())
+	}
+	return args
+}
@@ -0,0 +1,131 @@
+package daemon
+
+import (
+	"os"
+	"path/filepath"
+	"reflect"
+	"testing"
+	"time"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/logger"
+)
+
+func TestSplitCommand(t *testing.T) {
+	tests := []struct {
+		command string
+		want    []string
+	}{
+		{"c++ -c main.cpp", []string{"c++", "-c", "main.cpp"}},
+		{`c++  -DNAME="a b" -c main.cpp`, []string{"c++", "-DNAME=a b", "-c", "main.cpp"}},
+		{`c++ -DQ=\"x\" 'it''s' -I"dir with space"`, []string{"c++", `-DQ="x"`, "its", "-Idir with space"}},
+		{`c++ -DEMPTY="" -c`, []string{"c++", "-DEMPTY=", "-c"}},
+		{`c++ ""`, []string{"c++", ""}},
+	}
+	for _, test := range tests {
+		if got := splitCommand(test.command); !reflect.DeepEqual(got, test.want) {
+			t.Errorf("splitCommand(%q) = %q, want %q", test.command, got, test.want)
+		}
+	}
+}
+
+func TestLoadCompileCommands(t *testing.T) {
+	dir := t.TempDir()
+	writeFile(t, filepath.Join(dir, "compile_commands.json"), `[
+		{"directory": "/src/build", "file": "../a.cpp", "command": "c++ -O2 -c ../a.cpp"},
+		{"directory": "/src/build", "file": "/src/b.cpp", "arguments": ["c++", "-c", "/src/b.cpp"]},
+		{"directory": "/src/build", "file": "/src/b.cpp", "arguments": ["c++", "-DSECOND", "-c", "/src/b.cpp"]}
+	]`)
+
+	commands, err := loadCompileCommands(dir)
+	if err != nil {
+		t.Fatal(err)
+	}
+	want := map[string]clangd.CompileCommand{
+		"/src/a.cpp": {WorkingDirectory: "/src/build", CompilationCommand: []string{"c++", "-O2", "-c", "../a.cpp"}},
+		"/src/b.cpp": {WorkingDirectory: "/src/build", CompilationCommand: []string{"c++", "-c", "/src/b.cpp"}},
+	}
+	if !reflect.DeepEqual(commands, want) {
+		t.Errorf("got %+v, want %+v", commands, want)
+	}
+}
+
+func TestDiffCompileCommands(t *testing.T) {
+	command := func(args ...string) clangd.CompileCommand {
+		return clangd.CompileCommand{WorkingDirectory: "/build", CompilationCommand: args}
+	}
+	before := map[string]clangd.CompileCommand{
+		"/a.cpp": command("c++", "-c", "/a.cpp"),
+		"/b.cpp": command("c++", "-c", "/b.cpp"),
+		"/c.cpp": command("c++", "-c", "/c.cpp"),
+		"/d.cpp": command("c++", "-c", "/d.cpp"),
+	}
+
+	// One target gained a define, a file was added and one removed
+	after := map[string]clangd.CompileCommand{
+		"/a.cpp": command("c++", "-DFEATURE", "-c", "/a.cpp"),
+		"/b.cpp": command("c++", "-c", "/b.cpp"),
+		"/c.cpp": command("c++", "-c", "/c.cpp"),
+		"/e.cpp": command("c++", "-c", "/e.cpp"),
+	}
+	diff := diffCompileCommands(before, after)
+	if diff.changed != 1 || diff.added != 1 || diff.removed != 1 {
+		t.Errorf("expected 1 changed, 1 added and 1 removed, got %+v", diff)
+	}
+	if len(diff.commands) != 2 || diff.commands["/a.cpp"].CompilationCommand[1] != "-DFEATURE" {
+		t.Errorf("expected the commands of a.cpp and e.cpp, got %+v", diff.commands)
+	}
+	if diff.global(len(before)) {
+		t.Errorf("a change to one of four files is not global")
+	}
+
+	// The language standard changed everywhere
+	for file, cmd := range before {
+		after[file] = command(append([]string{"c++", "-std=c++20"}, cmd.CompilationCommand[1:]...)...)
+	}
+	if diff := diffCompileCommands(before, after); !diff.global(len(before)) {
+		t.Errorf("a change to all files is global, got %+v", diff)
+	}
+
+	if diff := diffCompileCommands(before, before); len(diff.commands) != 0 || diff.global(len(before)) {
+		t.Errorf("expected no changes, got %+v", diff)
+	}
+}
+
+func TestBuildTreeOfDeveloperIsNotRegenerated(t *testing.T) {
+	configured := time.Now().Add(-time.Hour)
+	projectRoot := newCMakeProject(t, configured.Add(time.Minute))
+	buildDir := filepath.Join(projectRoot, "build")
+	writeBuildTree(t, buildDir, filepath.Join(projectRoot, "main.cpp"), configured)
+	cache := filepath.Join(buildDir, "CMakeCache.txt")
+	writeFile(t, cache, "")
+	if err := os.Chtimes(cache, configured, configured); err != nil {
+		t.Fatal(err)
+	}
+
+	database := &CompilationDatabase{Dir: buildDir, Source: DatabaseBuildTree}
+	b := &Backend{projectRoot: projectRoot, database: database, databaseConfigured: configured}
+	b.regenerator = NewDatabaseRegenerator(b, &logger.NullLogger{})
+
+	// CMake files changed, but the build directory is left to the developer
+	// and reported as stale
+	b.regenerator.Start(*database)
+	if status := b.regenerator.Status(); status.Running || status.Regenerations != 0 {
+		t.Errorf("expected no regeneration, got %+v", status)
+	}
+	b.mu.Lock()
+	stale := b.databaseStatusLocked().Stale
+	b.mu.Unlock()
+	if !stale {
+		t.Errorf("expected the build directory to be reported as stale")
+	}
+
+	// Until the developer reconfigures it
+	writeBuildTree(t, buildDir, filepath.Join(projectRoot, "main.cpp"), time.Now())
+	b.mu.Lock()
+	stale = b.databaseStatusLocked().Stale
+	b.mu.Unlock()
+	if stale {
+		t.Errorf("expected the reconfigured build directory to be up to date")
+	}
+}
@@ -0,0 +1,269 @@
+package daemon
+
+import (
+	"fmt"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+
+	"clangd-query/internal/logger"
+)
+
+const (
+	// How often clangd's resources are sampled
+	resourceInterval = 5 * time.Second
+
+	// Number of samples kept, an hour at the sampling interval
+	maxResourceSamples = 720
+
+	// The on-disk index is walked only every this many samples, since it
+	// can consist of thousands of files
+	cacheSizeEvery = 12
+
+	// Clock ticks per second of the CPU times in /proc/<pid>/stat. The
+	// kernel reports them in USER_HZ, which is 100 on all Linux platforms.
+	clockTicksPerSecond = 100
+)
+
+// ResourceSample holds clangd's resource use at one point in time
+type ResourceSample struct {
+	Time       time.Time `json:"time"`
+	RSS        int64     `json:"rss"`        // Bytes
+	CPUPercent float64   `json:"cpuPercent"` // Of one core, since the previous sample
+	Threads    int       `json:"threads"`
+	OpenFiles  int       `json:"openFiles"`
+	CacheSize  int64     `json:"cacheSize"`          // Bytes of .cache/clangd
+	Requests   int       `json:"requests"`           // Requests since the previous sample
+	Activity   string    `json:"activity,omitempty"` // Their methods and counts
+}
+
+// ResourceStatus reports clangd's resource use over time for status --resources
+type ResourceStatus struct {
+	Interval string           `json:"interval"`
+	CPUTime  string           `json:"cpuTime"` // Used by the current clangd process
+	Samples  []ResourceSample `json:"samples"` // Oldest first
+}
+
+// ResourceMonitor samples the resource use of a project's clangd into a
+// bounded time series: its RSS, CPU time, threads and open files from /proc,
+// and the size of its on-disk index. Each sample also records which requests
+// the daemon served since the previous one, so growth can be attributed to
+// what agents were doing at the time.
+type ResourceMonitor struct {
+	backend  *Backend
+	cacheDir string
+	logger   logger.Logger
+
+	mu        sync.Mutex
+	samples   []ResourceSample // Ring buffer
+	next      int
+	count     int
+	activity  map[string]int // Requests since the last sample, by method
+	pid       int            // Process of the last CPU time
+	cpuTicks  int64
+	cpuAt     time.Time
+	cacheSize int64
+	sampled   int
+}
+
+// Creates a monitor for a backend
+func NewResourceMonitor(backend *Backend, log logger.Logger) *ResourceMonitor {
+	return &ResourceMonitor{
+		backend:  backend,
+		cacheDir: filepath.Join(backend.projectRoot, ".cache", "clangd"),
+		logger:   log,
+		samples:  make([]ResourceSample, maxResourceSamples),
+		activity: make(map[string]int),
+	}
+}
+
+// Counts a request for the activity of the current interval
+func (m *ResourceMonitor) RecordRequest(method string) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	m.activity[method]++
+}
+
+// Samples clangd's resources until stop is closed
+func (m *ResourceMonitor) Run(stop <-chan struct{}) {
+	ticker := time.NewTicker(resourceInterval)
+	defer ticker.Stop()
+
+	for {
+		select {
+		case <-ticker.C:
+			if client := m.backend.runningClient(); client != nil {
+				m.sample(client.PID(), time.Now())
+			}
+		case <-stop:
+			return
+		}
+	}
+}
+
+// Records a sample of a process. Samples that can't be read, e.g. because
+// clangd just exited, are skipped.
+func (m *ResourceMonitor) sample(pid int, now time.Time) {
+	usage, err := readProcessUsage(pid)
+	if err != nil {
+		m.logger.Debug("Failed to sample resources of clangd (pid %d): %v", pid, err)
+		return
+	}
+
+	m.mu.Lock()
+	walkCache := m.sampled%cacheSizeEvery == 0
+	m.mu.Unlock()
+	var cacheSize int64
+	if walkCache {
+		cacheSize = directorySize(m.cacheDir)
+	}
+
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if walkCache {
+		m.cacheSize = cacheSize
+	}
+	m.sampled++
+
+	s := ResourceSample{
+		Time:      now,
+		RSS:       usage.rss,
+		Threads:   usage.threads,
+		OpenFiles: usage.openFiles,
+		CacheSize: m.cacheSize,
+	}
+	// CPU use since the previous sample of the same process
+	if pid == m.pid && now.After(m.cpuAt) {
+		seconds := float64(usage.cpuTicks-m.cpuTicks) / clockTicksPerSecond
+		s.CPUPercent = 100 * seconds / now.Sub(m.cpuAt).Seconds()
+	}
+	m.pid = pid
+	m.cpuTicks = usage.cpuTicks
+	m.cpuAt = now
+
+	s.Requests, s.Activity = summarizeActivity(m.activity)
+	m.activity = make(map[string]int)
+
+	m.samples[m.next] = s
+	m.next = (m.next + 1) % len(m.samples)
+	if m.count < len(m.samples) {
+		m.count++
+	}
+}
+
+// Returns the number of requests and their methods, most frequent first,
+// e.g. "show 3, usages 1"
+func summarizeActivity(activity map[string]int) (int, string) {
+	methods := make([]string, 0, len(activity))
+	total := 0
+	for method, n := range activity {
+		methods = append(methods, method)
+		total += n
+	}
+	sort.Slice(methods, func(i, j int) bool {
+		if activity[methods[i]] != activity[methods[j]] {
+			return activity[methods[i]] > activity[methods[j]]
+		}
+		return methods[i] < methods[j]
+	})
+
+	parts := make([]string, len(methods))
+	for i, method := range methods {
+		parts[i] = fmt.Sprintf("%s %d", method, activity[method])
+	}
+	return total, strings.Join(parts, ", ")
+}
+
+// Returns the time series for the status command
+func (m *ResourceMonitor) Status() ResourceStatus {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+
+	status := ResourceStatus{
+		Interval: resourceInterval.String(),
+		CPUTime:  (time.Duration(m.cpuTicks) * time.Second / clockTicksPerSecond).String(),
+		Samples:  make([]ResourceSample, 0, m.count),
+	}
+	for i := m.count; i > 0; i-- {
+		status.Samples = append(status.Samples, m.samples[(m.next-i+len(m.samples))%len(m.samples)])
+	}
+	return status
+}
+
+// Resource use of a process as reported by /proc
+type processUsage struct {
+	rss       int64
+	cpuTicks  int64 // User and system time
+	threads   int
+	openFiles int
+}
+
+func readProcessUsage(pid int) (processUsage, error) {
+	var usage processUsage
+	var err error
+	if usage.rss, err = readRSS(pid); err != nil {
+		return usage, err
+	}
+
+	stat, err := os.ReadFile(fmt.Sprintf("/proc/%d/stat", pid))
+	if err != nil {
+		return usage, err
+	}
+	if usage.cpuTicks, usage.threads, err = parseProcStat(string(stat)); err != nil {
+		return usage, err
+	}
+
+	fds, err := os.ReadDir(fmt.Sprintf("/proc/%d/fd", pid))
+	if err != nil {
+		return usage, err
+	}
+	usage.openFiles = len(fds)
+	return usage, nil
+}
+
+// Parses the CPU time in clock ticks and the thread count from the contents
+// of /proc/<pid>/stat
+func parseProcStat(stat string) (cpuTicks int64, threads int, err error) {
+	// The command name in parentheses may contain spaces, the fields after
+	// it start with the state (field 3)
+	end := strings.LastIndexByte(stat, ')')
+	if end < 0 {
+		return 0, 0, fmt.Errorf("malformed stat: %q", stat)
+	}
+	fields := strings.Fields(stat[end+1:])
+	if len(fields) < 18 {
+		return 0, 0, fmt.Errorf("malformed stat: %q", stat)
+	}
+
+	// utime (field 14), stime (15) and num_threads (20)
+	utime, err1 := strconv.ParseInt(fields[11], 10, 64)
+	stime, err2 := strconv.ParseInt(fields[12], 10, 64)
+	threads, err3 := strconv.Atoi(fields[17])
+	if err1 != nil || err2 != nil || err3 != nil {
+		return 0, 0, fmt.Errorf("malformed stat: %q", stat)
+	}
+	return utime + stime, threads, nil
+}
+
+// Returns the total size of the files in a directory tree, 0 if it doesn't
+// exist
+func directorySize(dir string) int64 {
+	var size int64
+	filepath.WalkDir(dir, func(path string, entry fs.DirEntry, err error) error {
+		if err != nil {
+			return nil
+		}
+		if !entry.IsDir() {
+			if info, err := entry.Info(); err == nil {
+				size += info.Size()
+			}
+		}
+		return nil
+	})
+	return size
+}
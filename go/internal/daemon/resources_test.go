@@ -0,0 +1,94 @@
+package daemon
+
+import (
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+	"time"
+
+	"clangd-query/internal/logger"
+)
+
+func TestParseProcStat(t *testing.T) {
+	// The command name can contain spaces and parentheses
+	stat := "1234 (clangd (main) x) S 1 1234 1234 0 -1 4194560 5000 0 0 0 250 75 0 0 20 0 17 0 100 1000000 2000 18446744073709551615"
+	ticks, threads, err := parseProcStat(stat)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if ticks != 325 || threads != 17 {
+		t.Errorf("Got %d ticks and %d threads, want 325 and 17", ticks, threads)
+	}
+
+	if _, _, err := parseProcStat("1234 (clangd) S 1"); err == nil {
+		t.Error("Expected an error for a truncated stat")
+	}
+}
+
+func TestResourceSamples(t *testing.T) {
+	if _, err := os.Stat("/proc/self/stat"); err != nil {
+		t.Skip("No /proc on this system")
+	}
+	projectRoot := t.TempDir()
+	indexDir := filepath.Join(projectRoot, ".cache", "clangd", "index")
+	if err := os.MkdirAll(indexDir, 0755); err != nil {
+		t.Fatal(err)
+	}
+	writeFile(t, filepath.Join(indexDir, "a.idx"), strings.Repeat("x", 4096))
+
+	monitor := NewResourceMonitor(&Backend{projectRoot: projectRoot}, &logger.NullLogger{})
+	monitor.RecordRequest("show")
+	monitor.RecordRequest("usages")
+	monitor.RecordRequest("show")
+
+	// Sample this process, which has memory, threads and open files too
+	start := time.Now()
+	monitor.sample(os.Getpid(), start)
+	monitor.sample(os.Getpid(), start.Add(resourceInterval))
+
+	status := monitor.Status()
+	if len(status.Samples) != 2 {
+		t.Fatalf("Got %d samples, want 2", len(status.Samples))
+	}
+	first, second := status.Samples[0], status.Samples[1]
+	if first.RSS == 0 || first.Threads == 0 || first.OpenFiles == 0 {
+		t.Errorf("Sample is missing values: %+v", first)
+	}
+	if first.CacheSize != 4096 || second.CacheSize != 4096 {
+		t.Errorf("Got cache sizes %d and %d, want 4096", first.CacheSize, second.CacheSize)
+	}
+	if first.Requests != 3 || first.Activity != "show 2, usages 1" {
+		t.Errorf("Got %d requests (%s), want 3 (show 2, usages 1)", first.Requests, first.Activity)
+	}
+	if second.Requests != 0 || second.Activity != "" {
+		t.Errorf("Activity wasn't reset: %d requests (%s)", second.Requests, second.Activity)
+	}
+	if first.CPUPercent != 0 || second.CPUPercent < 0 {
+		t.Errorf("Got CPU %.1f%% and %.1f%%", first.CPUPercent, second.CPUPercent)
+	}
+}
+
+func TestResourceSamplesAreBounded(t *testing.T) {
+	if _, err := os.Stat("/proc/self/stat"); err != nil {
+		t.Skip("No /proc on this system")
+	}
+	monitor := NewResourceMonitor(&Backend{projectRoot: t.TempDir()}, &logger.NullLogger{})
+	start := time.Now()
+	for i := 0; i < maxResourceSamples+5; i++ {
+		monitor.sample(os.Getpid(), start.Add(time.Duration(i)*resourceInterval))
+	}
+
+	samples := monitor.Status().Samples
+	if len(samples) != maxResourceSamples {
+		t.Fatalf("Got %d samples, want %d", len(samples), maxResourceSamples)
+	}
+	if !samples[0].Time.Equal(start.Add(5 * resourceInterval)) {
+		t.Errorf("Oldest sample is from %v, want the 6th", samples[0].Time)
+	}
+	for i := 1; i < len(samples); i++ {
+		if !samples[i].Time.After(samples[i-1].Time) {
+			t.Fatalf("Samples are out of order at %d", i)
+		}
+	}
+}
@@ -0,0 +1,548 @@
+package daemon
+
+import (
+	"bufio"
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"io"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+
+	"clangd-query/internal/logger"
+)
+
+// Default size limit of the result cache file. When appending pushes the file
+// past it, the cache is compacted down to resultCacheCompactRatio of it.
+const defaultResultCacheSize = 32 * 1024 * 1024
+
+const resultCacheCompactRatio = 0.75
+
+// Results older than this are never served, even if none of the files they
+// were computed from changed. A symbol can be redeclared in a new file, this
+// bounds how stale a result gets.
+const maxResultAge = 24 * time.Hour
+
+// Identifies the file format: magic bytes followed by a version byte
+var resultCacheHeader = []byte("CQRC\x01")
+
+// Commands whose results are cached. Their results come from the documents
+// of the symbol they look up, which are recorded as the result's dependencies.
+// search, usages and hierarchy are not cached: a match, call or subclass
+// added to any other file changes their results, and those files are not
+// among the dependencies.
+var cacheableMethods = map[string]bool{
+	"show":      true,
+	"view":      true,
+	"signature": true,
+	"interface": true,
+}
+
+// A file a cached result was computed from, with its content hash at the time
+type resultDependency struct {
+	path string
+	hash uint64
+}
+
+type resultEntry struct {
+	result   json.RawMessage
+	deps     []resultDependency
+	created  time.Time
+	lastUsed time.Time
+	size     int64 // Size of the entry's record in the file
+}
+
+// Memoized content hash of a file, valid while size and mtime don't change
+type fileHash struct {
+	size    int64
+	modTime time.Time
+	hash    uint64
+}
+
+// ResultCacheStatus reports result cache usage for the status command
+type ResultCacheStatus struct {
+	Entries       int    `json:"entries"`
+	FileSize      int64  `json:"fileSize"`
+	Hits          int64  `json:"hits"`
+	Misses        int64  `json:"misses"`
+	Invalidated   int64  `json:"invalidated"` // Entries dropped because a dependency changed
+	Evicted       int64  `json:"evicted"`     // Entries dropped by compaction
+	LoadedEntries int    `json:"loadedEntries"`
+	LoadTime      string `json:"loadTime"`
+}
+
+// ResultCache persists command results under .cache/clangd-query so they
+// survive daemon restarts. Each entry is keyed by the normalized query and
+// stores a content hash of every file the result was computed from; an entry
+// is only served while all of those files still hash the same.
+//
+// The file is append-only: a header followed by length-prefixed, checksummed
+// binary records. Later records for a key replace earlier ones. Loading stops
+// at the first damaged record (e.g. from a crash during a write) and drops
+// the rest. When the file grows past its size limit, it is rewritten with the
+// most recently used entries only.
+type ResultCache struct {
+	mu       sync.Mutex
+	path     string
+	maxSize  int64
+	entries  map[string]*resultEntry
+	file     *os.File
+	fileSize int64
+	hashes   map[string]fileHash
+	logger   logger.Logger
+
+	hits, misses, invalidated, evicted int64
+	loadedEntries                      int
+	loadTime                           time.Duration
+}
+
+// Returns the path of the result cache file for a project
+func GetResultCachePath(projectRoot string) string {
+	return filepath.Join(projectRoot, ".cache", "clangd-query", "results.bin")
+}
+
+// Opens the result cache of a project, loading all entries from disk. If the
+// file can't be opened the cache still works, but only in memory.
+func OpenResultCache(projectRoot string, maxSize int64, log logger.Logger) *ResultCache {
+	rc := &ResultCache{
+		path:    GetResultCachePath(projectRoot),
+		maxSize: maxSize,
+		entries: make(map[string]*resultEntry),
+		hashes:  make(map[string]fileHash),
+		logger:  log,
+	}
+
+	start := time.Now()
+	if err := rc.load(); err != nil {
+		log.Error("Failed to load result cache, starting empty: %v", err)
+		rc.entries = make(map[string]*resultEntry)
+		rc.reset()
+	}
+	rc.loadedEntries = len(rc.entries)
+	rc.loadTime = time.Since(start)
+
+	if rc.loadedEntries > 0 {
+		log.Info("Loaded %d cached results in %v", rc.loadedEntries, rc.loadTime.Round(time.Millisecond))
+	}
+	return rc
+}
+
+// Returns the normalized query a request's result is cached under, and false
+// if the request's result can't be cached.
+func resultCacheKey(req Request) (string, bool) {
+	if !cacheableMethods[req.Method] {
+		return "", false
+	}
+
+	params := make(map[string]interface{}, len(req.Params))
+	for name, value := range req.Params {
+		if s, ok := value.(string); ok {
+			value = strings.TrimSpace(s)
+		}
+		params[name] = value
+	}
+	data, _ := json.Marshal(params) // Map keys are sorted, so this is canonical
+	return req.Method + "\x00" + string(data), true
+}
+
+// Returns the cached result for a key if all files it depends on are
+// unchanged. Entries with changed dependencies are dropped.
+func (rc *ResultCache) Get(key string) (json.RawMessage, bool) {
+	rc.mu.Lock()
+	defer rc.mu.Unlock()
+
+	entry, ok := rc.entries[key]
+	if !ok {
+		rc.misses++
+		return nil, false
+	}
+
+	if time.Since(entry.created) > maxResultAge || !rc.valid(entry) {
+		delete(rc.entries, key)
+		rc.invalidated++
+		rc.misses++
+		return nil, false
+	}
+
+	entry.lastUsed = time.Now()
+	rc.hits++
+	return entry.result, true
+}
+
+// Stores a result along with content hashes of the files it depends on.
+// Results without dependencies are not stored, since there is no way to tell
+// when they become stale.
+func (rc *ResultCache) Put(key string, result json.RawMessage, paths []string) {
+	if len(paths) == 0 {
+		return
+	}
+
+	rc.mu.Lock()
+	defer rc.mu.Unlock()
+
+	deps := make([]resultDependency, 0, len(paths))
+	for _, path := range paths {
+		hash, err := rc.hashFile(path)
+		if err != nil {
+			return // A dependency vanished already, the result may be stale
+		}
+		deps = append(deps, resultDependency{path: path, hash: hash})
+	}
+
+	now := time.Now()
+	entry := &resultEntry{
+		result:   result,
+		deps:     deps,
+		created:  now,
+		lastUsed: now,
+	}
+
+	record := encodeResultRecord(key, entry)
+	entry.size = int64(len(record))
+	rc.entries[key] = entry
+
+	if err := rc.append(record); err != nil {
+		rc.logger.Error("Failed to write result cache: %v", err)
+		return
+	}
+
+	if rc.fileSize > rc.maxSize {
+		if err := rc.compact(); err != nil {
+			rc.logger.Error("Failed to compact result cache: %v", err)
+		}
+	}
+}
+
+// Closes the cache file
+func (rc *ResultCache) Close() error {
+	rc.mu.Lock()
+	defer rc.mu.Unlock()
+
+	if rc.file == nil {
+		return nil
+	}
+	err := rc.file.Close()
+	rc.file = nil
+	return err
+}
+
+// Returns cache statistics for the status command
+func (rc *ResultCache) Status() ResultCacheStatus {
+	rc.mu.Lock()
+	defer rc.mu.Unlock()
+
+	return ResultCacheStatus{
+		Entries:       len(rc.entries),
+		FileSize:      rc.fileSize,
+		Hits:          rc.hits,
+		Misses:        rc.misses,
+		Invalidated:   rc.invalidated,
+		Evicted:       rc.evicted,
+		LoadedEntries: rc.loadedEntries,
+		LoadTime:      rc.loadTime.Round(time.Millisecond).String(),
+	}
+}
+
+// Checks that all dependencies of an entry still have the recorded content.
+// The caller must hold rc.mu.
+func (rc *ResultCache) valid(entry *resultEntry) bool {
+	for _, dep := range entry.deps {
+		hash, err := rc.hashFile(dep.path)
+		if err != nil || hash != dep.hash {
+			return false
+		}
+	}
+	return true
+}
+
+// Returns the content hash of a file. Hashes are memoized by size and mtime,
+// so checking an entry normally doesn't read any files. The caller must hold
+// rc.mu.
+func (rc *ResultCache) hashFile(path string) (uint64, error) {
+	info, err := os.Stat(path)
+	if err != nil {
+		return 0, err
+	}
+
+	if memo, ok := rc.hashes[path]; ok && memo.size == info.Size() && memo.modTime.Equal(info.ModTime()) {
+		return memo.hash, nil
+	}
+
+	memo, err := hashFileContent(path)
+	if err != nil {
+		return 0, err
+	}
+	rc.hashes[path] = memo
+	return memo.hash, nil
+}
+
+// Reads all records from the cache file and opens it for appending. The
+// caller must hold rc.mu or have exclusive access.
+func (rc *ResultCache) load() error {
+	data, err := os.ReadFile(rc.path)
+	if os.IsNotExist(err) {
+		return rc.reset()
+	}
+	if err != nil {
+		return err
+	}
+
+	if len(data) < len(resultCacheHeader) || string(data[:len(resultCacheHeader)]) != string(resultCacheHeader) {
+		return errors.New("unknown result cache format")
+	}
+
+	offset := len(resultCacheHeader)
+	for offset < len(data) {
+		key, entry, n, err := decodeResultRecord(data[offset:])
+		if err != nil {
+			// A torn write at the end of the file, keep what came before
+			rc.logger.Debug("Result cache damaged at offset %d, truncating: %v", offset, err)
+			break
+		}
+		entry.size = int64(n)
+		rc.entries[key] = entry
+		offset += n
+	}
+
+	file, err := os.OpenFile(rc.path, os.O_WRONLY, 0644)
+	if err != nil {
+		return err
+	}
+	if err := file.Truncate(int64(offset)); err != nil {
+		file.Close()
+		return err
+	}
+	if _, err := file.Seek(int64(offset), io.SeekStart); err != nil {
+		file.Close()
+		return err
+	}
+	rc.file = file
+	rc.fileSize = int64(offset)
+	return nil
+}
+
+// Starts a new, empty cache file. The caller must hold rc.mu.
+func (rc *ResultCache) reset() error {
+	if rc.file != nil {
+		rc.file.Close()
+		rc.file = nil
+	}
+	rc.fileSize = 0
+
+	if err := os.MkdirAll(filepath.Dir(rc.path), 0755); err != nil {
+		return err
+	}
+	file, err := os.Create(rc.path)
+	if err != nil {
+		return err
+	}
+	if _, err := file.Write(resultCacheHeader); err != nil {
+		file.Close()
+		return err
+	}
+	rc.file = file
+	rc.fileSize = int64(len(resultCacheHeader))
+	return nil
+}
+
+// Appends a record to the cache file. The caller must hold rc.mu.
+func (rc *ResultCache) append(record []byte) error {
+	if rc.file == nil {
+		return nil // Memory only
+	}
+	if _, err := rc.file.Write(record); err != nil {
+		return err
+	}
+	rc.fileSize += int64(len(record))
+	return nil
+}
+
+// Rewrites the cache file with the most recently used entries that fit into
+// the compaction target, dropping everything else. The caller must hold rc.mu.
+func (rc *ResultCache) compact() error {
+	keys := make([]string, 0, len(rc.entries))
+	for key := range rc.entries {
+		keys = append(keys, key)
+	}
+	sort.Slice(keys, func(i, j int) bool {
+		return rc.entries[keys[i]].lastUsed.After(rc.entries[keys[j]].lastUsed)
+	})
+
+	target := int64(float64(rc.maxSize) * resultCacheCompactRatio)
+	tempPath := rc.path + ".tmp"
+	file, err := os.Create(tempPath)
+	if err != nil {
+		return err
+	}
+
+	w := bufio.NewWriter(file)
+	w.Write(resultCacheHeader)
+	size := int64(len(resultCacheHeader))
+	kept := make(map[string]*resultEntry)
+
+	var keep []string
+	for _, key := range keys {
+		entry := rc.entries[key]
+		if size+entry.size > target {
+			rc.evicted++
+			continue
+		}
+		size += entry.size
+		keep = append(keep, key)
+	}
+	// Write least recently used first, so reloading keeps the order of use
+	for i := len(keep) - 1; i >= 0; i-- {
+		key := keep[i]
+		entry := rc.entries[key]
+		w.Write(encodeResultRecord(key, entry))
+		kept[key] = entry
+	}
+
+	if err := w.Flush(); err != nil {
+		file.Close()
+		return err
+	}
+	if err := os.Rename(tempPath, rc.path); err != nil {
+		file.Close()
+		return err
+	}
+
+	if rc.file != nil {
+		rc.file.Close()
+	}
+	rc.file = file
+	rc.fileSize = size
+	rc.entries = kept
+	rc.logger.Debug("Compacted result cache to %d entries (%d bytes)", len(kept), size)
+	return nil
+}
+
+// Encodes an entry as a record:
+//
+//	uvarint payload length
+//	payload: key, result, created (unix seconds), dependency count,
+//	         then per dependency its path and 8 byte content hash
+//	uint32 CRC-32 of the payload
+//
+// Strings are encoded as a uvarint length followed by their bytes.
+func encodeResultRecord(key string, entry *resultEntry) []byte {
+	payload := make([]byte, 0, len(key)+len(entry.result)+64*len(entry.deps)+32)
+	payload = appendString(payload, key)
+	payload = appendString(payload, string(entry.result))
+	payload = binary.AppendVarint(payload, entry.created.Unix())
+	payload = binary.AppendUvarint(payload, uint64(len(entry.deps)))
+	for _, dep := range entry.deps {
+		payload = appendString(payload, dep.path)
+		payload = binary.LittleEndian.AppendUint64(payload, dep.hash)
+	}
+
+	record := binary.AppendUvarint(make([]byte, 0, len(payload)+binary.MaxVarintLen64+4), uint64(len(payload)))
+	record = append(record, payload...)
+	return binary.LittleEndian.AppendUint32(record, crc32.ChecksumIEEE(payload))
+}
+
+// Decodes the record at the start of data. Returns the record's total size.
+func decodeResultRecord(data []byte) (string, *resultEntry, int, error) {
+	length, n := binary.Uvarint(data)
+	if n <= 0 || uint64(len(data)-n) < length+4 {
+		return "", nil, 0, errors.New("truncated record")
+	}
+
+	payload := data[n : n+int(length)]
+	checksum := binary.LittleEndian.Uint32(data[n+int(length):])
+	if crc32.ChecksumIEEE(payload) != checksum {
+		return "", nil, 0, errors.New("checksum mismatch")
+	}
+
+	r := recordReader{data: payload}
+	key := r.string()
+	result := r.string()
+	created := r.varint()
+	count := r.uvarint()
+
+	entry := &resultEntry{
+		result:   json.RawMessage(result),
+		created:  time.Unix(created, 0),
+		lastUsed: time.Unix(created, 0),
+	}
+	for i := uint64(0); i < count && r.err == nil; i++ {
+		path := r.string()
+		entry.deps = append(entry.deps, resultDependency{path: path, hash: r.uint64()})
+	}
+	if r.err != nil {
+		return "", nil, 0, r.err
+	}
+
+	return key, entry, n + int(length) + 4, nil
+}
+
+func appendString(b []byte, s string) []byte {
+	b = binary.AppendUvarint(b, uint64(len(s)))
+	return append(b, s...)
+}
+
+// recordReader decodes the fields of a record payload. The first error is
+// kept and all later reads return zero values.
+type recordReader struct {
+	data []byte
+	err  error
+}
+
+func (r *recordReader) uvarint() uint64 {
+	if r.err != nil {
+		return 0
+	}
+	v, n := binary.Uvarint(r.data)
+	if n <= 0 {
+		r.err = errors.New("invalid varint")
+		return 0
+	}
+	r.data = r.data[n:]
+	return v
+}
+
+func (r *recordReader) varint() int64 {
+	if r.err != nil {
+		return 0
+	}
+	v, n := binary.Varint(r.data)
+	if n <= 0 {
+		r.err = errors.New("invalid varint")
+		return 0
+	}
+	r.data = r.data[n:]
+	return v
+}
+
+func (r *recordReader) string() string {
+	length := r.uvarint()
+	if r.err != nil {
+		return ""
+	}
+	if uint64(len(r.data)) < length {
+		r.err = fmt.Errorf("string of length %d exceeds record", length)
+		return ""
+	}
+	s := string(r.data[:length])
+	r.data = r.data[length:]
+	return s
+}
+
+func (r *recordReader) uint64() uint64 {
+	if r.err != nil {
+		return 0
+	}
+	if len(r.data) < 8 {
+		r.err = errors.New("truncated uint64")
+		return 0
+	}
+	v := binary.LittleEndian.Uint64(r.data)
+	r.data = r.data[8:]
+	return v
+}
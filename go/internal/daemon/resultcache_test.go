@@ -0,0 +1,126 @@
+package daemon
+
+import (
+	"encoding/json"
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+	"time"
+
+	"clangd-query/internal/logger"
+)
+
+func writeFile(t *testing.T, path string, content string) {
+	t.Helper()
+	if err := os.WriteFile(path, []byte(content), 0644); err != nil {
+		t.Fatal(err)
+	}
+}
+
+func TestResultCacheSurvivesRestart(t *testing.T) {
+	projectRoot := t.TempDir()
+	header := filepath.Join(projectRoot, "engine.h")
+	writeFile(t, header, "class Engine {};")
+	log := &logger.NullLogger{}
+
+	key, ok := resultCacheKey(Request{Method: "show", Params: map[string]interface{}{"symbol": " Engine "}})
+	if !ok {
+		t.Fatalf("expected show to be cacheable")
+	}
+
+	rc := OpenResultCache(projectRoot, defaultResultCacheSize, log)
+	rc.Put(key, json.RawMessage(`{"output":"class Engine"}`), []string{header})
+	rc.Close()
+
+	reopened := OpenResultCache(projectRoot, defaultResultCacheSize, log)
+	defer reopened.Close()
+
+	// Whitespace around the symbol doesn't change the normalized query
+	sameKey, _ := resultCacheKey(Request{Method: "show", Params: map[string]interface{}{"symbol": "Engine"}})
+	result, ok := reopened.Get(sameKey)
+	if !ok || string(result) != `{"output":"class Engine"}` {
+		t.Fatalf("expected cached result after restart, got %s, %v", result, ok)
+	}
+
+	// Changing the dependency invalidates the entry
+	writeFile(t, header, "class Engine { void Update(); };")
+	if _, ok := reopened.Get(sameKey); ok {
+		t.Errorf("expected entry to be invalidated after its dependency changed")
+	}
+	if status := reopened.Status(); status.Hits != 1 || status.Invalidated != 1 {
+		t.Errorf("unexpected status: %+v", status)
+	}
+}
+
+func TestResultCacheSkipsIndexWideCommands(t *testing.T) {
+	// Their results depend on files they don't record
+	for _, method := range []string{"search", "usages", "hierarchy"} {
+		if _, ok := resultCacheKey(Request{Method: method, Params: map[string]interface{}{"symbol": "Engine"}}); ok {
+			t.Errorf("expected %s not to be cacheable", method)
+		}
+	}
+}
+
+func TestResultCacheTruncatesDamagedTail(t *testing.T) {
+	projectRoot := t.TempDir()
+	source := filepath.Join(projectRoot, "engine.cpp")
+	writeFile(t, source, "void Engine::Update() {}")
+	log := &logger.NullLogger{}
+
+	rc := OpenResultCache(projectRoot, defaultResultCacheSize, log)
+	rc.Put("first", json.RawMessage(`1`), []string{source})
+	rc.Put("second", json.RawMessage(`2`), []string{source})
+	rc.Close()
+
+	// Simulate a crash in the middle of writing the second record
+	path := GetResultCachePath(projectRoot)
+	info, _ := os.Stat(path)
+	os.Truncate(path, info.Size()-3)
+
+	reopened := OpenResultCache(projectRoot, defaultResultCacheSize, log)
+	if _, ok := reopened.Get("first"); !ok {
+		t.Errorf("expected intact record to survive")
+	}
+	if _, ok := reopened.Get("second"); ok {
+		t.Errorf("expected damaged record to be dropped")
+	}
+
+	// Appending after truncation yields a readable file again
+	reopened.Put("third", json.RawMessage(`3`), []string{source})
+	reopened.Close()
+
+	final := OpenResultCache(projectRoot, defaultResultCacheSize, log)
+	defer final.Close()
+	if status := final.Status(); status.LoadedEntries != 2 {
+		t.Errorf("expected 2 entries after reload, got %d", status.LoadedEntries)
+	}
+}
+
+func TestResultCacheEvictsLeastRecentlyUsed(t *testing.T) {
+	projectRoot := t.TempDir()
+	source := filepath.Join(projectRoot, "engine.cpp")
+	writeFile(t, source, "void Engine::Update() {}")
+	log := &logger.NullLogger{}
+
+	result := json.RawMessage(`"` + strings.Repeat("x", 1000) + `"`)
+	rc := OpenResultCache(projectRoot, 8*1024, log)
+	defer rc.Close()
+
+	rc.Put("keep", result, []string{source})
+	for i := 0; i < 20; i++ {
+		// Keep using the first entry so it stays the most recently used
+		time.Sleep(time.Millisecond)
+		rc.Get("keep")
+		rc.Put(fmt.Sprintf("filler%d", i), result, []string{source})
+	}
+
+	status := rc.Status()
+	if status.FileSize > 8*1024 || status.Evicted == 0 {
+		t.Errorf("expected compaction to bound the file, got %+v", status)
+	}
+	if _, ok := rc.Get("keep"); !ok {
+		t.Errorf("expected most recently used entry to survive compaction")
+	}
+}
@@ -0,0 +1,273 @@
+package daemon
+
+import (
+	"context"
+	"os"
+	"strconv"
+	"sync"
+	"time"
+)
+
+// Default number of commands that run against clangd at the same time. Can be
+// overridden with the CLANGD_DAEMON_WORKERS environment variable.
+const defaultWorkers = 4
+
+// Lane is a priority class of daemon work. A free worker always picks up
+// queued interactive work before bulk work, and bulk work before background
+// work.
+type Lane int
+
+const (
+	// Status, logs and shutdown. Never queued and not counted against the
+	// worker pool, so they answer even while every worker is busy.
+	LaneControl Lane = iota
+
+	// Cheap queries an agent is waiting on: search, show, view, signature
+	// and interface.
+	LaneInteractive
+
+	// Queries that can keep clangd busy for many seconds: usages and
+	// hierarchy. Bulk and background work together never occupy the last
+	// worker, so interactive queries can always start.
+	LaneBulk
+
+	// Work nobody is waiting on, like prefetching and symbol index builds.
+	// At most one background task runs at a time.
+	LaneBackground
+
+	numLanes
+)
+
+var laneNames = [numLanes]string{"control", "interactive", "bulk", "background"}
+
+func (l Lane) String() string {
+	return laneNames[l]
+}
+
+// Returns the lane a client request runs in
+func laneForMethod(method string) Lane {
+	switch method {
+	case "status", "logs", "trace", "profile", "shutdown":
+		return LaneControl
+	case "usages", "hierarchy":
+		return LaneBulk
+	default:
+		return LaneInteractive
+	}
+}
+
+// A unit of work waiting for or holding a worker
+type task struct {
+	lane     Lane
+	enqueued time.Time
+	wait     time.Duration
+	start    chan struct{} // Closed when the task is given a worker
+}
+
+type laneStats struct {
+	completed int64
+	cancelled int64
+	waitTotal time.Duration
+	waitMax   time.Duration
+}
+
+// Scheduler runs daemon work on a bounded pool of workers with priority
+// lanes. Tasks block in Do until a worker is free for their lane, and leave
+// the queue again if their context is done first.
+type Scheduler struct {
+	workers  int
+	limits   [numLanes]int // Maximum running tasks per lane
+	deferred int           // Maximum running bulk and background tasks together
+
+	mu      sync.Mutex
+	queues  [numLanes][]*task
+	running [numLanes]int
+	busy    int // Workers in use, control tasks excluded
+	stats   [numLanes]laneStats
+}
+
+// LaneStatus reports the state of one lane for the status command
+type LaneStatus struct {
+	Name      string `json:"name"`
+	Queued    int    `json:"queued"`
+	Running   int    `json:"running"`
+	Completed int64  `json:"completed"`
+	Cancelled int64  `json:"cancelled"`
+	AvgWait   string `json:"avgWait"`
+	MaxWait   string `json:"maxWait"`
+}
+
+// SchedulerStatus reports worker pool usage for the status command
+type SchedulerStatus struct {
+	Workers                 int          `json:"workers"`
+	Lanes                   []LaneStatus `json:"lanes"`
+	CancelledClangdRequests int64        `json:"cancelledClangdRequests"`
+}
+
+// Creates a scheduler with the given number of workers. At least two workers
+// are used so bulk and background work can never block interactive work.
+func NewScheduler(workers int) *Scheduler {
+	if workers < 2 {
+		workers = 2
+	}
+
+	s := &Scheduler{workers: workers}
+	s.limits[LaneInteractive] = workers
+	s.limits[LaneBulk] = workers - 1
+	s.limits[LaneBackground] = 1
+	s.deferred = workers - 1
+	return s
+}
+
+// Returns the number of workers from the CLANGD_DAEMON_WORKERS environment
+// variable or the default
+func getWorkerCount() int {
+	if value := os.Getenv("CLANGD_DAEMON_WORKERS"); value != "" {
+		if count, err := strconv.Atoi(value); err == nil && count > 0 {
+			return count
+		}
+	}
+	return defaultWorkers
+}
+
+// Runs fn in the given lane once a worker is available and returns its error.
+// If ctx is done before fn starts, fn is never run and ctx's error is
+// returned. Work that finishes with ctx done is counted as cancelled.
+func (s *Scheduler) Do(ctx context.Context, lane Lane, fn func(ctx context.Context) error) error {
+	if lane == LaneControl {
+		s.mu.Lock()
+		s.running[lane]++
+		s.mu.Unlock()
+
+		err := fn(ctx)
+
+		s.mu.Lock()
+		s.running[lane]--
+		s.record(lane, 0, ctx.Err() != nil)
+		s.mu.Unlock()
+		return err
+	}
+
+	t := &task{
+		lane:     lane,
+		enqueued: time.Now(),
+		start:    make(chan struct{}),
+	}
+
+	s.mu.Lock()
+	s.queues[lane] = append(s.queues[lane], t)
+	s.dispatch()
+	s.mu.Unlock()
+
+	select {
+	case <-t.start:
+	case <-ctx.Done():
+		s.mu.Lock()
+		if s.dequeue(t) {
+			s.record(lane, time.Since(t.enqueued), true)
+			s.mu.Unlock()
+			return ctx.Err()
+		}
+		s.mu.Unlock()
+
+		// A worker was assigned at the same time, hand it back unused
+		<-t.start
+		s.finish(t, true)
+		return ctx.Err()
+	}
+
+	err := fn(ctx)
+	s.finish(t, ctx.Err() != nil)
+	return err
+}
+
+// Hands free workers to queued tasks in lane priority order, keeping one
+// worker for the interactive lane. The caller must hold s.mu.
+func (s *Scheduler) dispatch() {
+	for s.busy < s.workers {
+		started := false
+		for lane := LaneInteractive; lane < numLanes; lane++ {
+			if len(s.queues[lane]) == 0 || s.running[lane] >= s.limits[lane] {
+				continue
+			}
+			if lane != LaneInteractive && s.running[LaneBulk]+s.running[LaneBackground] >= s.deferred {
+				continue
+			}
+
+			t := s.queues[lane][0]
+			s.queues[lane] = s.queues[lane][1:]
+			s.running[lane]++
+			s.busy++
+			t.wait = time.Since(t.enqueued)
+			close(t.start)
+			started = true
+			break
+		}
+		if !started {
+			return
+		}
+	}
+}
+
+// Removes a task that has not started from its queue. Returns false if the
+// task already got a worker. The caller must hold s.mu.
+func (s *Scheduler) dequeue(t *task) bool {
+	queue := s.queues[t.lane]
+	for i, queued := range queue {
+		if queued == t {
+			s.queues[t.lane] = append(queue[:i:i], queue[i+1:]...)
+			return true
+		}
+	}
+	return false
+}
+
+// Releases the worker of a started task
+func (s *Scheduler) finish(t *task, cancelled bool) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	s.running[t.lane]--
+	s.busy--
+	s.record(t.lane, t.wait, cancelled)
+	s.dispatch()
+}
+
+// The caller must hold s.mu.
+func (s *Scheduler) record(lane Lane, wait time.Duration, cancelled bool) {
+	stats := &s.stats[lane]
+	if cancelled {
+		stats.cancelled++
+	} else {
+		stats.completed++
+	}
+	stats.waitTotal += wait
+	if wait > stats.waitMax {
+		stats.waitMax = wait
+	}
+}
+
+// Returns queue depths and wait times of all lanes
+func (s *Scheduler) Status() SchedulerStatus {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	status := SchedulerStatus{Workers: s.workers}
+	for lane := LaneControl; lane < numLanes; lane++ {
+		stats := s.stats[lane]
+		var avgWait time.Duration
+		if count := stats.completed + stats.cancelled; count > 0 {
+			avgWait = stats.waitTotal / time.Duration(count)
+		}
+		status.Lanes = append(status.Lanes, LaneStatus{
+			Name:      lane.String(),
+			Queued:    len(s.queues[lane]),
+			Running:   s.running[lane],
+			Completed: stats.completed,
+			Cancelled: stats.cancelled,
+			AvgWait:   avgWait.Round(time.Millisecond).String(),
+			MaxWait:   stats.waitMax.Round(time.Millisecond).String(),
+		})
+	}
+	return status
+}
@@ -0,0 +1,132 @@
+package daemon
+
+import (
+	"context"
+	"errors"
+	"testing"
+	"time"
+)
+
+// Occupies a worker in the given lane until release is closed
+func hold(s *Scheduler, lane Lane, release chan struct{}) <-chan struct{} {
+	started := make(chan struct{})
+	go s.Do(context.Background(), lane, func(ctx context.Context) error {
+		close(started)
+		<-release
+		return nil
+	})
+	return started
+}
+
+func TestSchedulerKeepsWorkerForInteractive(t *testing.T) {
+	s := NewScheduler(2)
+	release := make(chan struct{})
+	defer close(release)
+
+	<-hold(s, LaneBulk, release)
+
+	// The second bulk task must wait, the only free worker is reserved
+	bulkStarted := make(chan struct{})
+	go s.Do(context.Background(), LaneBulk, func(ctx context.Context) error {
+		close(bulkStarted)
+		return nil
+	})
+
+	done := make(chan struct{})
+	go s.Do(context.Background(), LaneInteractive, func(ctx context.Context) error {
+		close(done)
+		return nil
+	})
+
+	select {
+	case <-done:
+	case <-time.After(time.Second):
+		t.Fatalf("interactive task did not run while bulk work held a worker")
+	}
+
+	select {
+	case <-bulkStarted:
+		t.Errorf("second bulk task started although only one bulk worker is allowed")
+	case <-time.After(50 * time.Millisecond):
+	}
+}
+
+func TestSchedulerKeepsWorkerForInteractiveUnderBackground(t *testing.T) {
+	s := NewScheduler(4)
+	release := make(chan struct{})
+	defer close(release)
+
+	// Bulk and background work fill every worker but the last
+	<-hold(s, LaneBackground, release)
+	<-hold(s, LaneBulk, release)
+	<-hold(s, LaneBulk, release)
+
+	bulkStarted := make(chan struct{})
+	go s.Do(context.Background(), LaneBulk, func(ctx context.Context) error {
+		close(bulkStarted)
+		return nil
+	})
+
+	done := make(chan struct{})
+	go s.Do(context.Background(), LaneInteractive, func(ctx context.Context) error {
+		close(done)
+		return nil
+	})
+
+	select {
+	case <-done:
+	case <-time.After(time.Second):
+		t.Fatalf("interactive task did not run while bulk and background work held workers")
+	}
+
+	select {
+	case <-bulkStarted:
+		t.Errorf("third bulk task started next to background work, taking the last worker")
+	case <-time.After(50 * time.Millisecond):
+	}
+}
+
+func TestSchedulerCancelWhileQueued(t *testing.T) {
+	s := NewScheduler(2)
+	release := make(chan struct{})
+	defer close(release)
+
+	<-hold(s, LaneInteractive, release)
+	<-hold(s, LaneInteractive, release)
+
+	ctx, cancel := context.WithTimeout(context.Background(), 20*time.Millisecond)
+	defer cancel()
+
+	ran := false
+	err := s.Do(ctx, LaneInteractive, func(ctx context.Context) error {
+		ran = true
+		return nil
+	})
+	if !errors.Is(err, context.DeadlineExceeded) || ran {
+		t.Fatalf("expected queued task to be cancelled without running, got err=%v ran=%v", err, ran)
+	}
+
+	status := s.Status()
+	lane := status.Lanes[LaneInteractive]
+	if lane.Cancelled != 1 || lane.Queued != 0 || lane.Running != 2 {
+		t.Errorf("unexpected interactive lane status: %+v", lane)
+	}
+}
+
+func TestSchedulerControlNeverQueues(t *testing.T) {
+	s := NewScheduler(2)
+	release := make(chan struct{})
+	defer close(release)
+
+	<-hold(s, LaneInteractive, release)
+	<-hold(s, LaneInteractive, release)
+
+	ran := false
+	s.Do(context.Background(), LaneControl, func(ctx context.Context) error {
+		ran = true
+		return nil
+	})
+	if !ran {
+		t.Errorf("control task did not run while all workers were busy")
+	}
+}
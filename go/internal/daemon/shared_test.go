@@ -0,0 +1,79 @@
+package daemon
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+
+	"clangd-query/internal/logger"
+)
+
+func TestParseByteSize(t *testing.T) {
+	cases := map[string]int64{
+		"1024": 1024,
+		"512M": 512 << 20,
+		"8G":   8 << 30,
+		"64kb": 64 << 10,
+	}
+	for value, expected := range cases {
+		if size, err := parseByteSize(value); err != nil || size != expected {
+			t.Errorf("parseByteSize(%q) = %d, %v, expected %d", value, size, err, expected)
+		}
+	}
+	if _, err := parseByteSize("lots"); err == nil {
+		t.Errorf("expected an error for an invalid size")
+	}
+}
+
+func TestReadRSS(t *testing.T) {
+	if _, err := os.Stat("/proc/self/status"); err != nil {
+		t.Skip("requires /proc")
+	}
+	rss, err := readRSS(os.Getpid())
+	if err != nil || rss <= 0 {
+		t.Errorf("expected the RSS of the test process, got %d, %v", rss, err)
+	}
+}
+
+func TestSharedDaemonRoutesByProject(t *testing.T) {
+	d := &Daemon{
+		shared:    true,
+		scheduler: NewScheduler(2),
+		logger:    &logger.NullLogger{},
+		backends:  make(map[string]*Backend),
+	}
+	defer func() {
+		for _, backend := range d.allBackends() {
+			backend.Close()
+		}
+	}()
+
+	first, second := t.TempDir(), t.TempDir()
+	writeFile(t, filepath.Join(first, "CMakeLists.txt"), "project(first)")
+	writeFile(t, filepath.Join(second, "CMakeLists.txt"), "project(second)")
+
+	a, err := d.backendFor(first)
+	if err != nil {
+		t.Fatal(err)
+	}
+	b, err := d.backendFor(second)
+	if err != nil {
+		t.Fatal(err)
+	}
+	again, _ := d.backendFor(first)
+	if a == b || a != again {
+		t.Errorf("expected one backend per project")
+	}
+
+	// Backends start stopped; clangd only starts for requests that need it
+	if status := a.ProjectStatus(); status.State != BackendStopped {
+		t.Errorf("expected a new backend to be stopped, got %+v", status)
+	}
+
+	if _, err := d.backendFor(""); err == nil {
+		t.Errorf("expected requests without a project to be rejected")
+	}
+	if _, err := d.backendFor(t.TempDir()); err == nil {
+		t.Errorf("expected directories without CMakeLists.txt to be rejected")
+	}
+}
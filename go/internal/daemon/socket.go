@@ -1,6 +1,7 @@
 package daemon
 
 import (
+	"bytes"
 	"crypto/md5"
 	"encoding/json"
 	"fmt"
@@ -40,6 +41,21 @@ func GetLockPath(projectRoot string) string {
 	return filepath.Join(projectRoot, ".clangd-query.lock")
 }
 
+// Returns the directory of the shared daemon, which takes the place of the
+// project root for its lock and log files. It is specific to the user, like
+// the cache directory it lives in.
+func GetSharedDaemonDir() (string, error) {
+	cacheDir, err := os.UserCacheDir()
+	if err != nil {
+		return "", err
+	}
+	dir := filepath.Join(cacheDir, "clangd-query", "shared")
+	if err := os.MkdirAll(dir, 0755); err != nil {
+		return "", err
+	}
+	return dir, nil
+}
+
 // Returns the path to the daemon log file for a given project.
 // The log file is stored in a .cache/clangd-query subdirectory within the
 // project root. The cache directory is created if it doesn't exist. This log
@@ -98,6 +114,11 @@ func ReadLockFile(projectRoot string) (*LockInfo, error) {
 		return nil, err
 	}
 
+	// A client that holds the spawn lock may have just created the file
+	if len(bytes.TrimSpace(data)) == 0 {
+		return nil, nil
+	}
+
 	var lockInfo LockInfo
 	if err := json.Unmarshal(data, &lockInfo); err != nil {
 		return nil, err
@@ -119,6 +140,58 @@ func RemoveLockFile(projectRoot string) error {
 	return nil
 }
 
+// Takes an exclusive flock on the project's lock file, creating the file if
+// needed, so that only one client at a time decides whether to start a
+// daemon. Clients that arrive while a daemon is being started block here
+// until it is ready, then find it in the lock file. Returns a function that
+// releases the lock.
+//
+// The lock only works as long as everyone locks the same file, so the daemon
+// overwrites the lock file in place rather than replacing it. If the file is
+// removed while we wait, the lock is taken again on the new one.
+func LockSpawn(projectRoot string) (func(), error) {
+	lockPath := GetLockPath(projectRoot)
+
+	for {
+		file, err := os.OpenFile(lockPath, os.O_RDWR|os.O_CREATE, 0644)
+		if err != nil {
+			return nil, err
+		}
+		if err := syscall.Flock(int(file.Fd()), syscall.LOCK_EX); err != nil {
+			file.Close()
+			return nil, err
+		}
+
+		// Make sure the file we locked is still the one at lockPath
+		locked, err := file.Stat()
+		if err != nil {
+			file.Close()
+			return nil, err
+		}
+		if current, err := os.Stat(lockPath); err == nil && os.SameFile(locked, current) {
+			return func() { file.Close() }, nil
+		}
+		file.Close()
+	}
+}
+
+// Removes the lock file on daemon shutdown, unless another daemon has taken
+// it over in the meantime. Takes the spawn lock first, so a client that is
+// starting a replacement daemon never sees its lock file disappear.
+func RemoveOwnLockFile(projectRoot string, pid int) error {
+	unlock, err := LockSpawn(projectRoot)
+	if err != nil {
+		return err
+	}
+	defer unlock()
+
+	lockInfo, err := ReadLockFile(projectRoot)
+	if err != nil || lockInfo == nil || lockInfo.PID != pid {
+		return err
+	}
+	return RemoveLockFile(projectRoot)
+}
+
 // Checks whether a process with the given PID is still running on the system.
 // This is done by sending signal 0 to the process, which performs a permission
 // check without actually sending a signal. Returns false for invalid PIDs or
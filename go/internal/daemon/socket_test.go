@@ -0,0 +1,93 @@
+package daemon
+
+import (
+	"os"
+	"testing"
+	"time"
+)
+
+func TestLockSpawnSerializesClients(t *testing.T) {
+	projectRoot := t.TempDir()
+
+	unlock, err := LockSpawn(projectRoot)
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	acquired := make(chan func())
+	go func() {
+		unlock, err := LockSpawn(projectRoot)
+		if err != nil {
+			t.Error(err)
+		}
+		acquired <- unlock
+	}()
+
+	select {
+	case <-acquired:
+		t.Fatalf("second client got the spawn lock while the first held it")
+	case <-time.After(50 * time.Millisecond):
+	}
+
+	// The first client starts a daemon, which writes the lock file in place
+	if err := WriteLockFile(projectRoot, os.Getpid(), GetSocketPath(projectRoot)); err != nil {
+		t.Fatal(err)
+	}
+	unlock()
+
+	select {
+	case unlockSecond := <-acquired:
+		defer unlockSecond()
+	case <-time.After(time.Second):
+		t.Fatalf("second client never got the spawn lock")
+	}
+
+	// Once it has the lock, the second client finds the daemon
+	lockInfo, err := ReadLockFile(projectRoot)
+	if err != nil || lockInfo == nil || lockInfo.PID != os.Getpid() {
+		t.Errorf("expected the first client's daemon in the lock file, got %+v, %v", lockInfo, err)
+	}
+}
+
+func TestLockSpawnFollowsRemovedLockFile(t *testing.T) {
+	projectRoot := t.TempDir()
+
+	unlock, err := LockSpawn(projectRoot)
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	acquired := make(chan func())
+	go func() {
+		unlock, _ := LockSpawn(projectRoot)
+		acquired <- unlock
+	}()
+	time.Sleep(20 * time.Millisecond)
+
+	// A daemon shutting down removes the file the waiting client has open
+	RemoveLockFile(projectRoot)
+	unlock()
+
+	select {
+	case unlockSecond := <-acquired:
+		defer unlockSecond()
+	case <-time.After(time.Second):
+		t.Fatalf("waiting client never got the spawn lock")
+	}
+	if _, err := os.Stat(GetLockPath(projectRoot)); err != nil {
+		t.Errorf("expected the lock to be taken on a recreated lock file: %v", err)
+	}
+
+	// A third client must contend with the second one on the same file
+	third := make(chan func(), 1)
+	go func() {
+		unlock, _ := LockSpawn(projectRoot)
+		third <- unlock
+	}()
+	select {
+	case unlockThird := <-third:
+		unlockThird()
+		t.Fatalf("two clients held the spawn lock at once")
+	case <-time.After(50 * time.Millisecond):
+	}
+}
@@ -0,0 +1,217 @@
+package daemon
+
+import (
+	"context"
+	"fmt"
+	"os"
+	"strconv"
+	"sync"
+	"time"
+)
+
+// Startup phases, in order, as reported by the status command
+const (
+	PhaseConfiguring    = "configuring"     // Generating the compilation database
+	PhaseStartingClangd = "starting clangd" // Launching and initializing clangd
+	PhaseIndexing       = "indexing"        // Queries are served, clangd is still indexing
+	PhaseReady          = "ready"
+	PhaseFailed         = "failed"
+)
+
+// Readiness policies for queries that arrive before clangd is running, set
+// with the CLANGD_DAEMON_READINESS environment variable
+const (
+	ReadinessWait = "wait" // Queue the query until clangd is running or its deadline passes
+	ReadinessFail = "fail" // Fail the query immediately with the current phase
+)
+
+// ReadyFDEnv names the environment variable through which the client passes
+// the file descriptor of its readiness pipe. The daemon writes a single line
+// to it: "ready" once the socket accepts connections, or "error: <reason>" if
+// it exits before that.
+const ReadyFDEnv = "CLANGD_QUERY_READY_FD"
+
+// How long a daemon whose bring-up failed keeps answering queries with the
+// error before it exits, so clients see the reason instead of a dead socket
+const failedStartupGrace = 10 * time.Second
+
+// How long daemon shutdown waits for an unfinished bring-up to stop the
+// clangd it started
+const startupShutdownWait = 5 * time.Second
+
+// PhaseTiming is how long a completed startup phase took
+type PhaseTiming struct {
+	Phase    string `json:"phase"`
+	Duration string `json:"duration"`
+}
+
+// StartupStatus reports the progress of the daemon's bring-up for the status command
+type StartupStatus struct {
+	Phase     string        `json:"phase"`
+	Elapsed   string        `json:"elapsed"` // Time spent in the current phase
+	Error     string        `json:"error,omitempty"`
+	Readiness string        `json:"readiness"`
+	Phases    []PhaseTiming `json:"phases"` // Completed phases
+}
+
+// Startup tracks the phases of the daemon's bring-up. The socket accepts
+// connections from the start; queries that need clangd wait on ready.
+type Startup struct {
+	mu        sync.Mutex
+	phase     string
+	since     time.Time
+	phases    []PhaseTiming
+	err       error
+	readiness string
+	ready     chan struct{} // Closed once clangd is running or bring-up failed
+	done      chan struct{} // Closed when the bring-up goroutine returns
+}
+
+// Creates a startup tracker in the configuring phase
+func NewStartup(readiness string) *Startup {
+	return &Startup{
+		phase:     PhaseConfiguring,
+		since:     time.Now(),
+		readiness: readiness,
+		ready:     make(chan struct{}),
+		done:      make(chan struct{}),
+	}
+}
+
+// Ends the current phase and starts the next one
+func (s *Startup) setPhase(phase string) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	if s.phase == phase {
+		return
+	}
+	now := time.Now()
+	s.phases = append(s.phases, PhaseTiming{
+		Phase:    s.phase,
+		Duration: now.Sub(s.since).Round(time.Millisecond).String(),
+	})
+	s.phase = phase
+	s.since = now
+}
+
+// Marks clangd as running, releasing all waiting queries
+func (s *Startup) markReady() {
+	s.setPhase(PhaseIndexing)
+	close(s.ready)
+}
+
+// Marks the bring-up as failed. Waiting queries fail with err.
+func (s *Startup) fail(err error) {
+	s.mu.Lock()
+	s.err = err
+	s.mu.Unlock()
+	s.setPhase(PhaseFailed)
+	close(s.ready)
+}
+
+// Returns true once clangd is running
+func (s *Startup) isReady() bool {
+	select {
+	case <-s.ready:
+		return s.Err() == nil
+	default:
+		return false
+	}
+}
+
+// Returns the bring-up error, if it failed
+func (s *Startup) Err() error {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	return s.err
+}
+
+// Returns the current phase
+func (s *Startup) Phase() string {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	return s.phase
+}
+
+// Waits until clangd is running, as the readiness policy dictates. Returns
+// an error naming the current phase if the query can't be served.
+func (s *Startup) wait(ctx context.Context) error {
+	select {
+	case <-s.ready:
+		return s.readyErr()
+	default:
+	}
+
+	if s.readiness == ReadinessFail {
+		return fmt.Errorf("daemon is still starting (%s), try again shortly", s.Phase())
+	}
+
+	select {
+	case <-s.ready:
+		return s.readyErr()
+	case <-ctx.Done():
+		return fmt.Errorf("daemon is still starting (%s): %v", s.Phase(), ctx.Err())
+	}
+}
+
+func (s *Startup) readyErr() error {
+	if err := s.Err(); err != nil {
+		return fmt.Errorf("daemon failed to start: %v", err)
+	}
+	return nil
+}
+
+// Returns startup progress for the status command
+func (s *Startup) Status() StartupStatus {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	status := StartupStatus{
+		Phase:     s.phase,
+		Elapsed:   time.Since(s.since).Round(time.Millisecond).String(),
+		Readiness: s.readiness,
+		Phases:    append([]PhaseTiming(nil), s.phases...),
+	}
+	if s.err != nil {
+		status.Error = s.err.Error()
+	}
+	return status
+}
+
+// Returns the readiness policy from the CLANGD_DAEMON_READINESS environment
+// variable, waiting by default
+func getReadinessPolicy() string {
+	if os.Getenv("CLANGD_DAEMON_READINESS") == ReadinessFail {
+		return ReadinessFail
+	}
+	return ReadinessWait
+}
+
+// Tells the client that started this daemon whether it is accepting
+// connections. Does nothing if the daemon wasn't started with a readiness
+// pipe, or after the first call.
+func notifyStarted(err error) {
+	value := os.Getenv(ReadyFDEnv)
+	if value == "" {
+		return
+	}
+	// Neither clangd nor cmake should inherit the variable
+	os.Unsetenv(ReadyFDEnv)
+
+	fd, convErr := strconv.Atoi(value)
+	if convErr != nil {
+		return
+	}
+	pipe := os.NewFile(uintptr(fd), "ready")
+	if pipe == nil {
+		return
+	}
+	defer pipe.Close()
+
+	if err != nil {
+		fmt.Fprintf(pipe, "error: %v\n", err)
+	} else {
+		fmt.Fprintln(pipe, "ready")
+	}
+}
@@ -0,0 +1,98 @@
+package daemon
+
+import (
+	"bufio"
+	"context"
+	"errors"
+	"fmt"
+	"os"
+	"strings"
+	"syscall"
+	"testing"
+	"time"
+)
+
+func TestStartupWaitPolicyQueuesUntilReady(t *testing.T) {
+	s := NewStartup(ReadinessWait)
+
+	// A query whose deadline passes during startup names the phase
+	ctx, cancel := context.WithTimeout(context.Background(), 10*time.Millisecond)
+	defer cancel()
+	if err := s.wait(ctx); err == nil || !strings.Contains(err.Error(), PhaseConfiguring) {
+		t.Fatalf("expected error naming the configuring phase, got %v", err)
+	}
+
+	errs := make(chan error, 1)
+	go func() {
+		errs <- s.wait(context.Background())
+	}()
+
+	s.setPhase(PhaseStartingClangd)
+	s.markReady()
+
+	select {
+	case err := <-errs:
+		if err != nil {
+			t.Fatalf("expected queued query to proceed, got %v", err)
+		}
+	case <-time.After(time.Second):
+		t.Fatalf("queued query not released when clangd became ready")
+	}
+
+	status := s.Status()
+	if status.Phase != PhaseIndexing || len(status.Phases) != 2 {
+		t.Errorf("unexpected status: %+v", status)
+	}
+}
+
+func TestStartupFailPolicyFailsFast(t *testing.T) {
+	s := NewStartup(ReadinessFail)
+	s.setPhase(PhaseStartingClangd)
+
+	start := time.Now()
+	err := s.wait(context.Background())
+	if err == nil || !strings.Contains(err.Error(), PhaseStartingClangd) {
+		t.Fatalf("expected error naming the phase, got %v", err)
+	}
+	if time.Since(start) > 100*time.Millisecond {
+		t.Errorf("fail policy should not wait")
+	}
+}
+
+func TestStartupFailureReachesQueuedQueries(t *testing.T) {
+	s := NewStartup(ReadinessWait)
+	s.fail(errors.New("cmake not found"))
+
+	if err := s.wait(context.Background()); err == nil || !strings.Contains(err.Error(), "cmake not found") {
+		t.Fatalf("expected bring-up error, got %v", err)
+	}
+	if status := s.Status(); status.Phase != PhaseFailed || status.Error != "cmake not found" {
+		t.Errorf("unexpected status: %+v", status)
+	}
+}
+
+func TestNotifyStartedWritesToReadyPipe(t *testing.T) {
+	reader, writer, err := os.Pipe()
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer reader.Close()
+
+	// notifyStarted takes ownership of the descriptor, like the daemon does of fd 3
+	fd, err := syscall.Dup(int(writer.Fd()))
+	if err != nil {
+		t.Fatal(err)
+	}
+	writer.Close()
+
+	t.Setenv(ReadyFDEnv, fmt.Sprint(fd))
+	notifyStarted(nil)
+
+	line, err := bufio.NewReader(reader).ReadString('\n')
+	if err != nil || line != "ready\n" {
+		t.Fatalf("expected ready message, got %q, %v", line, err)
+	}
+	if os.Getenv(ReadyFDEnv) != "" {
+		t.Errorf("expected the variable to be cleared so child processes don't inherit it")
+	}
+}
@@ -1,87 +1,415 @@
 package daemon
 
 import (
+	"errors"
 	"os"
 	"path/filepath"
+	"sort"
+	"strconv"
 	"strings"
 	"sync"
+	"syscall"
 	"time"
 
+	"clangd-query/internal/clangd"
 	"clangd-query/internal/logger"
 	"github.com/fsnotify/fsnotify"
 )
 
-// FileWatcher watches for changes in C++ source files
+// How often polled directories are scanned for changes
+const pollInterval = 2 * time.Second
+
+const (
+	// Changes are delivered once no file changed for this long
+	debounceDelay = 500 * time.Millisecond
+
+	// Quiet period during bulk changes like a branch switch, so a checkout
+	// that takes seconds ends up in a single batch
+	bulkDebounceDelay = 2 * time.Second
+
+	// A batch is delivered at the latest this long after its first change,
+	// even if files keep changing
+	maxBatchDelay = 10 * time.Second
+
+	// Number of changes in a batch from which it counts as bulk
+	bulkChangeThreshold = 100
+)
+
+// Watch modes. CLANGD_DAEMON_WATCHER=poll forces polling, e.g. for network
+// file systems that don't support inotify.
+const (
+	WatchModeNotify = "inotify"
+	WatchModePoll   = "poll"
+	WatchModeMixed  = "inotify+poll" // The inotify watch limit was reached
+)
+
+// Watch scopes
+const (
+	WatchScopeDatabase = "compilation database" // Directories of compiled files and their include paths
+	WatchScopeProject  = "project"              // The whole project, without a compilation database
+)
+
+// Compiler flags whose argument is an include directory
+var includeFlags = []string{"-isystem", "-iquote", "-idirafter", "-I"}
+
+// WatcherStatus reports the scope and cost of file watching for the status command
+type WatcherStatus struct {
+	Mode               string `json:"mode"`
+	Scope              string `json:"scope"`
+	WatchedDirectories int    `json:"watchedDirectories"` // With inotify
+	PolledDirectories  int    `json:"polledDirectories"`
+	IgnoredDirectories int    `json:"ignoredDirectories"` // Skipped because of .gitignore or as build directories
+	SetupTime          string `json:"setupTime"`
+	WatchLimitReached  bool   `json:"watchLimitReached"`
+	MaxUserWatches     int    `json:"maxUserWatches,omitempty"`
+	PollInterval       string `json:"pollInterval,omitempty"`
+	HashedFiles        int    `json:"hashedFiles"` // Files with a known content hash
+	Suppressed         int64  `json:"suppressed"`  // Changes dropped because the content didn't change
+	Batches            int    `json:"batches"`     // Batches of changes delivered to clangd
+	BulkBatches        int    `json:"bulkBatches"` // Of those, after branch switches or other bulk changes
+	LastBatch          int    `json:"lastBatch"`   // Number of changes in the last batch
+}
+
+// Modification time and size of a file, compared between polls
+type fileStamp struct {
+	modTime time.Time
+	size    int64
+}
+
+// FileWatcher watches for changes in C++ source files and CMake files. Only
+// directories that matter to clangd are watched: those containing files of
+// the compilation database, their parents up to the project root (for the
+// CMakeLists.txt files), and the project's include directories with all
+// their subdirectories. Directories excluded by .gitignore are skipped. When
+// the inotify watch limit is reached, the remaining directories are polled
+// for modification time changes instead.
 type FileWatcher struct {
-	watcher       *fsnotify.Watcher
-	projectRoot   string
-	onChange      func([]string)
-	debounceTimer *time.Timer
+	watcher     *fsnotify.Watcher // nil if inotify is unavailable or polling is forced
+	projectRoot string
+	onChange    func([]clangd.FileChange)
+	gitHead     string // .git/HEAD, which changes on branch switches
+	stop        chan struct{}
+	logger      logger.Logger
+	gitignore   *Gitignore
+	hashes      *ContentHashes
+
+	mu           sync.Mutex
+	scope        string
+	trees        map[string]bool                 // Directories whose new subdirectories are watched too
+	watched      map[string]bool                 // Directories watched with inotify
+	polled       map[string]map[string]fileStamp // Polled directories and the files last seen in them
+	polling      bool                            // New directories are polled
+	limitReached bool
+	ignored      map[string]bool // Directories skipped as ignored or build directories
+	setupTime    time.Duration
+
+	// The batch of changes being collected
 	debounceMu    sync.Mutex
-	changedFiles  map[string]bool
-	stop          chan struct{}
-	logger        logger.Logger
+	debounceTimer *time.Timer
+	pending       map[string]clangd.FileChangeType
+	batchStart    time.Time
+	batchEvents   int
+	bulk          bool // HEAD changed or many files changed in this batch
+	headStamp     fileStamp
+	batches       int
+	bulkBatches   int
+	lastBatch     int
 }
 
-// NewFileWatcher creates a new file watcher
-func NewFileWatcher(projectRoot string, onChange func([]string), log logger.Logger) (*FileWatcher, error) {
-	watcher, err := fsnotify.NewWatcher()
-	if err != nil {
-		return nil, err
-	}
-
+// NewFileWatcher creates a new file watcher for the directories referenced
+// by the compile_commands.json in databaseDir. Without a readable database
+// the whole project is watched.
+func NewFileWatcher(projectRoot string, databaseDir string, onChange func([]clangd.FileChange), log logger.Logger) (*FileWatcher, error) {
+	begin := time.Now()
 	fw := &FileWatcher{
-		watcher:      watcher,
-		projectRoot:  projectRoot,
-		onChange:     onChange,
-		changedFiles: make(map[string]bool),
-		stop:         make(chan struct{}),
-		logger:       log,
+		projectRoot: projectRoot,
+		onChange:    onChange,
+		pending:     make(map[string]clangd.FileChangeType),
+		stop:        make(chan struct{}),
+		logger:      log,
+		gitignore:   NewGitignore(projectRoot),
+		hashes:      NewContentHashes(),
+		trees:       make(map[string]bool),
+		watched:     make(map[string]bool),
+		polled:      make(map[string]map[string]fileStamp),
+		ignored:     make(map[string]bool),
+		polling:     os.Getenv("CLANGD_DAEMON_WATCHER") == WatchModePoll,
 	}
 
-	// Add project root and subdirectories
-	if err := fw.addDirectoryRecursive(projectRoot); err != nil {
-		watcher.Close()
-		return nil, err
+	if !fw.polling {
+		watcher, err := fsnotify.NewWatcher()
+		if err != nil {
+			// Usually the limit of inotify instances per user
+			log.Info("Warning: inotify unavailable (%v), polling for file changes every %s", err, pollInterval)
+			fw.polling = true
+		} else {
+			fw.watcher = watcher
+		}
 	}
 
+	fw.AddScope(databaseDir)
+	fw.watchGitHead()
+	fw.mu.Lock()
+	fw.setupTime = time.Since(begin)
+	status := fw.statusLocked()
+	fw.mu.Unlock()
+	log.Info("Watching %d directories with inotify and polling %d (%s scope, %d ignored) after %s",
+		status.WatchedDirectories, status.PolledDirectories, status.Scope, status.IgnoredDirectories, status.SetupTime)
+
 	// Start watching
-	go fw.watch()
+	if fw.watcher != nil {
+		go fw.watch()
+	}
+	go fw.poll()
 
 	return fw, nil
 }
 
+// Adds the directories referenced by the compile_commands.json in
+// databaseDir to the watch, e.g. after it was regenerated. Directories that
+// are already watched stay watched.
+func (fw *FileWatcher) AddScope(databaseDir string) {
+	var commands map[string]clangd.CompileCommand
+	if databaseDir != "" {
+		var err error
+		if commands, err = loadCompileCommands(databaseDir); err != nil {
+			fw.logger.Info("Warning: failed to read compile_commands.json, watching the whole project: %v", err)
+		}
+	}
+
+	if len(commands) == 0 {
+		fw.setScope(WatchScopeProject)
+		fw.addTree(fw.projectRoot)
+		return
+	}
+
+	fw.setScope(WatchScopeDatabase)
+	dirs, trees := watchScope(fw.projectRoot, commands)
+	for _, dir := range dirs {
+		if fw.gitignore.Ignored(dir, true) {
+			fw.skip(dir)
+			continue
+		}
+		fw.addDirectory(dir)
+	}
+	for _, tree := range trees {
+		fw.addTree(tree)
+	}
+}
+
+func (fw *FileWatcher) setScope(scope string) {
+	fw.mu.Lock()
+	defer fw.mu.Unlock()
+	// Once the whole project is watched, it stays watched
+	if fw.scope != WatchScopeProject {
+		fw.scope = scope
+	}
+}
+
+func (fw *FileWatcher) skip(dir string) {
+	fw.mu.Lock()
+	fw.ignored[dir] = true
+	fw.mu.Unlock()
+}
+
+// Returns the directories to watch for a compilation database: those of its
+// files and their parents up to the project root, which are watched without
+// subdirectories, and the include directories inside the project, which are
+// watched with all subdirectories
+func watchScope(projectRoot string, commands map[string]clangd.CompileCommand) (dirs []string, trees []string) {
+	seenDirs := make(map[string]bool)
+	seenTrees := make(map[string]bool)
+
+	for file, command := range commands {
+		for dir := filepath.Dir(file); isWithin(dir, projectRoot) && !seenDirs[dir]; dir = filepath.Dir(dir) {
+			seenDirs[dir] = true
+			dirs = append(dirs, dir)
+		}
+
+		for _, include := range includeDirectories(command) {
+			if !filepath.IsAbs(include) {
+				include = filepath.Join(command.WorkingDirectory, include)
+			}
+			include = filepath.Clean(include)
+			if isWithin(include, projectRoot) && !seenTrees[include] {
+				seenTrees[include] = true
+				trees = append(trees, include)
+			}
+		}
+	}
+
+	sort.Strings(dirs)
+	sort.Strings(trees)
+	return dirs, trees
+}
+
+// Returns the include directories of a compile command, as given
+func includeDirectories(command clangd.CompileCommand) []string {
+	var dirs []string
+	args := command.CompilationCommand
+	for i := 0; i < len(args); i++ {
+		for _, flag := range includeFlags {
+			if !strings.HasPrefix(args[i], flag) {
+				continue
+			}
+			if dir := args[i][len(flag):]; dir != "" {
+				dirs = append(dirs, dir)
+			} else if i+1 < len(args) {
+				i++
+				dirs = append(dirs, args[i])
+			}
+			break
+		}
+	}
+	return dirs
+}
+
+// Adds a directory and all subdirectories that aren't ignored to the watch.
+// Directories created in it later are added as well.
+func (fw *FileWatcher) addTree(root string) {
+	fw.mu.Lock()
+	fw.trees[root] = true
+	fw.mu.Unlock()
+	fw.addDirectoryRecursive(root)
+}
+
 // addDirectoryRecursive adds a directory and all subdirectories to the watcher
-func (fw *FileWatcher) addDirectoryRecursive(dir string) error {
-	return filepath.Walk(dir, func(path string, info os.FileInfo, err error) error {
+func (fw *FileWatcher) addDirectoryRecursive(dir string) {
+	filepath.Walk(dir, func(path string, info os.FileInfo, err error) error {
 		if err != nil {
 			return nil // Ignore errors walking the tree
 		}
+		if !info.IsDir() {
+			return nil
+		}
 
-		// Skip hidden directories and build directories
-		if info.IsDir() {
-			base := filepath.Base(path)
-			if strings.HasPrefix(base, ".") ||
-				base == "build" ||
-				base == "cmake-build-debug" ||
-				base == "cmake-build-release" ||
-				base == "out" ||
-				base == "bin" ||
-				base == "obj" {
+		// Skip hidden directories, build directories and ignored directories
+		if isSkippedDirectory(filepath.Base(path)) || fw.gitignore.Ignored(path, true) {
+			if path != fw.projectRoot {
+				fw.skip(path)
 				return filepath.SkipDir
 			}
-
-			// Add directory to watcher
-			if err := fw.watcher.Add(path); err != nil {
-				// Ignore errors adding individual directories
-				fw.logger.Info("Warning: failed to watch %s: %v", path, err)
-			}
 		}
 
+		fw.addDirectory(path)
 		return nil
 	})
 }
 
+// Watches a single directory, without subdirectories. Falls back to polling
+// once the inotify watch limit is reached.
+func (fw *FileWatcher) addDirectory(dir string) {
+	fw.mu.Lock()
+	defer fw.mu.Unlock()
+
+	if fw.watched[dir] || fw.polled[dir] != nil {
+		return
+	}
+
+	if !fw.polling {
+		err := fw.watcher.Add(dir)
+		if err == nil {
+			fw.watched[dir] = true
+			return
+		}
+		if !errors.Is(err, syscall.ENOSPC) {
+			// Ignore errors adding individual directories
+			fw.logger.Info("Warning: failed to watch %s: %v", dir, err)
+			return
+		}
+		fw.logger.Info("Warning: inotify watch limit (fs.inotify.max_user_watches = %d) reached after %d directories, polling the rest every %s",
+			readMaxUserWatches(), len(fw.watched), pollInterval)
+		fw.polling = true
+		fw.limitReached = true
+	}
+
+	fw.polled[dir] = snapshotDirectory(dir)
+}
+
+// Returns true if new subdirectories of dir are watched
+func (fw *FileWatcher) inTree(dir string) bool {
+	fw.mu.Lock()
+	defer fw.mu.Unlock()
+	for tree := range fw.trees {
+		if isWithin(dir, tree) {
+			return true
+		}
+	}
+	return false
+}
+
+// Returns the C++ and CMake files of a directory with their modification
+// times and sizes
+func snapshotDirectory(dir string) map[string]fileStamp {
+	snapshot := make(map[string]fileStamp)
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		return snapshot
+	}
+	for _, entry := range entries {
+		path := filepath.Join(dir, entry.Name())
+		if entry.IsDir() || !(isCppFile(path) || isCMakeFile(path)) {
+			continue
+		}
+		if info, err := entry.Info(); err == nil {
+			snapshot[path] = fileStamp{modTime: info.ModTime(), size: info.Size()}
+		}
+	}
+	return snapshot
+}
+
+// Returns the inotify watch limit, or 0 if it can't be read
+func readMaxUserWatches() int {
+	data, err := os.ReadFile("/proc/sys/fs/inotify/max_user_watches")
+	if err != nil {
+		return 0
+	}
+	limit, _ := strconv.Atoi(strings.TrimSpace(string(data)))
+	return limit
+}
+
+// Watches .git/HEAD, so branch switches are recognized as bulk changes.
+// git replaces HEAD by renaming a lock file, so its directory is watched.
+func (fw *FileWatcher) watchGitHead() {
+	gitDir := filepath.Join(fw.projectRoot, ".git")
+	if info, err := os.Stat(gitDir); err != nil || !info.IsDir() {
+		return // Not a git checkout, or a worktree whose .git is a file
+	}
+	fw.gitHead = filepath.Join(gitDir, "HEAD")
+	fw.headStamp = statStamp(fw.gitHead)
+
+	if fw.watcher != nil {
+		if err := fw.watcher.Add(gitDir); err != nil {
+			fw.logger.Info("Warning: failed to watch %s: %v", gitDir, err)
+		}
+	}
+}
+
+// Returns the modification time and size of a file, or zero if it is missing
+func statStamp(path string) fileStamp {
+	info, err := os.Stat(path)
+	if err != nil {
+		return fileStamp{}
+	}
+	return fileStamp{modTime: info.ModTime(), size: info.Size()}
+}
+
+// Returns the type of change an inotify event means for a file, and false
+// for events that don't change its content
+func changeType(op fsnotify.Op) (clangd.FileChangeType, bool) {
+	switch {
+	case op&(fsnotify.Remove|fsnotify.Rename) != 0:
+		// A renamed file is gone under its old name; the new name gets a Create
+		return clangd.FileChangeTypeDeleted, true
+	case op&fsnotify.Create != 0:
+		return clangd.FileChangeTypeCreated, true
+	case op&fsnotify.Write != 0:
+		return clangd.FileChangeTypeChanged, true
+	default:
+		return 0, false
+	}
+}
+
 // watch handles file system events
 func (fw *FileWatcher) watch() {
 	for {
@@ -91,17 +419,22 @@ func (fw *FileWatcher) watch() {
 				return
 			}
 
-			// Check if it's a C++ file
-			if fw.isCppFile(event.Name) {
-				if event.Op&(fsnotify.Write|fsnotify.Create) != 0 {
-					fw.handleFileChange(event.Name)
+			if event.Name == fw.gitHead {
+				fw.handleBranchSwitch()
+				continue
+			}
+
+			// Check if it's a C++ or CMake file
+			if isCppFile(event.Name) || isCMakeFile(event.Name) {
+				if typ, ok := changeType(event.Op); ok {
+					fw.handleFileChange(event.Name, typ)
 				}
 			}
 
-			// If a new directory was created, add it to the watcher
+			// If a new directory was created in a watched tree, add it to the watcher
 			if event.Op&fsnotify.Create != 0 {
-				if info, err := os.Stat(event.Name); err == nil && info.IsDir() {
-					fw.addDirectoryRecursive(event.Name)
+				if info, err := os.Stat(event.Name); err == nil && info.IsDir() && fw.inTree(event.Name) {
+					fw.addNewDirectory(event.Name)
 				}
 			}
 
@@ -117,43 +450,252 @@ func (fw *FileWatcher) watch() {
 	}
 }
 
-// handleFileChange handles a file change event with debouncing
-func (fw *FileWatcher) handleFileChange(path string) {
+// poll scans the polled directories for changed files until the watcher stops
+func (fw *FileWatcher) poll() {
+	ticker := time.NewTicker(pollInterval)
+	defer ticker.Stop()
+
+	for {
+		select {
+		case <-ticker.C:
+			fw.pollOnce()
+		case <-fw.stop:
+			return
+		}
+	}
+}
+
+func (fw *FileWatcher) pollOnce() {
+	fw.mu.Lock()
+	dirs := make([]string, 0, len(fw.polled))
+	for dir := range fw.polled {
+		dirs = append(dirs, dir)
+	}
+	fw.mu.Unlock()
+
+	for _, dir := range dirs {
+		snapshot := snapshotDirectory(dir)
+
+		fw.mu.Lock()
+		previous := fw.polled[dir]
+		fw.polled[dir] = snapshot
+		fw.mu.Unlock()
+
+		for path, stamp := range snapshot {
+			if old, ok := previous[path]; !ok {
+				fw.handleFileChange(path, clangd.FileChangeTypeCreated)
+			} else if old != stamp {
+				fw.handleFileChange(path, clangd.FileChangeTypeChanged)
+			}
+		}
+		for path := range previous {
+			if _, ok := snapshot[path]; !ok {
+				fw.handleFileChange(path, clangd.FileChangeTypeDeleted)
+			}
+		}
+
+		// New directories in polled trees
+		if !fw.inTree(dir) {
+			continue
+		}
+		entries, _ := os.ReadDir(dir)
+		for _, entry := range entries {
+			if !entry.IsDir() {
+				continue
+			}
+			sub := filepath.Join(dir, entry.Name())
+			fw.mu.Lock()
+			known := fw.watched[sub] || fw.polled[sub] != nil
+			fw.mu.Unlock()
+			if !known && !isSkippedDirectory(entry.Name()) && !fw.gitignore.Ignored(sub, true) {
+				fw.addNewDirectory(sub)
+			}
+		}
+	}
+
+	// Without inotify, branch switches are noticed here
+	if fw.watcher == nil && fw.gitHead != "" {
+		if stamp := statStamp(fw.gitHead); stamp != fw.headStamp {
+			fw.headStamp = stamp
+			fw.handleBranchSwitch()
+		}
+	}
+}
+
+// Watches a directory that was created while the daemon runs. Its files may
+// have been written before the watch was in place, so they are reported as
+// created.
+func (fw *FileWatcher) addNewDirectory(dir string) {
+	fw.addDirectoryRecursive(dir)
+
+	filepath.WalkDir(dir, func(path string, entry os.DirEntry, err error) error {
+		if err != nil {
+			return nil
+		}
+		if entry.IsDir() {
+			if path != dir && (isSkippedDirectory(entry.Name()) || fw.gitignore.Ignored(path, true)) {
+				return filepath.SkipDir
+			}
+			return nil
+		}
+		if isCppFile(path) || isCMakeFile(path) {
+			fw.handleFileChange(path, clangd.FileChangeTypeCreated)
+		}
+		return nil
+	})
+}
+
+// handleFileChange adds a change to the current batch. A batch is delivered
+// once files stop changing for debounceDelay, or bulkDebounceDelay during a
+// branch switch or other bulk change, and at the latest after maxBatchDelay.
+func (fw *FileWatcher) handleFileChange(path string, typ clangd.FileChangeType) {
 	fw.debounceMu.Lock()
 	defer fw.debounceMu.Unlock()
 
-	// Add to changed files
-	fw.changedFiles[path] = true
+	if len(fw.pending) == 0 && fw.batchEvents == 0 {
+		fw.batchStart = time.Now()
+	}
+	fw.batchEvents++
+	if fw.batchEvents >= bulkChangeThreshold {
+		fw.bulk = true
+	}
+
+	// Several events for a file within a batch add up to one change
+	if previous, ok := fw.pending[path]; ok {
+		if merged, ok := mergeChanges(previous, typ); ok {
+			fw.pending[path] = merged
+		} else {
+			delete(fw.pending, path)
+		}
+	} else {
+		fw.pending[path] = typ
+	}
+
+	fw.scheduleBatchLocked()
+}
+
+// Notes a change of .git/HEAD. The files of a branch switch are collected
+// with the longer bulk delay, so they reach clangd as a single batch.
+func (fw *FileWatcher) handleBranchSwitch() {
+	fw.debounceMu.Lock()
+	defer fw.debounceMu.Unlock()
+
+	fw.logger.Debug("Branch switch detected, batching file changes")
+	if len(fw.pending) == 0 && fw.batchEvents == 0 {
+		fw.batchStart = time.Now()
+	}
+	fw.bulk = true
+	fw.scheduleBatchLocked()
+}
+
+// Returns the net change of two consecutive changes to a file, and false if
+// they cancel out
+func mergeChanges(previous, next clangd.FileChangeType) (clangd.FileChangeType, bool) {
+	switch previous {
+	case clangd.FileChangeTypeCreated:
+		if next == clangd.FileChangeTypeDeleted {
+			return 0, false // Never existed as far as clangd knows
+		}
+		return clangd.FileChangeTypeCreated, true
+	case clangd.FileChangeTypeDeleted:
+		if next == clangd.FileChangeTypeDeleted {
+			return clangd.FileChangeTypeDeleted, true
+		}
+		return clangd.FileChangeTypeChanged, true // Replaced, e.g. by an editor's atomic save
+	default:
+		if next == clangd.FileChangeTypeDeleted {
+			return clangd.FileChangeTypeDeleted, true
+		}
+		return clangd.FileChangeTypeChanged, true
+	}
+}
+
+// (Re)starts the timer that delivers the current batch. Must be called with
+// fw.debounceMu held.
+func (fw *FileWatcher) scheduleBatchLocked() {
+	delay := debounceDelay
+	if fw.bulk {
+		delay = bulkDebounceDelay
+	}
+	if remaining := maxBatchDelay - time.Since(fw.batchStart); delay > remaining {
+		delay = remaining
+	}
 
 	// Cancel existing timer
 	if fw.debounceTimer != nil {
 		fw.debounceTimer.Stop()
 	}
+	fw.debounceTimer = time.AfterFunc(delay, fw.deliverBatch)
+}
 
-	// Start new timer
-	fw.debounceTimer = time.AfterFunc(500*time.Millisecond, func() {
-		fw.debounceMu.Lock()
+// Records the content hash of a file in the background, so a later event
+// that doesn't change its content can be dropped. Called for the files
+// queries use, which are the ones whose ASTs are expensive to lose.
+func (fw *FileWatcher) Track(path string) {
+	fw.hashes.Track(path)
+}
 
-		// Collect all changed files
-		files := make([]string, 0, len(fw.changedFiles))
-		for file := range fw.changedFiles {
-			files = append(files, file)
+// Drops changes to files whose content hash is the same as before
+func (fw *FileWatcher) dropUnchanged(changes []clangd.FileChange) []clangd.FileChange {
+	kept := changes[:0]
+	for _, change := range changes {
+		switch change.Type {
+		case clangd.FileChangeTypeDeleted:
+			fw.hashes.Forget(change.Path)
+		case clangd.FileChangeTypeCreated:
+			fw.hashes.Changed(change.Path) // Records the hash
+		default:
+			if !fw.hashes.Changed(change.Path) {
+				continue
+			}
 		}
+		kept = append(kept, change)
+	}
+	return kept
+}
+
+// Delivers the collected changes in one call, sorted by path
+func (fw *FileWatcher) deliverBatch() {
+	fw.debounceMu.Lock()
 
-		// Clear the map
-		fw.changedFiles = make(map[string]bool)
+	changes := make([]clangd.FileChange, 0, len(fw.pending))
+	for path, typ := range fw.pending {
+		changes = append(changes, clangd.FileChange{Path: path, Type: typ})
+	}
+	sort.Slice(changes, func(i, j int) bool { return changes[i].Path < changes[j].Path })
 
-		fw.debounceMu.Unlock()
+	bulk := fw.bulk
+	events := fw.batchEvents
+	fw.pending = make(map[string]clangd.FileChangeType)
+	fw.batchEvents = 0
+	fw.bulk = false
 
-		// Call the callback
-		if len(files) > 0 {
-			fw.onChange(files)
+	fw.debounceMu.Unlock()
+
+	// Hash outside of the lock, as a branch switch can touch thousands of files
+	changes = fw.dropUnchanged(changes)
+
+	fw.debounceMu.Lock()
+	if len(changes) > 0 {
+		fw.batches++
+		fw.lastBatch = len(changes)
+		if bulk {
+			fw.bulkBatches++
 		}
-	})
+	}
+	fw.debounceMu.Unlock()
+
+	// Call the callback
+	if len(changes) > 0 {
+		if bulk {
+			fw.logger.Info("Delivering %d changed files to clangd in one batch (%d events)", len(changes), events)
+		}
+		fw.onChange(changes)
+	}
 }
 
 // isCppFile checks if a file is a C++ source or header file
-func (fw *FileWatcher) isCppFile(path string) bool {
+func isCppFile(path string) bool {
 	ext := strings.ToLower(filepath.Ext(path))
 	switch ext {
 	case ".cpp", ".cc", ".cxx", ".c++",
@@ -165,6 +707,50 @@ func (fw *FileWatcher) isCppFile(path string) bool {
 	}
 }
 
+// isCMakeFile checks if a file is part of the CMake configuration, which
+// changes the compilation database
+func isCMakeFile(path string) bool {
+	base := filepath.Base(path)
+	return base == "CMakeLists.txt" || base == "CMakePresets.json" || strings.HasSuffix(base, ".cmake")
+}
+
+// Returns the watch scope and cost for the status command
+func (fw *FileWatcher) Status() WatcherStatus {
+	fw.mu.Lock()
+	defer fw.mu.Unlock()
+	return fw.statusLocked()
+}
+
+func (fw *FileWatcher) statusLocked() WatcherStatus {
+	status := WatcherStatus{
+		Mode:               WatchModeNotify,
+		Scope:              fw.scope,
+		WatchedDirectories: len(fw.watched),
+		PolledDirectories:  len(fw.polled),
+		IgnoredDirectories: len(fw.ignored),
+		SetupTime:          fw.setupTime.Round(time.Millisecond).String(),
+		WatchLimitReached:  fw.limitReached,
+	}
+	if fw.limitReached {
+		status.Mode = WatchModeMixed
+		status.MaxUserWatches = readMaxUserWatches()
+	} else if fw.polling {
+		status.Mode = WatchModePoll
+	}
+	if len(fw.polled) > 0 {
+		status.PollInterval = pollInterval.String()
+	}
+
+	status.HashedFiles, status.Suppressed = fw.hashes.Stats()
+
+	fw.debounceMu.Lock()
+	status.Batches = fw.batches
+	status.BulkBatches = fw.bulkBatches
+	status.LastBatch = fw.lastBatch
+	fw.debounceMu.Unlock()
+	return status
+}
+
 // Stop stops the file watcher
 func (fw *FileWatcher) Stop() error {
 	close(fw.stop)
@@ -175,5 +761,8 @@ func (fw *FileWatcher) Stop() error {
 	}
 	fw.debounceMu.Unlock()
 
+	if fw.watcher == nil {
+		return nil
+	}
 	return fw.watcher.Close()
 }
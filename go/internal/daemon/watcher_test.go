@@ -0,0 +1,219 @@
+package daemon
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"reflect"
+	"sort"
+	"testing"
+	"time"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/logger"
+)
+
+func TestWatchScope(t *testing.T) {
+	root := "/project"
+	commands := map[string]clangd.CompileCommand{
+		"/project/src/engine/engine.cpp": {
+			WorkingDirectory:   "/project/build",
+			CompilationCommand: []string{"c++", "-I/project/include", "-isystem", "../third_party/include", "-I/usr/include", "-c", "engine.cpp"},
+		},
+		"/project/src/main.cpp": {
+			WorkingDirectory:   "/project/build",
+			CompilationCommand: []string{"c++", "-I", "/project/include", "-iquote../src", "-c", "main.cpp"},
+		},
+		"/elsewhere/other.cpp": {
+			WorkingDirectory:   "/elsewhere",
+			CompilationCommand: []string{"c++", "-c", "other.cpp"},
+		},
+	}
+
+	dirs, trees := watchScope(root, commands)
+	wantDirs := []string{"/project", "/project/src", "/project/src/engine"}
+	wantTrees := []string{"/project/include", "/project/src", "/project/third_party/include"}
+	if !reflect.DeepEqual(dirs, wantDirs) {
+		t.Errorf("dirs = %v, want %v", dirs, wantDirs)
+	}
+	if !reflect.DeepEqual(trees, wantTrees) {
+		t.Errorf("trees = %v, want %v", trees, wantTrees)
+	}
+}
+
+// Creates a project whose compilation database lists src/main.cpp with
+// include/ as include directory, next to an unrelated, ignored and build
+// directory
+func newWatchedProject(t *testing.T) string {
+	t.Helper()
+	root := t.TempDir()
+	for _, dir := range []string{"src", "include/engine", "docs/images", "generated/src", "build"} {
+		if err := os.MkdirAll(filepath.Join(root, dir), 0755); err != nil {
+			t.Fatal(err)
+		}
+	}
+	writeFile(t, filepath.Join(root, ".gitignore"), "generated/\n")
+	writeFile(t, filepath.Join(root, "src", "main.cpp"), "int main() {}")
+	writeFile(t, filepath.Join(root, "build", "compile_commands.json"), `[
+		{"directory": "`+root+`/build", "file": "../src/main.cpp", "arguments": ["c++", "-I../include", "-c", "../src/main.cpp"]},
+		{"directory": "`+root+`/build", "file": "`+root+`/generated/src/gen.cpp", "arguments": ["c++", "-c", "gen.cpp"]}
+	]`)
+	return root
+}
+
+func watchedDirectories(fw *FileWatcher) []string {
+	fw.mu.Lock()
+	defer fw.mu.Unlock()
+	var dirs []string
+	for dir := range fw.watched {
+		dirs = append(dirs, dir)
+	}
+	for dir := range fw.polled {
+		dirs = append(dirs, dir)
+	}
+	sort.Strings(dirs)
+	return dirs
+}
+
+func TestFileWatcherScope(t *testing.T) {
+	root := newWatchedProject(t)
+	fw, err := NewFileWatcher(root, filepath.Join(root, "build"), func([]clangd.FileChange) {}, &logger.NullLogger{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer fw.Stop()
+
+	want := []string{root, filepath.Join(root, "include"), filepath.Join(root, "include", "engine"), filepath.Join(root, "src")}
+	if got := watchedDirectories(fw); !reflect.DeepEqual(got, want) {
+		t.Errorf("watched %v, want %v", got, want)
+	}
+	status := fw.Status()
+	if status.Scope != WatchScopeDatabase || status.IgnoredDirectories != 2 {
+		t.Errorf("expected database scope with generated/ and generated/src ignored, got %+v", status)
+	}
+}
+
+func TestFileWatcherWithoutDatabaseWatchesProject(t *testing.T) {
+	root := newWatchedProject(t)
+	fw, err := NewFileWatcher(root, "", func([]clangd.FileChange) {}, &logger.NullLogger{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer fw.Stop()
+
+	// Everything but the build and ignored directories
+	want := []string{root, filepath.Join(root, "docs"), filepath.Join(root, "docs", "images"),
+		filepath.Join(root, "include"), filepath.Join(root, "include", "engine"), filepath.Join(root, "src")}
+	if got := watchedDirectories(fw); !reflect.DeepEqual(got, want) {
+		t.Errorf("watched %v, want %v", got, want)
+	}
+	if status := fw.Status(); status.Scope != WatchScopeProject {
+		t.Errorf("expected project scope, got %+v", status)
+	}
+}
+
+func TestFileWatcherPolling(t *testing.T) {
+	t.Setenv("CLANGD_DAEMON_WATCHER", WatchModePoll)
+	root := newWatchedProject(t)
+	changes := make(chan []clangd.FileChange, 10)
+	fw, err := NewFileWatcher(root, filepath.Join(root, "build"), func(batch []clangd.FileChange) { changes <- batch }, &logger.NullLogger{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer fw.Stop()
+
+	if status := fw.Status(); status.Mode != WatchModePoll || status.WatchedDirectories != 0 || status.PolledDirectories != 4 {
+		t.Fatalf("expected 4 polled directories, got %+v", status)
+	}
+
+	// A modified source, a new header in a new directory of an include tree
+	// and a deleted source
+	main := filepath.Join(root, "src", "main.cpp")
+	removed := filepath.Join(root, "src", "old.cpp")
+	writeFile(t, removed, "")
+	fw.pollOnce()
+	writeFile(t, main, "int main() { return 0; }")
+	later := time.Now().Add(time.Second)
+	os.Chtimes(main, later, later)
+	fw.pollOnce()
+	if err := os.MkdirAll(filepath.Join(root, "include", "net"), 0755); err != nil {
+		t.Fatal(err)
+	}
+	fw.pollOnce()
+	header := filepath.Join(root, "include", "net", "socket.h")
+	writeFile(t, header, "class Socket {};")
+	if err := os.Remove(removed); err != nil {
+		t.Fatal(err)
+	}
+	fw.pollOnce()
+
+	// old.cpp was created and deleted within the batch, so it isn't reported
+	want := []clangd.FileChange{
+		{Path: header, Type: clangd.FileChangeTypeCreated},
+		{Path: main, Type: clangd.FileChangeTypeChanged},
+	}
+	select {
+	case batch := <-changes:
+		if !reflect.DeepEqual(batch, want) {
+			t.Errorf("got %+v, want %+v", batch, want)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatalf("expected changes to %s and %s", main, header)
+	}
+}
+
+func TestMergeChanges(t *testing.T) {
+	const (
+		created = clangd.FileChangeTypeCreated
+		changed = clangd.FileChangeTypeChanged
+		deleted = clangd.FileChangeTypeDeleted
+	)
+	tests := []struct {
+		previous, next clangd.FileChangeType
+		want           clangd.FileChangeType
+		keep           bool
+	}{
+		{created, changed, created, true},
+		{created, deleted, 0, false},
+		{changed, changed, changed, true},
+		{changed, deleted, deleted, true},
+		{deleted, created, changed, true}, // Atomic save
+		{deleted, deleted, deleted, true},
+	}
+	for _, test := range tests {
+		got, keep := mergeChanges(test.previous, test.next)
+		if got != test.want || keep != test.keep {
+			t.Errorf("mergeChanges(%v, %v) = %v, %v, want %v, %v", test.previous, test.next, got, keep, test.want, test.keep)
+		}
+	}
+}
+
+func TestBranchSwitchIsDeliveredAsOneBatch(t *testing.T) {
+	t.Setenv("CLANGD_DAEMON_WATCHER", WatchModePoll)
+	root := newWatchedProject(t)
+	batches := make(chan []clangd.FileChange, 10)
+	fw, err := NewFileWatcher(root, filepath.Join(root, "build"), func(batch []clangd.FileChange) { batches <- batch }, &logger.NullLogger{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer fw.Stop()
+
+	// A checkout that takes longer than the normal debounce delay
+	fw.handleBranchSwitch()
+	for i := 0; i < 3; i++ {
+		fw.handleFileChange(filepath.Join(root, "src", fmt.Sprintf("file%d.cpp", i)), clangd.FileChangeTypeChanged)
+		time.Sleep(debounceDelay + 100*time.Millisecond)
+	}
+
+	select {
+	case batch := <-batches:
+		if len(batch) != 3 {
+			t.Errorf("expected all 3 files in one batch, got %+v", batch)
+		}
+	case <-time.After(maxBatchDelay):
+		t.Fatal("expected a batch")
+	}
+	if status := fw.Status(); status.Batches != 1 || status.BulkBatches != 1 || status.LastBatch != 3 {
+		t.Errorf("expected one bulk batch of 3 files, got %+v", status)
+	}
+}
@@ -0,0 +1,298 @@
+package daemon
+
+import (
+	"encoding/json"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/logger"
+)
+
+// Maximum number of documents remembered in the working set file. Only the
+// top entries are ever prewarmed, the rest just lets rankings shift over time.
+const maxWorkingSetEntries = 256
+
+// Default number of documents opened in the background at startup. Can be
+// overridden with the CLANGD_DAEMON_PREWARM environment variable.
+const defaultPrewarmCount = 8
+
+// Pause between prewarmed documents, so clangd builds one AST at a time and
+// interactive requests are not starved of CPU.
+const prewarmInterval = 500 * time.Millisecond
+
+// Records how often a document was used by queries.
+type workingSetEntry struct {
+	Path     string    `json:"path"` // Relative to the project root
+	Uses     int       `json:"uses"`
+	LastUsed time.Time `json:"lastUsed"`
+}
+
+type workingSetFile struct {
+	Version   int               `json:"version"`
+	Documents []workingSetEntry `json:"documents"`
+}
+
+// First request latency of a document after daemon startup
+type firstRequest struct {
+	prewarmed bool
+	latency   time.Duration
+}
+
+// WorkingSet tracks which documents queries touch and how often, persists that
+// under .cache/clangd-query so it survives daemon restarts, and opens the most
+// used documents in clangd at startup so their preambles and ASTs are built
+// before the first query needs them.
+//
+// To make the effect of prewarming measurable, the latency of the first
+// request against each document is recorded separately for prewarmed and cold
+// documents.
+type WorkingSet struct {
+	mu            sync.Mutex
+	path          string
+	projectRoot   string
+	entries       map[string]*workingSetEntry
+	dirty         bool
+	prewarmed     map[string]bool
+	firstRequests map[string]firstRequest
+	prewarmTime   time.Duration
+	saveMu        sync.Mutex // Serializes writers of the working set file
+	logger        logger.Logger
+}
+
+// WorkingSetStatus summarizes prewarming for the status command
+type WorkingSetStatus struct {
+	TrackedDocuments  int    `json:"trackedDocuments"`
+	PrewarmedFiles    int    `json:"prewarmedFiles"`
+	PrewarmTime       string `json:"prewarmTime"`
+	WarmFirstRequests int    `json:"warmFirstRequests"`
+	WarmFirstLatency  string `json:"warmFirstLatency"`
+	ColdFirstRequests int    `json:"coldFirstRequests"`
+	ColdFirstLatency  string `json:"coldFirstLatency"`
+}
+
+// Returns the path of the working set file for a project
+func GetWorkingSetPath(projectRoot string) string {
+	return filepath.Join(projectRoot, ".cache", "clangd-query", "working_set.json")
+}
+
+// Loads the working set of a project. A missing or unreadable file results in
+// an empty working set.
+func LoadWorkingSet(projectRoot string, log logger.Logger) *WorkingSet {
+	ws := &WorkingSet{
+		path:          GetWorkingSetPath(projectRoot),
+		projectRoot:   projectRoot,
+		entries:       make(map[string]*workingSetEntry),
+		prewarmed:     make(map[string]bool),
+		firstRequests: make(map[string]firstRequest),
+		logger:        log,
+	}
+
+	data, err := os.ReadFile(ws.path)
+	if err != nil {
+		if !os.IsNotExist(err) {
+			log.Error("Failed to read working set: %v", err)
+		}
+		return ws
+	}
+
+	var file workingSetFile
+	if err := json.Unmarshal(data, &file); err != nil {
+		log.Error("Failed to parse working set, starting empty: %v", err)
+		return ws
+	}
+
+	for i := range file.Documents {
+		entry := file.Documents[i]
+		ws.entries[entry.Path] = &entry
+	}
+	log.Debug("Loaded working set with %d documents", len(ws.entries))
+	return ws
+}
+
+// Records a request against a document. Used as the clangd document observer.
+func (ws *WorkingSet) Record(path string, latency time.Duration) {
+	ws.mu.Lock()
+	defer ws.mu.Unlock()
+
+	rel, err := filepath.Rel(ws.projectRoot, path)
+	if err != nil || strings.HasPrefix(rel, "..") {
+		// Only track project files, system headers are cheap to rebuild
+		return
+	}
+
+	entry, ok := ws.entries[rel]
+	if !ok {
+		entry = &workingSetEntry{Path: rel}
+		ws.entries[rel] = entry
+	}
+	entry.Uses++
+	entry.LastUsed = time.Now()
+	ws.dirty = true
+
+	if _, seen := ws.firstRequests[rel]; !seen {
+		ws.firstRequests[rel] = firstRequest{
+			prewarmed: ws.prewarmed[rel],
+			latency:   latency,
+		}
+	}
+}
+
+// Returns the paths of the k most used documents, most used first
+func (ws *WorkingSet) Top(k int) []string {
+	ws.mu.Lock()
+	defer ws.mu.Unlock()
+
+	ranked := ws.ranked()
+	if len(ranked) > k {
+		ranked = ranked[:k]
+	}
+
+	paths := make([]string, len(ranked))
+	for i, entry := range ranked {
+		paths[i] = entry.Path
+	}
+	return paths
+}
+
+// Returns all entries sorted by use count, then recency. The caller must
+// hold ws.mu.
+func (ws *WorkingSet) ranked() []*workingSetEntry {
+	ranked := make([]*workingSetEntry, 0, len(ws.entries))
+	for _, entry := range ws.entries {
+		ranked = append(ranked, entry)
+	}
+	sort.Slice(ranked, func(i, j int) bool {
+		if ranked[i].Uses != ranked[j].Uses {
+			return ranked[i].Uses > ranked[j].Uses
+		}
+		return ranked[i].LastUsed.After(ranked[j].LastUsed)
+	})
+	return ranked
+}
+
+// Opens the k most used documents in clangd, one at a time. Before each
+// document it waits until no interactive request is running, so prewarming
+// never competes with real queries. Stops early when stop is closed.
+func (ws *WorkingSet) Prewarm(client *clangd.ClangdClient, k int, busy func() bool, stop <-chan struct{}) {
+	if k <= 0 {
+		return
+	}
+
+	start := time.Now()
+	count := 0
+	for _, rel := range ws.Top(k) {
+		absolutePath := filepath.Join(ws.projectRoot, rel)
+		if _, err := os.Stat(absolutePath); err != nil {
+			continue
+		}
+
+		// Yield to interactive requests
+		for busy() {
+			select {
+			case <-stop:
+				return
+			case <-time.After(prewarmInterval):
+			}
+		}
+
+		ws.mu.Lock()
+		ws.prewarmed[rel] = true
+		ws.mu.Unlock()
+
+		if err := client.OpenDocument(client.FileURIFromPath(absolutePath)); err != nil {
+			ws.logger.Debug("Failed to prewarm %s: %v", rel, err)
+			continue
+		}
+		count++
+
+		select {
+		case <-stop:
+			return
+		case <-time.After(prewarmInterval):
+		}
+	}
+
+	ws.mu.Lock()
+	ws.prewarmTime = time.Since(start)
+	ws.mu.Unlock()
+
+	if count > 0 {
+		ws.logger.Info("Prewarmed %d documents from the working set", count)
+	}
+}
+
+// Writes the working set to disk if it changed since the last save
+func (ws *WorkingSet) Save() error {
+	ws.saveMu.Lock()
+	defer ws.saveMu.Unlock()
+
+	ws.mu.Lock()
+	if !ws.dirty {
+		ws.mu.Unlock()
+		return nil
+	}
+
+	ranked := ws.ranked()
+	if len(ranked) > maxWorkingSetEntries {
+		ranked = ranked[:maxWorkingSetEntries]
+	}
+	file := workingSetFile{Version: 1}
+	for _, entry := range ranked {
+		file.Documents = append(file.Documents, *entry)
+	}
+	ws.dirty = false
+	ws.mu.Unlock()
+
+	data, err := json.MarshalIndent(file, "", "  ")
+	if err != nil {
+		return err
+	}
+
+	// Write to a temporary file first so a crash never leaves a truncated file
+	tempPath := ws.path + ".tmp"
+	if err := os.WriteFile(tempPath, data, 0644); err != nil {
+		return err
+	}
+	return os.Rename(tempPath, ws.path)
+}
+
+// Returns prewarming statistics for the status command
+func (ws *WorkingSet) Status() WorkingSetStatus {
+	ws.mu.Lock()
+	defer ws.mu.Unlock()
+
+	var warm, cold []time.Duration
+	for _, first := range ws.firstRequests {
+		if first.prewarmed {
+			warm = append(warm, first.latency)
+		} else {
+			cold = append(cold, first.latency)
+		}
+	}
+
+	return WorkingSetStatus{
+		TrackedDocuments:  len(ws.entries),
+		PrewarmedFiles:    len(ws.prewarmed),
+		PrewarmTime:       ws.prewarmTime.Round(time.Millisecond).String(),
+		WarmFirstRequests: len(warm),
+		WarmFirstLatency:  averageDuration(warm).String(),
+		ColdFirstRequests: len(cold),
+		ColdFirstLatency:  averageDuration(cold).String(),
+	}
+}
+
+func averageDuration(durations []time.Duration) time.Duration {
+	if len(durations) == 0 {
+		return 0
+	}
+	var total time.Duration
+	for _, d := range durations {
+		total += d
+	}
+	return (total / time.Duration(len(durations))).Round(time.Millisecond)
+}
@@ -0,0 +1,55 @@
+package daemon
+
+import (
+	"os"
+	"path/filepath"
+	"reflect"
+	"testing"
+	"time"
+
+	"clangd-query/internal/logger"
+)
+
+func TestWorkingSetPersistsRanking(t *testing.T) {
+	projectRoot := t.TempDir()
+	os.MkdirAll(filepath.Join(projectRoot, ".cache", "clangd-query"), 0755)
+	log := &logger.NullLogger{}
+
+	ws := LoadWorkingSet(projectRoot, log)
+	for i := 0; i < 3; i++ {
+		ws.Record(filepath.Join(projectRoot, "src/engine.cpp"), time.Millisecond)
+	}
+	ws.Record(filepath.Join(projectRoot, "include/engine.h"), time.Millisecond)
+	ws.Record("/usr/include/c++/vector", time.Millisecond)
+
+	if err := ws.Save(); err != nil {
+		t.Fatalf("Save failed: %v", err)
+	}
+
+	reloaded := LoadWorkingSet(projectRoot, log)
+	want := []string{"src/engine.cpp", "include/engine.h"}
+	if got := reloaded.Top(10); !reflect.DeepEqual(got, want) {
+		t.Errorf("Top(10) after reload:\nwant: %v\ngot:  %v", want, got)
+	}
+	if got := reloaded.Top(1); !reflect.DeepEqual(got, want[:1]) {
+		t.Errorf("Top(1) after reload:\nwant: %v\ngot:  %v", want[:1], got)
+	}
+}
+
+func TestWorkingSetSeparatesWarmAndColdLatency(t *testing.T) {
+	projectRoot := t.TempDir()
+	ws := LoadWorkingSet(projectRoot, &logger.NullLogger{})
+	ws.prewarmed["src/warm.cpp"] = true
+
+	ws.Record(filepath.Join(projectRoot, "src/warm.cpp"), 10*time.Millisecond)
+	ws.Record(filepath.Join(projectRoot, "src/warm.cpp"), time.Second) // Not a first request
+	ws.Record(filepath.Join(projectRoot, "src/cold.cpp"), 2*time.Second)
+
+	status := ws.Status()
+	if status.WarmFirstRequests != 1 || status.WarmFirstLatency != "10ms" {
+		t.Errorf("unexpected warm stats: %d requests, %s", status.WarmFirstRequests, status.WarmFirstLatency)
+	}
+	if status.ColdFirstRequests != 1 || status.ColdFirstLatency != "2s" {
+		t.Errorf("unexpected cold stats: %d requests, %s", status.ColdFirstRequests, status.ColdFirstLatency)
+	}
+}
@@ -0,0 +1,412 @@
+package index
+
+import (
+	"fmt"
+	"regexp"
+	"regexp/syntax"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+
+	"clangd-query/internal/clangd"
+)
+
+// Symbol is a single entry in the SymbolIndex. Name is the fully qualified
+// name as shown by the search command (e.g. "game_engine::GameObject::Update")
+// and Path is the file path relative to the project root.
+type Symbol struct {
+	Name     string
+	Kind     clangd.SymbolKind
+	Path     string
+	Location clangd.Location
+}
+
+// BaseName returns the unqualified part of the symbol name.
+func (s *Symbol) BaseName() string {
+	if idx := strings.LastIndex(s.Name, "::"); idx != -1 {
+		return s.Name[idx+2:]
+	}
+	return s.Name
+}
+
+// QueryOptions restricts the results of a pattern query.
+type QueryOptions struct {
+	// Kinds limits results to the given symbol kinds. Empty means all kinds.
+	Kinds []clangd.SymbolKind
+
+	// PathPrefix limits results to symbols in files whose project relative
+	// path starts with this prefix.
+	PathPrefix string
+
+	// Limit caps the number of returned symbols. Zero or negative means no cap.
+	Limit int
+}
+
+// QueryResult contains the matches of a pattern query along with statistics
+// about how much of the index had to be scanned.
+type QueryResult struct {
+	Symbols    []Symbol
+	Total      int // Matches before applying the limit
+	Candidates int // Symbols left after trigram narrowing
+	Duration   time.Duration
+}
+
+// SymbolIndex is an in-memory trigram index over fully qualified symbol names.
+// Each trigram of the lowercased name maps to a sorted posting list of symbol
+// ids, so regex and glob queries only run the full matcher against symbols
+// that contain every literal trigram the pattern requires.
+//
+// The index is rebuilt wholesale from clangd whenever the source generation
+// it was built from no longer matches the current one.
+type SymbolIndex struct {
+	mu         sync.RWMutex
+	symbols    []Symbol
+	postings   map[uint32][]uint32
+	generation uint64
+	built      bool
+	builtAt    time.Time
+	buildTime  time.Duration
+
+	buildMu sync.Mutex // Serializes rebuilds so concurrent queries share one
+}
+
+// Creates an empty symbol index.
+func NewSymbolIndex() *SymbolIndex {
+	return &SymbolIndex{
+		postings: make(map[uint32][]uint32),
+	}
+}
+
+// Returns the number of indexed symbols.
+func (idx *SymbolIndex) Len() int {
+	idx.mu.RLock()
+	defer idx.mu.RUnlock()
+	return len(idx.symbols)
+}
+
+// Returns the source generation the index was last built from, and whether
+// it has been built at all.
+func (idx *SymbolIndex) Generation() (uint64, bool) {
+	idx.mu.RLock()
+	defer idx.mu.RUnlock()
+	return idx.generation, idx.built
+}
+
+// Returns when the index was last built and how long building it took.
+func (idx *SymbolIndex) BuildInfo() (time.Time, time.Duration) {
+	idx.mu.RLock()
+	defer idx.mu.RUnlock()
+	return idx.builtAt, idx.buildTime
+}
+
+// Drops all symbols. The next EnsureFresh rebuilds the index regardless of
+// the generation, which matters when the generation counter starts over with
+// a new clangd.
+func (idx *SymbolIndex) Reset() {
+	idx.buildMu.Lock()
+	defer idx.buildMu.Unlock()
+
+	idx.mu.Lock()
+	defer idx.mu.Unlock()
+	idx.symbols = nil
+	idx.postings = make(map[uint32][]uint32)
+	idx.generation = 0
+	idx.built = false
+}
+
+// Rebuilds the index if it was never built or was built from a different
+// source generation. The build function is only called by one goroutine at a
+// time; concurrent callers wait and then see the freshly built index.
+func (idx *SymbolIndex) EnsureFresh(generation uint64, build func() ([]Symbol, error)) error {
+	idx.buildMu.Lock()
+	defer idx.buildMu.Unlock()
+
+	if current, built := idx.Generation(); built && current == generation {
+		return nil
+	}
+
+	start := time.Now()
+	symbols, err := build()
+	if err != nil {
+		return err
+	}
+	idx.replace(symbols, generation, time.Since(start))
+	return nil
+}
+
+func (idx *SymbolIndex) replace(symbols []Symbol, generation uint64, buildTime time.Duration) {
+	start := time.Now()
+	postings := make(map[uint32][]uint32)
+	seen := make(map[uint32]bool)
+
+	for id := range symbols {
+		for k := range seen {
+			delete(seen, k)
+		}
+		lower := strings.ToLower(symbols[id].Name)
+		for i := 0; i+3 <= len(lower); i++ {
+			t := trigram(lower[i : i+3])
+			if seen[t] {
+				continue
+			}
+			seen[t] = true
+			// Ids are visited in increasing order, so posting lists stay sorted
+			postings[t] = append(postings[t], uint32(id))
+		}
+	}
+
+	idx.mu.Lock()
+	defer idx.mu.Unlock()
+	idx.symbols = symbols
+	idx.postings = postings
+	idx.generation = generation
+	idx.built = true
+	idx.builtAt = time.Now()
+	idx.buildTime = buildTime + time.Since(start)
+}
+
+// Returns all symbols matching the regular expression. Patterns that contain
+// "::" are matched against the fully qualified name, all other patterns are
+// matched against the unqualified name so that anchors like ^ and $ apply to
+// the symbol name itself.
+func (idx *SymbolIndex) QueryRegex(pattern string, opts QueryOptions) (*QueryResult, error) {
+	re, err := regexp.Compile(pattern)
+	if err != nil {
+		return nil, fmt.Errorf("invalid regular expression %q: %v", pattern, err)
+	}
+
+	parsed, err := syntax.Parse(pattern, syntax.Perl)
+	if err != nil {
+		return nil, fmt.Errorf("invalid regular expression %q: %v", pattern, err)
+	}
+
+	qualified := strings.Contains(pattern, "::")
+	return idx.query(re, requiredLiterals(parsed.Simplify()), qualified, opts), nil
+}
+
+// Returns all symbols matching the glob pattern. Supported wildcards are
+// "*" (any run of characters), "?" (any single character) and bracket
+// expressions like [A-Z] or [!_]. The glob must match the whole name; like
+// QueryRegex it is matched against the qualified name only if it contains "::".
+func (idx *SymbolIndex) QueryGlob(glob string, opts QueryOptions) (*QueryResult, error) {
+	pattern, err := GlobToRegexp(glob)
+	if err != nil {
+		return nil, err
+	}
+	return idx.QueryRegex(pattern, opts)
+}
+
+func (idx *SymbolIndex) query(re *regexp.Regexp, literals []string, qualified bool, opts QueryOptions) *QueryResult {
+	start := time.Now()
+
+	idx.mu.RLock()
+	defer idx.mu.RUnlock()
+
+	candidates, all := idx.candidates(literals)
+	count := len(candidates)
+	if all {
+		count = len(idx.symbols)
+	}
+
+	kinds := make(map[clangd.SymbolKind]bool, len(opts.Kinds))
+	for _, kind := range opts.Kinds {
+		kinds[kind] = true
+	}
+
+	var matches []Symbol
+	check := func(id uint32) {
+		symbol := &idx.symbols[id]
+		if len(kinds) > 0 && !kinds[symbol.Kind] {
+			return
+		}
+		if opts.PathPrefix != "" && !strings.HasPrefix(symbol.Path, opts.PathPrefix) {
+			return
+		}
+		target := symbol.Name
+		if !qualified {
+			target = symbol.BaseName()
+		}
+		if re.MatchString(target) {
+			matches = append(matches, *symbol)
+		}
+	}
+
+	if all {
+		for id := range idx.symbols {
+			check(uint32(id))
+		}
+	} else {
+		for _, id := range candidates {
+			check(id)
+		}
+	}
+
+	sort.SliceStable(matches, func(i, j int) bool {
+		return matches[i].Name < matches[j].Name
+	})
+
+	total := len(matches)
+	if opts.Limit > 0 && len(matches) > opts.Limit {
+		matches = matches[:opts.Limit]
+	}
+
+	return &QueryResult{
+		Symbols:    matches,
+		Total:      total,
+		Candidates: count,
+		Duration:   time.Since(start),
+	}
+}
+
+// Intersects the posting lists of all trigrams in the required literals.
+// Returns all=true when the literals contain no trigrams, meaning every
+// symbol is a candidate. The caller must hold idx.mu.
+func (idx *SymbolIndex) candidates(literals []string) (ids []uint32, all bool) {
+	var lists [][]uint32
+	seen := make(map[uint32]bool)
+
+	for _, literal := range literals {
+		lower := strings.ToLower(literal)
+		for i := 0; i+3 <= len(lower); i++ {
+			t := trigram(lower[i : i+3])
+			if seen[t] {
+				continue
+			}
+			seen[t] = true
+			list, ok := idx.postings[t]
+			if !ok {
+				// A required trigram appears nowhere, nothing can match
+				return nil, false
+			}
+			lists = append(lists, list)
+		}
+	}
+
+	if len(lists) == 0 {
+		return nil, true
+	}
+
+	// Intersect shortest lists first to keep intermediate results small
+	sort.Slice(lists, func(i, j int) bool {
+		return len(lists[i]) < len(lists[j])
+	})
+
+	result := lists[0]
+	for _, list := range lists[1:] {
+		result = intersect(result, list)
+		if len(result) == 0 {
+			break
+		}
+	}
+	return result, false
+}
+
+// Intersects two sorted posting lists.
+func intersect(a, b []uint32) []uint32 {
+	result := make([]uint32, 0, len(a))
+	i, j := 0, 0
+	for i < len(a) && j < len(b) {
+		switch {
+		case a[i] < b[j]:
+			i++
+		case a[i] > b[j]:
+			j++
+		default:
+			result = append(result, a[i])
+			i++
+			j++
+		}
+	}
+	return result
+}
+
+func trigram(s string) uint32 {
+	return uint32(s[0])<<16 | uint32(s[1])<<8 | uint32(s[2])
+}
+
+// Returns literal strings that must appear in every match of the regular
+// expression. The result is conservative: an empty result means the pattern
+// could match anything and the whole index has to be scanned.
+func requiredLiterals(re *syntax.Regexp) []string {
+	switch re.Op {
+	case syntax.OpLiteral:
+		return []string{string(re.Rune)}
+
+	case syntax.OpCapture:
+		return requiredLiterals(re.Sub[0])
+
+	case syntax.OpPlus:
+		return requiredLiterals(re.Sub[0])
+
+	case syntax.OpRepeat:
+		if re.Min >= 1 {
+			return requiredLiterals(re.Sub[0])
+		}
+		return nil
+
+	case syntax.OpConcat:
+		// Adjacent literals join into longer runs, which yield more trigrams
+		// than the pieces would on their own
+		var literals []string
+		var run strings.Builder
+		flush := func() {
+			if run.Len() > 0 {
+				literals = append(literals, run.String())
+				run.Reset()
+			}
+		}
+		for _, sub := range re.Sub {
+			if sub.Op == syntax.OpLiteral {
+				run.WriteString(string(sub.Rune))
+				continue
+			}
+			flush()
+			literals = append(literals, requiredLiterals(sub)...)
+		}
+		flush()
+		return literals
+
+	default:
+		return nil
+	}
+}
+
+// Converts a glob pattern into an anchored regular expression.
+func GlobToRegexp(glob string) (string, error) {
+	var b strings.Builder
+	b.WriteString("^")
+
+	runes := []rune(glob)
+	for i := 0; i < len(runes); i++ {
+		ch := runes[i]
+		switch ch {
+		case '*':
+			b.WriteString(".*")
+		case '?':
+			b.WriteString(".")
+		case '[':
+			end := -1
+			for j := i + 1; j < len(runes); j++ {
+				if runes[j] == ']' {
+					end = j - i - 1
+					break
+				}
+			}
+			if end == -1 {
+				return "", fmt.Errorf("invalid glob %q: unterminated [", glob)
+			}
+			class := string(runes[i+1 : i+1+end])
+			if strings.HasPrefix(class, "!") {
+				class = "^" + class[1:]
+			}
+			b.WriteString("[" + strings.ReplaceAll(class, `\`, `\\`) + "]")
+			i += end + 1
+		default:
+			b.WriteString(regexp.QuoteMeta(string(ch)))
+		}
+	}
+
+	b.WriteString("$")
+	return b.String(), nil
+}
@@ -0,0 +1,242 @@
+package index
+
+import (
+	"fmt"
+	"reflect"
+	"testing"
+
+	"clangd-query/internal/clangd"
+)
+
+func newTestIndex(t *testing.T) *SymbolIndex {
+	t.Helper()
+	symbols := []Symbol{
+		{Name: "game_engine::GameObject", Kind: clangd.SymbolKindClass, Path: "include/core/game_object.h"},
+		{Name: "game_engine::GameObject::Update", Kind: clangd.SymbolKindMethod, Path: "src/core/game_object.cpp"},
+		{Name: "game_engine::PhysicsSystem::Update", Kind: clangd.SymbolKindMethod, Path: "src/systems/physics_system.cpp"},
+		{Name: "game_engine::RenderSystem::Update", Kind: clangd.SymbolKindMethod, Path: "src/systems/render_system.cpp"},
+		{Name: "game_engine::RenderSystem", Kind: clangd.SymbolKindClass, Path: "include/systems/render_system.h"},
+		{Name: "game_engine::EventSystem::OnCollisionEvent", Kind: clangd.SymbolKindMethod, Path: "include/events/event_system.h"},
+		{Name: "game_engine::EventSystem::OnInputEvent", Kind: clangd.SymbolKindMethod, Path: "include/events/event_system.h"},
+		{Name: "game_engine::EventSystem::onlyLowercaseEvent", Kind: clangd.SymbolKindMethod, Path: "include/events/event_system.h"},
+		{Name: "game_engine::Engine", Kind: clangd.SymbolKindClass, Path: "include/core/engine.h"},
+	}
+
+	idx := NewSymbolIndex()
+	if err := idx.EnsureFresh(1, func() ([]Symbol, error) { return symbols, nil }); err != nil {
+		t.Fatalf("EnsureFresh failed: %v", err)
+	}
+	return idx
+}
+
+func names(result *QueryResult) []string {
+	var out []string
+	for _, symbol := range result.Symbols {
+		out = append(out, symbol.Name)
+	}
+	return out
+}
+
+func TestQueryRegex(t *testing.T) {
+	idx := newTestIndex(t)
+
+	tests := []struct {
+		name    string
+		pattern string
+		opts    QueryOptions
+		want    []string
+	}{
+		{
+			name:    "anchored unqualified pattern",
+			pattern: "^On[A-Z].*Event$",
+			want: []string{
+				"game_engine::EventSystem::OnCollisionEvent",
+				"game_engine::EventSystem::OnInputEvent",
+			},
+		},
+		{
+			name:    "qualified pattern",
+			pattern: `System::Update$`,
+			want: []string{
+				"game_engine::PhysicsSystem::Update",
+				"game_engine::RenderSystem::Update",
+			},
+		},
+		{
+			name:    "kind filter",
+			pattern: "System",
+			opts:    QueryOptions{Kinds: []clangd.SymbolKind{clangd.SymbolKindClass}},
+			want:    []string{"game_engine::RenderSystem"},
+		},
+		{
+			name:    "path prefix filter",
+			pattern: "Update",
+			opts:    QueryOptions{PathPrefix: "src/systems/"},
+			want: []string{
+				"game_engine::PhysicsSystem::Update",
+				"game_engine::RenderSystem::Update",
+			},
+		},
+		{
+			name:    "case insensitive flag",
+			pattern: "(?i)^engine$",
+			want:    []string{"game_engine::Engine"},
+		},
+		{
+			name:    "no trigram literal scans everything",
+			pattern: "^E",
+			want: []string{
+				"game_engine::Engine",
+			},
+		},
+		{
+			name:    "unknown trigram matches nothing",
+			pattern: "Renderer",
+			want:    nil,
+		},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			result, err := idx.QueryRegex(tt.pattern, tt.opts)
+			if err != nil {
+				t.Fatalf("QueryRegex(%q) failed: %v", tt.pattern, err)
+			}
+			if got := names(result); !reflect.DeepEqual(got, tt.want) {
+				t.Errorf("QueryRegex(%q):\nwant: %v\ngot:  %v", tt.pattern, tt.want, got)
+			}
+		})
+	}
+}
+
+func TestQueryGlob(t *testing.T) {
+	idx := newTestIndex(t)
+
+	result, err := idx.QueryGlob("*System::Update", QueryOptions{})
+	if err != nil {
+		t.Fatalf("QueryGlob failed: %v", err)
+	}
+	want := []string{
+		"game_engine::PhysicsSystem::Update",
+		"game_engine::RenderSystem::Update",
+	}
+	if got := names(result); !reflect.DeepEqual(got, want) {
+		t.Errorf("want: %v\ngot:  %v", want, got)
+	}
+
+	result, err = idx.QueryGlob("On?????Event", QueryOptions{})
+	if err != nil {
+		t.Fatalf("QueryGlob failed: %v", err)
+	}
+	want = []string{"game_engine::EventSystem::OnInputEvent"}
+	if got := names(result); !reflect.DeepEqual(got, want) {
+		t.Errorf("want: %v\ngot:  %v", want, got)
+	}
+}
+
+func TestTrigramNarrowing(t *testing.T) {
+	idx := newTestIndex(t)
+
+	result, err := idx.QueryRegex("^On[A-Z].*Event$", QueryOptions{})
+	if err != nil {
+		t.Fatalf("QueryRegex failed: %v", err)
+	}
+	// Only the three *Event symbols contain the trigrams of "Event"
+	if result.Candidates != 3 {
+		t.Errorf("expected 3 candidates after trigram narrowing, got %d", result.Candidates)
+	}
+}
+
+func TestQueryLimit(t *testing.T) {
+	idx := newTestIndex(t)
+
+	result, err := idx.QueryRegex("Update", QueryOptions{Limit: 1})
+	if err != nil {
+		t.Fatalf("QueryRegex failed: %v", err)
+	}
+	if len(result.Symbols) != 1 || result.Total != 3 {
+		t.Errorf("expected 1 of 3 results, got %d of %d", len(result.Symbols), result.Total)
+	}
+}
+
+func TestEnsureFreshRebuildsOnNewGeneration(t *testing.T) {
+	idx := NewSymbolIndex()
+	builds := 0
+	build := func() ([]Symbol, error) {
+		builds++
+		return []Symbol{{Name: fmt.Sprintf("Symbol%d", builds)}}, nil
+	}
+
+	idx.EnsureFresh(1, build)
+	idx.EnsureFresh(1, build)
+	if builds != 1 {
+		t.Errorf("expected 1 build for the same generation, got %d", builds)
+	}
+
+	idx.EnsureFresh(2, build)
+	if builds != 2 {
+		t.Errorf("expected a rebuild for a new generation, got %d builds", builds)
+	}
+}
+
+func TestResetForcesRebuild(t *testing.T) {
+	idx := newTestIndex(t)
+	idx.Reset()
+	if idx.Len() != 0 {
+		t.Errorf("expected an empty index after reset, got %d symbols", idx.Len())
+	}
+
+	// A new clangd starts counting generations from the beginning again
+	rebuilt := false
+	idx.EnsureFresh(1, func() ([]Symbol, error) {
+		rebuilt = true
+		return nil, nil
+	})
+	if !rebuilt {
+		t.Errorf("expected a rebuild after reset even for the same generation")
+	}
+}
+
+func TestGlobToRegexp(t *testing.T) {
+	tests := map[string]string{
+		"*System::Update": `^.*System::Update$`,
+		"Get?":            `^Get.$`,
+		"[!_]*":           `^[^_].*$`,
+		"On[A-Z]*":        `^On[A-Z].*$`,
+	}
+	for glob, want := range tests {
+		got, err := GlobToRegexp(glob)
+		if err != nil {
+			t.Errorf("GlobToRegexp(%q) failed: %v", glob, err)
+			continue
+		}
+		if got != want {
+			t.Errorf("GlobToRegexp(%q) = %q, want %q", glob, got, want)
+		}
+	}
+
+	if _, err := GlobToRegexp("[abc"); err == nil {
+		t.Errorf("expected error for unterminated bracket expression")
+	}
+}
+
+func BenchmarkQueryRegex(b *testing.B) {
+	symbols := make([]Symbol, 0, 1000000)
+	for i := 0; i < cap(symbols); i++ {
+		symbols = append(symbols, Symbol{
+			Name: fmt.Sprintf("ns%d::Class%d::Method%d", i%97, i%10007, i),
+			Kind: clangd.SymbolKindMethod,
+		})
+	}
+	symbols = append(symbols, Symbol{Name: "game_engine::EventSystem::OnCollisionEvent", Kind: clangd.SymbolKindMethod})
+
+	idx := NewSymbolIndex()
+	idx.EnsureFresh(1, func() ([]Symbol, error) { return symbols, nil })
+
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := idx.QueryRegex("^On[A-Z].*Event$", QueryOptions{}); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
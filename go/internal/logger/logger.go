@@ -1,11 +1,13 @@
 package logger
 
 import (
+	"bufio"
 	"fmt"
 	"os"
 	"path/filepath"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 )
 
@@ -18,8 +20,21 @@ const (
 	LevelDebug
 )
 
+// Returns the name of the level as it appears in log lines
+func (l LogLevel) String() string {
+	switch l {
+	case LevelError:
+		return "ERROR"
+	case LevelDebug:
+		return "DEBUG"
+	default:
+		return "INFO"
+	}
+}
+
 // LogEntry represents a single log entry in memory
 type LogEntry struct {
+	Seq       uint64 // Position in the log, starting at 1
 	Timestamp time.Time
 	Level     LogLevel
 	Message   string
@@ -30,35 +45,69 @@ type Logger interface {
 	Error(format string, args ...interface{})
 	Info(format string, args ...interface{})
 	Debug(format string, args ...interface{})
-	GetLogs(minLevel LogLevel) string
+	// Returns true if messages of the level are recorded, so callers can
+	// skip computing arguments of messages that would be dropped
+	Enabled(level LogLevel) bool
+	// Returns the formatted entries up to minLevel logged after the cursor,
+	// and the cursor to pass to get the entries logged next. A cursor of 0
+	// returns all entries in memory.
+	GetLogs(minLevel LogLevel, after uint64) (string, uint64)
+}
+
+const (
+	// Number of entries kept in memory
+	memoryEntries = 10000
+	// Size at which the log file is rotated
+	maxLogFileSize = 1024 * 1024
+	// Number of lines that can wait for the background writer before
+	// logging blocks
+	writeQueueSize = 4096
+)
+
+// A slot of the in-memory ring buffer. Each slot has its own lock, so
+// concurrent loggers only contend when they wrap around onto the same slot.
+type ringSlot struct {
+	mu    sync.Mutex
+	entry LogEntry
 }
 
-// FileLogger implements Logger with file output and in-memory storage
+// FileLogger implements Logger with file output and in-memory storage.
+// Messages above the logger's level are dropped before they are formatted.
+// Entries are kept in a fixed-size ring buffer, and written to the file by a
+// background goroutine, which rotates the file once it exceeds maxSize.
 type FileLogger struct {
-	file      *os.File
+	level     LogLevel // Most verbose level recorded at all
 	fileLevel LogLevel // Minimum level to write to file
-	mu        sync.Mutex
 	maxSize   int64
 	filePath  string
 
-	// In-memory storage for all logs
-	memoryLogs []LogEntry
-	maxMemory  int // Maximum number of entries to keep in memory
+	// In-memory storage of the latest entries
+	ring []ringSlot
+	last atomic.Uint64 // Sequence number of the latest entry
+
+	// Background writer. The file and its size are owned by writeLoop.
+	lines      chan string
+	done       chan struct{}
+	writerDone chan struct{}
+	closeOnce  sync.Once
+	file       *os.File
+	size       int64
 }
 
-// NewFileLogger creates a new file logger
-func NewFileLogger(logPath string, fileLevel LogLevel) (*FileLogger, error) {
+// NewFileLogger creates a new file logger. Messages up to fileLevel are
+// written to the file, and messages up to memoryLevel are kept in memory
+// for GetLogs.
+func NewFileLogger(logPath string, fileLevel, memoryLevel LogLevel) (*FileLogger, error) {
 	// Create log directory if needed
 	logDir := filepath.Dir(logPath)
 	if err := os.MkdirAll(logDir, 0755); err != nil {
 		return nil, fmt.Errorf("failed to create log directory: %v", err)
 	}
 
-	// Check if log file is too large and rotate if needed
-	maxSize := int64(1024 * 1024) // 1MB
+	// Rotate a log file that is too large already
+	maxSize := int64(maxLogFileSize)
 	if info, err := os.Stat(logPath); err == nil && info.Size() > maxSize {
-		// Delete old log file if it's too large
-		os.Remove(logPath)
+		os.Rename(logPath, rotatedLogPath(logPath))
 	}
 
 	// Open log file in append mode
@@ -66,98 +115,208 @@ func NewFileLogger(logPath string, fileLevel LogLevel) (*FileLogger, error) {
 	if err != nil {
 		return nil, fmt.Errorf("failed to open log file: %v", err)
 	}
+	var size int64
+	if info, err := file.Stat(); err == nil {
+		size = info.Size()
+	}
 
-	return &FileLogger{
-		file:       file,
+	level := fileLevel
+	if memoryLevel > level {
+		level = memoryLevel
+	}
+	l := &FileLogger{
+		level:      level,
 		fileLevel:  fileLevel,
 		maxSize:    maxSize,
 		filePath:   logPath,
-		memoryLogs: make([]LogEntry, 0, 10000),
-		maxMemory:  10000, // Keep last 10000 log entries in memory
-	}, nil
+		ring:       make([]ringSlot, memoryEntries),
+		lines:      make(chan string, writeQueueSize),
+		done:       make(chan struct{}),
+		writerDone: make(chan struct{}),
+		file:       file,
+		size:       size,
+	}
+	go l.writeLoop()
+	return l, nil
 }
 
-// log adds an entry to memory and optionally to file
-func (l *FileLogger) log(level LogLevel, format string, args ...interface{}) {
-	l.mu.Lock()
-	defer l.mu.Unlock()
+// Returns the path a log file is moved to when it is rotated
+func rotatedLogPath(logPath string) string {
+	return logPath + ".1"
+}
+
+// Returns true if messages of the level are recorded
+func (l *FileLogger) Enabled(level LogLevel) bool {
+	return level <= l.level
+}
 
-	// Create log entry
+// log adds an entry to memory and optionally to file
+func (l *FileLogger) log(level LogLevel, format string, args []interface{}) {
 	entry := LogEntry{
 		Timestamp: time.Now(),
 		Level:     level,
 		Message:   fmt.Sprintf(format, args...),
 	}
 
-	// Always add to memory (ring buffer)
-	if len(l.memoryLogs) >= l.maxMemory {
-		// Remove oldest entry if at capacity
-		l.memoryLogs = l.memoryLogs[1:]
+	entry.Seq = l.last.Add(1)
+	slot := &l.ring[(entry.Seq-1)%uint64(len(l.ring))]
+	slot.mu.Lock()
+	// A logger that wrapped around the ring meanwhile stored a newer entry
+	if slot.entry.Seq < entry.Seq {
+		slot.entry = entry
 	}
-	l.memoryLogs = append(l.memoryLogs, entry)
+	slot.mu.Unlock()
 
 	// Write to file if level meets threshold
 	if level <= l.fileLevel {
-		levelStr := "INFO"
-		switch level {
-		case LevelError:
-			levelStr = "ERROR"
-		case LevelDebug:
-			levelStr = "DEBUG"
+		select {
+		case l.lines <- formatEntry(entry) + "\n":
+		case <-l.done:
 		}
-		formatted := fmt.Sprintf("[%s] [%s] %s\n",
-			entry.Timestamp.Format("2006-01-02 15:04:05.000"),
-			levelStr,
-			entry.Message)
-		l.file.WriteString(formatted)
 	}
 }
 
 // Error logs an error message
 func (l *FileLogger) Error(format string, args ...interface{}) {
-	l.log(LevelError, format, args...)
+	if l.Enabled(LevelError) {
+		l.log(LevelError, format, args)
+	}
 }
 
 // Info logs an info message
 func (l *FileLogger) Info(format string, args ...interface{}) {
-	l.log(LevelInfo, format, args...)
+	if l.Enabled(LevelInfo) {
+		l.log(LevelInfo, format, args)
+	}
 }
 
 // Debug logs a debug message
 func (l *FileLogger) Debug(format string, args ...interface{}) {
-	l.log(LevelDebug, format, args...)
+	if l.Enabled(LevelDebug) {
+		l.log(LevelDebug, format, args)
+	}
 }
 
-// Close closes the log file
-func (l *FileLogger) Close() error {
-	l.mu.Lock()
-	defer l.mu.Unlock()
-	return l.file.Close()
-}
-
-// GetLogs returns filtered logs from memory
-func (l *FileLogger) GetLogs(minLevel LogLevel) string {
-	l.mu.Lock()
-	defer l.mu.Unlock()
-
-	var result []string
-	for _, entry := range l.memoryLogs {
-		if entry.Level <= minLevel {
-			levelStr := "INFO"
-			switch entry.Level {
-			case LevelError:
-				levelStr = "ERROR"
-			case LevelDebug:
-				levelStr = "DEBUG"
+// Writes queued lines to the file until the logger is closed, flushing
+// whenever the queue runs empty
+func (l *FileLogger) writeLoop() {
+	defer close(l.writerDone)
+	w := bufio.NewWriter(l.file)
+	for {
+		select {
+		case line := <-l.lines:
+			l.writeLine(w, line)
+			if len(l.lines) == 0 {
+				w.Flush()
+			}
+		case <-l.done:
+			for {
+				select {
+				case line := <-l.lines:
+					l.writeLine(w, line)
+				default:
+					w.Flush()
+					return
+				}
 			}
-			formatted := fmt.Sprintf("[%s] [%s] %s",
-				entry.Timestamp.Format("2006-01-02 15:04:05.000"),
-				levelStr,
-				entry.Message)
-			result = append(result, formatted)
 		}
 	}
-	return strings.Join(result, "\n")
+}
+
+func (l *FileLogger) writeLine(w *bufio.Writer, line string) {
+	if l.size > 0 && l.size+int64(len(line)) > l.maxSize {
+		l.rotate(w)
+	}
+	if l.file == nil {
+		return
+	}
+	w.WriteString(line)
+	l.size += int64(len(line))
+}
+
+// Moves the full log file aside and starts a new one. If the new file can't
+// be created, file output stops.
+func (l *FileLogger) rotate(w *bufio.Writer) {
+	w.Flush()
+	l.file.Close()
+	os.Rename(l.filePath, rotatedLogPath(l.filePath))
+
+	file, err := os.OpenFile(l.filePath, os.O_CREATE|os.O_WRONLY|os.O_TRUNC, 0644)
+	if err != nil {
+		l.file = nil
+		return
+	}
+	l.file = file
+	l.size = 0
+	w.Reset(file)
+}
+
+// Close writes the queued lines and closes the log file. Messages logged
+// afterwards are only kept in memory.
+func (l *FileLogger) Close() error {
+	var err error
+	l.closeOnce.Do(func() {
+		close(l.done)
+		<-l.writerDone
+		if l.file != nil {
+			err = l.file.Close()
+		}
+	})
+	return err
+}
+
+// Returns the entries up to minLevel logged after the cursor, and the
+// sequence number of the latest entry read. Entries that were overwritten
+// in the ring buffer before they could be read are skipped.
+func (l *FileLogger) Entries(minLevel LogLevel, after uint64) ([]LogEntry, uint64) {
+	last := l.last.Load()
+	first := after + 1
+	if size := uint64(len(l.ring)); last > size && first <= last-size {
+		first = last - size + 1
+	}
+
+	var entries []LogEntry
+	for seq := first; seq <= last; seq++ {
+		slot := &l.ring[(seq-1)%uint64(len(l.ring))]
+		slot.mu.Lock()
+		entry := slot.entry
+		slot.mu.Unlock()
+
+		if entry.Seq < seq {
+			// Still being stored, continue from here next time
+			return entries, seq - 1
+		}
+		if entry.Seq == seq && entry.Level <= minLevel {
+			entries = append(entries, entry)
+		}
+	}
+	return entries, last
+}
+
+// GetLogs returns formatted logs from memory
+func (l *FileLogger) GetLogs(minLevel LogLevel, after uint64) (string, uint64) {
+	entries, cursor := l.Entries(minLevel, after)
+
+	var result strings.Builder
+	for i, entry := range entries {
+		if i > 0 {
+			result.WriteByte('\n')
+		}
+		result.WriteString(formatEntry(entry))
+	}
+	return result.String(), cursor
+}
+
+// Formats an entry as a log line, without the line break
+func formatEntry(entry LogEntry) string {
+	buf := make([]byte, 0, 40+len(entry.Message))
+	buf = append(buf, '[')
+	buf = entry.Timestamp.AppendFormat(buf, "2006-01-02 15:04:05.000")
+	buf = append(buf, "] ["...)
+	buf = append(buf, entry.Level.String()...)
+	buf = append(buf, "] "...)
+	buf = append(buf, entry.Message...)
+	return string(buf)
 }
 
 // NullLogger is a logger that discards all messages
@@ -166,4 +325,7 @@ type NullLogger struct{}
 func (n *NullLogger) Error(format string, args ...interface{}) {}
 func (n *NullLogger) Info(format string, args ...interface{})  {}
 func (n *NullLogger) Debug(format string, args ...interface{}) {}
-func (n *NullLogger) GetLogs(minLevel LogLevel) string         { return "" }
+func (n *NullLogger) Enabled(level LogLevel) bool              { return false }
+func (n *NullLogger) GetLogs(minLevel LogLevel, after uint64) (string, uint64) {
+	return "", after
+}
@@ -0,0 +1,192 @@
+package logger
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"testing"
+)
+
+func newTestLogger(t testing.TB, fileLevel, memoryLevel LogLevel) (*FileLogger, string) {
+	t.Helper()
+	logPath := filepath.Join(t.TempDir(), "daemon.log")
+	l, err := NewFileLogger(logPath, fileLevel, memoryLevel)
+	if err != nil {
+		t.Fatal(err)
+	}
+	t.Cleanup(func() { l.Close() })
+	return l, logPath
+}
+
+func TestFilteredLevelsAreNotRecorded(t *testing.T) {
+	l, logPath := newTestLogger(t, LevelInfo, LevelInfo)
+	l.Debug("hidden %d", 1)
+	l.Info("shown %d", 2)
+	l.Error("failed %d", 3)
+
+	if l.Enabled(LevelDebug) || !l.Enabled(LevelInfo) {
+		t.Error("Enabled doesn't match the logger's level")
+	}
+	logs, _ := l.GetLogs(LevelDebug, 0)
+	if strings.Contains(logs, "hidden") || !strings.Contains(logs, "[INFO] shown 2") || !strings.Contains(logs, "[ERROR] failed 3") {
+		t.Errorf("Unexpected logs:\n%s", logs)
+	}
+	errors, _ := l.GetLogs(LevelError, 0)
+	if strings.Contains(errors, "shown") {
+		t.Errorf("Error logs contain an info message:\n%s", errors)
+	}
+
+	l.Close()
+	data, err := os.ReadFile(logPath)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if got := strings.Count(string(data), "\n"); got != 2 {
+		t.Errorf("Log file has %d lines, want 2:\n%s", got, data)
+	}
+}
+
+func TestMemoryLevelAboveFileLevel(t *testing.T) {
+	l, logPath := newTestLogger(t, LevelInfo, LevelDebug)
+	l.Debug("details")
+	l.Close()
+
+	if logs, _ := l.GetLogs(LevelDebug, 0); !strings.Contains(logs, "[DEBUG] details") {
+		t.Errorf("Debug message not kept in memory:\n%s", logs)
+	}
+	if data, _ := os.ReadFile(logPath); len(data) != 0 {
+		t.Errorf("Debug message written to the file:\n%s", data)
+	}
+}
+
+func TestRingBufferKeepsLatestEntries(t *testing.T) {
+	l, _ := newTestLogger(t, LevelError, LevelInfo)
+	total := memoryEntries + 123
+	for i := 1; i <= total; i++ {
+		l.Info("entry %d", i)
+	}
+
+	entries, cursor := l.Entries(LevelInfo, 0)
+	if len(entries) != memoryEntries || cursor != uint64(total) {
+		t.Fatalf("Got %d entries up to %d, want %d up to %d", len(entries), cursor, memoryEntries, total)
+	}
+	if first := entries[0].Message; first != "entry 124" {
+		t.Errorf("Oldest entry is %q, want entry 124", first)
+	}
+	if last := entries[len(entries)-1].Message; last != fmt.Sprintf("entry %d", total) {
+		t.Errorf("Latest entry is %q", last)
+	}
+}
+
+func TestCursorReturnsNewEntries(t *testing.T) {
+	l, _ := newTestLogger(t, LevelError, LevelInfo)
+	l.Info("first")
+	logs, cursor := l.GetLogs(LevelInfo, 0)
+	if !strings.Contains(logs, "first") || cursor != 1 {
+		t.Fatalf("Got %q up to %d", logs, cursor)
+	}
+
+	if logs, next := l.GetLogs(LevelInfo, cursor); logs != "" || next != cursor {
+		t.Errorf("Got %q up to %d without new entries", logs, next)
+	}
+
+	l.Info("second")
+	l.Info("third")
+	logs, cursor = l.GetLogs(LevelInfo, cursor)
+	if strings.Contains(logs, "first") || !strings.Contains(logs, "second") || !strings.Contains(logs, "third") || cursor != 3 {
+		t.Errorf("Got %q up to %d", logs, cursor)
+	}
+}
+
+func TestConcurrentLogging(t *testing.T) {
+	l, _ := newTestLogger(t, LevelInfo, LevelInfo)
+	var wg sync.WaitGroup
+	for g := 0; g < 8; g++ {
+		wg.Add(1)
+		go func(g int) {
+			defer wg.Done()
+			for i := 0; i < 500; i++ {
+				l.Info("goroutine %d entry %d", g, i)
+			}
+		}(g)
+	}
+	wg.Wait()
+
+	entries, cursor := l.Entries(LevelInfo, 0)
+	if len(entries) != 4000 || cursor != 4000 {
+		t.Errorf("Got %d entries up to %d, want 4000", len(entries), cursor)
+	}
+	for i, entry := range entries {
+		if entry.Seq != uint64(i+1) {
+			t.Fatalf("Entry %d has sequence number %d", i, entry.Seq)
+		}
+	}
+}
+
+func TestLogFileIsRotated(t *testing.T) {
+	l, logPath := newTestLogger(t, LevelInfo, LevelInfo)
+	l.maxSize = 1000
+	for i := 0; i < 100; i++ {
+		l.Info("line %d", i)
+	}
+	l.Close()
+
+	current, err := os.Stat(logPath)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if current.Size() > 1000 {
+		t.Errorf("Log file has %d bytes, more than its maximum size", current.Size())
+	}
+	data, err := os.ReadFile(rotatedLogPath(logPath))
+	if err != nil {
+		t.Fatalf("Rotated log file is missing: %v", err)
+	}
+	if len(data) == 0 || len(data) > 1000 {
+		t.Errorf("Rotated log file has %d bytes", len(data))
+	}
+}
+
+func BenchmarkDebugFiltered(b *testing.B) {
+	l, _ := newTestLogger(b, LevelInfo, LevelInfo)
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		l.Debug("Received notification %s for %s", "textDocument/publishDiagnostics", "file:///src/main.cpp")
+	}
+}
+
+func BenchmarkInfo(b *testing.B) {
+	l, _ := newTestLogger(b, LevelInfo, LevelInfo)
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		l.Info("Request %d completed in %s", i, "12ms")
+	}
+}
+
+func BenchmarkInfoParallel(b *testing.B) {
+	l, _ := newTestLogger(b, LevelInfo, LevelInfo)
+	b.ReportAllocs()
+	b.ResetTimer()
+	b.RunParallel(func(pb *testing.PB) {
+		for pb.Next() {
+			l.Info("Request completed in %s", "12ms")
+		}
+	})
+}
+
+func BenchmarkGetLogsFollow(b *testing.B) {
+	l, _ := newTestLogger(b, LevelError, LevelInfo)
+	for i := 0; i < memoryEntries; i++ {
+		l.Info("entry %d", i)
+	}
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		l.Info("new entry")
+		l.GetLogs(LevelInfo, l.last.Load()-1)
+	}
+}
@@ -0,0 +1,582 @@
+// Package projectgen generates C++ projects of any size in the style of the
+// sample project in test/fixtures: a game engine with namespaces per module,
+// inheritance chains from GameObject and Component, classes that use each
+// other across modules, and a few very large headers. The generated projects
+// are deterministic for a seed and build with CMake, so they can be used to
+// measure how the daemon and clangd scale.
+package projectgen
+
+import (
+	"fmt"
+	"math/rand"
+	"os"
+	"path/filepath"
+	"strings"
+)
+
+const (
+	// Classes per module, each module is a directory and a namespace
+	moduleSize = 100
+
+	// Length of the inheritance chains below GameObject and Component
+	inheritanceDepth = 5
+
+	// Every this many classes, one is a manager with a header of a few
+	// thousand lines, like large_ui_manager.h of the sample project
+	largeClassEvery   = 500
+	largeClassMethods = 300
+
+	// Headers of other classes each source file includes and uses at most
+	maxDependencies = 3
+)
+
+// Options configure a generated project
+type Options struct {
+	// Number of translation units (.cpp files), including main.cpp
+	TranslationUnits int
+	// Seed of the names, members and dependencies
+	Seed int64
+}
+
+// Project describes a generated project, so measurements can query symbols
+// that are known to exist
+type Project struct {
+	Root    string
+	Classes []Class
+}
+
+// Class is a generated class with its own header and source file
+type Class struct {
+	Name      string
+	Namespace string   // e.g. "game_engine::combat"
+	Base      string   // Qualified name of the base class
+	Header    string   // Relative to the project root
+	Source    string   // Relative to the project root
+	Methods   []string // Methods declared in the header and defined in the source
+}
+
+// Returns the qualified name of the class
+func (c *Class) QualifiedName() string {
+	return c.Namespace + "::" + c.Name
+}
+
+type param struct {
+	typ  string
+	name string
+}
+
+type method struct {
+	name    string
+	returns string
+	params  []param
+	doc     string
+}
+
+type field struct {
+	typ  string
+	name string // Without the trailing underscore
+}
+
+// Everything needed to write a class
+type classSpec struct {
+	Class
+	module       string
+	guard        string
+	component    bool // Derives from Component rather than GameObject
+	baseHeader   string
+	methods      []method
+	fields       []field
+	dependencies []*classSpec
+}
+
+var (
+	moduleNames = []string{"ai", "animation", "audio", "combat", "gameplay", "input", "inventory",
+		"network", "physics", "quests", "rendering", "scripting", "terrain", "ui", "weather", "world"}
+	adjectives = []string{"Armored", "Ancient", "Burning", "Crystal", "Dynamic", "Elite", "Frozen",
+		"Hidden", "Iron", "Mystic", "Noble", "Rapid", "Shadow", "Silent", "Static", "Storm",
+		"Swift", "Toxic", "Vast", "Wild"}
+	nouns = []string{"Archer", "Beacon", "Bridge", "Camera", "Cannon", "Controller", "Drone", "Emitter",
+		"Engine", "Gate", "Guardian", "Knight", "Launcher", "Mage", "Portal", "Sensor", "Shield",
+		"Spawner", "Tower", "Trigger", "Turret", "Vehicle", "Volume", "Wall"}
+	verbs = []string{"Apply", "Calculate", "Compute", "Configure", "Emit", "Evaluate", "Find",
+		"Handle", "Load", "Merge", "Process", "Refresh", "Reset", "Resolve", "Schedule", "Store",
+		"Sync", "Track", "Validate"}
+	objects = []string{"Cooldown", "Damage", "Energy", "Path", "Position", "Priority", "Range",
+		"Score", "Speed", "State", "Target", "Threshold", "Velocity", "Weight"}
+	paramTypes = []string{"int", "float", "bool", "const std::string&"}
+	fieldTypes = []string{"int", "float", "bool", "std::string", "std::vector<int>"}
+	returns    = []string{"void", "void", "int", "float", "bool"}
+)
+
+// Generates a project into dir, which is created if needed. Existing files
+// with the same names are overwritten.
+func Generate(dir string, opts Options) (*Project, error) {
+	if opts.TranslationUnits < 2 {
+		return nil, fmt.Errorf("a project needs at least 2 translation units, got %d", opts.TranslationUnits)
+	}
+	rng := rand.New(rand.NewSource(opts.Seed))
+	specs := planClasses(rng, opts.TranslationUnits-1)
+
+	w := &writer{root: dir}
+	w.write("CMakeLists.txt", cmakeLists)
+	w.write("include/core/interfaces.h", interfacesHeader)
+	w.write("include/core/game_object.h", gameObjectHeader)
+	w.write("include/core/component.h", componentHeader)
+	for _, spec := range specs {
+		w.write(spec.Header, spec.header())
+		w.write(spec.Source, spec.source())
+	}
+	w.write("src/main.cpp", mainSource(specs))
+	if w.err != nil {
+		return nil, w.err
+	}
+
+	project := &Project{Root: dir, Classes: make([]Class, len(specs))}
+	for i, spec := range specs {
+		project.Classes[i] = spec.Class
+	}
+	return project, nil
+}
+
+// Decides the names, bases, members and dependencies of all classes
+func planClasses(rng *rand.Rand, count int) []*classSpec {
+	specs := make([]*classSpec, count)
+	used := make(map[string]bool)
+
+	for i := range specs {
+		module := moduleNames[(i/moduleSize)%len(moduleNames)]
+		if round := i / (moduleSize * len(moduleNames)); round > 0 {
+			module = fmt.Sprintf("%s%d", module, round+1)
+		}
+
+		name := adjectives[rng.Intn(len(adjectives))] + nouns[rng.Intn(len(nouns))]
+		if i%largeClassEvery == largeClassEvery-1 {
+			name = toCamelCase(module) + "Manager"
+		}
+		for n := 2; used[name]; n++ {
+			name = fmt.Sprintf("%s%s%d", adjectives[rng.Intn(len(adjectives))], nouns[rng.Intn(len(nouns))], n)
+		}
+		used[name] = true
+
+		file := toSnakeCase(name)
+		spec := &classSpec{
+			Class: Class{
+				Name:      name,
+				Namespace: "game_engine::" + module,
+				Header:    fmt.Sprintf("include/%s/%s.h", module, file),
+				Source:    fmt.Sprintf("src/%s/%s.cpp", module, file),
+			},
+			module: module,
+			guard:  strings.ToUpper(module + "_" + file + "_H_"),
+		}
+
+		// Chains of inheritanceDepth classes within a module, every third
+		// chain made of components
+		local := i % moduleSize
+		spec.component = (local/inheritanceDepth)%3 == 2
+		if local%inheritanceDepth == 0 {
+			if spec.component {
+				spec.Base, spec.baseHeader = "game_engine::Component", "core/component.h"
+			} else {
+				spec.Base, spec.baseHeader = "game_engine::GameObject", "core/game_object.h"
+			}
+		} else {
+			parent := specs[i-1]
+			spec.Base = parent.QualifiedName()
+			spec.baseHeader = strings.TrimPrefix(parent.Header, "include/")
+		}
+
+		methodCount := 4 + rng.Intn(9)
+		if i%largeClassEvery == largeClassEvery-1 {
+			methodCount = largeClassMethods
+		}
+		spec.methods = planMethods(rng, methodCount)
+		for _, m := range spec.methods {
+			spec.Methods = append(spec.Methods, m.name)
+		}
+		for n := 2 + rng.Intn(5); n > 0; n-- {
+			spec.fields = append(spec.fields, field{
+				typ:  fieldTypes[rng.Intn(len(fieldTypes))],
+				name: fmt.Sprintf("%s_%d", toSnakeCase(objects[rng.Intn(len(objects))]), len(spec.fields)),
+			})
+		}
+
+		// Earlier classes, mostly from the same module
+		for n := rng.Intn(maxDependencies + 1); n > 0 && i > 0; n-- {
+			var dep *classSpec
+			if rng.Intn(4) == 0 {
+				dep = specs[rng.Intn(i)]
+			} else {
+				start := i - local
+				if start == i {
+					continue
+				}
+				dep = specs[start+rng.Intn(i-start)]
+			}
+			spec.dependencies = append(spec.dependencies, dep)
+		}
+
+		specs[i] = spec
+	}
+	return specs
+}
+
+func planMethods(rng *rand.Rand, count int) []method {
+	methods := make([]method, 0, count)
+	names := make(map[string]bool)
+	for len(methods) < count {
+		name := verbs[rng.Intn(len(verbs))] + objects[rng.Intn(len(objects))]
+		if names[name] {
+			name = fmt.Sprintf("%s%d", name, len(methods))
+		}
+		names[name] = true
+
+		m := method{name: name, returns: returns[rng.Intn(len(returns))]}
+		for n := rng.Intn(4); n > 0; n-- {
+			m.params = append(m.params, param{
+				typ:  paramTypes[rng.Intn(len(paramTypes))],
+				name: fmt.Sprintf("%s_%d", toSnakeCase(objects[rng.Intn(len(objects))]), len(m.params)),
+			})
+		}
+		if rng.Intn(2) == 0 {
+			m.doc = fmt.Sprintf("%s the %s of the object", thirdPerson(verbs[rng.Intn(len(verbs))]),
+				strings.ToLower(objects[rng.Intn(len(objects))]))
+		}
+		methods = append(methods, m)
+	}
+	return methods
+}
+
+func (s *classSpec) header() string {
+	var b strings.Builder
+	fmt.Fprintf(&b, "#ifndef %s\n#define %s\n\n", s.guard, s.guard)
+	b.WriteString("#include <string>\n#include <vector>\n\n")
+	fmt.Fprintf(&b, "#include \"%s\"\n\n", s.baseHeader)
+	fmt.Fprintf(&b, "namespace %s {\n\n", s.Namespace)
+
+	fmt.Fprintf(&b, "/**\n * @brief %s %s of the %s module\n */\n",
+		article(s.Name), s.Name, s.module)
+	fmt.Fprintf(&b, "class %s : public %s {\n public:\n", s.Name, s.Base)
+	fmt.Fprintf(&b, "  explicit %s(const std::string& name);\n", s.Name)
+	fmt.Fprintf(&b, "  ~%s() override;\n\n", s.Name)
+
+	for _, m := range s.methods {
+		if m.doc != "" {
+			fmt.Fprintf(&b, "  /**\n   * @brief %s\n", m.doc)
+			for _, p := range m.params {
+				fmt.Fprintf(&b, "   * @param %s The %s\n", p.name, p.name[:strings.LastIndexByte(p.name, '_')])
+			}
+			b.WriteString("   */\n")
+		}
+		fmt.Fprintf(&b, "  %s %s(%s);\n\n", m.returns, m.name, formatParams(m.params))
+	}
+
+	for _, f := range s.fields {
+		accessor := toCamelCase(f.name)
+		typ := f.typ
+		if strings.HasPrefix(typ, "std::") {
+			typ = "const " + typ + "&"
+		}
+		fmt.Fprintf(&b, "  %s Get%s() const { return %s_; }\n", typ, accessor, f.name)
+		fmt.Fprintf(&b, "  void Set%s(%s value) { %s_ = value; }\n", accessor, typ, f.name)
+	}
+
+	b.WriteString("\n protected:\n  void OnUpdate(float delta_time) override;\n\n private:\n")
+	for _, f := range s.fields {
+		fmt.Fprintf(&b, "  %s %s_{};\n", f.typ, f.name)
+	}
+	fmt.Fprintf(&b, "};\n\n}  // namespace %s\n\n#endif  // %s\n", s.Namespace, s.guard)
+	return b.String()
+}
+
+func (s *classSpec) source() string {
+	var b strings.Builder
+	fmt.Fprintf(&b, "#include \"%s\"\n\n", strings.TrimPrefix(s.Header, "include/"))
+	included := map[string]bool{s.Header: true}
+	for _, dep := range s.dependencies {
+		if !included[dep.Header] {
+			included[dep.Header] = true
+			fmt.Fprintf(&b, "#include \"%s\"\n", strings.TrimPrefix(dep.Header, "include/"))
+		}
+	}
+	if len(included) > 1 {
+		b.WriteByte('\n')
+	}
+	fmt.Fprintf(&b, "namespace %s {\n\n", s.Namespace)
+
+	fmt.Fprintf(&b, "%s::%s(const std::string& name) : %s(name) {\n}\n\n", s.Name, s.Name, s.Base)
+	fmt.Fprintf(&b, "%s::~%s() = default;\n\n", s.Name, s.Name)
+
+	for i, m := range s.methods {
+		fmt.Fprintf(&b, "%s %s::%s(%s) {\n", m.returns, s.Name, m.name, formatParams(m.params))
+		for _, p := range m.params {
+			fmt.Fprintf(&b, "  (void)%s;\n", p.name)
+		}
+		// The first methods use the dependencies
+		if i < len(s.dependencies) {
+			dep := s.dependencies[i]
+			call := dep.methods[i%len(dep.methods)]
+			fmt.Fprintf(&b, "  %s helper(\"%s\");\n", dep.QualifiedName(), strings.ToLower(dep.Name))
+			fmt.Fprintf(&b, "  helper.%s(%s);\n", call.name, callArguments(call.params))
+		}
+		switch m.returns {
+		case "int":
+			b.WriteString("  return 0;\n")
+		case "float":
+			b.WriteString("  return 0.0f;\n")
+		case "bool":
+			b.WriteString("  return true;\n")
+		}
+		b.WriteString("}\n\n")
+	}
+
+	fmt.Fprintf(&b, "void %s::OnUpdate(float delta_time) {\n", s.Name)
+	fmt.Fprintf(&b, "  %s::OnUpdate(delta_time);\n", s.Base)
+	fmt.Fprintf(&b, "}\n\n}  // namespace %s\n", s.Namespace)
+	return b.String()
+}
+
+func mainSource(specs []*classSpec) string {
+	var b strings.Builder
+	b.WriteString("#include <iostream>\n\n")
+	shown := specs
+	if len(shown) > 10 {
+		shown = shown[:10]
+	}
+	for _, spec := range shown {
+		fmt.Fprintf(&b, "#include \"%s\"\n", strings.TrimPrefix(spec.Header, "include/"))
+	}
+	b.WriteString("\nint main() {\n")
+	for i, spec := range shown {
+		fmt.Fprintf(&b, "  %s object%d(\"object%d\");\n", spec.QualifiedName(), i, i)
+		fmt.Fprintf(&b, "  object%d.Update(0.016f);\n", i)
+	}
+	b.WriteString("  std::cout << \"Done\\n\";\n  return 0;\n}\n")
+	return b.String()
+}
+
+func formatParams(params []param) string {
+	parts := make([]string, len(params))
+	for i, p := range params {
+		parts[i] = p.typ + " " + p.name
+	}
+	return strings.Join(parts, ", ")
+}
+
+func callArguments(params []param) string {
+	args := make([]string, len(params))
+	for i, p := range params {
+		switch p.typ {
+		case "int":
+			args[i] = "1"
+		case "float":
+			args[i] = "1.0f"
+		case "bool":
+			args[i] = "true"
+		default:
+			args[i] = "\"value\""
+		}
+	}
+	return strings.Join(args, ", ")
+}
+
+// Converts "ArmoredKnight" to "armored_knight"
+func toSnakeCase(name string) string {
+	var b strings.Builder
+	for i, r := range name {
+		if r >= 'A' && r <= 'Z' {
+			if i > 0 {
+				b.WriteByte('_')
+			}
+			r += 'a' - 'A'
+		}
+		b.WriteRune(r)
+	}
+	return b.String()
+}
+
+// Converts "damage_2" to "Damage2"
+func toCamelCase(name string) string {
+	var b strings.Builder
+	for _, part := range strings.Split(name, "_") {
+		if part != "" {
+			b.WriteString(strings.ToUpper(part[:1]) + part[1:])
+		}
+	}
+	return b.String()
+}
+
+// Converts "Apply" to "Applies", "Process" to "Processes"
+func thirdPerson(verb string) string {
+	switch {
+	case strings.HasSuffix(verb, "y"):
+		return verb[:len(verb)-1] + "ies"
+	case strings.HasSuffix(verb, "s"), strings.HasSuffix(verb, "sh"):
+		return verb + "es"
+	}
+	return verb + "s"
+}
+
+func article(word string) string {
+	if strings.ContainsRune("AEIOU", rune(word[0])) {
+		return "An"
+	}
+	return "A"
+}
+
+// Writes files, keeping the first error
+type writer struct {
+	root string
+	err  error
+}
+
+func (w *writer) write(path, content string) {
+	if w.err != nil {
+		return
+	}
+	path = filepath.Join(w.root, path)
+	if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+		w.err = err
+		return
+	}
+	w.err = os.WriteFile(path, []byte(content), 0644)
+}
+
+const cmakeLists = `cmake_minimum_required(VERSION 3.20)
+project(GeneratedGameEngine LANGUAGES CXX)
+
+file(GLOB_RECURSE SOURCES "src/*.cpp")
+file(GLOB_RECURSE HEADERS "include/*.h")
+
+add_executable(game_engine ${SOURCES} ${HEADERS})
+target_compile_features(game_engine PRIVATE cxx_std_20)
+target_include_directories(game_engine PRIVATE include)
+`
+
+const interfacesHeader = `#ifndef CORE_INTERFACES_H_
+#define CORE_INTERFACES_H_
+
+namespace game_engine {
+
+/**
+ * @brief Base interface for objects that can be updated in the game loop
+ */
+class Updatable {
+ public:
+  virtual ~Updatable() = default;
+
+  /**
+   * @brief Updates the object state
+   * @param delta_time Time elapsed since last update in seconds
+   */
+  virtual void Update(float delta_time) = 0;
+
+  /**
+   * @brief Checks if the object should be updated
+   * @return true if the object is active and should be updated
+   */
+  virtual bool IsActive() const = 0;
+};
+
+}  // namespace game_engine
+
+#endif  // CORE_INTERFACES_H_
+`
+
+const gameObjectHeader = `#ifndef CORE_GAME_OBJECT_H_
+#define CORE_GAME_OBJECT_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/component.h"
+#include "core/interfaces.h"
+
+namespace game_engine {
+
+/**
+ * @brief Base class for all game objects in the engine
+ *
+ * GameObject represents any entity in the game world. It can contain
+ * multiple components that define its behavior and properties.
+ */
+class GameObject : public Updatable {
+ public:
+  explicit GameObject(const std::string& name) : name_(name) {}
+  virtual ~GameObject() = default;
+
+  // Updatable interface
+  void Update(float delta_time) override {
+    for (auto& component : components_) {
+      component->Update(delta_time);
+    }
+    OnUpdate(delta_time);
+  }
+  bool IsActive() const override { return active_; }
+
+  const std::string& GetName() const { return name_; }
+  void SetActive(bool active) { active_ = active; }
+
+  void AddComponent(std::unique_ptr<Component> component) {
+    components_.push_back(std::move(component));
+  }
+
+ protected:
+  virtual void OnUpdate(float delta_time) { (void)delta_time; }
+
+ private:
+  std::string name_;
+  bool active_ = true;
+  std::vector<std::unique_ptr<Component>> components_;
+};
+
+}  // namespace game_engine
+
+#endif  // CORE_GAME_OBJECT_H_
+`
+
+const componentHeader = `#ifndef CORE_COMPONENT_H_
+#define CORE_COMPONENT_H_
+
+#include <string>
+
+#include "core/interfaces.h"
+
+namespace game_engine {
+
+/**
+ * @brief Base class for all components
+ *
+ * Components are modular pieces of functionality that can be
+ * attached to GameObjects.
+ */
+class Component : public Updatable {
+ public:
+  explicit Component(const std::string& type_name) : type_name_(type_name) {}
+  virtual ~Component() = default;
+
+  const std::string& GetTypeName() const { return type_name_; }
+
+  // Updatable interface
+  void Update(float delta_time) override {
+    if (IsActive()) {
+      OnUpdate(delta_time);
+    }
+  }
+  bool IsActive() const override { return enabled_; }
+
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+
+ protected:
+  virtual void OnUpdate(float delta_time) { (void)delta_time; }
+
+ private:
+  std::string type_name_;
+  bool enabled_ = true;
+};
+
+}  // namespace game_engine
+
+#endif  // CORE_COMPONENT_H_
+`
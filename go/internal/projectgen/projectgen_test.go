@@ -0,0 +1,116 @@
+package projectgen
+
+import (
+	"io/fs"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strings"
+	"testing"
+)
+
+// Returns the files of a directory tree by their relative path
+func readTree(t *testing.T, root string) map[string]string {
+	t.Helper()
+	files := make(map[string]string)
+	err := filepath.WalkDir(root, func(path string, entry fs.DirEntry, err error) error {
+		if err != nil || entry.IsDir() {
+			return err
+		}
+		data, err := os.ReadFile(path)
+		if err != nil {
+			return err
+		}
+		rel, _ := filepath.Rel(root, path)
+		files[rel] = string(data)
+		return nil
+	})
+	if err != nil {
+		t.Fatal(err)
+	}
+	return files
+}
+
+func TestGenerateIsDeterministic(t *testing.T) {
+	first, second := t.TempDir(), t.TempDir()
+	opts := Options{TranslationUnits: 250, Seed: 7}
+	project, err := Generate(first, opts)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, err := Generate(second, opts); err != nil {
+		t.Fatal(err)
+	}
+
+	files, again := readTree(t, first), readTree(t, second)
+	if len(files) != len(again) {
+		t.Fatalf("Generated %d and %d files", len(files), len(again))
+	}
+	sources := 0
+	for path, content := range files {
+		if again[path] != content {
+			t.Errorf("%s differs between runs", path)
+		}
+		if strings.HasSuffix(path, ".cpp") {
+			sources++
+		}
+	}
+	if sources != opts.TranslationUnits {
+		t.Errorf("Expected %d translation units, got %d", opts.TranslationUnits, sources)
+	}
+	if len(project.Classes) != opts.TranslationUnits-1 {
+		t.Errorf("Expected %d classes, got %d", opts.TranslationUnits-1, len(project.Classes))
+	}
+	for _, class := range project.Classes {
+		if _, ok := files[class.Header]; !ok {
+			t.Errorf("Header of %s missing: %s", class.Name, class.Header)
+		}
+	}
+}
+
+func TestGenerateInheritanceChains(t *testing.T) {
+	project, err := Generate(t.TempDir(), Options{TranslationUnits: 101, Seed: 1})
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	// Each class derives from the previous one, except at the start of a chain
+	for i, class := range project.Classes {
+		if i%inheritanceDepth == 0 {
+			if class.Base != "game_engine::GameObject" && class.Base != "game_engine::Component" {
+				t.Errorf("%s starts a chain, but derives from %s", class.Name, class.Base)
+			}
+		} else if want := project.Classes[i-1].QualifiedName(); class.Base != want {
+			t.Errorf("Expected %s to derive from %s, got %s", class.Name, want, class.Base)
+		}
+	}
+}
+
+// Compiles part of a generated project, including its large header, to make
+// sure the generated code is valid C++
+func TestGeneratedProjectCompiles(t *testing.T) {
+	compiler, err := exec.LookPath("c++")
+	if err != nil {
+		t.Skip("requires a C++ compiler")
+	}
+	root := t.TempDir()
+	project, err := Generate(root, Options{TranslationUnits: largeClassEvery + 1, Seed: 3})
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	manager := project.Classes[largeClassEvery-1]
+	if len(manager.Methods) != largeClassMethods {
+		t.Fatalf("Expected %s to have %d methods, got %d", manager.Name, largeClassMethods, len(manager.Methods))
+	}
+	args := []string{"-std=c++20", "-fsyntax-only", "-Iinclude", "src/main.cpp", manager.Source}
+	for _, class := range project.Classes[:10] {
+		args = append(args, class.Source)
+	}
+
+	cmd := exec.Command(compiler, args...)
+	cmd.Dir = root
+	if output, err := cmd.CombinedOutput(); err != nil {
+		t.Fatalf("Compiling the generated project failed: %v\n%s", err, output)
+	}
+}
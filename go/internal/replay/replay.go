@@ -0,0 +1,332 @@
+// Package replay pretends to be clangd by serving a recorded LSP session.
+// Requests are answered with the responses recorded for them, after the
+// latency they had, optionally scaled, and the notifications clangd sent in
+// between, e.g. the end of indexing, are sent again at the same points.
+// Commands can therefore be tested and benchmarked without clangd, with the
+// same results every time.
+//
+// Sessions are recorded by the daemon when CLANGD_DAEMON_LSP_RECORD names a
+// file. A recording made in one checkout of a project can be replayed in
+// another one, paths below the project root are translated. Sessions can
+// also be written by hand in the same format, like the synthetic ones the
+// tests of the commands package replay.
+package replay
+
+import (
+	"bufio"
+	"encoding/json"
+	"fmt"
+	"io"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/logger"
+)
+
+// A message the client sent in the recorded session and what clangd did in
+// response
+type exchange struct {
+	method    string
+	params    string        // Canonical JSON, with the recorded project root
+	sentAt    int64         // Microseconds into the recording
+	response  string        // Result or error member, empty for notifications
+	latency   time.Duration // Until the response arrived
+	followers []follower    // Notifications clangd sent before the client's next message
+}
+
+// A notification clangd sent after a message of the client
+type follower struct {
+	delay   time.Duration // Since the client's message
+	message json.RawMessage
+}
+
+// Server answers LSP messages from a recorded session. A message is matched
+// to the recorded message with the same method and parameters, or, if there
+// is none, e.g. because the files changed, to the next recorded message of
+// the same method.
+type Server struct {
+	scale    float64
+	rootPath string                 // Recorded project root
+	exact    map[string][]*exchange // By method and parameters
+	byMethod map[string][]*exchange // In recorded order
+
+	mu       sync.Mutex
+	next     map[string]int // Rotates through equally good matches
+	livePath string         // Project root of the replaying client
+
+	writeMu sync.Mutex
+}
+
+// The parts of an LSP message the server looks at
+type message struct {
+	ID     json.RawMessage `json:"id,omitempty"`
+	Method string          `json:"method,omitempty"`
+	Params json.RawMessage `json:"params,omitempty"`
+	Result json.RawMessage `json:"result,omitempty"`
+	Error  json.RawMessage `json:"error,omitempty"`
+}
+
+// Loads a recording made with clangd.Recorder. Latencies are multiplied by
+// scale: 1 replays them as recorded, 0 answers immediately.
+func Load(path string, scale float64) (*Server, error) {
+	messages, err := clangd.ReadRecording(path)
+	if err != nil {
+		return nil, fmt.Errorf("failed to read recording: %v", err)
+	}
+	return NewServer(messages, scale)
+}
+
+// Creates a server for the messages of a recording
+func NewServer(messages []clangd.RecordedMessage, scale float64) (*Server, error) {
+	s := &Server{
+		scale:    scale,
+		exact:    make(map[string][]*exchange),
+		byMethod: make(map[string][]*exchange),
+		next:     make(map[string]int),
+	}
+
+	pending := make(map[string]*exchange) // Requests by ID
+	var last *exchange
+	for i, recorded := range messages {
+		var msg message
+		if err := json.Unmarshal(recorded.Message, &msg); err != nil {
+			return nil, fmt.Errorf("message %d: %v", i+1, err)
+		}
+
+		switch recorded.Direction {
+		case clangd.RecordSend:
+			if msg.Method == "initialize" {
+				s.rootPath = rootPath(msg.Params)
+			}
+			ex := &exchange{method: msg.Method, params: canonicalJSON(msg.Params), sentAt: recorded.Time}
+			key := msg.Method + "\x00" + ex.params
+			s.exact[key] = append(s.exact[key], ex)
+			s.byMethod[msg.Method] = append(s.byMethod[msg.Method], ex)
+			if len(msg.ID) > 0 {
+				pending[string(msg.ID)] = ex
+			}
+			last = ex
+
+		case clangd.RecordReceive:
+			switch {
+			case msg.Method == "" && len(msg.ID) > 0:
+				ex := pending[string(msg.ID)]
+				if ex == nil {
+					continue
+				}
+				delete(pending, string(msg.ID))
+				if len(msg.Error) > 0 {
+					ex.response = `"error":` + string(msg.Error)
+				} else if len(msg.Result) > 0 {
+					ex.response = `"result":` + string(msg.Result)
+				} else {
+					ex.response = `"result":null`
+				}
+				ex.latency = time.Duration(recorded.Time-ex.sentAt) * time.Microsecond
+
+			case msg.Method != "" && len(msg.ID) == 0 && last != nil:
+				last.followers = append(last.followers, follower{
+					delay:   time.Duration(recorded.Time-last.sentAt) * time.Microsecond,
+					message: recorded.Message,
+				})
+			}
+			// Requests from clangd are not replayed, the client ignores them
+		}
+	}
+	return s, nil
+}
+
+// Serves the LSP messages read from in until the client sends exit or in
+// closes
+func (s *Server) Serve(in io.Reader, out io.Writer) error {
+	reader := bufio.NewReader(in)
+	for {
+		content, err := readFrame(reader)
+		if err != nil {
+			if err == io.EOF {
+				return nil
+			}
+			return err
+		}
+		var msg message
+		if err := json.Unmarshal(content, &msg); err != nil {
+			return fmt.Errorf("invalid message: %v", err)
+		}
+		if msg.Method == "exit" {
+			return nil
+		}
+		s.handle(&msg, out)
+	}
+}
+
+// Sends the recorded response and notifications of a message
+func (s *Server) handle(msg *message, out io.Writer) {
+	if msg.Method == "initialize" {
+		s.mu.Lock()
+		s.livePath = rootPath(msg.Params)
+		s.mu.Unlock()
+	}
+
+	type reply struct {
+		delay   time.Duration
+		content string
+	}
+	var replies []reply
+
+	ex := s.match(msg.Method, s.toRecorded(string(msg.Params)))
+	if len(msg.ID) > 0 {
+		switch {
+		case ex != nil && ex.response != "":
+			replies = append(replies, reply{ex.latency, fmt.Sprintf(`{"jsonrpc":"2.0","id":%s,%s}`,
+				msg.ID, s.toLive(ex.response))})
+		case msg.Method == "shutdown":
+			replies = append(replies, reply{0, fmt.Sprintf(`{"jsonrpc":"2.0","id":%s,"result":null}`, msg.ID)})
+		default:
+			replies = append(replies, reply{0, fmt.Sprintf(`{"jsonrpc":"2.0","id":%s,"error":{"code":%d,"message":%q}}`,
+				msg.ID, clangd.MethodNotFound, "no recorded response for "+msg.Method)})
+		}
+	}
+	if ex != nil {
+		for _, f := range ex.followers {
+			replies = append(replies, reply{f.delay, s.toLive(string(f.message))})
+		}
+	}
+	// Send in recorded order, which may differ from the order of the delays
+	// only by the jitter of the recording
+	for i := 1; i < len(replies); i++ {
+		for j := i; j > 0 && replies[j].delay < replies[j-1].delay; j-- {
+			replies[j], replies[j-1] = replies[j-1], replies[j]
+		}
+	}
+
+	if s.scale <= 0 {
+		for _, r := range replies {
+			s.write(out, r.content)
+		}
+		return
+	}
+	go func() {
+		start := time.Now()
+		for _, r := range replies {
+			time.Sleep(time.Duration(float64(r.delay)*s.scale) - time.Since(start))
+			s.write(out, r.content)
+		}
+	}()
+}
+
+// Returns the recorded exchange for a message, nil if its method was never
+// recorded
+func (s *Server) match(method, params string) *exchange {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	key := method + "\x00" + canonicalJSON(json.RawMessage(params))
+	candidates := s.exact[key]
+	if len(candidates) == 0 {
+		key = "\x00" + method
+		candidates = s.byMethod[method]
+	}
+	if len(candidates) == 0 {
+		return nil
+	}
+	ex := candidates[s.next[key]%len(candidates)]
+	s.next[key]++
+	return ex
+}
+
+func (s *Server) write(out io.Writer, content string) {
+	s.writeMu.Lock()
+	defer s.writeMu.Unlock()
+	fmt.Fprintf(out, "Content-Length: %d\r\n\r\n%s", len(content), content)
+}
+
+// Translates paths of the replaying client into those of the recording
+func (s *Server) toRecorded(text string) string {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if s.livePath == "" || s.rootPath == "" || s.livePath == s.rootPath {
+		return text
+	}
+	return strings.ReplaceAll(text, s.livePath, s.rootPath)
+}
+
+// Translates paths of the recording into those of the replaying client
+func (s *Server) toLive(text string) string {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if s.livePath == "" || s.rootPath == "" || s.livePath == s.rootPath {
+		return text
+	}
+	return strings.ReplaceAll(text, s.rootPath, s.livePath)
+}
+
+// Returns the project root path of initialize parameters
+func rootPath(params json.RawMessage) string {
+	var initialize struct {
+		RootURI string `json:"rootUri"`
+	}
+	json.Unmarshal(params, &initialize)
+	return strings.TrimPrefix(initialize.RootURI, "file://")
+}
+
+// Returns JSON with sorted keys and no whitespace, so equal values compare
+// equal as strings
+func canonicalJSON(raw json.RawMessage) string {
+	if len(raw) == 0 {
+		return ""
+	}
+	var value interface{}
+	if err := json.Unmarshal(raw, &value); err != nil {
+		return string(raw)
+	}
+	canonical, err := json.Marshal(value)
+	if err != nil {
+		return string(raw)
+	}
+	return string(canonical)
+}
+
+// Reads the content of a message framed with a Content-Length header
+func readFrame(reader *bufio.Reader) ([]byte, error) {
+	length := -1
+	for {
+		line, err := reader.ReadString('\n')
+		if err != nil {
+			return nil, err
+		}
+		line = strings.TrimSpace(line)
+		if line == "" {
+			break
+		}
+		if value, ok := strings.CutPrefix(line, "Content-Length: "); ok {
+			if length, err = strconv.Atoi(value); err != nil {
+				return nil, fmt.Errorf("invalid Content-Length: %v", err)
+			}
+		}
+	}
+	if length < 0 {
+		return nil, fmt.Errorf("missing Content-Length header")
+	}
+	content := make([]byte, length)
+	if _, err := io.ReadFull(reader, content); err != nil {
+		return nil, err
+	}
+	return content, nil
+}
+
+// Connects a client to the server through pipes, as if the server were a
+// clangd process. buildDir must contain a compile_commands.json, whose first
+// source file the client opens during initialization like with clangd.
+func Connect(server *Server, projectRoot, buildDir string, log logger.Logger) (*clangd.ClangdClient, error) {
+	requestsR, requestsW := io.Pipe()
+	responsesR, responsesW := io.Pipe()
+	go func() {
+		err := server.Serve(requestsR, responsesW)
+		requestsR.CloseWithError(io.ErrClosedPipe)
+		responsesW.CloseWithError(err)
+	}()
+	return clangd.NewStreamClient(projectRoot, buildDir, responsesR, requestsW, log)
+}
@@ -0,0 +1,114 @@
+package replay
+
+import (
+	"bufio"
+	"encoding/json"
+	"fmt"
+	"io"
+	"strings"
+	"testing"
+	"time"
+
+	"clangd-query/internal/clangd"
+)
+
+// A session recorded in /recorded/project: initialize, a hover that took
+// 40ms, and the end of indexing after the first document was opened
+var session = []clangd.RecordedMessage{
+	{Time: 0, Direction: clangd.RecordSend, Message: json.RawMessage(`{"jsonrpc":"2.0","id":"1","method":"initialize","params":{"processId":1,"rootUri":"file:///recorded/project"}}`)},
+	{Time: 100, Direction: clangd.RecordReceive, Message: json.RawMessage(`{"jsonrpc":"2.0","id":"1","result":{"capabilities":{}}}`)},
+	{Time: 200, Direction: clangd.RecordSend, Message: json.RawMessage(`{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///recorded/project/main.cpp"}}}`)},
+	{Time: 300, Direction: clangd.RecordReceive, Message: json.RawMessage(`{"jsonrpc":"2.0","id":0,"method":"window/workDoneProgress/create","params":{"token":"backgroundIndexProgress"}}`)},
+	{Time: 900, Direction: clangd.RecordReceive, Message: json.RawMessage(`{"jsonrpc":"2.0","method":"$/progress","params":{"token":"backgroundIndexProgress","value":{"kind":"end"}}}`)},
+	{Time: 1000, Direction: clangd.RecordSend, Message: json.RawMessage(`{"jsonrpc":"2.0","id":"2","method":"textDocument/hover","params":{"textDocument":{"uri":"file:///recorded/project/a.h"},"position":{"line":3,"character":4}}}`)},
+	{Time: 41000, Direction: clangd.RecordReceive, Message: json.RawMessage(`{"jsonrpc":"2.0","id":"2","result":{"contents":{"kind":"markdown","value":"a.h"}}}`)},
+	{Time: 42000, Direction: clangd.RecordSend, Message: json.RawMessage(`{"jsonrpc":"2.0","id":"3","method":"textDocument/hover","params":{"textDocument":{"uri":"file:///recorded/project/b.h"},"position":{"line":3,"character":4}}}`)},
+	{Time: 43000, Direction: clangd.RecordReceive, Message: json.RawMessage(`{"jsonrpc":"2.0","id":"3","result":{"contents":{"kind":"markdown","value":"b.h"}}}`)},
+}
+
+// The client side of a server serving over pipes
+type conn struct {
+	in  io.Writer
+	out *bufio.Reader
+}
+
+func serve(t *testing.T, scale float64) *conn {
+	t.Helper()
+	server, err := NewServer(session, scale)
+	if err != nil {
+		t.Fatal(err)
+	}
+	requestsR, requestsW := io.Pipe()
+	responsesR, responsesW := io.Pipe()
+	go func() {
+		server.Serve(requestsR, responsesW)
+		responsesW.Close()
+	}()
+	t.Cleanup(func() { requestsW.Close() })
+	return &conn{in: requestsW, out: bufio.NewReader(responsesR)}
+}
+
+func (c *conn) send(t *testing.T, content string) {
+	t.Helper()
+	if _, err := fmt.Fprintf(c.in, "Content-Length: %d\r\n\r\n%s", len(content), content); err != nil {
+		t.Fatal(err)
+	}
+}
+
+func (c *conn) read(t *testing.T) string {
+	t.Helper()
+	content, err := readFrame(c.out)
+	if err != nil {
+		t.Fatalf("reading message: %v", err)
+	}
+	return string(content)
+}
+
+func TestServeRecordedSession(t *testing.T) {
+	c := serve(t, 0)
+
+	// Replayed in another checkout of the project
+	c.send(t, `{"jsonrpc":"2.0","id":"1","method":"initialize","params":{"processId":2,"rootUri":"file:///live/checkout"}}`)
+	if got, want := c.read(t), `{"jsonrpc":"2.0","id":"1","result":{"capabilities":{}}}`; got != want {
+		t.Errorf("initialize: got %s, want %s", got, want)
+	}
+
+	// The request of clangd is not replayed, its notification is
+	c.send(t, `{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///live/checkout/main.cpp"}}}`)
+	if got := c.read(t); !strings.Contains(got, `"$/progress"`) {
+		t.Errorf("expected the end of indexing after didOpen, got %s", got)
+	}
+
+	// Requests are matched by their parameters, with paths translated both ways
+	c.send(t, `{"jsonrpc":"2.0","id":"7","method":"textDocument/hover","params":{"position":{"character":4,"line":3},"textDocument":{"uri":"file:///live/checkout/b.h"}}}`)
+	if got := c.read(t); !strings.Contains(got, `"id":"7"`) || !strings.Contains(got, `"value":"b.h"`) {
+		t.Errorf("hover of b.h: got %s", got)
+	}
+
+	// Unknown parameters get the recorded responses of the method in turn
+	for _, want := range []string{"a.h", "b.h", "a.h"} {
+		c.send(t, `{"jsonrpc":"2.0","id":"8","method":"textDocument/hover","params":{"textDocument":{"uri":"file:///live/checkout/c.h"},"position":{"line":0,"character":0}}}`)
+		if got := c.read(t); !strings.Contains(got, `"value":"`+want+`"`) {
+			t.Errorf("expected the hover of %s, got %s", want, got)
+		}
+	}
+
+	c.send(t, `{"jsonrpc":"2.0","id":"9","method":"textDocument/references","params":{}}`)
+	if got := c.read(t); !strings.Contains(got, fmt.Sprintf(`"code":%d`, clangd.MethodNotFound)) {
+		t.Errorf("expected an error for an unrecorded method, got %s", got)
+	}
+}
+
+func TestServeScalesLatency(t *testing.T) {
+	c := serve(t, 0.5)
+	c.send(t, `{"jsonrpc":"2.0","id":"1","method":"initialize","params":{"rootUri":"file:///recorded/project"}}`)
+	c.read(t)
+
+	// Recorded after 40ms
+	start := time.Now()
+	c.send(t, `{"jsonrpc":"2.0","id":"2","method":"textDocument/hover","params":{"textDocument":{"uri":"file:///recorded/project/a.h"},"position":{"line":3,"character":4}}}`)
+	c.read(t)
+	if elapsed := time.Since(start); elapsed < 20*time.Millisecond || elapsed > 500*time.Millisecond {
+		t.Errorf("expected the response after about 20ms, got %v", elapsed)
+	}
+}
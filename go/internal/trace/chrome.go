@@ -0,0 +1,78 @@
+package trace
+
+import (
+	"encoding/json"
+	"fmt"
+	"os"
+	"sort"
+)
+
+// A record of Chrome's trace event format
+type chromeEvent struct {
+	Name      string            `json:"name"`
+	Category  string            `json:"cat,omitempty"`
+	Phase     string            `json:"ph"`
+	Timestamp int64             `json:"ts"`            // Microseconds
+	Duration  *int64            `json:"dur,omitempty"` // Microseconds
+	PID       int               `json:"pid"`
+	TID       uint64            `json:"tid"`
+	Args      map[string]string `json:"args,omitempty"`
+}
+
+type chromeTrace struct {
+	TraceEvents     []chromeEvent `json:"traceEvents"`
+	DisplayTimeUnit string        `json:"displayTimeUnit"`
+}
+
+// Encodes traces in Chrome's trace event format. Each trace is shown as its
+// own thread, named after the request, with its spans as complete events.
+func ChromeJSON(traces []*Trace) ([]byte, error) {
+	pid := os.Getpid()
+	events := []chromeEvent{{
+		Name:  "process_name",
+		Phase: "M",
+		PID:   pid,
+		Args:  map[string]string{"name": "clangd-query daemon"},
+	}}
+
+	for _, tr := range traces {
+		spans, dropped := tr.Spans()
+		threadName := fmt.Sprintf("%s #%d", tr.Name, tr.ID)
+		if dropped > 0 {
+			threadName += fmt.Sprintf(" (%d spans dropped)", dropped)
+		}
+		events = append(events, chromeEvent{
+			Name:  "thread_name",
+			Phase: "M",
+			PID:   pid,
+			TID:   tr.ID,
+			Args:  map[string]string{"name": threadName},
+		})
+
+		// Enclosing spans first, so viewers nest spans that start together
+		sort.SliceStable(spans, func(i, j int) bool {
+			if !spans[i].Start.Equal(spans[j].Start) {
+				return spans[i].Start.Before(spans[j].Start)
+			}
+			return spans[i].Duration > spans[j].Duration
+		})
+		for _, span := range spans {
+			duration := span.Duration.Microseconds()
+			events = append(events, chromeEvent{
+				Name:      span.Name,
+				Category:  span.Category,
+				Phase:     "X",
+				Timestamp: span.Start.UnixMicro(),
+				Duration:  &duration,
+				PID:       pid,
+				TID:       tr.ID,
+				Args:      span.Args,
+			})
+		}
+	}
+
+	return json.Marshal(chromeTrace{
+		TraceEvents:     events,
+		DisplayTimeUnit: "ms",
+	})
+}
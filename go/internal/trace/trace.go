@@ -0,0 +1,184 @@
+// Package trace records where the time of a request goes: in the daemon,
+// in command logic, in file IO and in every clangd call. Spans are passed
+// along in contexts, and completed traces are kept in a bounded buffer that
+// can be exported in Chrome's trace event format for Perfetto or
+// chrome://tracing.
+package trace
+
+import (
+	"context"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// Spans recorded per trace at most. Further spans are counted, but dropped,
+// so a request making thousands of clangd calls can't exhaust memory.
+const maxSpansPerTrace = 10000
+
+// Span is a timed operation within a trace
+type Span struct {
+	Name     string
+	Category string
+	Start    time.Time
+	Duration time.Duration
+	ID       uint64
+	Parent   uint64 // ID of the enclosing span, 0 for the root
+	Args     map[string]string
+
+	trace *Trace
+	ended atomic.Bool
+}
+
+// Trace holds the spans of one request
+type Trace struct {
+	ID    uint64
+	Name  string
+	Start time.Time
+
+	mu      sync.Mutex
+	spans   []*Span // Completed spans
+	dropped int
+	tracer  *Tracer
+	nextID  atomic.Uint64
+}
+
+// Tracer keeps the latest completed traces
+type Tracer struct {
+	mu       sync.Mutex
+	traces   []*Trace // Ring buffer of completed traces
+	next     int
+	count    int
+	nextID   atomic.Uint64
+	recorded int64
+}
+
+type spanKey struct{}
+
+// Creates a tracer that keeps the last capacity traces
+func NewTracer(capacity int) *Tracer {
+	return &Tracer{traces: make([]*Trace, capacity)}
+}
+
+// Starts a new trace with its root span. The returned context carries the
+// span, so Start creates children of it. The trace is stored in the tracer
+// when the root span ends.
+func (t *Tracer) StartTrace(ctx context.Context, name, category string) (context.Context, *Span) {
+	tr := &Trace{
+		ID:     t.nextID.Add(1),
+		Name:   name,
+		Start:  time.Now(),
+		tracer: t,
+	}
+	span := tr.newSpan(name, category, 0, tr.Start)
+	return context.WithValue(ctx, spanKey{}, span), span
+}
+
+// Starts a span as a child of the span in ctx. Returns ctx and a nil span,
+// on which all methods are no-ops, if ctx isn't traced.
+func Start(ctx context.Context, name, category string) (context.Context, *Span) {
+	parent, ok := ctx.Value(spanKey{}).(*Span)
+	if !ok {
+		return ctx, nil
+	}
+	span := parent.trace.newSpan(name, category, parent.ID, time.Now())
+	return context.WithValue(ctx, spanKey{}, span), span
+}
+
+// Records an operation that was timed elsewhere, e.g. in another process,
+// as a child of the span in ctx
+func Record(ctx context.Context, name, category string, start, end time.Time) {
+	parent, ok := ctx.Value(spanKey{}).(*Span)
+	if !ok {
+		return
+	}
+	span := parent.trace.newSpan(name, category, parent.ID, start)
+	span.Duration = end.Sub(start)
+	parent.trace.add(span)
+}
+
+func (tr *Trace) newSpan(name, category string, parent uint64, start time.Time) *Span {
+	return &Span{
+		Name:     name,
+		Category: category,
+		Start:    start,
+		ID:       tr.nextID.Add(1),
+		Parent:   parent,
+		trace:    tr,
+	}
+}
+
+// Attaches a key and value shown with the span. Must be called before End.
+func (s *Span) SetArg(key, value string) {
+	if s == nil {
+		return
+	}
+	if s.Args == nil {
+		s.Args = make(map[string]string)
+	}
+	s.Args[key] = value
+}
+
+// Ends the span. Ending the root span completes the trace. Spans that end
+// after their root, e.g. abandoned work, are still added to the trace.
+func (s *Span) End() {
+	if s == nil || s.ended.Swap(true) {
+		return
+	}
+	s.Duration = time.Since(s.Start)
+	s.trace.add(s)
+	if s.Parent == 0 {
+		s.trace.tracer.store(s.trace)
+	}
+}
+
+func (tr *Trace) add(span *Span) {
+	tr.mu.Lock()
+	defer tr.mu.Unlock()
+	if len(tr.spans) >= maxSpansPerTrace {
+		tr.dropped++
+		return
+	}
+	tr.spans = append(tr.spans, span)
+}
+
+// Returns the completed spans of the trace and the number of dropped ones
+func (tr *Trace) Spans() ([]*Span, int) {
+	tr.mu.Lock()
+	defer tr.mu.Unlock()
+	return append([]*Span(nil), tr.spans...), tr.dropped
+}
+
+func (t *Tracer) store(tr *Trace) {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	t.traces[t.next] = tr
+	t.next = (t.next + 1) % len(t.traces)
+	if t.count < len(t.traces) {
+		t.count++
+	}
+	t.recorded++
+}
+
+// Returns the last n completed traces, oldest first. n <= 0 returns all
+// traces in the buffer.
+func (t *Tracer) Last(n int) []*Trace {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	if n <= 0 || n > t.count {
+		n = t.count
+	}
+	traces := make([]*Trace, 0, n)
+	for i := n; i > 0; i-- {
+		index := (t.next - i + len(t.traces)) % len(t.traces)
+		traces = append(traces, t.traces[index])
+	}
+	return traces
+}
+
+// Returns the number of traces in the buffer and recorded in total
+func (t *Tracer) Stats() (buffered int, recorded int64) {
+	t.mu.Lock()
+	defer t.mu.Unlock()
+	return t.count, t.recorded
+}
@@ -0,0 +1,149 @@
+package trace
+
+import (
+	"context"
+	"encoding/json"
+	"testing"
+	"time"
+)
+
+func TestSpansNestUnderTheirParent(t *testing.T) {
+	tracer := NewTracer(10)
+	ctx, root := tracer.StartTrace(context.Background(), "show", "daemon")
+	commandCtx, command := Start(ctx, "commands.Show", "command")
+	_, request := Start(commandCtx, "workspace/symbol", "lsp")
+	request.End()
+	command.End()
+	root.End()
+
+	traces := tracer.Last(0)
+	if len(traces) != 1 {
+		t.Fatalf("Got %d traces, want 1", len(traces))
+	}
+	spans, dropped := traces[0].Spans()
+	if len(spans) != 3 || dropped != 0 {
+		t.Fatalf("Got %d spans and %d dropped, want 3 and 0", len(spans), dropped)
+	}
+	parents := make(map[string]uint64)
+	ids := make(map[string]uint64)
+	for _, span := range spans {
+		parents[span.Name] = span.Parent
+		ids[span.Name] = span.ID
+	}
+	if parents["show"] != 0 || parents["commands.Show"] != ids["show"] || parents["workspace/symbol"] != ids["commands.Show"] {
+		t.Errorf("Unexpected span tree: parents %v, ids %v", parents, ids)
+	}
+}
+
+func TestUntracedContextIsANoOp(t *testing.T) {
+	ctx := context.Background()
+	spanCtx, span := Start(ctx, "textDocument/hover", "lsp")
+	if span != nil || spanCtx != ctx {
+		t.Fatal("Start created a span without a trace")
+	}
+	span.SetArg("key", "value")
+	span.End()
+	Record(ctx, "client.Run", "client", time.Now(), time.Now())
+}
+
+func TestTraceIsStoredWhenRootEnds(t *testing.T) {
+	tracer := NewTracer(10)
+	ctx, root := tracer.StartTrace(context.Background(), "usages", "daemon")
+	_, child := Start(ctx, "textDocument/references", "lsp")
+	child.End()
+	if buffered, _ := tracer.Stats(); buffered != 0 {
+		t.Fatal("Trace stored before its root span ended")
+	}
+	root.End()
+	root.End()
+	if buffered, recorded := tracer.Stats(); buffered != 1 || recorded != 1 {
+		t.Errorf("Got %d buffered and %d recorded traces, want 1 and 1", buffered, recorded)
+	}
+}
+
+func TestTracerKeepsLastTraces(t *testing.T) {
+	tracer := NewTracer(3)
+	for _, name := range []string{"a", "b", "c", "d", "e"} {
+		_, root := tracer.StartTrace(context.Background(), name, "daemon")
+		root.End()
+	}
+
+	var names []string
+	for _, tr := range tracer.Last(0) {
+		names = append(names, tr.Name)
+	}
+	if len(names) != 3 || names[0] != "c" || names[2] != "e" {
+		t.Errorf("Got traces %v, want [c d e]", names)
+	}
+	if last := tracer.Last(2); len(last) != 2 || last[0].Name != "d" || last[1].Name != "e" {
+		t.Errorf("Last(2) returned %d traces", len(last))
+	}
+}
+
+func TestSpansPerTraceAreBounded(t *testing.T) {
+	tracer := NewTracer(1)
+	ctx, root := tracer.StartTrace(context.Background(), "hierarchy", "daemon")
+	for i := 0; i < maxSpansPerTrace+10; i++ {
+		_, span := Start(ctx, "typeHierarchy/supertypes", "lsp")
+		span.End()
+	}
+	root.End()
+
+	spans, dropped := tracer.Last(1)[0].Spans()
+	if len(spans) != maxSpansPerTrace || dropped != 11 {
+		t.Errorf("Got %d spans and %d dropped", len(spans), dropped)
+	}
+}
+
+func TestChromeJSON(t *testing.T) {
+	tracer := NewTracer(10)
+	ctx, root := tracer.StartTrace(context.Background(), "show", "daemon")
+	root.SetArg("symbol", "GameObject")
+	_, request := Start(ctx, "textDocument/definition", "lsp")
+	request.End()
+	root.End()
+	start := root.Start.Add(-time.Millisecond)
+	Record(ctx, "client.Run", "client", start, time.Now())
+
+	data, err := ChromeJSON(tracer.Last(1))
+	if err != nil {
+		t.Fatal(err)
+	}
+	var decoded struct {
+		TraceEvents []struct {
+			Name  string            `json:"name"`
+			Phase string            `json:"ph"`
+			TS    int64             `json:"ts"`
+			Dur   *int64            `json:"dur"`
+			TID   uint64            `json:"tid"`
+			Args  map[string]string `json:"args"`
+		} `json:"traceEvents"`
+	}
+	if err := json.Unmarshal(data, &decoded); err != nil {
+		t.Fatalf("Invalid JSON: %v\n%s", err, data)
+	}
+
+	var complete []string
+	for _, event := range decoded.TraceEvents {
+		if event.Phase != "X" {
+			continue
+		}
+		complete = append(complete, event.Name)
+		if event.Dur == nil || event.TID != root.trace.ID {
+			t.Errorf("Event %s lacks a duration or is on the wrong thread", event.Name)
+		}
+		if event.Name == "show" && event.Args["symbol"] != "GameObject" {
+			t.Errorf("Root span lost its arguments: %v", event.Args)
+		}
+	}
+	// Sorted by start time, enclosing spans first
+	want := []string{"client.Run", "show", "textDocument/definition"}
+	if len(complete) != len(want) {
+		t.Fatalf("Got events %v, want %v", complete, want)
+	}
+	for i := range want {
+		if complete[i] != want[i] {
+			t.Fatalf("Got events %v, want %v", complete, want)
+		}
+	}
+}
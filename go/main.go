@@ -102,13 +102,26 @@ Usage:
 
 Commands:
   search <query>              Search for symbols across the project
+    --regex                   Treat query as a regular expression
+    --glob                    Treat query as a glob pattern (*, ?, [A-Z])
+    --kind <kinds>            Only show these kinds, e.g. class,method
+    --path <prefix>           Only show symbols in files under this path
   show <symbol>               Show source code of symbol
   usages <symbol>             Find all usages of a symbol
   hierarchy <symbol>          Show type hierarchy
   signature <symbol>          Show function signature
   interface <symbol>          Show public interface
   logs                        Show daemon logs
+    --follow                  Keep printing new log entries
+  trace                       Print traces of recent requests as Chrome
+                              trace event JSON, for Perfetto
+    --last <n>                Only the last n requests
+  profile <kind>              Capture a profile of the daemon into a file:
+                              cpu, heap, goroutine, mutex or block
+    --seconds <n>             How long to sample cpu, mutex and block
+                              profiles (default: 30)
   status                      Show daemon status
+    --resources               Include clangd's resource use over time
   shutdown                    Shutdown the daemon
 
 Flags:
@@ -119,6 +132,8 @@ Flags:
 
 Examples:
   clangd-query search Widget
+  clangd-query search --glob '*System::Update'
+  clangd-query search --regex '^On[A-Z].*Event$' --kind method
   clangd-query show GameScene::update
   clangd-query usages src/main.cpp:42:15
   clangd-query hierarchy BaseClass --limit 10`)
@@ -140,10 +155,11 @@ func findProjectRoot(startDir string) (string, error) {
 	return "", fmt.Errorf("no CMakeLists.txt found in any parent directory")
 }
 
-func runDaemon(projectRoot string, verbose bool) {
+func runDaemon(projectRoot string, verbose bool, shared bool) {
 	config := &daemon.Config{
 		ProjectRoot: projectRoot,
 		Verbose:     verbose,
+		Shared:      shared,
 	}
 	daemon.Run(config)
 }
@@ -173,14 +189,17 @@ func main() {
 		}
 		projectRoot := os.Args[2]
 		verbose := false
-		// Check for --verbose flag
+		shared := false
+		// Check for --verbose and --shared flags
 		for i := 3; i < len(os.Args); i++ {
-			if os.Args[i] == "--verbose" || os.Args[i] == "-v" {
+			switch os.Args[i] {
+			case "--verbose", "-v":
 				verbose = true
-				break
+			case "--shared":
+				shared = true
 			}
 		}
-		runDaemon(projectRoot, verbose)
+		runDaemon(projectRoot, verbose, shared)
 		return
 	}
 
@@ -199,7 +218,7 @@ func main() {
 
 	// Validate command
 	validCommands := []string{"search", "show", "view", "usages", "hierarchy",
-		"signature", "interface", "logs", "status", "shutdown"}
+		"signature", "interface", "logs", "trace", "profile", "status", "shutdown"}
 
 	if config.Command == "" {
 		fmt.Fprintf(os.Stderr, "Error: no command specified\n")
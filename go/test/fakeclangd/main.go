@@ -0,0 +1,376 @@
+// Command fakeclangd is a stand-in for clangd that misbehaves on purpose,
+// following a script: it answers slowly with latencies drawn from a
+// distribution, returns errors, drops responses, pads them to huge sizes,
+// crashes in the middle of a response and floods the client with progress
+// notifications, some of them out of order. The fault tests in go/test put
+// it on the PATH of a daemon as clangd, to check how the daemon copes.
+//
+// The script is the JSON file named by FAKE_CLANGD_SCRIPT, see Script. Its
+// answers are made up but well-formed: workspace/symbol returns classes and
+// functions named after the query, other requests empty results. Command line
+// arguments meant for clangd are ignored.
+package main
+
+import (
+	"bufio"
+	"encoding/json"
+	"fmt"
+	"io"
+	"math"
+	"math/rand"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+// Script describes the faults to inject
+type Script struct {
+	Seed int64 `json:"seed"`
+
+	// Faults of requests whose method is not in Methods
+	Default Faults            `json:"default"`
+	Methods map[string]Faults `json:"methods"`
+
+	// Exit halfway through writing the response to the CrashAfter-th request
+	// of CrashMethod (0 never, any method if empty), on the first CrashStarts
+	// starts of the fake (0 every start). Starts are counted in a file next to
+	// the script.
+	CrashAfter  int    `json:"crashAfter"`
+	CrashMethod string `json:"crashMethod"`
+	CrashStarts int    `json:"crashStarts"`
+
+	// Number of $/progress reports sent while indexing
+	ProgressStorm int `json:"progressStorm"`
+
+	// Sends notifications out of order: indexing ends before it begins,
+	// reports arrive for unknown tokens and after the end, and diagnostics
+	// arrive for files that were never opened
+	OutOfOrder bool `json:"outOfOrder"`
+
+	// Symbols returned by workspace/symbol (5 by default)
+	Symbols int `json:"symbols"`
+}
+
+// Faults of the requests of one method
+type Faults struct {
+	// Latency follows a log-normal distribution with this median and 99th
+	// percentile. Without a P99Ms it is always MedianMs.
+	MedianMs float64 `json:"medianMs"`
+	P99Ms    float64 `json:"p99Ms"`
+
+	ErrorRate float64 `json:"errorRate"` // Share of requests answered with an error
+	DropRate  float64 `json:"dropRate"`  // Share of requests never answered
+
+	// Results of workspace/symbol are padded with more symbols to at least
+	// this many bytes. Queries of one character are not, so the daemon
+	// enumerating the index by leading character stays quick.
+	PayloadBytes int `json:"payloadBytes"`
+}
+
+// Error codes of LSP
+const (
+	internalError    = -32603
+	requestCancelled = -32800
+)
+
+type message struct {
+	ID     json.RawMessage `json:"id,omitempty"`
+	Method string          `json:"method,omitempty"`
+	Params json.RawMessage `json:"params,omitempty"`
+}
+
+type server struct {
+	script  Script
+	crashes bool // Whether this start crashes
+
+	writeMu sync.Mutex
+	out     io.Writer
+
+	mu       sync.Mutex
+	random   *rand.Rand
+	requests int                      // Of the crash method
+	pending  map[string]chan struct{} // Closed when a request is cancelled
+	rootURI  string
+	opened   bool
+}
+
+func main() {
+	path := os.Getenv("FAKE_CLANGD_SCRIPT")
+	if path == "" {
+		fatalf("FAKE_CLANGD_SCRIPT must name a script")
+	}
+	data, err := os.ReadFile(path)
+	if err != nil {
+		fatalf("%v", err)
+	}
+	var script Script
+	if err := json.Unmarshal(data, &script); err != nil {
+		fatalf("invalid script: %v", err)
+	}
+	if script.Symbols == 0 {
+		script.Symbols = 5
+	}
+
+	start := countStart(path + ".starts")
+	s := &server{
+		script:  script,
+		crashes: script.CrashAfter > 0 && (script.CrashStarts == 0 || start <= script.CrashStarts),
+		out:     os.Stdout,
+		random:  rand.New(rand.NewSource(script.Seed + int64(start))),
+		pending: make(map[string]chan struct{}),
+	}
+	fmt.Fprintf(os.Stderr, "I[00:00:00.000] fakeclangd start %d\n", start)
+	if err := s.serve(bufio.NewReader(os.Stdin)); err != nil {
+		fatalf("%v", err)
+	}
+}
+
+func fatalf(format string, args ...interface{}) {
+	fmt.Fprintf(os.Stderr, "fakeclangd: "+format+"\n", args...)
+	os.Exit(1)
+}
+
+// Increments the number of starts stored in a file and returns it
+func countStart(path string) int {
+	data, _ := os.ReadFile(path)
+	n, _ := strconv.Atoi(strings.TrimSpace(string(data)))
+	n++
+	os.WriteFile(path, []byte(strconv.Itoa(n)), 0644)
+	return n
+}
+
+func (s *server) serve(in *bufio.Reader) error {
+	for {
+		content, err := readFrame(in)
+		if err != nil {
+			if err == io.EOF {
+				return nil
+			}
+			return err
+		}
+		var msg message
+		if err := json.Unmarshal(content, &msg); err != nil {
+			return fmt.Errorf("invalid message: %v", err)
+		}
+
+		switch {
+		case msg.Method == "exit":
+			return nil
+		case msg.Method == "$/cancelRequest":
+			var params struct {
+				ID json.RawMessage `json:"id"`
+			}
+			json.Unmarshal(msg.Params, &params)
+			s.cancel(params.ID)
+		case msg.Method == "textDocument/didOpen":
+			s.mu.Lock()
+			first := !s.opened
+			s.opened = true
+			s.mu.Unlock()
+			if first {
+				go s.index()
+			}
+		case len(msg.ID) > 0:
+			s.handle(msg)
+		}
+	}
+}
+
+// Answers a request after its latency, unless it is dropped or cancelled
+func (s *server) handle(msg message) {
+	faults, ok := s.script.Methods[msg.Method]
+	if !ok {
+		faults = s.script.Default
+	}
+
+	s.mu.Lock()
+	counted := s.script.CrashMethod == "" || msg.Method == s.script.CrashMethod
+	if counted {
+		s.requests++
+	}
+	crash := s.crashes && counted && s.requests == s.script.CrashAfter
+	latency := sampleLatency(s.random, faults)
+	drop := s.random.Float64() < faults.DropRate
+	fail := s.random.Float64() < faults.ErrorRate
+	cancelled := make(chan struct{})
+	s.pending[string(msg.ID)] = cancelled
+	if msg.Method == "initialize" {
+		var params struct {
+			RootURI string `json:"rootUri"`
+		}
+		json.Unmarshal(msg.Params, &params)
+		s.rootURI = params.RootURI
+	}
+	s.mu.Unlock()
+
+	if drop {
+		return // Not even a cancellation is answered
+	}
+
+	go func() {
+		select {
+		case <-time.After(latency):
+		case <-cancelled:
+			s.write(fmt.Sprintf(`{"jsonrpc":"2.0","id":%s,"error":{"code":%d,"message":"Request cancelled"}}`,
+				msg.ID, requestCancelled))
+			return
+		}
+		s.mu.Lock()
+		delete(s.pending, string(msg.ID))
+		s.mu.Unlock()
+
+		var response string
+		if fail {
+			response = fmt.Sprintf(`{"jsonrpc":"2.0","id":%s,"error":{"code":%d,"message":"injected failure of %s"}}`,
+				msg.ID, internalError, msg.Method)
+		} else {
+			response = fmt.Sprintf(`{"jsonrpc":"2.0","id":%s,"result":%s}`, msg.ID, s.result(msg, faults))
+		}
+		if crash {
+			s.crash(response)
+		}
+		s.write(response)
+	}()
+}
+
+// Returns the result of a request
+func (s *server) result(msg message, faults Faults) string {
+	switch msg.Method {
+	case "initialize":
+		return `{"capabilities":{"textDocumentSync":{"openClose":true,"change":2,"save":true},` +
+			`"hoverProvider":true,"definitionProvider":true,"declarationProvider":true,` +
+			`"referencesProvider":true,"documentSymbolProvider":true,"workspaceSymbolProvider":true,` +
+			`"foldingRangeProvider":true,"typeHierarchyProvider":true},` +
+			`"serverInfo":{"name":"clangd","version":"fakeclangd"}}`
+	case "workspace/symbol":
+		var params struct {
+			Query string `json:"query"`
+		}
+		json.Unmarshal(msg.Params, &params)
+		if len(params.Query) <= 1 {
+			return s.symbols(params.Query, 0)
+		}
+		return s.symbols(params.Query, faults.PayloadBytes)
+	case "textDocument/hover", "shutdown":
+		return "null"
+	default:
+		return "[]"
+	}
+}
+
+// Returns classes and functions named after the query, all in src/main.cpp
+// of the project
+func (s *server) symbols(query string, minBytes int) string {
+	s.mu.Lock()
+	root := s.rootURI
+	s.mu.Unlock()
+
+	var b strings.Builder
+	b.WriteByte('[')
+	for i := 0; i < s.script.Symbols || b.Len() < minBytes; i++ {
+		if i > 0 {
+			b.WriteByte(',')
+		}
+		name := query
+		if i > 0 {
+			name = fmt.Sprintf("%s%d", query, i)
+		}
+		kind := 5 // Class
+		if i%2 == 1 {
+			kind = 12 // Function
+		}
+		fmt.Fprintf(&b, `{"name":%q,"kind":%d,"containerName":"fake","location":{"uri":"%s/src/main.cpp",`+
+			`"range":{"start":{"line":%d,"character":6},"end":{"line":%d,"character":%d}}}}`,
+			name, kind, root, i, i, 6+len(name))
+	}
+	b.WriteByte(']')
+	return b.String()
+}
+
+// Indexes the project, which here only means sending progress notifications
+func (s *server) index() {
+	const token = `"backgroundIndexProgress"`
+	progress := func(value string) {
+		s.write(`{"jsonrpc":"2.0","method":"$/progress","params":{"token":` + token + `,"value":` + value + `}}`)
+	}
+
+	if s.script.OutOfOrder {
+		progress(`{"kind":"end"}`)
+		s.write(`{"jsonrpc":"2.0","method":"$/progress","params":{"token":"unknown","value":{"kind":"report","percentage":50}}}`)
+		s.write(`{"jsonrpc":"2.0","method":"textDocument/publishDiagnostics","params":{"uri":"file:///never/opened.cpp","diagnostics":[]}}`)
+	}
+	progress(`{"kind":"begin","title":"indexing","percentage":0}`)
+	for i := 0; i < s.script.ProgressStorm; i++ {
+		progress(fmt.Sprintf(`{"kind":"report","message":"%d/%d","percentage":%d}`,
+			i, s.script.ProgressStorm, i*100/s.script.ProgressStorm))
+	}
+	progress(`{"kind":"end"}`)
+	if s.script.OutOfOrder {
+		progress(`{"kind":"report","percentage":100}`)
+		progress(`{"kind":"end"}`)
+	}
+}
+
+func (s *server) cancel(id json.RawMessage) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if cancelled, ok := s.pending[string(id)]; ok {
+		close(cancelled)
+		delete(s.pending, string(id))
+	}
+}
+
+// Writes the header and half of a response, then exits
+func (s *server) crash(response string) {
+	s.writeMu.Lock()
+	fmt.Fprintf(s.out, "Content-Length: %d\r\n\r\n%s", len(response), response[:len(response)/2])
+	fmt.Fprintf(os.Stderr, "E[00:00:00.000] fakeclangd crashing as scripted\n")
+	os.Exit(2)
+}
+
+func (s *server) write(content string) {
+	s.writeMu.Lock()
+	defer s.writeMu.Unlock()
+	fmt.Fprintf(s.out, "Content-Length: %d\r\n\r\n%s", len(content), content)
+}
+
+// Draws a latency from the log-normal distribution of the faults
+func sampleLatency(random *rand.Rand, faults Faults) time.Duration {
+	ms := faults.MedianMs
+	if faults.P99Ms > faults.MedianMs && faults.MedianMs > 0 {
+		// The 99th percentile of a standard normal distribution
+		sigma := math.Log(faults.P99Ms/faults.MedianMs) / 2.326
+		ms = faults.MedianMs * math.Exp(sigma*random.NormFloat64())
+	}
+	return time.Duration(ms * float64(time.Millisecond))
+}
+
+// Reads the content of a message framed with a Content-Length header
+func readFrame(reader *bufio.Reader) ([]byte, error) {
+	length := -1
+	for {
+		line, err := reader.ReadString('\n')
+		if err != nil {
+			return nil, err
+		}
+		line = strings.TrimSpace(line)
+		if line == "" {
+			break
+		}
+		if value, ok := strings.CutPrefix(line, "Content-Length: "); ok {
+			if length, err = strconv.Atoi(value); err != nil {
+				return nil, fmt.Errorf("invalid Content-Length: %v", err)
+			}
+		}
+	}
+	if length < 0 {
+		return nil, fmt.Errorf("missing Content-Length header")
+	}
+	content := make([]byte, length)
+	if _, err := io.ReadFull(reader, content); err != nil {
+		return nil, err
+	}
+	return content, nil
+}
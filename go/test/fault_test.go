@@ -0,0 +1,391 @@
+package test
+
+import (
+	"bytes"
+	"fmt"
+	"net"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"sort"
+	"strings"
+	"sync"
+	"testing"
+	"time"
+
+	"clangd-query/internal/client"
+	"clangd-query/internal/daemon"
+)
+
+// Budgets the daemon has to stay within while clangd misbehaves
+const (
+	// Added by the daemon to clangd's latency at the 99th percentile
+	faultLatencyOverhead = 50 * time.Millisecond
+	// Until a failed or abandoned command returns
+	faultFailureBudget = time.Second
+	// Until commands succeed again after clangd crashed
+	faultRecoveryBudget = 15 * time.Second
+	// Peak RSS of the daemon while clangd floods it with notifications, and
+	// with 64MB results
+	faultMemoryBudget        = 128 << 20
+	faultPayloadMemoryBudget = 512 << 20
+	// Until a command on a 64MB result returns, about a third of it spent by
+	// fakeclangd writing the result
+	faultPayloadBudget = 10 * time.Second
+	// Until the daemon is ready
+	faultReadyTimeout = 30 * time.Second
+)
+
+// A daemon whose clangd is fakeclangd, following a script, in a project of
+// its own
+type faultDaemon struct {
+	t          *testing.T
+	binaryPath string
+	root       string
+	env        []string
+	socketPath string
+	pid        int
+}
+
+// Builds fakeclangd, installs it as clangd and starts a daemon that uses it,
+// in a small project in a temporary directory. The script is the JSON
+// described by fakeclangd's Script type, env adds to the daemon's environment.
+func startFaultDaemon(t *testing.T, script string, env ...string) *faultDaemon {
+	t.Helper()
+	tc := GetTestContext(t)
+	dir := t.TempDir()
+
+	// The daemon finds clangd on its PATH
+	binDir := filepath.Join(dir, "bin")
+	build := exec.Command("go", "build", "-o", filepath.Join(binDir, "clangd"), "./fakeclangd")
+	if output, err := build.CombinedOutput(); err != nil {
+		t.Fatalf("Failed to build fakeclangd: %v\n%s", err, output)
+	}
+	scriptPath := filepath.Join(dir, "script.json")
+	writeFile(t, scriptPath, script)
+
+	// The compilation database is newer than the CMake files, so it's used
+	// as is
+	root := filepath.Join(dir, "project")
+	writeFile(t, filepath.Join(root, "CMakeLists.txt"), "cmake_minimum_required(VERSION 3.16)\nproject(fault)\nadd_executable(fault src/main.cpp)\n")
+	writeFile(t, filepath.Join(root, "src", "main.cpp"), "int main() { return 0; }\n")
+	time.Sleep(10 * time.Millisecond)
+	writeFile(t, filepath.Join(root, "compile_commands.json"), fmt.Sprintf(
+		`[{"directory":%q,"file":%q,"command":"c++ -c src/main.cpp"}]`, root, filepath.Join(root, "src", "main.cpp")))
+
+	d := &faultDaemon{
+		t:          t,
+		binaryPath: tc.BinaryPath,
+		root:       root,
+		env: append(os.Environ(),
+			"PATH="+binDir+string(os.PathListSeparator)+os.Getenv("PATH"),
+			"FAKE_CLANGD_SCRIPT="+scriptPath,
+			"CLANGD_DAEMON_PREFETCH=0",
+			"CLANGD_DAEMON_PREWARM=0"),
+	}
+	d.env = append(d.env, env...)
+	d.run("status")
+	t.Cleanup(func() { d.run("shutdown") })
+
+	lockInfo, err := daemon.ReadLockFile(root)
+	if err != nil || lockInfo == nil {
+		t.Fatalf("Failed to read lock file: %v", err)
+	}
+	d.socketPath = lockInfo.SocketPath
+	d.pid = lockInfo.PID
+	return d
+}
+
+func writeFile(t *testing.T, path, content string) {
+	t.Helper()
+	if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+		t.Fatal(err)
+	}
+	if err := os.WriteFile(path, []byte(content), 0644); err != nil {
+		t.Fatal(err)
+	}
+}
+
+// Runs clangd-query in the project, with fakeclangd on its PATH
+func (d *faultDaemon) run(args ...string) string {
+	d.t.Helper()
+	cmd := exec.Command(d.binaryPath, args...)
+	cmd.Dir = d.root
+	cmd.Env = d.env
+	var output bytes.Buffer
+	cmd.Stdout = &output
+	cmd.Stderr = &output
+	if err := cmd.Run(); err != nil && args[0] != "shutdown" {
+		d.t.Fatalf("clangd-query %s failed: %v\n%s", strings.Join(args, " "), err, output.String())
+	}
+	return output.String()
+}
+
+// Returns a client on a connection of its own. A command that timed out
+// leaves its late response on the connection, so every command gets a new
+// one.
+func (d *faultDaemon) connect(timeout time.Duration) *client.Client {
+	d.t.Helper()
+	conn, err := net.Dial("unix", d.socketPath)
+	if err != nil {
+		d.t.Fatalf("Failed to connect to daemon: %v", err)
+	}
+	d.t.Cleanup(func() { conn.Close() })
+	return client.NewClient(conn, timeout)
+}
+
+func (d *faultDaemon) status() *client.StatusInfo {
+	d.t.Helper()
+	status, err := d.connect(5 * time.Second).GetStatus(false)
+	if err != nil {
+		d.t.Fatalf("Failed to get status: %v", err)
+	}
+	return status
+}
+
+// Waits until clangd finished indexing
+func (d *faultDaemon) waitReady() {
+	d.t.Helper()
+	deadline := time.Now().Add(faultReadyTimeout)
+	for {
+		status := d.status()
+		if status.Startup != nil && status.Startup.Phase == daemon.PhaseReady {
+			return
+		}
+		if time.Now().After(deadline) {
+			d.t.Fatalf("Daemon not ready after %v: %+v", faultReadyTimeout, status.Startup)
+		}
+		time.Sleep(100 * time.Millisecond)
+	}
+}
+
+// Runs a search with a query no earlier command used, so neither the result
+// cache nor coalescing answers it, and returns how long it took
+func (d *faultDaemon) search(query string, timeout time.Duration) (time.Duration, error) {
+	c := d.connect(timeout)
+	start := time.Now()
+	_, err := c.Search(query, 20)
+	return time.Since(start), err
+}
+
+func TestFaultLatencyTail(t *testing.T) {
+	const medianMs, p99Ms = 10, 60
+	d := startFaultDaemon(t, fmt.Sprintf(`{
+		"seed": 1,
+		"default": {"medianMs": 1},
+		"methods": {"workspace/symbol": {"medianMs": %d, "p99Ms": %d}}
+	}`, medianMs, p99Ms))
+	d.waitReady()
+
+	// As many clients as the daemon has workers
+	const clients, perClient = 4, 75
+	var mu sync.Mutex
+	var latencies []time.Duration
+	var wg sync.WaitGroup
+	for i := 0; i < clients; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			for j := 0; j < perClient; j++ {
+				latency, err := d.search(fmt.Sprintf("Tail%dx%d", i, j), 10*time.Second)
+				if err != nil {
+					t.Errorf("Search failed: %v", err)
+					return
+				}
+				mu.Lock()
+				latencies = append(latencies, latency)
+				mu.Unlock()
+			}
+		}(i)
+	}
+	wg.Wait()
+	if t.Failed() {
+		return
+	}
+
+	sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+	p50, p99 := percentile(latencies, 50), percentile(latencies, 99)
+	t.Logf("clangd p50/p99 %dms/%dms, daemon p50/p99 %v/%v", medianMs, p99Ms,
+		p50.Round(time.Millisecond), p99.Round(time.Millisecond))
+	// Samples of the scripted distribution scatter around its p99
+	if budget := p99Ms*time.Millisecond*3/2 + faultLatencyOverhead; p99 > budget {
+		t.Errorf("Expected a p99 latency within %v, got %v", budget, p99)
+	}
+}
+
+func TestFaultErrors(t *testing.T) {
+	d := startFaultDaemon(t, `{"methods": {"workspace/symbol": {"errorRate": 1}}}`)
+	d.waitReady()
+
+	for i := 0; i < 5; i++ {
+		latency, err := d.search(fmt.Sprintf("Error%d", i), 10*time.Second)
+		if err == nil || !strings.Contains(err.Error(), "injected failure") {
+			t.Errorf("Expected the error of clangd, got %v", err)
+		}
+		if latency > faultFailureBudget {
+			t.Errorf("Expected the error within %v, got it after %v", faultFailureBudget, latency)
+		}
+	}
+	if status := d.status(); status.Startup == nil || status.Startup.Phase != daemon.PhaseReady {
+		t.Errorf("Expected the daemon to stay ready, got %+v", status.Startup)
+	}
+}
+
+func TestFaultDroppedResponses(t *testing.T) {
+	d := startFaultDaemon(t, `{"seed": 2, "methods": {"workspace/symbol": {"medianMs": 2, "dropRate": 0.3}}}`)
+	d.waitReady()
+
+	const timeout = time.Second
+	timeouts := 0
+	for i := 0; i < 30; i++ {
+		latency, err := d.search(fmt.Sprintf("Dropped%d", i), timeout)
+		if err != nil {
+			timeouts++
+			if latency > timeout+faultFailureBudget {
+				t.Errorf("Expected the command to give up after %v, took %v", timeout, latency)
+			}
+		} else if latency > timeout/2 {
+			t.Errorf("Answered search took %v", latency)
+		}
+	}
+	if timeouts == 0 || timeouts == 30 {
+		t.Fatalf("Expected some of the searches to time out, %d of 30 did", timeouts)
+	}
+
+	// The daemon told clangd to stop working on every abandoned request
+	deadline := time.Now().Add(faultFailureBudget)
+	for {
+		status := d.status()
+		if status.Scheduler != nil && status.Scheduler.CancelledClangdRequests >= int64(timeouts) {
+			break
+		}
+		if time.Now().After(deadline) {
+			t.Fatalf("Expected %d cancelled clangd requests, got %+v", timeouts, status.Scheduler)
+		}
+		time.Sleep(50 * time.Millisecond)
+	}
+}
+
+func TestFaultCrashRecovery(t *testing.T) {
+	d := startFaultDaemon(t, `{"crashAfter": 1, "crashMethod": "textDocument/hover", "crashStarts": 1}`)
+	d.waitReady()
+
+	// signature hovers the functions it finds, the first hover crashes clangd
+	// in the middle of its response
+	output, err := d.connect(10 * time.Second).Signature("Crash")
+	if err == nil && !strings.Contains(output, "Error getting documentation") {
+		t.Fatalf("Expected signature to fail when clangd crashed, got:\n%s", output)
+	}
+
+	start := time.Now()
+	for i := 0; ; i++ {
+		if _, err := d.search(fmt.Sprintf("Recovered%d", i), 5*time.Second); err == nil {
+			break
+		}
+		if time.Since(start) > faultRecoveryBudget {
+			t.Fatalf("Searches still fail %v after the crash", faultRecoveryBudget)
+		}
+		time.Sleep(100 * time.Millisecond)
+	}
+	t.Logf("Recovered after %v", time.Since(start).Round(time.Millisecond))
+
+	// The restarted clangd doesn't crash
+	output, err = d.connect(10 * time.Second).Signature("NoCrash")
+	if err != nil || strings.Contains(output, "Error getting documentation") {
+		t.Errorf("Signature failed after the restart: %v\n%s", err, output)
+	}
+	if status := d.status(); status.StartTimes == nil || status.StartTimes.Crashes != 1 {
+		t.Errorf("Expected status to count 1 crash, got %+v", status.StartTimes)
+	}
+}
+
+func TestFaultHungShutdown(t *testing.T) {
+	// clangd never answers shutdown, and the memory governor restarts it at its
+	// first sample
+	d := startFaultDaemon(t, `{"methods": {"shutdown": {"dropRate": 1}}}`, "CLANGD_DAEMON_MEMORY_HARD=1")
+	d.waitReady()
+
+	// The old clangd takes until the request timeout to refuse shutdown.
+	// Status keeps answering meanwhile, and so does the new clangd.
+	status := func() *client.StatusInfo {
+		start := time.Now()
+		status := d.status()
+		if latency := time.Since(start); latency > faultFailureBudget {
+			t.Fatalf("Expected status within %v while clangd refuses shutdown, took %v", faultFailureBudget, latency)
+		}
+		return status
+	}
+	deadline := time.Now().Add(faultRecoveryBudget)
+	for {
+		if s := status(); s.Memory != nil && s.Memory.Restarts > 0 {
+			break
+		}
+		if time.Now().After(deadline) {
+			t.Fatalf("Expected the memory governor to restart clangd within %v", faultRecoveryBudget)
+		}
+		time.Sleep(50 * time.Millisecond)
+	}
+	start := time.Now()
+	for i := 0; ; i++ {
+		status()
+		if _, err := d.search(fmt.Sprintf("Restarted%d", i), 5*time.Second); err == nil {
+			break
+		}
+		if time.Since(start) > faultRecoveryBudget {
+			t.Fatalf("Searches still fail %v after the restart", faultRecoveryBudget)
+		}
+		time.Sleep(100 * time.Millisecond)
+	}
+	t.Logf("Searches answered %v after the restart", time.Since(start).Round(time.Millisecond))
+}
+
+func TestFaultHugePayload(t *testing.T) {
+	const payload = 64 << 20
+	d := startFaultDaemon(t, fmt.Sprintf(`{"methods": {"workspace/symbol": {"payloadBytes": %d}}}`, payload))
+	d.waitReady()
+
+	for i := 0; i < 3; i++ {
+		latency, err := d.search(fmt.Sprintf("Huge%d", i), 2*faultPayloadBudget)
+		if err != nil {
+			t.Fatalf("Search of a %dMB result failed: %v", payload>>20, err)
+		}
+		t.Logf("Search of a %dMB result took %v", payload>>20, latency.Round(time.Millisecond))
+		if latency > faultPayloadBudget {
+			t.Errorf("Expected the search within %v, got %v", faultPayloadBudget, latency)
+		}
+	}
+
+	// Each result is let go once the command has its 20 symbols
+	rss := readPeakRSS(d.pid)
+	t.Logf("Peak RSS of the daemon %dMB", rss>>20)
+	if rss > faultPayloadMemoryBudget {
+		t.Errorf("Expected the daemon's peak RSS within %dMB, got %dMB", faultPayloadMemoryBudget>>20, rss>>20)
+	}
+}
+
+func TestFaultProgressStorm(t *testing.T) {
+	d := startFaultDaemon(t, `{"progressStorm": 200000, "outOfOrder": true}`)
+
+	// Commands are answered while the notifications pour in
+	var latencies []time.Duration
+	for i := 0; i < 50; i++ {
+		latency, err := d.search(fmt.Sprintf("Storm%d", i), 10*time.Second)
+		if err != nil {
+			t.Fatalf("Search failed during the storm: %v", err)
+		}
+		latencies = append(latencies, latency)
+	}
+	sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+	if p99 := percentile(latencies, 99); p99 > faultLatencyOverhead*4 {
+		t.Errorf("Expected a p99 latency within %v during the storm, got %v", faultLatencyOverhead*4, p99)
+	}
+
+	// Indexing ends with the last notification, even though an end arrived
+	// before the beginning
+	d.waitReady()
+	rss := readPeakRSS(d.pid)
+	t.Logf("Peak RSS of the daemon %dMB", rss>>20)
+	if rss > faultMemoryBudget {
+		t.Errorf("Expected the daemon's peak RSS within %dMB, got %dMB", faultMemoryBudget>>20, rss>>20)
+	}
+}
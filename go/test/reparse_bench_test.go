@@ -0,0 +1,117 @@
+package test
+
+import (
+	"fmt"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"testing"
+
+	"clangd-query/internal/clangd"
+	"clangd-query/internal/daemon"
+	"clangd-query/internal/logger"
+)
+
+// The file the re-parse benchmarks edit, relative to the sample project
+const reparseBenchFile = "src/main.cpp"
+
+// BenchmarkReparseDidChange measures how long clangd takes to answer a query
+// about a document after an edit sent as an incremental didChange.
+func BenchmarkReparseDidChange(b *testing.B) {
+	client, path, original := startReparseBench(b)
+	uri := client.FileURIFromPath(path)
+
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if err := client.ChangeDocument(uri, editedSource(original, i)); err != nil {
+			b.Fatal(err)
+		}
+		if _, err := client.GetDocumentSymbols(uri); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+// BenchmarkReparseCloseReopen measures the same edit and query as
+// BenchmarkReparseDidChange, with the document closed and reopened instead,
+// as the daemon used to do.
+func BenchmarkReparseCloseReopen(b *testing.B) {
+	client, path, original := startReparseBench(b)
+	uri := client.FileURIFromPath(path)
+
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if err := os.WriteFile(path, []byte(editedSource(original, i)), 0644); err != nil {
+			b.Fatal(err)
+		}
+		if err := client.CloseDocument(uri); err != nil {
+			b.Fatal(err)
+		}
+		if err := client.OpenDocument(uri); err != nil {
+			b.Fatal(err)
+		}
+		if _, err := client.GetDocumentSymbols(uri); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+// Starts clangd on a copy of the sample project, with the benchmarked file
+// opened and parsed. Returns the client, the path of the file and its
+// original content.
+func startReparseBench(b *testing.B) (*clangd.ClangdClient, string, string) {
+	b.Helper()
+	projectRoot := b.TempDir()
+	if err := copyTree(globalTestContext.SampleProjectPath, projectRoot); err != nil {
+		b.Fatalf("Failed to copy the sample project: %v", err)
+	}
+
+	log := &logger.NullLogger{}
+	db, err := daemon.EnsureCompilationDatabase(projectRoot, log)
+	if err != nil {
+		b.Fatalf("Failed to create compilation database: %v", err)
+	}
+	client, err := clangd.NewClangdClient(projectRoot, db.Dir, nil, log)
+	if err != nil {
+		b.Fatalf("Failed to start clangd: %v", err)
+	}
+	b.Cleanup(func() { client.Stop() })
+
+	path := filepath.Join(projectRoot, reparseBenchFile)
+	original, err := os.ReadFile(path)
+	if err != nil {
+		b.Fatal(err)
+	}
+	if _, err := client.GetDocumentSymbols(client.FileURIFromPath(path)); err != nil {
+		b.Fatal(err)
+	}
+	return client, path, string(original)
+}
+
+// Returns the source with a function appended that differs per iteration,
+// so every edit is a real change
+func editedSource(original string, i int) string {
+	return original + fmt.Sprintf("\nstatic int reparseBench() { return %d; }\n", i)
+}
+
+// Copies the files of a directory tree
+func copyTree(src, dst string) error {
+	return filepath.WalkDir(src, func(path string, entry fs.DirEntry, err error) error {
+		if err != nil {
+			return err
+		}
+		rel, err := filepath.Rel(src, path)
+		if err != nil {
+			return err
+		}
+		target := filepath.Join(dst, rel)
+		if entry.IsDir() {
+			return os.MkdirAll(target, 0755)
+		}
+		data, err := os.ReadFile(path)
+		if err != nil {
+			return err
+		}
+		return os.WriteFile(target, data, 0644)
+	})
+}
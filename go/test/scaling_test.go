@@ -0,0 +1,288 @@
+package test
+
+import (
+	"bytes"
+	"encoding/csv"
+	"fmt"
+	"net"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+	"testing"
+	"time"
+
+	"clangd-query/internal/client"
+	"clangd-query/internal/daemon"
+	"clangd-query/internal/projectgen"
+)
+
+// How long a generated project may take to become ready, and a command on it
+const (
+	scalingReadyTimeout   = 2 * time.Hour
+	scalingCommandTimeout = 5 * time.Minute
+)
+
+// A command measured at every project size, run on a different class of the
+// project each time so the result cache doesn't answer it
+type scalingCommand struct {
+	name string
+	run  func(c *client.Client, class projectgen.Class) (string, error)
+}
+
+var scalingCommands = []scalingCommand{
+	{"search", func(c *client.Client, class projectgen.Class) (string, error) {
+		return c.Search(class.Name, 20)
+	}},
+	{"show", func(c *client.Client, class projectgen.Class) (string, error) {
+		return c.Show(class.Name + "::" + class.Methods[0])
+	}},
+	{"view", func(c *client.Client, class projectgen.Class) (string, error) {
+		return c.View(class.Name)
+	}},
+	{"usages", func(c *client.Client, class projectgen.Class) (string, error) {
+		return c.Usages(class.Name, 20)
+	}},
+	{"hierarchy", func(c *client.Client, class projectgen.Class) (string, error) {
+		return c.Hierarchy(class.Name, 20)
+	}},
+	{"signature", func(c *client.Client, class projectgen.Class) (string, error) {
+		return c.Signature(class.Name + "::" + class.Methods[0])
+	}},
+	{"interface", func(c *client.Client, class projectgen.Class) (string, error) {
+		return c.Interface(class.Name)
+	}},
+}
+
+// Measurements of one project size
+type scalingResult struct {
+	translationUnits int
+	startup          time.Duration // Until the daemon accepted the first command
+	ready            time.Duration // Until clangd finished indexing
+	clangdPeakRSS    int64
+	daemonPeakRSS    int64
+	latencies        map[string][]time.Duration // By command, sorted
+}
+
+// TestScaling measures how the daemon and clangd scale with the size of a
+// project, on projects generated by projectgen: the time until the daemon
+// serves commands, the time until clangd finished indexing, the peak RSS of
+// both processes, and the latency percentiles of each command. It only runs
+// when CLANGD_QUERY_SCALING_SIZES lists the numbers of translation units to
+// measure, e.g.
+//
+//	CLANGD_QUERY_SCALING_SIZES=1000,5000,20000,50000 go test ./test -run TestScaling -timeout 0 -v
+//
+// CLANGD_QUERY_SCALING_RUNS sets how often each command runs per size (20 by
+// default). The results are logged as a table, and written as CSV to the
+// file in CLANGD_QUERY_SCALING_OUT if it is set.
+func TestScaling(t *testing.T) {
+	sizesEnv := os.Getenv("CLANGD_QUERY_SCALING_SIZES")
+	if sizesEnv == "" {
+		t.Skip("set CLANGD_QUERY_SCALING_SIZES to measure scaling")
+	}
+	var sizes []int
+	for _, field := range strings.Split(sizesEnv, ",") {
+		size, err := strconv.Atoi(strings.TrimSpace(field))
+		if err != nil {
+			t.Fatalf("Invalid size %q in CLANGD_QUERY_SCALING_SIZES", field)
+		}
+		sizes = append(sizes, size)
+	}
+	runs := 20
+	if value := os.Getenv("CLANGD_QUERY_SCALING_RUNS"); value != "" {
+		var err error
+		if runs, err = strconv.Atoi(value); err != nil || runs < 1 {
+			t.Fatalf("Invalid CLANGD_QUERY_SCALING_RUNS %q", value)
+		}
+	}
+
+	tc := GetTestContext(t)
+	var results []scalingResult
+	for _, size := range sizes {
+		result := measureScaling(t, tc.BinaryPath, size, runs)
+		results = append(results, result)
+		t.Logf("%d translation units: started in %v, ready in %v", size,
+			result.startup.Round(time.Millisecond), result.ready.Round(time.Millisecond))
+	}
+
+	t.Log("\n" + formatScalingTable(results))
+	if path := os.Getenv("CLANGD_QUERY_SCALING_OUT"); path != "" {
+		if err := writeScalingCSV(path, results); err != nil {
+			t.Fatalf("Failed to write results: %v", err)
+		}
+	}
+}
+
+// Generates a project, starts a daemon in it and measures it
+func measureScaling(t *testing.T, binaryPath string, size, runs int) scalingResult {
+	t.Helper()
+	root := filepath.Join(t.TempDir(), fmt.Sprintf("project-%d", size))
+	project, err := projectgen.Generate(root, projectgen.Options{TranslationUnits: size, Seed: 1})
+	if err != nil {
+		t.Fatalf("Failed to generate project: %v", err)
+	}
+	result := scalingResult{translationUnits: size, latencies: make(map[string][]time.Duration)}
+
+	// The first command starts the daemon and returns once it is served
+	start := time.Now()
+	cmd := exec.Command(binaryPath, "status")
+	cmd.Dir = root
+	var output bytes.Buffer
+	cmd.Stdout = &output
+	cmd.Stderr = &output
+	if err := cmd.Run(); err != nil {
+		t.Fatalf("Failed to start daemon: %v\n%s", err, output.String())
+	}
+	result.startup = time.Since(start)
+	defer func() {
+		shutdown := exec.Command(binaryPath, "shutdown")
+		shutdown.Dir = root
+		shutdown.Run()
+	}()
+
+	lockInfo, err := daemon.ReadLockFile(root)
+	if err != nil || lockInfo == nil {
+		t.Fatalf("Failed to read lock file: %v", err)
+	}
+	conn, err := net.Dial("unix", lockInfo.SocketPath)
+	if err != nil {
+		t.Fatalf("Failed to connect to daemon: %v", err)
+	}
+	defer conn.Close()
+	c := client.NewClient(conn, scalingCommandTimeout)
+
+	// Indexing is done when the daemon leaves its last startup phase
+	for {
+		status, err := c.GetStatus(false)
+		if err != nil {
+			t.Fatalf("Failed to get status: %v", err)
+		}
+		if status.Startup != nil && status.Startup.Phase == daemon.PhaseFailed {
+			t.Fatalf("Daemon failed to start: %s", status.Startup.Error)
+		}
+		if status.Startup != nil && status.Startup.Phase == daemon.PhaseReady {
+			break
+		}
+		if time.Since(start) > scalingReadyTimeout {
+			t.Fatalf("Project of %d translation units not ready after %v", size, scalingReadyTimeout)
+		}
+		time.Sleep(time.Second)
+	}
+	result.ready = time.Since(start)
+
+	// Classes spread over the whole project
+	for _, command := range scalingCommands {
+		latencies := make([]time.Duration, 0, runs)
+		for i := 0; i < runs; i++ {
+			class := project.Classes[(2*i+1)*len(project.Classes)/(2*runs)]
+			start := time.Now()
+			if _, err := command.run(c, class); err != nil {
+				t.Fatalf("%s of %s failed: %v", command.name, class.Name, err)
+			}
+			latencies = append(latencies, time.Since(start))
+		}
+		sort.Slice(latencies, func(i, j int) bool { return latencies[i] < latencies[j] })
+		result.latencies[command.name] = latencies
+	}
+
+	result.daemonPeakRSS = readPeakRSS(lockInfo.PID)
+	if pid := findClangdPID(root); pid != 0 {
+		result.clangdPeakRSS = readPeakRSS(pid)
+	}
+	return result
+}
+
+// Returns the PID of the clangd serving a project, 0 if there is none
+func findClangdPID(projectPath string) int {
+	flag := "--compile-commands-dir=" + filepath.Join(projectPath, ".cache", "clangd-query", "build")
+	cmdlines, _ := filepath.Glob("/proc/[0-9]*/cmdline")
+	for _, path := range cmdlines {
+		data, err := os.ReadFile(path)
+		if err != nil {
+			continue // Process exited
+		}
+		args := strings.Split(string(data), "\x00")
+		if filepath.Base(args[0]) == "clangd" && strings.Contains(string(data), flag) {
+			pid, _ := strconv.Atoi(filepath.Base(filepath.Dir(path)))
+			return pid
+		}
+	}
+	return 0
+}
+
+// Returns the peak RSS of a process in bytes from /proc, 0 if unknown
+func readPeakRSS(pid int) int64 {
+	data, err := os.ReadFile(fmt.Sprintf("/proc/%d/status", pid))
+	if err != nil {
+		return 0
+	}
+	for _, line := range strings.Split(string(data), "\n") {
+		if value, ok := strings.CutPrefix(line, "VmHWM:"); ok {
+			kb, _ := strconv.ParseInt(strings.TrimSuffix(strings.TrimSpace(value), " kB"), 10, 64)
+			return kb * 1024
+		}
+	}
+	return 0
+}
+
+// Returns the latency at a percentile of sorted latencies
+func percentile(latencies []time.Duration, p float64) time.Duration {
+	index := int(p / 100 * float64(len(latencies)))
+	if index >= len(latencies) {
+		index = len(latencies) - 1
+	}
+	return latencies[index]
+}
+
+func formatScalingTable(results []scalingResult) string {
+	var b strings.Builder
+	fmt.Fprintf(&b, "%8s %10s %10s %12s %12s", "TUs", "startup", "ready", "clangd peak", "daemon peak")
+	for _, command := range scalingCommands {
+		fmt.Fprintf(&b, " %19s", command.name+" p50/p99")
+	}
+	b.WriteByte('\n')
+	for _, r := range results {
+		fmt.Fprintf(&b, "%8d %10v %10v %10dMB %10dMB", r.translationUnits,
+			r.startup.Round(time.Millisecond), r.ready.Round(time.Second),
+			r.clangdPeakRSS>>20, r.daemonPeakRSS>>20)
+		for _, command := range scalingCommands {
+			latencies := r.latencies[command.name]
+			fmt.Fprintf(&b, " %19s", fmt.Sprintf("%v/%v",
+				percentile(latencies, 50).Round(time.Millisecond), percentile(latencies, 99).Round(time.Millisecond)))
+		}
+		b.WriteByte('\n')
+	}
+	return b.String()
+}
+
+// Writes one row per size and command, with times in milliseconds and
+// memory in bytes
+func writeScalingCSV(path string, results []scalingResult) error {
+	file, err := os.Create(path)
+	if err != nil {
+		return err
+	}
+	defer file.Close()
+
+	w := csv.NewWriter(file)
+	w.Write([]string{"translation_units", "startup_ms", "ready_ms", "clangd_peak_rss", "daemon_peak_rss",
+		"command", "p50_ms", "p99_ms"})
+	ms := func(d time.Duration) string {
+		return strconv.FormatFloat(float64(d)/float64(time.Millisecond), 'f', 1, 64)
+	}
+	for _, r := range results {
+		for _, command := range scalingCommands {
+			latencies := r.latencies[command.name]
+			w.Write([]string{
+				strconv.Itoa(r.translationUnits), ms(r.startup), ms(r.ready),
+				strconv.FormatInt(r.clangdPeakRSS, 10), strconv.FormatInt(r.daemonPeakRSS, 10),
+				command.name, ms(percentile(latencies, 50)), ms(percentile(latencies, 99)),
+			})
+		}
+	}
+	w.Flush()
+	return w.Error()
+}
@@ -75,3 +75,44 @@ func TestSearchCommand(t *testing.T) {
 		tc.AssertContains(result.Stdout, "Updatable")
 	})
 }
+
+func TestSearchPatternCommand(t *testing.T) {
+	tc := GetTestContext(t)
+
+	t.Run("Glob search on qualified names", func(t *testing.T) {
+		result := tc.RunCommand("search", "--glob", "*System::Update")
+		tc.AssertExitCode(result, 0)
+		tc.AssertContains(result.Stdout, "matching glob \"*System::Update\"")
+		tc.AssertContains(result.Stdout, "- `game_engine::InputSystem::Update` at src/systems/input_system.cpp:17:19 [method]")
+		tc.AssertContains(result.Stdout, "- `game_engine::PhysicsSystem::Update` at src/systems/physics_system.cpp:37:21 [method]")
+		tc.AssertNotContains(result.Stdout, "GameObject::Update")
+	})
+
+	t.Run("Regex search on unqualified names", func(t *testing.T) {
+		result := tc.RunCommand("search", "--regex", "^GameObject$")
+		tc.AssertExitCode(result, 0)
+		tc.AssertContains(result.Stdout, "- `game_engine::GameObject` at include/core/game_object.h:26:7 [class]")
+		tc.AssertNotContains(result.Stdout, "CreateGameObject")
+	})
+
+	t.Run("Regex search with kind filter", func(t *testing.T) {
+		result := tc.RunCommand("search", "--regex", "System$", "--kind", "class")
+		tc.AssertExitCode(result, 0)
+		tc.AssertContains(result.Stdout, "game_engine::PhysicsSystem` at")
+		tc.AssertContains(result.Stdout, "game_engine::RenderSystem` at")
+		tc.AssertNotContains(result.Stdout, "[method]")
+	})
+
+	t.Run("Glob search with path filter", func(t *testing.T) {
+		result := tc.RunCommand("search", "--glob", "Update", "--path", "src/core/")
+		tc.AssertExitCode(result, 0)
+		tc.AssertContains(result.Stdout, "game_engine::GameObject::Update")
+		tc.AssertNotContains(result.Stdout, "PhysicsSystem::Update")
+	})
+
+	t.Run("Invalid regex", func(t *testing.T) {
+		result := tc.RunCommand("search", "--regex", "Update(")
+		tc.AssertExitCode(result, 1)
+		tc.AssertContains(result.Stderr, "invalid regular expression")
+	})
+}
@@ -0,0 +1,74 @@
+package test
+
+import (
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"testing"
+	"time"
+)
+
+// countClangdProcesses returns how many clangd processes are serving the
+// sample project, by scanning /proc for their --compile-commands-dir flag.
+func countClangdProcesses(t *testing.T, projectPath string) int {
+	buildDir := filepath.Join(projectPath, ".cache", "clangd-query", "build")
+	cmdlines, err := filepath.Glob("/proc/[0-9]*/cmdline")
+	if err != nil {
+		t.Fatalf("Failed to list processes: %v", err)
+	}
+
+	count := 0
+	for _, path := range cmdlines {
+		data, err := os.ReadFile(path)
+		if err != nil {
+			continue // Process exited
+		}
+		args := strings.Split(string(data), "\x00")
+		if filepath.Base(args[0]) == "clangd" && strings.Contains(string(data), "--compile-commands-dir="+buildDir) {
+			count++
+		}
+	}
+	return count
+}
+
+func TestConcurrentClientsStartOneDaemon(t *testing.T) {
+	if _, err := os.Stat("/proc/self/cmdline"); err != nil {
+		t.Skip("requires /proc")
+	}
+	tc := GetTestContext(t)
+
+	// Start from a cold project with no daemon running
+	tc.ShutdownDaemon()
+	lockPath := filepath.Join(tc.SampleProjectPath, ".clangd-query.lock")
+	for i := 0; i < 100; i++ {
+		if _, err := os.Stat(lockPath); os.IsNotExist(err) && countClangdProcesses(t, tc.SampleProjectPath) == 0 {
+			break
+		}
+		time.Sleep(100 * time.Millisecond)
+	}
+	if n := countClangdProcesses(t, tc.SampleProjectPath); n != 0 {
+		t.Fatalf("Expected no clangd after shutdown, found %d", n)
+	}
+
+	const clients = 8
+	var wg sync.WaitGroup
+	results := make([]*CommandResult, clients)
+	for i := 0; i < clients; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			results[i] = tc.RunCommandWithTimeout([]string{"search", "GameObject"}, 60*time.Second)
+		}(i)
+	}
+	wg.Wait()
+
+	for _, result := range results {
+		tc.AssertExitCode(result, 0)
+		tc.AssertContains(result.Stdout, "GameObject")
+	}
+
+	if n := countClangdProcesses(t, tc.SampleProjectPath); n != 1 {
+		t.Errorf("Expected exactly one clangd after %d concurrent clients, found %d", clients, n)
+	}
+}
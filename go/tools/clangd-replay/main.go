@@ -0,0 +1,46 @@
+// Command clangd-replay pretends to be clangd by replaying an LSP session
+// recorded with CLANGD_DAEMON_LSP_RECORD. Installed as clangd in front of the
+// real one on PATH, it lets the daemon and the end-to-end tests run without
+// clangd and with repeatable timing, e.g.
+//
+//	go build -o /tmp/replay/clangd ./tools/clangd-replay
+//	PATH=/tmp/replay:$PATH CLANGD_REPLAY_FILE=/tmp/session.jsonl clangd-query show Engine
+//
+// CLANGD_REPLAY_SCALE multiplies the recorded latencies: 1 (the default)
+// replays them as recorded, 0 answers immediately. Command line arguments
+// meant for clangd are ignored.
+package main
+
+import (
+	"fmt"
+	"os"
+	"strconv"
+
+	"clangd-query/internal/replay"
+)
+
+func main() {
+	path := os.Getenv("CLANGD_REPLAY_FILE")
+	if path == "" {
+		fmt.Fprintln(os.Stderr, "clangd-replay: CLANGD_REPLAY_FILE must name a recorded session")
+		os.Exit(1)
+	}
+	scale := 1.0
+	if value := os.Getenv("CLANGD_REPLAY_SCALE"); value != "" {
+		var err error
+		if scale, err = strconv.ParseFloat(value, 64); err != nil || scale < 0 {
+			fmt.Fprintf(os.Stderr, "clangd-replay: invalid CLANGD_REPLAY_SCALE %q\n", value)
+			os.Exit(1)
+		}
+	}
+
+	server, err := replay.Load(path, scale)
+	if err != nil {
+		fmt.Fprintf(os.Stderr, "clangd-replay: %v\n", err)
+		os.Exit(1)
+	}
+	if err := server.Serve(os.Stdin, os.Stdout); err != nil {
+		fmt.Fprintf(os.Stderr, "clangd-replay: %v\n", err)
+		os.Exit(1)
+	}
+}
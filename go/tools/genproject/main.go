@@ -0,0 +1,33 @@
+// Command genproject generates a synthetic C++ project in the style of the
+// sample project, for measuring how clangd-query scales, e.g.
+//
+//	go run ./tools/genproject -tus 10000 -out /tmp/project-10k
+package main
+
+import (
+	"flag"
+	"fmt"
+	"os"
+
+	"clangd-query/internal/projectgen"
+)
+
+func main() {
+	translationUnits := flag.Int("tus", 1000, "number of translation units")
+	seed := flag.Int64("seed", 1, "seed of the generated names and structure")
+	out := flag.String("out", "", "directory to generate the project into")
+	flag.Parse()
+
+	if *out == "" {
+		fmt.Fprintln(os.Stderr, "Usage: genproject -out <dir> [-tus <n>] [-seed <n>]")
+		os.Exit(1)
+	}
+
+	project, err := projectgen.Generate(*out, projectgen.Options{TranslationUnits: *translationUnits, Seed: *seed})
+	if err != nil {
+		fmt.Fprintf(os.Stderr, "Error: %v\n", err)
+		os.Exit(1)
+	}
+	fmt.Printf("Generated %d translation units with %d classes in %s\n",
+		*translationUnits, len(project.Classes), project.Root)
+}